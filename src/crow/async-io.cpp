@@ -0,0 +1,775 @@
+#include "crow/async-io.hpp"
+#include "crow/stdio.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <thread>
+
+#ifdef __linux__
+    #include <linux/io_uring.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+#endif
+
+#ifdef _XOPEN_SOURCE
+    #include <unistd.h>
+#else
+    #include <io.h>
+    #include <windows.h>
+#endif
+
+namespace Crow {
+
+    namespace Detail {
+
+        // One read or write request, resubmitted until the whole range
+        // has been transferred, EOF is reached, or an error occurs
+
+        struct AsyncOp {
+            bool is_write = false;
+            int fd = -1;
+            std::byte* ptr = nullptr;
+            size_t len = 0;
+            uint64_t offset = 0;
+            size_t done = 0;
+            std::function<void(size_t, int)> finish;
+        };
+
+        #ifdef __linux__
+
+            // The ring is driven through the raw system calls rather than
+            // liburing. Requests are queued in a backlog and moved into the
+            // submission ring only while the number in flight is below the
+            // completion ring capacity, so completions can never overflow.
+
+            class UringQueue {
+
+            public:
+
+                UringQueue(AsyncIo& owner, unsigned entries);
+                ~UringQueue() noexcept;
+                UringQueue(const UringQueue&) = delete;
+                UringQueue& operator=(const UringQueue&) = delete;
+
+                void push(AsyncOp* op);
+                void submit();
+
+            private:
+
+                static constexpr size_t max_chunk = size_t(1) << 30;
+
+                AsyncIo& owner_;
+                int ring_fd_ = -1;
+                void* sq_map_ = nullptr;
+                size_t sq_map_size_ = 0;
+                void* cq_map_ = nullptr;
+                size_t cq_map_size_ = 0;
+                io_uring_sqe* sqes_ = nullptr;
+                size_t sqes_size_ = 0;
+                unsigned* sq_head_ = nullptr;
+                unsigned* sq_tail_ = nullptr;
+                unsigned* sq_mask_ = nullptr;
+                unsigned* sq_array_ = nullptr;
+                unsigned sq_entries_ = 0;
+                unsigned* cq_head_ = nullptr;
+                unsigned* cq_tail_ = nullptr;
+                unsigned* cq_mask_ = nullptr;
+                io_uring_cqe* cqes_ = nullptr;
+                unsigned cq_entries_ = 0;
+                std::mutex mutex_;
+                std::deque<AsyncOp*> backlog_;
+                std::atomic<unsigned> in_flight_ = 0;
+                std::atomic<bool> stopping_ = false;
+                std::thread completion_thread_;
+
+                int enter(unsigned to_submit, unsigned min_complete, unsigned flags) noexcept;
+                void handle(const io_uring_cqe& cqe) noexcept;
+                void release() noexcept;
+                bool push_locked(AsyncOp* op) noexcept;
+                void submit_locked();
+                void completion_loop() noexcept;
+
+            };
+
+            UringQueue::UringQueue(AsyncIo& owner, unsigned entries):
+            owner_(owner) {
+
+                io_uring_params params;
+                std::memset(&params, 0, sizeof(params));
+                ring_fd_ = int(::syscall(__NR_io_uring_setup, entries, &params));
+                if (ring_fd_ < 0)
+                    throw IoError(errno, "io_uring_setup()");
+
+                auto fail = [this] (int err, const char* function) {
+                    release();
+                    throw IoError(err, function);
+                };
+
+                // IORING_OP_READ and IORING_OP_WRITE arrived in the same
+                // kernel release as IORING_FEAT_RW_CUR_POS
+
+                if (! (params.features & IORING_FEAT_RW_CUR_POS))
+                    fail(ENOSYS, "io_uring_setup()");
+
+                sq_map_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                cq_map_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if (single)
+                    sq_map_size_ = cq_map_size_ = std::max(sq_map_size_, cq_map_size_);
+
+                sq_map_ = ::mmap(nullptr, sq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd_, IORING_OFF_SQ_RING);
+                if (sq_map_ == MAP_FAILED) {
+                    sq_map_ = nullptr;
+                    fail(errno, "mmap()");
+                }
+
+                if (single) {
+                    cq_map_ = sq_map_;
+                } else {
+                    cq_map_ = ::mmap(nullptr, cq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring_fd_, IORING_OFF_CQ_RING);
+                    if (cq_map_ == MAP_FAILED) {
+                        cq_map_ = nullptr;
+                        fail(errno, "mmap()");
+                    }
+                }
+
+                sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+                auto sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd_, IORING_OFF_SQES);
+                if (sqes == MAP_FAILED)
+                    fail(errno, "mmap()");
+                sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+                auto sq = static_cast<char*>(sq_map_);
+                auto cq = static_cast<char*>(cq_map_);
+                sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+                sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+                sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+                sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+                sq_entries_ = params.sq_entries;
+                cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+                cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+                cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+                cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+                cq_entries_ = params.cq_entries;
+
+                completion_thread_ = std::thread([this] { completion_loop(); });
+
+            }
+
+            UringQueue::~UringQueue() noexcept {
+                if (completion_thread_.joinable()) {
+                    // The owner has already waited for all requests, so the
+                    // ring is empty; a no-op with null user data wakes the
+                    // completion thread so it can see the stop flag
+                    stopping_ = true;
+                    {
+                        std::unique_lock lock(mutex_);
+                        push_locked(nullptr);
+                        while (enter(1, 0, 0) < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY))
+                            std::this_thread::yield();
+                    }
+                    completion_thread_.join();
+                }
+                release();
+            }
+
+            void UringQueue::push(AsyncOp* op) {
+                std::unique_lock lock(mutex_);
+                backlog_.push_back(op);
+            }
+
+            void UringQueue::submit() {
+                std::unique_lock lock(mutex_);
+                submit_locked();
+            }
+
+            int UringQueue::enter(unsigned to_submit, unsigned min_complete, unsigned flags) noexcept {
+                return int(::syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags, nullptr, 0));
+            }
+
+            void UringQueue::handle(const io_uring_cqe& cqe) noexcept {
+
+                auto op = reinterpret_cast<AsyncOp*>(uintptr_t(cqe.user_data));
+                bool again = false;
+                int err = 0;
+
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                    again = true;
+                } else if (cqe.res < 0) {
+                    err = - cqe.res;
+                } else if (cqe.res == 0) {
+                    if (op->is_write)
+                        err = EIO;
+                } else {
+                    op->done += size_t(cqe.res);
+                    again = op->done < op->len;
+                }
+
+                if (again) {
+                    try {
+                        push(op);
+                        return;
+                    }
+                    catch (...) {
+                        err = ENOMEM;
+                    }
+                }
+
+                owner_.complete(op, err);
+
+            }
+
+            void UringQueue::release() noexcept {
+                if (sqes_)
+                    ::munmap(sqes_, sqes_size_);
+                if (cq_map_ && cq_map_ != sq_map_)
+                    ::munmap(cq_map_, cq_map_size_);
+                if (sq_map_)
+                    ::munmap(sq_map_, sq_map_size_);
+                if (ring_fd_ >= 0)
+                    ::close(ring_fd_);
+                sqes_ = nullptr;
+                sq_map_ = cq_map_ = nullptr;
+                ring_fd_ = -1;
+            }
+
+            bool UringQueue::push_locked(AsyncOp* op) noexcept {
+                unsigned tail = *sq_tail_;
+                unsigned head = std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+                if (tail - head >= sq_entries_)
+                    return false;
+                unsigned index = tail & *sq_mask_;
+                auto& sqe = sqes_[index];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.user_data = uint64_t(uintptr_t(op));
+                if (op) {
+                    sqe.opcode = op->is_write ? IORING_OP_WRITE : IORING_OP_READ;
+                    sqe.fd = op->fd;
+                    sqe.addr = uint64_t(uintptr_t(op->ptr + op->done));
+                    sqe.len = unsigned(std::min(op->len - op->done, max_chunk));
+                    sqe.off = op->offset + op->done;
+                } else {
+                    sqe.opcode = IORING_OP_NOP;
+                }
+                sq_array_[index] = index;
+                std::atomic_ref(*sq_tail_).store(tail + 1, std::memory_order_release);
+                return true;
+            }
+
+            void UringQueue::submit_locked() {
+
+                while (! backlog_.empty() && in_flight_ < cq_entries_ && push_locked(backlog_.front())) {
+                    backlog_.pop_front();
+                    ++in_flight_;
+                }
+
+                for (;;) {
+                    unsigned head = std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+                    unsigned queued = *sq_tail_ - head;
+                    if (queued == 0)
+                        return;
+                    if (enter(queued, 0, 0) >= 0)
+                        continue;
+                    if (errno == EINTR)
+                        continue;
+                    if (errno != EAGAIN && errno != EBUSY)
+                        throw IoError(errno, "io_uring_enter()");
+                    // Out of kernel resources: if other requests are still
+                    // in flight, the completion thread will retry when they
+                    // finish; otherwise spin until the kernel catches up
+                    if (in_flight_ > queued)
+                        return;
+                    std::this_thread::yield();
+                }
+
+            }
+
+            void UringQueue::completion_loop() noexcept {
+
+                for (;;) {
+
+                    enter(0, 1, IORING_ENTER_GETEVENTS);
+                    unsigned head = *cq_head_;
+                    unsigned tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+                    bool woken = false;
+
+                    for (; head != tail; ++head) {
+                        auto cqe = cqes_[head & *cq_mask_];
+                        std::atomic_ref(*cq_head_).store(head + 1, std::memory_order_release);
+                        if (cqe.user_data == 0) {
+                            woken = true;
+                        } else {
+                            --in_flight_;
+                            handle(cqe);
+                        }
+                    }
+
+                    if (woken && stopping_)
+                        break;
+
+                    // Move any requests resubmitted by the handlers, or held
+                    // back by the in-flight limit, into the ring
+
+                    try {
+                        submit();
+                    }
+                    catch (...) {}
+
+                }
+
+            }
+
+        #else
+
+            class UringQueue {
+            public:
+                UringQueue(AsyncIo&, unsigned) { throw IoError(std::errc::function_not_supported, "io_uring"); }
+                void push(AsyncOp*) {}
+                void submit() {}
+            };
+
+        #endif
+
+        namespace {
+
+            int blocking_transfer(AsyncOp& op) noexcept {
+
+                while (op.done < op.len) {
+
+                    size_t len = std::min(op.len - op.done, size_t(1) << 30);
+                    auto ptr = op.ptr + op.done;
+                    auto offset = op.offset + op.done;
+
+                    #ifdef _XOPEN_SOURCE
+
+                        auto rc = op.is_write ? ::pwrite(op.fd, ptr, len, off_t(offset))
+                            : ::pread(op.fd, ptr, len, off_t(offset));
+                        if (rc < 0) {
+                            if (errno == EINTR)
+                                continue;
+                            return errno;
+                        }
+
+                    #else
+
+                        auto handle = HANDLE(_get_osfhandle(op.fd));
+                        OVERLAPPED ov;
+                        std::memset(&ov, 0, sizeof(ov));
+                        ov.Offset = DWORD(offset);
+                        ov.OffsetHigh = DWORD(offset >> 32);
+                        DWORD rc = 0;
+                        BOOL ok = op.is_write ? WriteFile(handle, ptr, DWORD(len), &rc, &ov)
+                            : ReadFile(handle, ptr, DWORD(len), &rc, &ov);
+                        if (! ok)
+                            return GetLastError() == ERROR_HANDLE_EOF ? 0 : EIO;
+
+                    #endif
+
+                    if (rc == 0)
+                        return op.is_write ? EIO : 0;
+                    op.done += size_t(rc);
+
+                }
+
+                return 0;
+
+            }
+
+            std::exception_ptr make_error(int err, const Path& file) {
+                return std::make_exception_ptr(IoError(err, file.name()));
+            }
+
+        }
+
+    }
+
+    // Class AsyncIo
+
+    AsyncIo::AsyncIo(AsyncBackend backend, int threads, size_t depth) {
+
+        if (depth == 0 || depth > 32768)
+            throw IoError(std::errc::invalid_argument, "Invalid queue depth for async I/O");
+
+        if (backend != AsyncBackend::threads) {
+            try {
+                uring_ = std::make_unique<Detail::UringQueue>(*this, unsigned(depth));
+                backend_ = AsyncBackend::uring;
+            }
+            catch (const IoError&) {
+                if (backend == AsyncBackend::uring)
+                    throw;
+            }
+        }
+
+        if (! uring_) {
+            threads_ = std::make_unique<ThreadPool>(threads);
+            backend_ = AsyncBackend::threads;
+        }
+
+    }
+
+    AsyncIo::~AsyncIo() noexcept {
+        try { wait(); }
+        catch (...) {}
+        uring_.reset();
+        threads_.reset();
+    }
+
+    void AsyncIo::wait() {
+        flush();
+        std::unique_lock lock(mutex_);
+        done_cv_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+    void AsyncIo::read(int fd, void* ptr, size_t len, uint64_t offset, callback cb) {
+        auto op = std::make_unique<Detail::AsyncOp>();
+        op->fd = fd;
+        op->ptr = static_cast<std::byte*>(ptr);
+        op->len = len;
+        op->offset = offset;
+        op->finish = [cb] (size_t n, int err) {
+            cb(n, err == 0 ? std::error_code() : std::error_code(err, std::generic_category()));
+        };
+        start(std::move(op));
+    }
+
+    void AsyncIo::write(int fd, const void* ptr, size_t len, uint64_t offset, callback cb) {
+        auto op = std::make_unique<Detail::AsyncOp>();
+        op->is_write = true;
+        op->fd = fd;
+        op->ptr = static_cast<std::byte*>(const_cast<void*>(ptr));
+        op->len = len;
+        op->offset = offset;
+        op->finish = [cb] (size_t n, int err) {
+            cb(n, err == 0 ? std::error_code() : std::error_code(err, std::generic_category()));
+        };
+        start(std::move(op));
+    }
+
+    std::future<size_t> AsyncIo::read(int fd, void* ptr, size_t len, uint64_t offset) {
+        auto promise = std::make_shared<std::promise<size_t>>();
+        auto future = promise->get_future();
+        read(fd, ptr, len, offset, [promise] (size_t n, std::error_code ec) {
+            if (ec)
+                promise->set_exception(std::make_exception_ptr(IoError(ec.value())));
+            else
+                promise->set_value(n);
+        });
+        return future;
+    }
+
+    std::future<size_t> AsyncIo::write(int fd, const void* ptr, size_t len, uint64_t offset) {
+        auto promise = std::make_shared<std::promise<size_t>>();
+        auto future = promise->get_future();
+        write(fd, ptr, len, offset, [promise] (size_t n, std::error_code ec) {
+            if (ec)
+                promise->set_exception(std::make_exception_ptr(IoError(ec.value())));
+            else
+                promise->set_value(n);
+        });
+        return future;
+    }
+
+    std::future<std::string> AsyncIo::load(const Path& file) {
+        auto future = start_load(file);
+        flush();
+        return future;
+    }
+
+    std::future<void> AsyncIo::save(const Path& file, std::string content) {
+        auto future = start_save(file, std::move(content));
+        flush();
+        return future;
+    }
+
+    std::future<void> AsyncIo::copy(const Path& src, const Path& dst) {
+        auto promise = std::make_shared<std::promise<void>>();
+        auto future = promise->get_future();
+        start_copy(src, dst, [promise] (std::exception_ptr error) {
+            if (error)
+                promise->set_exception(error);
+            else
+                promise->set_value();
+        });
+        flush();
+        return future;
+    }
+
+    std::vector<std::future<std::string>> AsyncIo::load_all(const std::vector<Path>& files) {
+        std::vector<std::future<std::string>> futures;
+        futures.reserve(files.size());
+        for (auto& file: files)
+            futures.push_back(start_load(file));
+        flush();
+        return futures;
+    }
+
+    std::vector<std::future<void>> AsyncIo::save_all(std::vector<std::pair<Path, std::string>> files) {
+        std::vector<std::future<void>> futures;
+        futures.reserve(files.size());
+        for (auto& [file, content]: files)
+            futures.push_back(start_save(file, std::move(content)));
+        flush();
+        return futures;
+    }
+
+    std::vector<std::future<void>> AsyncIo::copy_all(const std::vector<std::pair<Path, Path>>& files) {
+        std::vector<std::future<void>> futures;
+        futures.reserve(files.size());
+        for (auto& [src, dst]: files) {
+            auto promise = std::make_shared<std::promise<void>>();
+            futures.push_back(promise->get_future());
+            start_copy(src, dst, [promise] (std::exception_ptr error) {
+                if (error)
+                    promise->set_exception(error);
+                else
+                    promise->set_value();
+            });
+        }
+        flush();
+        return futures;
+    }
+
+    std::future<size_t> AsyncIo::copy_directory(const Path& src, const Path& dst) {
+
+        struct state_type {
+            std::promise<size_t> promise;
+            std::mutex mutex;
+            std::exception_ptr error;
+            size_t count = 0;
+            size_t remaining = 1; // Held until all copies have been queued
+        };
+
+        auto state = std::make_shared<state_type>();
+        auto future = state->promise.get_future();
+
+        auto release = [state] (std::exception_ptr error, size_t files) {
+            std::unique_lock lock(state->mutex);
+            if (error && ! state->error)
+                state->error = error;
+            state->count += files;
+            if (--state->remaining == 0) {
+                if (state->error)
+                    state->promise.set_exception(state->error);
+                else
+                    state->promise.set_value(state->count);
+            }
+        };
+
+        try {
+
+            if (! src.is_directory())
+                throw IoError(std::errc::not_a_directory, src.name());
+
+            dst.make_directory(Path::recurse);
+
+            // Directories and special files are handled synchronously on
+            // the calling thread; regular file contents go through the queue
+
+            for (auto& file: src.deep_search()) {
+                auto target = dst / file.relative_to(src);
+                if (file.is_directory(Path::no_follow)) {
+                    target.make_directory(Path::recurse);
+                } else if (file.is_file(Path::no_follow)) {
+                    {
+                        std::unique_lock lock(state->mutex);
+                        ++state->remaining;
+                    }
+                    start_copy(file, target, [release] (std::exception_ptr error) {
+                        release(error, error ? 0 : 1);
+                    });
+                } else {
+                    file.copy_to(target, Path::overwrite);
+                }
+            }
+
+        }
+        catch (...) {
+            flush();
+            release(std::current_exception(), 0);
+            return future;
+        }
+
+        flush();
+        release(nullptr, 0);
+        return future;
+
+    }
+
+    void AsyncIo::complete(Detail::AsyncOp* op, int err) noexcept {
+        try { op->finish(op->done, err); }
+        catch (...) {}
+        delete op;
+        std::unique_lock lock(mutex_);
+        --pending_;
+        done_cv_.notify_all();
+    }
+
+    void AsyncIo::flush() {
+        if (uring_)
+            uring_->submit();
+    }
+
+    void AsyncIo::start(std::unique_ptr<Detail::AsyncOp> op, bool now) {
+        ++pending_;
+        if (op->len == 0) {
+            complete(op.release(), 0);
+        } else if (uring_) {
+            try {
+                uring_->push(op.get());
+            }
+            catch (...) {
+                --pending_;
+                throw;
+            }
+            op.release();
+            if (now)
+                uring_->submit();
+        } else {
+            auto ptr = op.get();
+            try {
+                threads_->insert([this,ptr] {
+                    int err = Detail::blocking_transfer(*ptr);
+                    complete(ptr, err);
+                });
+            }
+            catch (...) {
+                --pending_;
+                throw;
+            }
+            op.release();
+        }
+    }
+
+    std::future<std::string> AsyncIo::start_load(const Path& file) {
+
+        auto promise = std::make_shared<std::promise<std::string>>();
+        auto future = promise->get_future();
+
+        try {
+
+            auto io = std::make_shared<Fdio>(file, O_RDONLY);
+            auto size = file.size();
+
+            // Files that report a zero size may still have content
+            // (e.g. procfs), so read those synchronously
+
+            if (size == 0) {
+                promise->set_value(file.load());
+                return future;
+            }
+
+            auto content = std::make_shared<std::string>(size, '\0');
+            auto op = std::make_unique<Detail::AsyncOp>();
+            op->fd = io->get();
+            op->ptr = reinterpret_cast<std::byte*>(content->data());
+            op->len = size;
+            op->finish = [promise,io,content,file] (size_t n, int err) {
+                if (err) {
+                    promise->set_exception(Detail::make_error(err, file));
+                } else {
+                    content->resize(n);
+                    promise->set_value(std::move(*content));
+                }
+            };
+            start(std::move(op), false);
+
+        }
+        catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+
+        return future;
+
+    }
+
+    std::future<void> AsyncIo::start_save(const Path& file, std::string content) {
+
+        auto promise = std::make_shared<std::promise<void>>();
+        auto future = promise->get_future();
+
+        try {
+
+            auto io = std::make_shared<Fdio>(file, O_WRONLY | O_CREAT | O_TRUNC);
+            auto buffer = std::make_shared<std::string>(std::move(content));
+            auto op = std::make_unique<Detail::AsyncOp>();
+            op->is_write = true;
+            op->fd = io->get();
+            op->ptr = reinterpret_cast<std::byte*>(buffer->data());
+            op->len = buffer->size();
+            op->finish = [promise,io,buffer,file] (size_t /*n*/, int err) {
+                if (err)
+                    promise->set_exception(Detail::make_error(err, file));
+                else
+                    promise->set_value();
+            };
+            start(std::move(op), false);
+
+        }
+        catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+
+        return future;
+
+    }
+
+    void AsyncIo::start_copy(const Path& src, const Path& dst, std::function<void(std::exception_ptr)> done) {
+
+        try {
+
+            auto in = std::make_shared<Fdio>(src, O_RDONLY);
+            auto size = src.size();
+
+            if (size == 0) {
+                dst.save(src.load(), Path::overwrite);
+                done(nullptr);
+                return;
+            }
+
+            // The read completion chains straight into the write, on
+            // whichever thread delivered it
+
+            auto out = std::make_shared<Fdio>(dst, O_WRONLY | O_CREAT | O_TRUNC);
+            auto buffer = std::make_shared<std::string>(size, '\0');
+            auto op = std::make_unique<Detail::AsyncOp>();
+            op->fd = in->get();
+            op->ptr = reinterpret_cast<std::byte*>(buffer->data());
+            op->len = size;
+
+            op->finish = [this,in,out,buffer,src,dst,done] (size_t n, int err) {
+                if (err) {
+                    done(Detail::make_error(err, src));
+                    return;
+                }
+                try {
+                    auto wop = std::make_unique<Detail::AsyncOp>();
+                    wop->is_write = true;
+                    wop->fd = out->get();
+                    wop->ptr = reinterpret_cast<std::byte*>(buffer->data());
+                    wop->len = n;
+                    wop->finish = [out,buffer,dst,done] (size_t /*n*/, int err) {
+                        done(err ? Detail::make_error(err, dst) : nullptr);
+                    };
+                    start(std::move(wop), false);
+                }
+                catch (...) {
+                    done(std::current_exception());
+                }
+            };
+
+            start(std::move(op), false);
+
+        }
+        catch (...) {
+            done(std::current_exception());
+        }
+
+    }
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "crow/enum.hpp"
+#include "crow/path.hpp"
+#include "crow/thread-pool.hpp"
+#include "crow/types.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace Crow {
+
+    CROW_ENUM_SCOPED(AsyncBackend, int,
+        automatic,
+        uring,
+        threads
+    )
+
+    namespace Detail {
+
+        struct AsyncOp;
+        class UringQueue;
+
+    }
+
+    class AsyncIo {
+
+    public:
+
+        using callback = std::function<void(size_t bytes, std::error_code ec)>;
+
+        static constexpr size_t default_depth = 256;
+
+        AsyncIo(): AsyncIo(AsyncBackend::automatic) {}
+        explicit AsyncIo(AsyncBackend backend, int threads = 0, size_t depth = default_depth);
+        ~AsyncIo() noexcept;
+        AsyncIo(const AsyncIo&) = delete;
+        AsyncIo(AsyncIo&&) = delete;
+        AsyncIo& operator=(const AsyncIo&) = delete;
+        AsyncIo& operator=(AsyncIo&&) = delete;
+
+        AsyncBackend backend() const noexcept { return backend_; }
+        size_t pending() const noexcept { return pending_; }
+        void wait();
+
+        void read(int fd, void* ptr, size_t len, uint64_t offset, callback cb);
+        void write(int fd, const void* ptr, size_t len, uint64_t offset, callback cb);
+        std::future<size_t> read(int fd, void* ptr, size_t len, uint64_t offset);
+        std::future<size_t> write(int fd, const void* ptr, size_t len, uint64_t offset);
+
+        std::future<std::string> load(const Path& file);
+        std::future<void> save(const Path& file, std::string content);
+        std::future<void> copy(const Path& src, const Path& dst);
+        std::vector<std::future<std::string>> load_all(const std::vector<Path>& files);
+        std::vector<std::future<void>> save_all(std::vector<std::pair<Path, std::string>> files);
+        std::vector<std::future<void>> copy_all(const std::vector<std::pair<Path, Path>>& files);
+        std::future<size_t> copy_directory(const Path& src, const Path& dst);
+
+    private:
+
+        friend class Detail::UringQueue;
+
+        AsyncBackend backend_ = AsyncBackend::threads;
+        std::unique_ptr<Detail::UringQueue> uring_;
+        std::unique_ptr<ThreadPool> threads_;
+        std::atomic<size_t> pending_ = 0;
+        std::mutex mutex_;
+        std::condition_variable done_cv_;
+
+        void complete(Detail::AsyncOp* op, int err) noexcept;
+        void flush();
+        void start(std::unique_ptr<Detail::AsyncOp> op, bool now = true);
+        std::future<std::string> start_load(const Path& file);
+        std::future<void> start_save(const Path& file, std::string content);
+        void start_copy(const Path& src, const Path& dst, std::function<void(std::exception_ptr)> done);
+
+    };
+
+}
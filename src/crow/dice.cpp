@@ -1,15 +1,108 @@
 #include "crow/dice.hpp"
-#include "crow/maths.hpp"
 #include "crow/regex.hpp"
 #include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include <iterator>
+#include <map>
+#include <numeric>
 #include <stdexcept>
 #include <utility>
 
 namespace Crow {
 
+    namespace {
+
+        // Largest table that will be built just for sampling, in units of
+        // roughly one machine word operation
+
+        constexpr size_t max_sampler_cost = size_t(1) << 26;
+
+        // Number of ways of rolling each total from n to n*f on nd6. Each die
+        // adds a convolution with a run of f ones, which is a sliding window
+        // sum over the previous counts.
+
+        template <typename T>
+        std::vector<T> sliding_counts(int n, int f) {
+            std::vector<T> counts(1, T(1));
+            for (int k = 0; k < n; ++k) {
+                std::vector<T> next(counts.size() + f - 1);
+                T window = 0;
+                for (size_t j = 0; j < next.size(); ++j) {
+                    if (j < counts.size())
+                        window += counts[j];
+                    if (j >= size_t(f))
+                        window -= counts[j - f];
+                    next[j] = window;
+                }
+                counts.swap(next);
+            }
+            return counts;
+        }
+
+        bool fits_uint64(int n, int f) noexcept {
+            uint64_t x = 1;
+            for (int i = 0; i < n; ++i) {
+                if (x > UINT64_MAX / uint64_t(f))
+                    return false;
+                x *= uint64_t(f);
+            }
+            return true;
+        }
+
+        // Memoised per (n,f), since the same groups tend to turn up
+        // repeatedly
+
+        std::shared_ptr<const std::vector<MPN>> group_counts(int n, int f) {
+
+            using key_type = std::pair<int, int>;
+            using counts_ptr = std::shared_ptr<const std::vector<MPN>>;
+
+            static std::mutex mutex;
+            static std::map<key_type, counts_ptr> cache;
+
+            auto lock = std::unique_lock(mutex);
+            auto& ptr = cache[{n, f}];
+
+            if (! ptr) {
+                std::vector<MPN> counts;
+                if (fits_uint64(n, f)) {
+                    auto small = sliding_counts<uint64_t>(n, f);
+                    counts.assign(small.begin(), small.end());
+                } else {
+                    counts = sliding_counts<MPN>(n, f);
+                }
+                ptr = std::make_shared<const std::vector<MPN>>(std::move(counts));
+            }
+
+            return ptr;
+
+        }
+
+        int64_t lcm64(int64_t a, int64_t b) noexcept {
+            return a / std::gcd(a, b) * b;
+        }
+
+        // Ratio of two large integers, accurate to double precision even when
+        // they are outside the double range
+
+        double mpn_ratio(const MPN& a, const MPN& b) {
+            size_t bits = b.bits();
+            size_t shift = bits > 960 ? bits - 960 : 0;
+            return double(a >> shift) / double(b >> shift);
+        }
+
+        Rational to_rational(const MPQ& q) {
+            static const MPZ max_int = INT_MAX;
+            if (q.num() > max_int || q.den() > max_int)
+                throw std::overflow_error("Dice probability can't be represented as a Rational: " + q.str());
+            return Rational(int(q.num()), int(q.den()));
+        }
+
+    }
+
     Dice::Dice(const std::string& str) {
 
         static const auto parse_integer = [] (const std::string& str, int def) noexcept {
@@ -155,43 +248,57 @@ namespace Crow {
     }
 
     Rational Dice::pdf(const Rational& x) const {
-        if (! check_table())
-            return 0;
-        auto it = info_->table.find(x);
-        if (it == info_->table.end())
-            return 0;
-        else
-            return it->second.pdf;
+        auto q = exact_pdf(x);
+        return to_rational(q);
     }
 
     Rational Dice::cdf(const Rational& x) const {
-        if (! check_table())
-            return 0;
-        auto it = info_->table.lower_bound(x);
-        if (it == info_->table.end())
-            return 1;
-        else if (it->first == x)
-            return it->second.cdf;
-        else if (it == info_->table.begin())
-            return 0;
-        else
-            return std::prev(it)->second.cdf;
+        auto q = exact_cdf(x);
+        return to_rational(q);
     }
 
     Rational Dice::ccdf(const Rational& x) const {
-        if (! check_table())
-            return 0;
-        auto it = info_->table.lower_bound(x);
-        if (it == info_->table.end())
-            return 0;
-        else
-            return it->second.ccdf;
+        auto q = exact_ccdf(x);
+        return to_rational(q);
     }
 
     Rational Dice::interval(const Rational& x, const Rational& y) const {
         return cdf(y) - cdf(x - 1);
     }
 
+    MPQ Dice::exact_pdf(const Rational& x) const {
+        if (! check_table())
+            return MPQ();
+        auto& info = *info_;
+        auto it = std::lower_bound(info.values.begin(), info.values.end(), x);
+        if (it == info.values.end() || *it != x)
+            return MPQ();
+        return MPQ(info.counts[it - info.values.begin()], info.cumulative.back());
+    }
+
+    MPQ Dice::exact_cdf(const Rational& x) const {
+        if (! check_table())
+            return MPQ();
+        auto& info = *info_;
+        auto it = std::upper_bound(info.values.begin(), info.values.end(), x);
+        if (it == info.values.begin())
+            return MPQ();
+        return MPQ(info.cumulative[it - info.values.begin() - 1], info.cumulative.back());
+    }
+
+    MPQ Dice::exact_ccdf(const Rational& x) const {
+        if (! check_table())
+            return MPQ();
+        auto& info = *info_;
+        auto it = std::lower_bound(info.values.begin(), info.values.end(), x);
+        if (it == info.values.end())
+            return MPQ();
+        if (it == info.values.begin())
+            return MPQ(1);
+        auto& total = info.cumulative.back();
+        return MPQ(total - info.cumulative[it - info.values.begin() - 1], total);
+    }
+
     std::string Dice::str() const {
 
         std::string text;
@@ -223,54 +330,46 @@ namespace Crow {
 
     }
 
-    bool Dice::check_table() const {
+    // The sampling table is built on the first roll if it is cheap enough;
+    // otherwise the dice are rolled one at a time
+
+    bool Dice::check_sampler() const {
 
         if (! info_)
             return false;
 
-        auto lock = std::unique_lock(info_->mutex);
+        auto mode = info_->mode.load(std::memory_order_acquire);
 
-        if (! info_->table.empty())
-            return true;
+        if (mode == sampler::unknown) {
+            auto lock = std::unique_lock(info_->mutex);
+            mode = info_->mode.load(std::memory_order_relaxed);
+            if (mode == sampler::unknown) {
+                if (info_->values.empty() && table_cost() <= max_sampler_cost)
+                    make_table();
+                mode = info_->values.empty() ? sampler::dice : sampler::table;
+                info_->mode.store(mode, std::memory_order_release);
+            }
+        }
 
-        int n = int(groups_.size());
-        std::vector<pdf_table> subtables(n);
-        std::transform(groups_.begin(), groups_.end(), subtables.begin(), make_table);
-        std::vector<pdf_table::const_iterator> iterators(n);
-        std::transform(subtables.begin(), subtables.end(), iterators.begin(), [] (auto& sub) { return sub.begin(); });
+        return mode == sampler::table;
 
-        for (;;) {
+    }
 
-            auto x = add_;
-            Rational p = 1;
+    bool Dice::check_table() const {
 
-            for (auto i: iterators) {
-                x += i->first;
-                p *= i->second;
-            }
+        if (! info_)
+            return false;
 
-            info_->table[x].pdf += p;
+        if (info_->mode.load(std::memory_order_acquire) == sampler::table)
+            return true;
 
-            int i = n - 1;
-            for (; i >= 0; --i) {
-                ++iterators[i];
-                if (iterators[i] != subtables[i].end())
-                    break;
-                iterators[i] = subtables[i].begin();
-            }
-            if (i == -1)
-                break;
+        auto lock = std::unique_lock(info_->mutex);
 
+        if (info_->values.empty()) {
+            make_table();
+            info_->mode.store(sampler::table, std::memory_order_release);
         }
 
-        Rational cdf = 0;
-        auto j = info_->table.end();
-
-        for (auto& [x,ps]: info_->table)
-            (--j)->second.ccdf = ps.cdf = cdf = cdf + ps.pdf;
-
-        info_->table.begin()->second.ccdf = std::prev(info_->table.end())->second.cdf = 1;
-
         return true;
 
     }
@@ -319,31 +418,102 @@ namespace Crow {
 
     }
 
-    Dice::pdf_table Dice::make_table(const dice_group& group) {
+    // All results are multiples of 1/D, where D is the LCM of the
+    // denominators, so the groups are combined exactly on that integer
+    // lattice. Counts are exact, and probabilities are counts divided by the
+    // total number of combinations.
+
+    void Dice::make_table() const {
+
+        auto& info = *info_;
+        int64_t scale = add_.den();
 
-        pdf_table table;
-        int n = group.number;
-        int f = group.one_dice.max();
-        int den = integer_power(f, n);
-        int max = f * n;
-        double b = n - 1;
+        for (auto& g: groups_)
+            scale = lcm64(scale, g.factor.den());
+
+        std::map<int64_t, MPN> table = {{add_.num() * (scale / add_.den()), MPN(1)}};
+
+        for (auto& g: groups_) {
+
+            int n = g.number;
+            auto counts = group_counts(n, g.one_dice.max());
+            int64_t step = g.factor.num() * (scale / g.factor.den());
+            std::map<int64_t, MPN> next;
+
+            for (auto& [x,c]: table) {
+                bool unit = c == MPN(1);
+                for (size_t i = 0; i < counts->size(); ++i) {
+                    auto& target = next[x + (n + int64_t(i)) * step];
+                    if (unit)
+                        target += (*counts)[i];
+                    else
+                        target += c * (*counts)[i];
+                }
+            }
 
-        for (int i = n; i <= max; ++i) {
+            table.swap(next);
 
-            int num = 0;
-            int sign = 1;
-            double a = i - 1;
+        }
 
-            for (int j = 0; j < n; ++j, a -= f, sign = - sign)
-                num += sign * int(std::lround(binomial(a, b) * binomial(double(n), double(j))));
+        info.values.clear();
+        info.counts.clear();
+        info.cumulative.clear();
+        MPN sum;
+
+        for (auto& [x,c]: table) {
+            if (x < INT_MIN || x > INT_MAX)
+                throw std::overflow_error("Dice result can't be represented as a Rational");
+            info.values.push_back(Rational(int(x), int(scale)));
+            sum += c;
+            info.cumulative.push_back(sum);
+            info.counts.push_back(std::move(c));
+        }
 
-            Rational x = i * group.factor;
-            Rational p(num, den);
-            table.insert({x, p});
+        // Vose's alias method
 
+        size_t n = info.values.size();
+        std::vector<double> scaled(n);
+        std::vector<int> small, large;
+        info.alias_prob.assign(n, 1.0);
+        info.alias_index.resize(n);
+
+        for (size_t i = 0; i < n; ++i) {
+            scaled[i] = double(n) * mpn_ratio(info.counts[i], sum);
+            info.alias_index[i] = int(i);
+            (scaled[i] < 1 ? small : large).push_back(int(i));
+        }
+
+        while (! small.empty() && ! large.empty()) {
+            int s = small.back();
+            int l = large.back();
+            small.pop_back();
+            large.pop_back();
+            info.alias_prob[s] = scaled[s];
+            info.alias_index[s] = l;
+            scaled[l] += scaled[s] - 1;
+            (scaled[l] < 1 ? small : large).push_back(l);
+        }
+
+    }
+
+    // Rough number of word operations needed to build the table
+
+    size_t Dice::table_cost() const noexcept {
+
+        double cost = 0;
+        double support = 1;
+
+        for (auto& g: groups_) {
+            double n = g.number;
+            double f = g.one_dice.max();
+            double words = std::max(1.0, n * std::log2(f) / 32);
+            double width = n * (f - 1) + 1;
+            cost += n * width * words;
+            support *= width;
+            cost += support * words;
         }
 
-        return table;
+        return cost > double(SIZE_MAX) ? SIZE_MAX : size_t(cost);
 
     }
 
@@ -1,10 +1,11 @@
 #pragma once
 
+#include "crow/mp-integer.hpp"
 #include "crow/string.hpp"
 #include "crow/random.hpp"
 #include "crow/rational.hpp"
 #include "crow/types.hpp"
-#include <map>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <ostream>
@@ -47,12 +48,14 @@ namespace Crow {
         Rational cdf(const Rational& x) const;
         Rational ccdf(const Rational& x) const;
         Rational interval(const Rational& x, const Rational& y) const;
+        MPQ exact_pdf(const Rational& x) const;
+        MPQ exact_cdf(const Rational& x) const;
+        MPQ exact_ccdf(const Rational& x) const;
         std::string str() const;
 
     private:
 
         using distribution_type = UniformInteger<int>;
-        using pdf_table = std::map<Rational, Rational>;
 
         struct dice_group {
             int number;
@@ -60,16 +63,19 @@ namespace Crow {
             Rational factor;
         };
 
-        struct probabilites {
-            Rational pdf;
-            Rational cdf;
-            Rational ccdf;
+        enum class sampler: int {
+            unknown,
+            table,
+            dice,
         };
 
-        using probability_table = std::map<Rational, probabilites>;
-
         struct table_info {
-            probability_table table;
+            std::vector<Rational> values;   // Possible results in ascending order
+            std::vector<MPN> counts;        // Number of ways to roll each result
+            std::vector<MPN> cumulative;    // Number of ways to roll each result or less
+            std::vector<double> alias_prob; // Alias table for sampling
+            std::vector<int> alias_index;
+            std::atomic<sampler> mode = sampler::unknown;
             std::mutex mutex;
         };
 
@@ -79,16 +85,26 @@ namespace Crow {
         Rational max_;
         std::shared_ptr<table_info> info_;
 
+        bool check_sampler() const;
         bool check_table() const;
         void insert(int n, int faces, const Rational& factor);
+        void make_table() const;
         void modified();
-
-        static pdf_table make_table(const dice_group& group);
+        size_t table_cost() const noexcept;
 
     };
 
         template <typename RNG>
         Rational Dice::operator()(RNG& rng) const {
+            if (check_sampler()) {
+                auto& info = *info_;
+                UniformInteger<int> index(0, int(info.values.size()) - 1);
+                UniformReal<double> unit;
+                int i = index(rng);
+                if (unit(rng) >= info.alias_prob[i])
+                    i = info.alias_index[i];
+                return info.values[i];
+            }
             Rational sum = add_;
             for (auto& g: groups_) {
                 int roll = 0;
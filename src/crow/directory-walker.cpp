@@ -0,0 +1,386 @@
+#include "crow/directory-walker.hpp"
+#include "crow/binary.hpp"
+#include "crow/guard.hpp"
+#include "crow/thread-pool.hpp"
+#include "crow/unicode.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef _XOPEN_SOURCE
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace Crow {
+
+    namespace {
+
+        using entry = DirectoryWalker::entry;
+        using emit_function = std::function<bool(entry&& e)>;
+
+        struct walk_options {
+            bool follow = true;
+            bool no_hidden = false;
+            bool unicode = false;
+        };
+
+        walk_options make_options(Path::flag_type flags) noexcept {
+            walk_options opt;
+            opt.follow = ! has_bit(flags, Path::no_follow);
+            opt.no_hidden = has_bit(flags, Path::no_hidden);
+            opt.unicode = has_bit(flags, Path::unicode);
+            return opt;
+        }
+
+        #ifdef _XOPEN_SOURCE
+
+            // Owns a directory descriptor until it is handed to fdopendir(),
+            // so a queued scan that is discarded still closes its directory
+
+            class DirectoryHandle {
+            public:
+                explicit DirectoryHandle(int fd) noexcept: fd_(fd) {}
+                ~DirectoryHandle() noexcept { if (fd_ != -1) close(fd_); }
+                DirectoryHandle(const DirectoryHandle&) = delete;
+                DirectoryHandle& operator=(const DirectoryHandle&) = delete;
+                int release() noexcept { int fd = fd_; fd_ = -1; return fd; }
+            private:
+                int fd_;
+            };
+
+            using descend_function = std::function<void(int parent, const char* leaf, const std::string& name, int depth,
+                const emit_function& emit)>;
+
+            std::string child_name(const std::string& prefix, const char* leaf) {
+                if (prefix.empty())
+                    return leaf;
+                std::string name;
+                name.reserve(prefix.size() + std::strlen(leaf) + 1);
+                name = prefix;
+                if (name.back() != '/')
+                    name += '/';
+                name += leaf;
+                return name;
+            }
+
+            int open_directory(int parent, const char* leaf, bool follow) noexcept {
+                int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+                if (! follow)
+                    flags |= O_NOFOLLOW;
+                int fd;
+                do fd = openat(parent, leaf, flags);
+                    while (fd == -1 && errno == EINTR);
+                return fd;
+            }
+
+            // The directory entry's type is used where the file system
+            // supplies one; fstatat() is needed only for DT_UNKNOWN, or for
+            // symlinks when following them
+
+            Path::kind entry_kind(int parent, const char* leaf, unsigned char type, bool follow) noexcept {
+
+                switch (type) {
+                    case DT_DIR:      return Path::kind::directory;
+                    case DT_REG:      return Path::kind::file;
+                    case DT_LNK:      if (! follow) return Path::kind::symlink; break;
+                    case DT_UNKNOWN:  break;
+                    default:          return Path::kind::special;
+                }
+
+                struct stat st;
+                if (fstatat(parent, leaf, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+                    return Path::kind::none;
+                else if (S_ISLNK(st.st_mode))
+                    return Path::kind::symlink;
+                else if (S_ISDIR(st.st_mode))
+                    return Path::kind::directory;
+                else if (S_ISREG(st.st_mode))
+                    return Path::kind::file;
+                else
+                    return Path::kind::special;
+
+            }
+
+            // Reads one directory (taking ownership of the descriptor),
+            // reporting entries through emit() and passing subdirectories
+            // that survive the filter to descend(). Stops early if emit()
+            // returns false.
+
+            bool scan_directory(int fd, const std::string& prefix, int depth, const walk_options& opt,
+                    const DirectoryWalker::filter& filter, const emit_function& emit, const descend_function& descend) {
+
+                auto dir = fdopendir(fd);
+
+                if (! dir) {
+                    close(fd);
+                    return true;
+                }
+
+                auto guard = on_scope_exit([dir] { closedir(dir); });
+                int parent = dirfd(dir);
+
+                while (auto ent = readdir(dir)) {
+
+                    const char* leaf = ent->d_name;
+
+                    if (leaf[0] == '.' && (leaf[1] == 0 || (leaf[1] == '.' && leaf[2] == 0)))
+                        continue;
+                    if (opt.no_hidden && leaf[0] == '.')
+                        continue;
+                    if (opt.unicode && ! is_valid_utf(std::string_view(leaf)))
+                        continue;
+
+                    auto name = child_name(prefix, leaf);
+                    entry e;
+                    e.kind = entry_kind(parent, leaf, ent->d_type, opt.follow);
+                    e.depth = depth;
+                    e.path = Path(name);
+
+                    if (filter && ! filter(e))
+                        continue;
+
+                    bool is_dir = e.kind == Path::kind::directory;
+
+                    if (! emit(std::move(e)))
+                        return false;
+
+                    if (is_dir)
+                        descend(parent, leaf, name, depth + 1, emit);
+
+                }
+
+                return true;
+
+            }
+
+            std::string root_prefix(const Path& root) {
+                return root.is_empty() ? std::string() : root.name();
+            }
+
+            int open_root(const Path& root) noexcept {
+                return open_directory(AT_FDCWD, root.is_empty() ? "." : root.c_name(), true);
+            }
+
+        #else
+
+            void scan_tree(const Path& dir, int depth, Path::flag_type flags,
+                    const DirectoryWalker::filter& filter, const emit_function& emit) {
+                for (auto& child: dir.directory(flags)) {
+                    entry e;
+                    e.path = child;
+                    e.kind = child.file_kind(flags);
+                    e.depth = depth;
+                    if (filter && ! filter(e))
+                        continue;
+                    bool is_dir = e.kind == Path::kind::directory;
+                    if (! emit(std::move(e)))
+                        return;
+                    if (is_dir)
+                        scan_tree(child, depth + 1, flags, filter, emit);
+                }
+            }
+
+        #endif
+
+    }
+
+    // Class DirectoryWalker
+
+    void DirectoryWalker::walk(const Path& root, callback f) const {
+        if (threads_ == 1)
+            walk_serial(root, f);
+        else
+            walk_parallel(root, f);
+    }
+
+    std::vector<DirectoryWalker::entry> DirectoryWalker::search(const Path& root) const {
+        std::vector<entry> entries;
+        walk(root, [&entries] (const entry& e) { entries.push_back(e); });
+        return entries;
+    }
+
+    void DirectoryWalker::walk_parallel(const Path& root, const callback& f) const {
+
+        #ifdef _XOPEN_SOURCE
+
+            struct state_type {
+                std::mutex mutex;
+                std::condition_variable not_empty;
+                std::condition_variable not_full;
+                std::deque<entry> queue;
+                size_t active = 0;
+                bool cancelled = false;
+                std::exception_ptr error;
+            };
+
+            int root_fd = open_root(root);
+
+            if (root_fd == -1)
+                return;
+
+            auto root_handle = std::make_shared<DirectoryHandle>(root_fd);
+            auto opt = make_options(flags_);
+            state_type state;
+            ThreadPool pool(threads_);
+
+            // Directories are handed to the pool only while there are fewer
+            // than a few per thread waiting; beyond that a worker scans the
+            // subdirectory itself, which bounds the number of open
+            // descriptors held by queued scans
+
+            const size_t max_active = 4 * size_t(pool.threads());
+            const size_t max_queue = queue_size_;
+            const size_t batch_size = std::min(max_queue, size_t(64));
+
+            // Each scan collects entries locally and hands them to the shared
+            // queue in batches, to keep lock traffic down
+
+            auto push_batch = [&state,max_queue] (std::vector<entry>& batch) {
+                std::unique_lock lock(state.mutex);
+                state.not_full.wait(lock, [&] { return state.queue.size() < max_queue || state.cancelled; });
+                if (state.cancelled)
+                    return false;
+                bool was_empty = state.queue.empty();
+                std::move(batch.begin(), batch.end(), std::back_inserter(state.queue));
+                batch.clear();
+                if (was_empty)
+                    state.not_empty.notify_one();
+                return true;
+            };
+
+            std::function<void(std::shared_ptr<DirectoryHandle>, std::string, int)> scan;
+
+            descend_function descend = [&] (int parent, const char* leaf, const std::string& name, int depth,
+                    const emit_function& emit) {
+                int fd = open_directory(parent, leaf, opt.follow);
+                if (fd == -1)
+                    return;
+                auto handle = std::make_shared<DirectoryHandle>(fd);
+                {
+                    std::unique_lock lock(state.mutex);
+                    if (state.cancelled)
+                        return;
+                    if (state.active < max_active) {
+                        ++state.active;
+                        lock.unlock();
+                        pool.insert([&scan,handle,name,depth] { scan(handle, name, depth); });
+                        return;
+                    }
+                }
+                scan_directory(handle->release(), name, depth, opt, filter_, emit, descend);
+            };
+
+            scan = [&] (std::shared_ptr<DirectoryHandle> handle, std::string prefix, int depth) {
+                std::exception_ptr error;
+                try {
+                    std::vector<entry> batch;
+                    emit_function emit = [&] (entry&& e) {
+                        batch.push_back(std::move(e));
+                        return batch.size() < batch_size || push_batch(batch);
+                    };
+                    if (scan_directory(handle->release(), prefix, depth, opt, filter_, emit, descend) && ! batch.empty())
+                        push_batch(batch);
+                }
+                catch (...) {
+                    error = std::current_exception();
+                }
+                std::unique_lock lock(state.mutex);
+                if (error && ! state.error) {
+                    state.error = error;
+                    state.cancelled = true;
+                    state.not_full.notify_all();
+                }
+                --state.active;
+                state.not_empty.notify_all();
+            };
+
+            // On exit, whether normal or not, stop any remaining scans before
+            // the functions they refer to are destroyed
+
+            auto guard = on_scope_exit([&] {
+                {
+                    std::unique_lock lock(state.mutex);
+                    state.cancelled = true;
+                    state.not_full.notify_all();
+                }
+                pool.clear();
+            });
+
+            state.active = 1;
+            pool.insert([&scan,root_handle,&root] { scan(root_handle, root_prefix(root), 1); });
+
+            // Entries are delivered to the callback on the calling thread,
+            // a queue's worth at a time
+
+            std::unique_lock lock(state.mutex);
+
+            for (;;) {
+                state.not_empty.wait(lock, [&] { return ! state.queue.empty() || state.active == 0 || state.error; });
+                if (state.error || state.queue.empty())
+                    break;
+                std::deque<entry> batch;
+                batch.swap(state.queue);
+                state.not_full.notify_all();
+                lock.unlock();
+                for (auto& e: batch)
+                    f(e);
+                lock.lock();
+            }
+
+            if (state.error)
+                std::rethrow_exception(state.error);
+
+        #else
+
+            walk_serial(root, f);
+
+        #endif
+
+    }
+
+    void DirectoryWalker::walk_serial(const Path& root, const callback& f) const {
+
+        emit_function emit = [&f] (entry&& e) {
+            f(e);
+            return true;
+        };
+
+        #ifdef _XOPEN_SOURCE
+
+            int root_fd = open_root(root);
+
+            if (root_fd == -1)
+                return;
+
+            auto opt = make_options(flags_);
+            descend_function descend;
+
+            descend = [&] (int parent, const char* leaf, const std::string& name, int depth, const emit_function& emit) {
+                int fd = open_directory(parent, leaf, opt.follow);
+                if (fd != -1)
+                    scan_directory(fd, name, depth, opt, filter_, emit, descend);
+            };
+
+            scan_directory(root_fd, root_prefix(root), 1, opt, filter_, emit, descend);
+
+        #else
+
+            if (root.is_empty() || root.is_directory(flags_))
+                scan_tree(root, 1, flags_, filter_, emit);
+
+        #endif
+
+    }
+
+}
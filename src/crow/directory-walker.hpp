@@ -0,0 +1,53 @@
+#pragma once
+
+#include "crow/path.hpp"
+#include "crow/types.hpp"
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace Crow {
+
+    class DirectoryWalker {
+
+    public:
+
+        struct entry {
+            Path path;
+            Path::kind kind = Path::kind::none;
+            int depth = 0;
+        };
+
+        using callback = std::function<void(const entry& e)>;
+        using filter = std::function<bool(const entry& e)>;
+
+        static constexpr size_t default_queue = 1024;
+
+        DirectoryWalker() = default;
+        explicit DirectoryWalker(Path::flag_type flags, int threads = 1):
+            flags_(flags), threads_(threads) {}
+
+        Path::flag_type flags() const noexcept { return flags_; }
+        void set_flags(Path::flag_type flags) noexcept { flags_ = flags; }
+        int threads() const noexcept { return threads_; }
+        void set_threads(int threads) noexcept { threads_ = threads; }
+        size_t queue_size() const noexcept { return queue_size_; }
+        void set_queue_size(size_t n) noexcept { queue_size_ = n == 0 ? 1 : n; }
+        void set_filter(filter f) { filter_ = std::move(f); }
+
+        void walk(const Path& root, callback f) const;
+        std::vector<entry> search(const Path& root) const;
+
+    private:
+
+        Path::flag_type flags_ = Path::no_flags;
+        int threads_ = 1;
+        size_t queue_size_ = default_queue;
+        filter filter_;
+
+        void walk_parallel(const Path& root, const callback& f) const;
+        void walk_serial(const Path& root, const callback& f) const;
+
+    };
+
+}
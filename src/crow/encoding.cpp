@@ -1,10 +1,242 @@
 #include "crow/encoding.hpp"
 #include "crow/string.hpp"
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+    #include <immintrin.h>
+#endif
 
 namespace Crow {
 
+    namespace {
+
+        constexpr const char* hex_digits = "0123456789abcdef";
+
+        // Values in the Base64 decoding table that are not digits
+
+        constexpr uint8_t b64_pad = 64;
+        constexpr uint8_t b64_skip = 128;
+        constexpr uint8_t b64_invalid = 255;
+
+        // Hex digit values, with -1 for characters that are not allowed and
+        // -2 for separators
+
+        constexpr auto hex_values = [] {
+            std::array<int8_t, 256> table = {};
+            for (int i = 0; i < 256; ++i) {
+                if (i >= '0' && i <= '9')
+                    table[i] = int8_t(i - '0');
+                else if (i >= 'a' && i <= 'f')
+                    table[i] = int8_t(i - 'a' + 10);
+                else if (i >= 'A' && i <= 'F')
+                    table[i] = int8_t(i - 'A' + 10);
+                else if (i > 127 || (i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z'))
+                    table[i] = -1;
+                else
+                    table[i] = -2;
+            }
+            return table;
+        }();
+
+        // A write that makes no progress is treated as an error rather
+        // than retried forever
+
+        void write_all(IoBase& out, const void* ptr, size_t len) {
+            auto cptr = static_cast<const char*>(ptr);
+            size_t ofs = 0;
+            while (ofs < len) {
+                size_t n = out.write(cptr + ofs, len - ofs);
+                if (n == 0)
+                    throw IoError(std::errc::io_error, "Encoding output stream accepted no data");
+                ofs += n;
+            }
+        }
+
+        // Vector kernels, selected at compile time. Each kernel handles one
+        // block and reports whether it succeeded; the decoders fail on any
+        // character that is not a digit of the encoding (including line
+        // breaks and padding), leaving the scalar code to deal with it.
+
+        // The Base64 kernels follow Wojciech Muła and Daniel Lemire,
+        // "Faster Base64 encoding and decoding using AVX2 instructions"
+        // (2018), except that the decoder classifies characters by range
+        // so that the last two digits can be changed.
+
+        #ifdef __SSSE3__
+
+            inline __m128i hex_lookup_128() noexcept {
+                return _mm_loadu_si128(reinterpret_cast<const __m128i*>(hex_digits));
+            }
+
+            inline void hex_encode_16(const std::byte* in, char* out) noexcept {
+                auto mask = _mm_set1_epi8(0x0f);
+                auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+                auto hi = _mm_shuffle_epi8(hex_lookup_128(), _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+                auto lo = _mm_shuffle_epi8(hex_lookup_128(), _mm_and_si128(x, mask));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(hi, lo));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(hi, lo));
+            }
+
+            inline __m128i in_range_128(__m128i x, char min, char max) noexcept {
+                return _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(char(min - 1))),
+                    _mm_cmpgt_epi8(_mm_set1_epi8(char(max + 1)), x));
+            }
+
+            inline bool hex_decode_16(const char* in, std::byte* out) noexcept {
+                auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+                auto lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+                auto digit = in_range_128(x, '0', '9');
+                auto alpha = in_range_128(lower, 'a', 'f');
+                if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xffff)
+                    return false;
+                auto value = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(x, _mm_set1_epi8('0'))),
+                    _mm_andnot_si128(digit, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+                auto pairs = _mm_maddubs_epi16(value, _mm_set1_epi16(0x0110));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(pairs, pairs));
+                return true;
+            }
+
+            inline __m128i b64_shuffle_in_128() noexcept {
+                return _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+            }
+
+            inline __m128i b64_shuffle_out_128() noexcept {
+                return _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+            }
+
+            inline __m128i b64_offsets_128(char c62, char c63) noexcept {
+                return _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                    '0' - 52, '0' - 52, '0' - 52, '0' - 52, char(c62 - 62), char(c63 - 63), 'A', 0, 0);
+            }
+
+            // Load 12 bytes (reading 16) and encode them as 16 digits
+
+            inline void b64_encode_12(const std::byte* in, char* out, __m128i offsets) noexcept {
+                auto x = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), b64_shuffle_in_128());
+                auto t0 = _mm_mulhi_epu16(_mm_and_si128(x, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+                auto t1 = _mm_mullo_epi16(_mm_and_si128(x, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+                auto index = _mm_or_si128(t0, t1);
+                auto range = _mm_subs_epu8(index, _mm_set1_epi8(51));
+                range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), index), _mm_set1_epi8(13)));
+                auto digits = _mm_add_epi8(_mm_shuffle_epi8(offsets, range), index);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), digits);
+            }
+
+            // Decode 16 digits into 12 bytes (writing 16)
+
+            inline bool b64_decode_16(const char* in, std::byte* out, char c62, char c63) noexcept {
+                auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+                auto upper = in_range_128(x, 'A', 'Z');
+                auto lower = in_range_128(x, 'a', 'z');
+                auto digit = in_range_128(x, '0', '9');
+                auto d62 = _mm_cmpeq_epi8(x, _mm_set1_epi8(c62));
+                auto d63 = _mm_cmpeq_epi8(x, _mm_set1_epi8(c63));
+                auto valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(d62, d63)));
+                if (_mm_movemask_epi8(valid) != 0xffff)
+                    return false;
+                auto shift = _mm_or_si128(
+                    _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-65)), _mm_and_si128(lower, _mm_set1_epi8(-71))),
+                    _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(4)),
+                        _mm_or_si128(_mm_and_si128(d62, _mm_set1_epi8(char(62 - c62))),
+                            _mm_and_si128(d63, _mm_set1_epi8(char(63 - c63))))));
+                auto value = _mm_add_epi8(x, shift);
+                auto merged = _mm_maddubs_epi16(value, _mm_set1_epi32(0x01400140));
+                auto packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(packed, b64_shuffle_out_128()));
+                return true;
+            }
+
+        #endif
+
+        #ifdef __AVX2__
+
+            inline void hex_encode_32(const std::byte* in, char* out) noexcept {
+                auto digits = _mm256_broadcastsi128_si256(hex_lookup_128());
+                auto mask = _mm256_set1_epi8(0x0f);
+                auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+                auto hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(x, 4), mask));
+                auto lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(x, mask));
+                auto a = _mm256_unpacklo_epi8(hi, lo);
+                auto b = _mm256_unpackhi_epi8(hi, lo);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permute2x128_si256(a, b, 0x20));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), _mm256_permute2x128_si256(a, b, 0x31));
+            }
+
+            inline __m256i in_range_256(__m256i x, char min, char max) noexcept {
+                return _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8(char(min - 1))),
+                    _mm256_cmpgt_epi8(_mm256_set1_epi8(char(max + 1)), x));
+            }
+
+            inline bool hex_decode_32(const char* in, std::byte* out) noexcept {
+                auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+                auto lower = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+                auto digit = in_range_256(x, '0', '9');
+                auto alpha = in_range_256(lower, 'a', 'f');
+                if (_mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) != -1)
+                    return false;
+                auto value = _mm256_or_si256(_mm256_and_si256(digit, _mm256_sub_epi8(x, _mm256_set1_epi8('0'))),
+                    _mm256_andnot_si256(digit, _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+                auto pairs = _mm256_maddubs_epi16(value, _mm256_set1_epi16(0x0110));
+                auto bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(pairs, pairs), 0xd8);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(bytes));
+                return true;
+            }
+
+            // Load 24 bytes (reading 28) and encode them as 32 digits
+
+            inline void b64_encode_24(const std::byte* in, char* out, __m256i offsets) noexcept {
+                auto x = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12)), 1);
+                x = _mm256_shuffle_epi8(x, _mm256_broadcastsi128_si256(b64_shuffle_in_128()));
+                auto t0 = _mm256_mulhi_epu16(_mm256_and_si256(x, _mm256_set1_epi32(0x0fc0fc00)),
+                    _mm256_set1_epi32(0x04000040));
+                auto t1 = _mm256_mullo_epi16(_mm256_and_si256(x, _mm256_set1_epi32(0x003f03f0)),
+                    _mm256_set1_epi32(0x01000010));
+                auto index = _mm256_or_si256(t0, t1);
+                auto range = _mm256_subs_epu8(index, _mm256_set1_epi8(51));
+                range = _mm256_or_si256(range,
+                    _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), index), _mm256_set1_epi8(13)));
+                auto digits = _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), index);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), digits);
+            }
+
+            // Decode 32 digits into 24 bytes (writing 32)
+
+            inline bool b64_decode_32(const char* in, std::byte* out, char c62, char c63) noexcept {
+                auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+                auto upper = in_range_256(x, 'A', 'Z');
+                auto lower = in_range_256(x, 'a', 'z');
+                auto digit = in_range_256(x, '0', '9');
+                auto d62 = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(c62));
+                auto d63 = _mm256_cmpeq_epi8(x, _mm256_set1_epi8(c63));
+                auto valid = _mm256_or_si256(_mm256_or_si256(upper, lower),
+                    _mm256_or_si256(digit, _mm256_or_si256(d62, d63)));
+                if (_mm256_movemask_epi8(valid) != -1)
+                    return false;
+                auto shift = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-65)),
+                        _mm256_and_si256(lower, _mm256_set1_epi8(-71))),
+                    _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(4)),
+                        _mm256_or_si256(_mm256_and_si256(d62, _mm256_set1_epi8(char(62 - c62))),
+                            _mm256_and_si256(d63, _mm256_set1_epi8(char(63 - c63))))));
+                auto value = _mm256_add_epi8(x, shift);
+                auto merged = _mm256_maddubs_epi16(value, _mm256_set1_epi32(0x01400140));
+                auto packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+                packed = _mm256_shuffle_epi8(packed, _mm256_broadcastsi128_si256(b64_shuffle_out_128()));
+                packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
+                return true;
+            }
+
+        #endif
+
+    }
+
     // Exceptions
 
     EncodingError::EncodingError(const std::string& encoding):
@@ -14,126 +246,320 @@ namespace Crow {
 
     std::string Encoding::encode(const void* in, size_t len) const {
 
-        auto str = do_encode(in, len);
-
-        if (line_ > 0 && line_ < npos && ! str.empty()) {
+        std::string str(encoded_length(len), '\0');
+        do_encode(static_cast<const std::byte*>(in), len, str.data());
 
-            std::string lines;
-            size_t n = line_;
+        if (has_lines() && ! str.empty()) {
 
-            for (size_t pos = 0; pos < str.size(); pos += n) {
+            // Find the break positions first, then open up the gaps in
+            // place, working back from the end
 
-                if (pos + line_ < str.size()) {
+            std::vector<size_t> breaks;
+            std::string_view rest = str;
+            size_t pos = 0;
 
-                    while (n > 0 && ! can_break(str, pos + n))
-                        --n;
+            for (;;) {
+                size_t n = next_break(rest, true);
+                pos += n;
+                rest.remove_prefix(n);
+                if (rest.empty())
+                    break;
+                breaks.push_back(pos);
+            }
 
-                    if (n == 0) {
-                        n = line_ + 1;
-                        while (n < str.size() && ! can_break(str, pos + n))
-                            ++n;
-                    }
+            size_t end = str.size();
+            str.resize(end + breaks.size());
+            auto out = str.data() + str.size();
 
-                }
+            for (size_t i = breaks.size(); i > 0; --i) {
+                out = std::copy_backward(str.data() + breaks[i - 1], str.data() + end, out);
+                *--out = '\n';
+                end = breaks[i - 1];
+            }
 
-                lines.append(str, pos, n);
-                lines += '\n';
+        }
 
-            }
+        return str;
 
-            if (lines.back() == '\n')
-                lines.pop_back();
+    }
 
-            str = std::move(lines);
+    size_t Encoding::encode(std::span<const std::byte> in, std::span<char> out) const {
+        size_t len = encoded_length(in.size());
+        if (out.size() < len)
+            return npos;
+        do_encode(in.data(), in.size(), out.data());
+        return len;
+    }
 
+    void Encoding::encode(IoBase& in, IoBase& out, size_t block) const {
+        encoder enc(*this);
+        std::string buf;
+        while (in.read_some(buf, block) > 0) {
+            auto text = enc.update(buf);
+            write_all(out, text.data(), text.size());
+            buf.clear();
         }
+        auto text = enc.finish();
+        write_all(out, text.data(), text.size());
+    }
 
+    size_t Encoding::decode(std::string_view in, void* out, size_t maxlen) const {
+        size_t used = 0;
+        if (maxlen >= max_decoded_length(in.size()))
+            return do_decode(in, static_cast<std::byte*>(out), used, true);
+        auto str = decode(in);
+        if (str.size() > maxlen)
+            return npos;
+        std::memcpy(out, str.data(), str.size());
+        return str.size();
+    }
+
+    std::string Encoding::decode(std::string_view in) const {
+        std::string str(max_decoded_length(in.size()), '\0');
+        size_t used = 0;
+        str.resize(do_decode(in, reinterpret_cast<std::byte*>(str.data()), used, true));
         return str;
+    }
+
+    void Encoding::decode(IoBase& in, IoBase& out, size_t block) const {
+        decoder dec(*this);
+        std::string buf;
+        while (in.read_some(buf, block) > 0) {
+            auto bytes = dec.update(buf);
+            write_all(out, bytes.data(), bytes.size());
+            buf.clear();
+        }
+        auto bytes = dec.finish();
+        write_all(out, bytes.data(), bytes.size());
+    }
+
+    // Returns the length of the next line, or npos if more text is needed
+    // to decide where to break it
+
+    size_t Encoding::next_break(std::string_view text, bool final) const noexcept {
+
+        if (text.size() <= line_)
+            return final ? text.size() : npos;
+
+        size_t n = line_;
+
+        while (n > 0 && ! can_break(text, n))
+            --n;
+
+        if (n == 0) {
+            n = line_ + 1;
+            while (n < text.size() && ! can_break(text, n))
+                ++n;
+            if (n == text.size() && ! final)
+                return npos;
+        }
+
+        return n;
 
     }
 
-    std::string Encoding::decode(std::string_view in) const {
+    // Class Encoding::encoder
 
-        std::string str(in.size(), '\0');
-        size_t len = 0;
+    std::string_view Encoding::encoder::update(const void* in, size_t len) {
 
-        for (;;) {
-            len = do_decode(in, str.data(), str.size());
-            if (len != npos)
-                break;
-            str.append(in.size(), '\0');
+        auto ptr = static_cast<const std::byte*>(in);
+        size_t group = code_->group_size();
+
+        auto append = [this] (const std::byte* p, size_t n) {
+            size_t pos = text_.size();
+            text_.resize(pos + code_->encoded_length(n));
+            code_->do_encode(p, n, text_.data() + pos);
+        };
+
+        if (carry_size_ > 0) {
+            size_t n = std::min(group - carry_size_, len);
+            std::memcpy(carry_.data() + carry_size_, ptr, n);
+            carry_size_ += n;
+            ptr += n;
+            len -= n;
+            if (carry_size_ < group)
+                return wrap(false);
+            append(carry_.data(), group);
+            carry_size_ = 0;
         }
 
-        str.resize(len);
+        size_t tail = len % group;
 
-        return str;
+        if (len > tail)
+            append(ptr, len - tail);
+
+        std::memcpy(carry_.data(), ptr + len - tail, tail);
+        carry_size_ = tail;
+
+        return wrap(false);
 
     }
 
-    // Class Hexcode
+    std::string_view Encoding::encoder::finish() {
+        if (carry_size_ > 0) {
+            size_t pos = text_.size();
+            text_.resize(pos + code_->encoded_length(carry_size_));
+            code_->do_encode(carry_.data(), carry_size_, text_.data() + pos);
+            carry_size_ = 0;
+        }
+        return wrap(true);
+    }
 
-    std::string Hexcode::do_encode(const void* in, size_t len) const {
+    // Text that may still need a line break inside it is held back until
+    // enough follows it to decide
 
-        static constexpr const char* xdigits = "0123456789abcdef";
+    std::string_view Encoding::encoder::wrap(bool final) {
 
-        auto in_ptr = static_cast<const uint8_t*>(in);
-        std::string str;
+        out_.clear();
 
-        for (size_t i = 0; i < len; ++i) {
-            str += xdigits[in_ptr[i] / 16];
-            str += xdigits[in_ptr[i] % 16];
+        if (! code_->has_lines()) {
+            out_.swap(text_);
+            return out_;
         }
 
-        return str;
+        std::string_view rest = text_;
+
+        while (! rest.empty()) {
+            size_t n = code_->next_break(rest, final);
+            if (n == npos)
+                break;
+            out_.append(rest, 0, n);
+            rest.remove_prefix(n);
+            if (! rest.empty())
+                out_ += '\n';
+        }
+
+        text_.erase(0, text_.size() - rest.size());
+
+        return out_;
 
     }
 
-    size_t Hexcode::do_decode(std::string_view in, void* out, size_t maxlen) const {
+    // Class Encoding::decoder
 
-        auto out_ptr = static_cast<uint8_t*>(out);
-        size_t in_pos = 0;
-        size_t out_pos = 0;
+    std::span<const std::byte> Encoding::decoder::update(std::string_view in) {
+        return run(in, false);
+    }
 
-        while (in_pos < in.size()) {
+    std::span<const std::byte> Encoding::decoder::finish() {
+        return run({}, true);
+    }
 
-            if (out_pos >= maxlen)
-                return npos;
+    std::span<const std::byte> Encoding::decoder::run(std::string_view in, bool final) {
 
-            if (in_pos == in.size() - 1)
-                throw EncodingError(name());
+        static constexpr size_t max_borrow = 64;
 
-            auto c = in[in_pos];
-            auto b = uint8_t(c);
+        out_.clear();
 
-            if (b <= 127 && ! ascii_isalnum(c)) {
-                ++in_pos;
-                continue;
+        auto decode_some = [this,final] (std::string_view src, bool last) {
+            size_t pos = out_.size();
+            size_t used = 0;
+            out_.resize(pos + code_->max_decoded_length(src.size()));
+            size_t n = code_->do_decode(src, reinterpret_cast<std::byte*>(out_.data() + pos), used, last && final);
+            out_.resize(pos + n);
+            return used;
+        };
+
+        // Complete any group left over from the last call by borrowing the
+        // start of the new input, rather than copying all of it
+
+        std::string_view src = in;
+
+        if (! carry_.empty()) {
+            size_t old = carry_.size();
+            size_t borrow = std::min(in.size(), max_borrow);
+            carry_.append(in, 0, borrow);
+            size_t used = decode_some(carry_, borrow == in.size());
+            if (used >= old) {
+                src.remove_prefix(used - old);
+                carry_.clear();
+            } else {
+                carry_.erase(0, used);
+                carry_.append(in, borrow);
+                src = carry_;
             }
+        }
+
+        if (! src.empty()) {
+            size_t used = decode_some(src, true);
+            carry_ = std::string(src.substr(used));
+        }
 
-            int value = 0;
+        return {reinterpret_cast<const std::byte*>(out_.data()), out_.size()};
 
-            for (size_t i = 0; i < 2; ++i) {
+    }
 
-                c = in[in_pos++];
-                b = uint8_t(c);
+    // Class Hexcode
 
-                if (b > 126 || ! ascii_isxdigit(c))
-                    throw EncodingError(name());
+    void Hexcode::do_encode(const std::byte* in, size_t len, char* out) const {
 
-                if (c <= '9')
-                    value = 16 * value + int(c - '0');
-                else if (c <= 'F')
-                    value = 16 * value + int(c - 'A' + 10);
-                else
-                    value = 16 * value + int(c - 'a' + 10);
+        auto end = in + len;
 
+        #ifdef __AVX2__
+            for (; end - in >= 32; in += 32, out += 64)
+                hex_encode_32(in, out);
+        #endif
+
+        #ifdef __SSSE3__
+            for (; end - in >= 16; in += 16, out += 32)
+                hex_encode_16(in, out);
+        #endif
+
+        for (; in != end; ++in) {
+            auto b = uint8_t(*in);
+            *out++ = hex_digits[b / 16];
+            *out++ = hex_digits[b % 16];
+        }
+
+    }
+
+    size_t Hexcode::do_decode(std::string_view in, std::byte* out, size_t& used, bool final) const {
+
+        auto ptr = in.data();
+        auto end = ptr + in.size();
+        auto out_ptr = out;
+
+        while (ptr != end) {
+
+            #ifdef __AVX2__
+                for (; end - ptr >= 32 && hex_decode_32(ptr, out_ptr); ptr += 32)
+                    out_ptr += 16;
+            #endif
+
+            #ifdef __SSSE3__
+                for (; end - ptr >= 16 && hex_decode_16(ptr, out_ptr); ptr += 16)
+                    out_ptr += 8;
+            #endif
+
+            if (ptr == end)
+                break;
+
+            int hi = hex_values[uint8_t(*ptr)];
+
+            if (hi == -2) {
+                ++ptr;
+                continue;
+            }
+
+            if (end - ptr == 1) {
+                if (final)
+                    throw EncodingError(name());
+                break;
             }
 
-            out_ptr[out_pos++] = uint8_t(value);
+            int lo = hex_values[uint8_t(ptr[1])];
+
+            if (hi < 0 || lo < 0)
+                throw EncodingError(name());
+
+            *out_ptr++ = std::byte(16 * hi + lo);
+            ptr += 2;
 
         }
 
-        return out_pos;
+        used = size_t(ptr - in.data());
+
+        return size_t(out_ptr - out);
 
     }
 
@@ -143,121 +569,161 @@ namespace Crow {
     Encoding(line),
     last2_(last2),
     padding_(padding) {
+
         if (last2.size() != 2 || ! ascii_ispunct(last2[0]) || ! ascii_ispunct(last2[1]) || last2[0] == last2[1])
             throw std::invalid_argument("Invalid Base64 coding");
-    }
 
-    std::string Base64::do_encode(const void* in, size_t len) const {
-
-        size_t tail_len = len % 3;
-        auto in_ptr = static_cast<const uint8_t*>(in);
-        auto in_end = in_ptr + len - tail_len;
-        std::string str;
-
-        auto convert_group = [&] (int n) {
-            uint32_t g = 0;
-            for (int i = 6 * n - 8; i >= 0; i -= 8)
-                g += uint32_t(*in_ptr++) << i;
-            for (int i = 6 * n - 6; i >= 0; i -= 6) {
-                uint32_t x = (g >> i) & 0x3f;
-                str += x < 26 ? char(x + 'A') :
-                    x < 52 ? char(x - 26 + 'a') :
-                    x < 62 ? char(x - 52 + '0') :
-                    last2_[x - 62];
-            }
-        };
+        for (int i = 0; i < 64; ++i)
+            digits_[i] = i < 26 ? char(i + 'A') : i < 52 ? char(i - 26 + 'a') : i < 62 ? char(i - 52 + '0') : last2_[i - 62];
 
-        while (in_ptr != in_end)
-            convert_group(4);
+        for (int i = 0; i < 256; ++i)
+            values_[i] = i > 126 ? b64_invalid : ascii_isgraph(char(i)) ? b64_invalid : b64_skip;
 
-        if (tail_len > 0) {
-            convert_group(int(tail_len) + 1);
-            if (padding_)
-                str.append(3 - tail_len, '=');
-        }
+        for (int i = 0; i < 64; ++i)
+            values_[uint8_t(digits_[i])] = uint8_t(i);
 
-        return str;
+        values_['='] = b64_pad;
 
     }
 
-    size_t Base64::do_decode(std::string_view in, void* out, size_t maxlen) const {
+    size_t Base64::encoded_length(size_t len) const noexcept {
+        size_t tail = len % 3;
+        if (padding_ && tail > 0)
+            tail = 3;
+        return len / 3 * 4 + (tail == 0 ? 0 : tail + 1);
+    }
 
-        auto out_ptr = static_cast<uint8_t*>(out);
-        size_t out_pos = 0;
-        std::array<char, 4> group;
-        size_t gpos = 0;
-        bool done = false;
+    size_t Base64::max_decoded_length(size_t len) const noexcept {
+        size_t tail = len % 4;
+        return len / 4 * 3 + (tail == 0 ? 0 : tail - 1);
+    }
 
-        auto convert_group = [&] () {
+    void Base64::do_encode(const std::byte* in, size_t len, char* out) const {
 
-            uint32_t g = 0;
-            int bits = 0;
+        auto end = in + len;
 
-            for (char c: group) {
+        #ifdef __AVX2__
+            auto offsets256 = _mm256_broadcastsi128_si256(b64_offsets_128(last2_[0], last2_[1]));
+            for (; end - in >= 28; in += 24, out += 32)
+                b64_encode_24(in, out, offsets256);
+        #endif
 
-                if (c == '=') {
-                    done = true;
-                    break;
-                }
+        #ifdef __SSSE3__
+            auto offsets128 = b64_offsets_128(last2_[0], last2_[1]);
+            for (; end - in >= 16; in += 12, out += 16)
+                b64_encode_12(in, out, offsets128);
+        #endif
 
-                if (done)
-                    throw EncodingError(name());
+        for (; end - in >= 3; in += 3) {
+            uint32_t g = (uint32_t(in[0]) << 16) + (uint32_t(in[1]) << 8) + uint32_t(in[2]);
+            *out++ = digits_[g >> 18];
+            *out++ = digits_[(g >> 12) & 0x3f];
+            *out++ = digits_[(g >> 6) & 0x3f];
+            *out++ = digits_[g & 0x3f];
+        }
 
-                uint32_t x;
-
-                if (c >= 'A' && c <= 'Z')
-                    x = uint32_t(c - 'A');
-                else if (c >= 'a' && c <= 'z')
-                    x = uint32_t(c - 'a' + 26);
-                else if (c >= '0' && c <= '9')
-                    x = uint32_t(c - '0' + 52);
-                else if (c == last2_[0])
-                    x = 62;
-                else if (c == last2_[1])
-                    x = 63;
-                else
-                    throw EncodingError(name());
+        if (in != end) {
+            uint32_t g = uint32_t(in[0]) << 16;
+            if (end - in == 2)
+                g += uint32_t(in[1]) << 8;
+            *out++ = digits_[g >> 18];
+            *out++ = digits_[(g >> 12) & 0x3f];
+            if (end - in == 2)
+                *out++ = digits_[(g >> 6) & 0x3f];
+            else if (padding_)
+                *out++ = '=';
+            if (padding_)
+                *out++ = '=';
+        }
 
-                g = (g << 6) + x;
-                bits += 6;
+    }
 
-            }
+    size_t Base64::do_decode(std::string_view in, std::byte* out, size_t& used, bool final) const {
 
-            for (int i = bits - 8; i >= 0; i -= 8) {
-                if (out_pos >= maxlen) {
-                    out_pos = npos;
-                    break;
+        auto ptr = in.data();
+        auto end = ptr + in.size();
+        auto group_end = ptr;
+        auto out_ptr = out;
+        uint32_t g = 0;
+        int chars = 0;
+        int bits = 0;
+        bool done = false;
+
+        auto convert_group = [&] {
+            for (int i = bits - 8; i >= 0; i -= 8)
+                *out_ptr++ = std::byte(g >> i);
+            g = 0;
+            chars = bits = 0;
+        };
+
+        while (ptr != end) {
+
+            if (chars == 0 && ! done) {
+
+                #ifdef __AVX2__
+                    for (; end - ptr >= 48 && b64_decode_32(ptr, out_ptr, last2_[0], last2_[1]); ptr += 32)
+                        out_ptr += 24;
+                #endif
+
+                #ifdef __SSSE3__
+                    for (; end - ptr >= 24 && b64_decode_16(ptr, out_ptr, last2_[0], last2_[1]); ptr += 16)
+                        out_ptr += 12;
+                #endif
+
+                for (; end - ptr >= 4; ptr += 4) {
+                    uint32_t a = values_[uint8_t(ptr[0])];
+                    uint32_t b = values_[uint8_t(ptr[1])];
+                    uint32_t c = values_[uint8_t(ptr[2])];
+                    uint32_t d = values_[uint8_t(ptr[3])];
+                    if ((a | b | c | d) >= 64)
+                        break;
+                    uint32_t x = (a << 18) + (b << 12) + (c << 6) + d;
+                    *out_ptr++ = std::byte(x >> 16);
+                    *out_ptr++ = std::byte(x >> 8);
+                    *out_ptr++ = std::byte(x);
                 }
-                out_ptr[out_pos++] = uint8_t(g >> i);
+
+                group_end = ptr;
+
+                if (ptr == end)
+                    break;
+
             }
 
-        };
+            auto x = values_[uint8_t(*ptr++)];
 
-        for (char c: in) {
+            if (x == b64_skip)
+                continue;
+            if (x == b64_invalid)
+                throw EncodingError(name());
 
-            if (uint8_t(c) > 126)
+            if (x == b64_pad) {
+                done = true;
+            } else if (done) {
                 throw EncodingError(name());
+            } else {
+                g = (g << 6) + x;
+                bits += 6;
+            }
 
-            if (ascii_isgraph(c)) {
-                group[gpos++] = c;
-                if (gpos == 4) {
-                    convert_group();
-                    gpos = 0;
-                }
+            if (++chars == 4) {
+                convert_group();
+                group_end = ptr;
             }
 
         }
 
-        if (gpos == 1)
-            throw EncodingError(name());
-
-        if (gpos != 0) {
-            while (gpos < 4)
-                group[gpos++] = '=';
-            convert_group();
+        if (final) {
+            if (chars == 1)
+                throw EncodingError(name());
+            if (chars > 0)
+                convert_group();
+            used = in.size();
+        } else {
+            used = size_t(group_end - in.data());
         }
 
-        return out_pos;
+        return size_t(out_ptr - out);
 
     }
 
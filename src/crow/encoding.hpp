@@ -1,6 +1,10 @@
 #pragma once
 
+#include "crow/stdio.hpp"
 #include "crow/types.hpp"
+#include <array>
+#include <cstddef>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -14,21 +18,68 @@ namespace Crow {
     };
 
     class Encoding {
+
     public:
+
+        class encoder {
+        public:
+            explicit encoder(const Encoding& code) noexcept: code_(&code) {}
+            std::string_view update(const void* in, size_t len);
+            std::string_view update(std::string_view in) { return update(in.data(), in.size()); }
+            std::string_view finish();
+        private:
+            const Encoding* code_;
+            std::array<std::byte, 16> carry_;
+            size_t carry_size_ = 0;
+            std::string text_;
+            std::string out_;
+            std::string_view wrap(bool final);
+        };
+
+        class decoder {
+        public:
+            explicit decoder(const Encoding& code) noexcept: code_(&code) {}
+            std::span<const std::byte> update(std::string_view in);
+            std::span<const std::byte> finish();
+        private:
+            const Encoding* code_;
+            std::string carry_;
+            std::string out_;
+            std::span<const std::byte> run(std::string_view in, bool final);
+        };
+
         virtual ~Encoding() noexcept {}
+
         virtual std::string name() const = 0;
+        virtual size_t encoded_length(size_t len) const noexcept = 0;
+        virtual size_t max_decoded_length(size_t len) const noexcept = 0;
+
         std::string encode(const void* in, size_t len) const;
         std::string encode(std::string_view in) const { return encode(in.data(), in.size()); }
-        size_t decode(std::string_view in, void* out, size_t maxlen) const { return do_decode(in, out, maxlen); }
+        size_t encode(std::span<const std::byte> in, std::span<char> out) const;
+        void encode(IoBase& in, IoBase& out, size_t block = IoBase::default_length) const;
+        size_t decode(std::string_view in, void* out, size_t maxlen) const;
+        size_t decode(std::string_view in, std::span<std::byte> out) const { return decode(in, out.data(), out.size()); }
         std::string decode(std::string_view in) const;
+        void decode(IoBase& in, IoBase& out, size_t block = IoBase::default_length) const;
         size_t line() const noexcept { return line_; }
+
     protected:
+
         explicit Encoding(size_t line): line_(line) {}
+
+        virtual size_t group_size() const noexcept { return 1; }
         virtual bool can_break(std::string_view /*encoded*/, size_t /*pos*/) const noexcept { return true; }
-        virtual std::string do_encode(const void* in, size_t len) const = 0;
-        virtual size_t do_decode(std::string_view in, void* out, size_t maxlen) const = 0;
+        virtual void do_encode(const std::byte* in, size_t len, char* out) const = 0;
+        virtual size_t do_decode(std::string_view in, std::byte* out, size_t& used, bool final) const = 0;
+
     private:
+
         size_t line_ = npos;
+
+        bool has_lines() const noexcept { return line_ > 0 && line_ < npos; }
+        size_t next_break(std::string_view text, bool final) const noexcept;
+
     };
 
     class Hexcode:
@@ -37,10 +88,12 @@ namespace Crow {
         Hexcode() noexcept: Encoding(npos) {}
         explicit Hexcode(size_t line) noexcept: Encoding(line) {}
         std::string name() const override { return "Hexcode"; }
+        size_t encoded_length(size_t len) const noexcept override { return 2 * len; }
+        size_t max_decoded_length(size_t len) const noexcept override { return len / 2; }
     protected:
         bool can_break(std::string_view /*encoded*/, size_t pos) const noexcept override { return pos % 2 == 0; }
-        std::string do_encode(const void* in, size_t len) const override;
-        size_t do_decode(std::string_view in, void* out, size_t maxlen) const override;
+        void do_encode(const std::byte* in, size_t len, char* out) const override;
+        size_t do_decode(std::string_view in, std::byte* out, size_t& used, bool final) const override;
     };
 
     class Base64:
@@ -49,13 +102,18 @@ namespace Crow {
         Base64() noexcept: Base64(npos, default_last2, true) {}
         explicit Base64(size_t line, const std::string& last2 = default_last2, bool padding = true);
         std::string name() const override { return "Base64"; }
+        size_t encoded_length(size_t len) const noexcept override;
+        size_t max_decoded_length(size_t len) const noexcept override;
     protected:
-        std::string do_encode(const void* in, size_t len) const override;
-        size_t do_decode(std::string_view in, void* out, size_t maxlen) const override;
+        size_t group_size() const noexcept override { return 3; }
+        void do_encode(const std::byte* in, size_t len, char* out) const override;
+        size_t do_decode(std::string_view in, std::byte* out, size_t& used, bool final) const override;
     private:
         static constexpr const char* default_last2 = "+/";
         std::string last2_;
         bool padding_;
+        std::array<char, 64> digits_;
+        std::array<uint8_t, 256> values_;
     };
 
 }
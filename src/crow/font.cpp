@@ -4,10 +4,13 @@
 #include "crow/unicode.hpp"
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
 #include <iterator>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
 
 #ifdef _MSC_VER
@@ -137,11 +140,6 @@ namespace Crow {
 
         }
 
-        void free_stb_bitmap(unsigned char* ptr) noexcept {
-            if (ptr != nullptr)
-                stbtt_FreeBitmap(ptr, nullptr);
-        }
-
         size_t get_file_size(Cstdio& io) noexcept {
             if (! io.is_open())
                 return 0;
@@ -446,14 +444,136 @@ namespace Crow {
 
     // ScaledFont class
 
+    // Rasterised glyphs are packed into atlas pages using a simple shelf
+    // algorithm. Pages are only ever appended to, never overwritten, so a
+    // glyph's pixels can be read without holding the lock once its entry
+    // has been copied out of the cache. When the cache limit is reached
+    // the whole cache is discarded; any pages still in use by a render in
+    // progress stay alive through their shared pointers.
+
+    struct ScaledFont::glyph_info {
+        int glyph = 0;          // Glyph index in font
+        int advance = 0;        // Advance width in font units
+        Box_i2 box;             // Bitmap box relative to reference point
+        Detail::ByteMask page;  // Atlas page (null if glyph has no pixels)
+        Point atlas_pos;        // Top left of bitmap within page
+    };
+
     struct ScaledFont::scaled_impl {
+
+        static constexpr size_t max_kerning_pairs = 65'536;
+        static constexpr int min_page_size = 256;
+        static constexpr int max_page_size = 2048;
+
         int ascent_pixels = 0;
         int descent_pixels = 0;
         int line_gap_pixels = 0;
         Point pixels_per_em = Point::null();
         Float2 pixels_per_unit = Float2::null();
+
+        std::mutex mutex;
+        size_t cache_limit = default_cache_limit;
+        size_t cache_bytes = 0;
+        std::unordered_map<char32_t, glyph_info> glyphs;
+        std::unordered_map<uint64_t, int> kerning;
+        Detail::ByteMask page;
+        int page_size = 0;
+        Point shelf_pos = Point::null();
+        int shelf_height = 0;
+
+        const glyph_info& get_glyph(const stbtt_fontinfo& info, char32_t c);
+        int get_kerning(const stbtt_fontinfo& info, const glyph_info& g1, const glyph_info& g2);
+        void reset() noexcept;
+
     };
 
+    const ScaledFont::glyph_info& ScaledFont::scaled_impl::get_glyph(const stbtt_fontinfo& info, char32_t c) {
+
+        using namespace Detail;
+
+        auto it = glyphs.find(c);
+        if (it != glyphs.end())
+            return it->second;
+
+        glyph_info g;
+        g.glyph = stbtt_FindGlyphIndex(&info, int(c));
+        int left_bearing = 0;
+        stbtt_GetGlyphHMetrics(&info, g.glyph, &g.advance, &left_bearing);
+        float sx = pixels_per_unit.x();
+        float sy = pixels_per_unit.y();
+        int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        stbtt_GetGlyphBitmapBox(&info, g.glyph, sx, sy, &x0, &y0, &x1, &y1);
+        g.box = {{x0, y0}, {x1 - x0, y1 - y0}};
+        Point shape = g.box.shape();
+
+        if (shape.x() > 0 && shape.y() > 0) {
+
+            if (page_size == 0)
+                page_size = std::clamp(int(std::bit_ceil(unsigned(16 * std::max(pixels_per_em.x(), pixels_per_em.y())))),
+                    min_page_size, max_page_size);
+
+            if (shape.x() > page_size || shape.y() > page_size) {
+
+                // Too big for a shared page, give it a page of its own
+
+                if (cache_bytes + size_t(shape.x()) * size_t(shape.y()) > cache_limit)
+                    reset();
+                g.page = ByteMask(shape);
+                g.atlas_pos = Point::null();
+                cache_bytes += g.page.area();
+
+            } else {
+
+                if (! page.empty() && shelf_pos.x() + shape.x() > page_size) {
+                    shelf_pos = {0, shelf_pos.y() + shelf_height};
+                    shelf_height = 0;
+                }
+
+                if (page.empty() || shelf_pos.y() + shape.y() > page_size) {
+                    auto bytes = size_t(page_size) * size_t(page_size);
+                    if (cache_bytes + bytes > cache_limit)
+                        reset();
+                    page = ByteMask({page_size, page_size});
+                    cache_bytes += bytes;
+                    shelf_pos = Point::null();
+                    shelf_height = 0;
+                }
+
+                g.page = page;
+                g.atlas_pos = shelf_pos;
+                shelf_pos.x() += shape.x();
+                shelf_height = std::max(shelf_height, shape.y());
+
+            }
+
+            stbtt_MakeGlyphBitmap(&info, &g.page[g.atlas_pos], shape.x(), shape.y(), g.page.shape().x(), sx, sy, g.glyph);
+
+        }
+
+        return glyphs.insert({c, std::move(g)}).first->second;
+
+    }
+
+    int ScaledFont::scaled_impl::get_kerning(const stbtt_fontinfo& info, const glyph_info& g1, const glyph_info& g2) {
+        auto key = (uint64_t(uint32_t(g1.glyph)) << 32) + uint64_t(uint32_t(g2.glyph));
+        auto it = kerning.find(key);
+        if (it != kerning.end())
+            return it->second;
+        if (kerning.size() >= max_kerning_pairs)
+            kerning.clear();
+        int kern = stbtt_GetGlyphKernAdvance(&info, g1.glyph, g2.glyph);
+        kerning.insert({key, kern});
+        return kern;
+    }
+
+    void ScaledFont::scaled_impl::reset() noexcept {
+        glyphs.clear();
+        page = {};
+        cache_bytes = 0;
+        shelf_pos = Point::null();
+        shelf_height = 0;
+    }
+
     ScaledFont::ScaledFont(const Font& font, Point scale) noexcept:
     Font(font),
     scaled_(std::make_shared<scaled_impl>()) {
@@ -488,12 +608,12 @@ namespace Crow {
             return {};
 
         auto utext = decode_string(text);
+        std::vector<glyph_info> glyphs;
+        std::vector<int> kerning;
+        layout_text(utext, glyphs, kerning);
         int x = 0, y = 0;
-        int x0 = 0, x1 = 0, y0 = 0, y1 = 0;
         int min_x = 0, min_y = 0, max_x = 0, max_y = 0;
         size_t length = utext.size();
-        float sx = scaled_->pixels_per_unit.x();
-        float sy = scaled_->pixels_per_unit.y();
 
         for (size_t i = 0; i < length; ++i) {
 
@@ -503,21 +623,17 @@ namespace Crow {
                 continue;
             }
 
-            stbtt_GetCodepointBitmapBox(&font_->info, int(utext[i]), sx, sy, &x0, &y0, &x1, &y1);
+            auto& box = glyphs[i].box;
 
-            if (x0 != 0 || y0 != 0 || x1 != 0 || y1 != 0) {
-                min_x = std::min(min_x, x + x0);
-                max_x = std::max(max_x, x + x1);
-                min_y = std::min(min_y, y + y0);
-                max_y = std::max(max_y, y + y1);
+            if (box.base() != Point::null() || box.shape() != Point::null()) {
+                min_x = std::min(min_x, x + box.base().x());
+                max_x = std::max(max_x, x + box.apex().x());
+                min_y = std::min(min_y, y + box.base().y());
+                max_y = std::max(max_y, y + box.apex().y());
             }
 
-            if (i + 1 < length) {
-                int advance, left_bearing;
-                stbtt_GetCodepointHMetrics(&font_->info, int(utext[i]), &advance, &left_bearing);
-                int kern_advance = stbtt_GetCodepointKernAdvance(&font_->info, int(utext[i]), int(utext[i + 1]));
-                x += scale_x(advance + kern_advance);
-            }
+            if (i + 1 < length)
+                x += scale_x(glyphs[i].advance + kerning[i]);
 
         }
 
@@ -535,34 +651,30 @@ namespace Crow {
             return 0;
 
         auto utext = decode_string(text);
-        int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        std::vector<glyph_info> glyphs;
+        std::vector<int> kerning;
+        layout_text(utext, glyphs, kerning);
         int x = 0, min_x = 0, max_x = 0;
         size_t length = utext.size();
         size_t i = 0;
-        float sx = scaled_->pixels_per_unit.x();
-        float sy = scaled_->pixels_per_unit.y();
 
         for (i = 0; i < length; ++i) {
 
             if (utext[i] == U'\n')
                 throw std::invalid_argument("Multiple lines in text fit test");
 
-            stbtt_GetCodepointBitmapBox(&font_->info, int(utext[i]), sx, sy, &x0, &y0, &x1, &y1);
+            auto& box = glyphs[i].box;
 
-            if (x0 != 0 || y0 != 0 || x1 != 0 || y1 != 0) {
-                min_x = std::min(min_x, x + x0);
-                max_x = std::max(max_x, x + x1);
+            if (box.base() != Point::null() || box.shape() != Point::null()) {
+                min_x = std::min(min_x, x + box.base().x());
+                max_x = std::max(max_x, x + box.apex().x());
                 size_t test_width = size_t(max_x - min_x);
                 if (test_width > max_pixels)
                     break;
             }
 
-            if (i + 1 < length) {
-                int advance, left_bearing;
-                stbtt_GetCodepointHMetrics(&font_->info, int(utext[i]), &advance, &left_bearing);
-                int kern_advance = stbtt_GetCodepointKernAdvance(&font_->info, int(utext[i]), int(utext[i + 1]));
-                x += scale_x(advance + kern_advance);
-            }
+            if (i + 1 < length)
+                x += scale_x(glyphs[i].advance + kerning[i]);
 
         }
 
@@ -618,17 +730,49 @@ namespace Crow {
 
     }
 
-    Detail::ByteMask ScaledFont::render_glyph_mask(char32_t c, Point& offset) const {
-        using namespace Detail;
-        offset = Point::null();
-        int width, height, xoff, yoff;
-        auto bitmap_ptr = stbtt_GetCodepointBitmap(&font_->info, scaled_->pixels_per_unit.x(), scaled_->pixels_per_unit.y(),
-            int(c), &width, &height, &xoff, &yoff);
-        if (! bitmap_ptr)
-            return {};
-        ByteMask mask({width, height}, bitmap_ptr, free_stb_bitmap);
-        offset = {xoff, yoff};
-        return mask;
+    size_t ScaledFont::cache_limit() const noexcept {
+        if (! scaled_)
+            return 0;
+        std::unique_lock lock(scaled_->mutex);
+        return scaled_->cache_limit;
+    }
+
+    void ScaledFont::set_cache_limit(size_t bytes) noexcept {
+        if (! scaled_)
+            return;
+        std::unique_lock lock(scaled_->mutex);
+        scaled_->cache_limit = bytes;
+        if (scaled_->cache_bytes > bytes)
+            scaled_->reset();
+    }
+
+    void ScaledFont::clear_cache() const noexcept {
+        if (! scaled_)
+            return;
+        std::unique_lock lock(scaled_->mutex);
+        scaled_->reset();
+        scaled_->kerning.clear();
+    }
+
+    void ScaledFont::layout_text(const std::u32string& utext, std::vector<glyph_info>& glyphs, std::vector<int>& kerning) const {
+
+        // Fill in the glyph information for every character, and the kerning
+        // between each character and the next (zero at line breaks), taking
+        // the lock only once for the whole string.
+
+        size_t length = utext.size();
+        glyphs.assign(length, {});
+        kerning.assign(length, 0);
+        std::unique_lock lock(scaled_->mutex);
+
+        for (size_t i = 0; i < length; ++i)
+            if (utext[i] != U'\n')
+                glyphs[i] = scaled_->get_glyph(font_->info, utext[i]);
+
+        for (size_t i = 0; i + 1 < length; ++i)
+            if (utext[i] != U'\n' && utext[i + 1] != U'\n')
+                kerning[i] = scaled_->get_kerning(font_->info, glyphs[i], glyphs[i + 1]);
+
     }
 
     Detail::ByteMask ScaledFont::render_text_mask(const std::u32string& utext, int line_shift, Point& offset) const {
@@ -636,7 +780,9 @@ namespace Crow {
         using namespace Detail;
 
         size_t length = utext.size();
-        std::vector<ByteMask> glyph_masks(length);
+        std::vector<glyph_info> glyphs;
+        std::vector<int> kerning;
+        layout_text(utext, glyphs, kerning);
         std::vector<Point> glyph_offsets(length); // Top left of glyph relative to initial reference point
         int line_delta = line_offset() + line_shift;
         int min_x = 0, max_x = 0, min_y = 0, max_y = 0;
@@ -651,17 +797,21 @@ namespace Crow {
 
             } else {
 
-                glyph_masks[i] = render_glyph_mask(utext[i], glyph_offsets[i]);
-                glyph_offsets[i] += ref_point;
+                Point shape = Point::null();
+                glyph_offsets[i] = ref_point;
+
+                if (! glyphs[i].page.empty()) {
+                    shape = glyphs[i].box.shape();
+                    glyph_offsets[i] += glyphs[i].box.base();
+                }
+
                 min_x = std::min(min_x, glyph_offsets[i].x());
                 min_y = std::min(min_y, glyph_offsets[i].y());
-                max_x = std::max(max_x, glyph_offsets[i].x() + glyph_masks[i].shape().x());
-                max_y = std::max(max_y, glyph_offsets[i].y() + glyph_masks[i].shape().y());
-                int advance, left_bearing;
-                stbtt_GetCodepointHMetrics(&font_->info, int(utext[i]), &advance, &left_bearing);
-                ref_point.x() += scale_x(advance);
-                if (i + 1 < length && utext[i + 1] != U'\n')
-                    ref_point.x() += scale_x(stbtt_GetCodepointKernAdvance(&font_->info, int(utext[i]), int(utext[i + 1])));
+                max_x = std::max(max_x, glyph_offsets[i].x() + shape.x());
+                max_y = std::max(max_y, glyph_offsets[i].y() + shape.y());
+
+                ref_point.x() += scale_x(glyphs[i].advance);
+                ref_point.x() += scale_x(kerning[i]);
 
             }
 
@@ -673,14 +823,16 @@ namespace Crow {
 
         for (size_t i = 0; i < length; ++i) {
 
-            if (glyph_masks[i].empty())
+            auto& g = glyphs[i];
+
+            if (g.page.empty())
                 continue;
 
             auto glyph_offset = glyph_offsets[i] - offset;
-            Point shape = glyph_masks[i].shape();
+            Point shape = g.box.shape();
 
             for (int glyph_y = 0, text_y = glyph_offset.y(); glyph_y < shape.y(); ++glyph_y, ++text_y) {
-                auto glyph_ptr = &glyph_masks[i][{0, glyph_y}];
+                auto glyph_ptr = &std::as_const(g.page)[g.atlas_pos + Point{0, glyph_y}];
                 auto text_ptr = &text_mask[{glyph_offset.x(), text_y}];
                 for (int x = 0; x < shape.x(); ++x, ++text_ptr, ++glyph_ptr)
                     *text_ptr = std::max(*text_ptr, *glyph_ptr);
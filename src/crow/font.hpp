@@ -84,6 +84,8 @@ namespace Crow {
 
     public:
 
+        static constexpr size_t default_cache_limit = 16 * 1'048'576;
+
         ScaledFont() = default;
         ScaledFont(const Font& font, int scale) noexcept: ScaledFont(font, {scale, scale}) {}
         ScaledFont(const Font& font, Point scale) noexcept;
@@ -100,16 +102,20 @@ namespace Crow {
         Box_i2 text_box(const std::string& text, int line_shift = 0) const;
         size_t text_fit(const std::string& text, size_t max_pixels) const;
         size_t text_wrap(const std::string& text_in, std::string& text_out, size_t max_pixels) const;
+        size_t cache_limit() const noexcept;
+        void set_cache_limit(size_t bytes) noexcept;
+        void clear_cache() const noexcept;
 
     private:
 
         static constexpr float byte_scale = 1.0f / 255.0f;
 
+        struct glyph_info;
         struct scaled_impl;
 
         std::shared_ptr<scaled_impl> scaled_;
 
-        Detail::ByteMask render_glyph_mask(char32_t c, Point& offset) const;
+        void layout_text(const std::u32string& utext, std::vector<glyph_info>& glyphs, std::vector<int>& kerning) const;
         Detail::ByteMask render_text_mask(const std::u32string& utext, int line_shift, Point& offset) const;
         int scale_x(int x) const noexcept;
         int scale_y(int y) const noexcept;
@@ -1,47 +1,210 @@
 #include "crow/format-floating.hpp"
+#include <algorithm>
+#include <cstring>
 
 namespace Crow {
 
     namespace Detail {
 
-        std::string trim_exponent(const std::string& str, bool xsign) {
-            size_t begin_cut = str.find_first_of("Ee");
-            if (begin_cut == npos)
-                return str;
-            ++begin_cut;
-            bool neg = str[begin_cut] == '-';
-            if (neg)
-                ++begin_cut;
-            size_t end_cut = begin_cut;
-            if (str[end_cut] == '+')
-                ++end_cut;
-            while (end_cut < str.size() && str[end_cut] == '0')
-                ++end_cut;
-            if (end_cut == str.size())
-                --end_cut;
-            auto result = str.substr(0, begin_cut);
-            if (xsign && ! neg)
-                result += '+';
-            result += str.substr(end_cut);
-            return result;
+        namespace {
+
+            void write_sign(std::string& out, bool negative, const FloatStyle& style) {
+                if (negative)
+                    out += '-';
+                else if (style.plus)
+                    out += '+';
+            }
+
+            void write_special(std::string& out, const FloatDigits& digits, bool cap, const FloatStyle& style) {
+                write_sign(out, digits.negative(), style);
+                for (char c: digits.digits())
+                    out += cap ? ascii_toupper(c) : c;
+            }
+
+            size_t trim_zeros(std::string_view str) noexcept {
+                size_t n = str.size();
+                while (n > 0 && str[n - 1] == '0')
+                    --n;
+                return n;
+            }
+
+            // Digits to display, and the total digit count including any
+            // zero padding up to the precision
+
+            std::string_view display_digits(const FloatDigits& digits, const FloatStyle& style, int& count) {
+                auto ds = digits.digits();
+                if (style.strip || style.shortest) {
+                    ds = ds.substr(0, std::max(trim_zeros(ds), size_t(1)));
+                    count = int(ds.size());
+                } else {
+                    count = std::max({style.prec, int(ds.size()), 1});
+                }
+                return ds;
+            }
+
+            void strip_fraction(std::string& out, size_t begin, char point) {
+                size_t pos = out.find(point, begin);
+                if (pos == npos)
+                    return;
+                size_t last = trim_zeros(out);
+                out.resize(last == pos + 1 ? pos : last);
+            }
+
+        }
+
+        FloatStyle::FloatStyle(const FormatSpec& spec) noexcept:
+        prec(spec.prec()),
+        cap(ascii_isupper(spec.mode())) {
+            bool comma = false;
+            for (char c: spec.options()) {
+                switch (c) {
+                    case 'A': case 'C': case 'U': case 'W':
+                    case 'a': case 'c': case 'u': case 'w':  grouped = true; break;
+                    case 'S':                                xsign = true; break;
+                    case 'e':                                comma = true; break;
+                    case 'r':                                shortest = true; break;
+                    case 's':                                plus = true; break;
+                    case 'z':                                strip = true; break;
+                    default:                                 break;
+                }
+            }
+            if (grouped)
+                plus = false;
+            else if (comma)
+                point = ',';
         }
 
-        std::string trim_zeros(const std::string& str) {
-            size_t dec_point = str.find('.');
-            if (dec_point == npos)
-                return str;
-            size_t end_sig = str.find_first_not_of("0123456789", dec_point + 1);
-            if (end_sig == npos)
-                end_sig = str.size();
-            size_t last_digit = end_sig - 1;
-            while (str[last_digit] == '0')
-                --last_digit;
-            if (str[last_digit] != '.')
-                ++last_digit;
-            if (last_digit < end_sig)
-                return str.substr(0, last_digit) + str.substr(end_sig);
+        void FloatDigits::parse(char* begin, char* end) noexcept {
+            negative_ = *begin == '-';
+            if (negative_)
+                ++begin;
+            finite_ = ascii_isdigit(*begin);
+            exponent_ = 0;
+            if (! finite_) {
+                digits_ = std::string_view(begin, size_t(end - begin));
+                return;
+            }
+            auto exp_pos = std::find(begin, end, 'e');
+            if (exp_pos - begin > 1) {
+                // Close up the decimal point
+                begin[1] = begin[0];
+                ++begin;
+            }
+            digits_ = std::string_view(begin, size_t(exp_pos - begin));
+            bool neg_exp = exp_pos[1] == '-';
+            for (auto p = exp_pos + 2; p < end; ++p)
+                exponent_ = 10 * exponent_ + (*p - '0');
+            if (neg_exp)
+                exponent_ = - exponent_;
+        }
+
+        void write_float_d(std::string& out, const FloatDigits& digits, const FloatStyle& style) {
+            if (! digits.finite()) {
+                write_special(out, digits, false, style);
+                return;
+            }
+            int count = 0;
+            auto ds = display_digits(digits, style, count);
+            int size = int(ds.size());
+            int exp = digits.exponent();
+            bool sign = digits.negative() || style.plus;
+            int length = int(sign);
+            if (exp < 0)
+                length += count + 1 - exp;
+            else if (exp < count - 1)
+                length += count + 1;
             else
-                return str;
+                length += exp + 1;
+            size_t offset = out.size();
+            out.resize(offset + size_t(length), '0');
+            auto ptr = out.data() + offset;
+            if (sign)
+                *ptr++ = digits.negative() ? '-' : '+';
+            if (exp < 0) {
+                ptr[1] = style.point;
+                std::memcpy(ptr + 1 - exp, ds.data(), ds.size());
+            } else if (exp < count - 1) {
+                int whole = exp + 1;
+                if (whole < size) {
+                    std::memcpy(ptr, ds.data(), size_t(whole));
+                    ptr[whole] = style.point;
+                    std::memcpy(ptr + whole + 1, ds.data() + whole, size_t(size - whole));
+                } else {
+                    std::memcpy(ptr, ds.data(), ds.size());
+                    ptr[whole] = style.point;
+                }
+            } else {
+                std::memcpy(ptr, ds.data(), ds.size());
+            }
+        }
+
+        void write_float_e(std::string& out, const FloatDigits& digits, const FloatStyle& style) {
+            if (! digits.finite()) {
+                write_special(out, digits, style.cap, style);
+                return;
+            }
+            int count = 0;
+            auto ds = display_digits(digits, style, count);
+            int exp = digits.exponent();
+            std::array<char, 16> exp_buffer;
+            auto exp_end = std::to_chars(exp_buffer.data(), exp_buffer.data() + exp_buffer.size(), std::abs(exp)).ptr;
+            auto exp_size = size_t(exp_end - exp_buffer.data());
+            bool sign = digits.negative() || style.plus;
+            bool exp_sign = exp < 0 || style.xsign;
+            size_t length = size_t(sign) + size_t(count) + size_t(count > 1) + 1 + size_t(exp_sign) + exp_size;
+            size_t offset = out.size();
+            out.resize(offset + length, '0');
+            auto ptr = out.data() + offset;
+            if (sign)
+                *ptr++ = digits.negative() ? '-' : '+';
+            *ptr++ = ds[0];
+            if (count > 1) {
+                *ptr++ = style.point;
+                std::memcpy(ptr, ds.data() + 1, ds.size() - 1);
+                ptr += count - 1;
+            }
+            *ptr++ = style.cap ? 'E' : 'e';
+            if (exp_sign)
+                *ptr++ = exp < 0 ? '-' : '+';
+            std::memcpy(ptr, exp_buffer.data(), exp_size);
+        }
+
+        void write_float_f(std::string& out, std::string_view fixed, const FloatStyle& style) {
+            bool negative = fixed[0] == '-';
+            if (negative) {
+                fixed.remove_prefix(1);
+                negative = fixed.find_first_not_of("0.") != npos;
+            }
+            size_t pos = fixed.find('.');
+            if (style.strip && pos != npos) {
+                size_t last = trim_zeros(fixed);
+                fixed = fixed.substr(0, last == pos + 1 ? pos : last);
+            }
+            write_sign(out, negative, style);
+            if (style.point == '.' || pos >= fixed.size()) {
+                out += fixed;
+            } else {
+                out += fixed.substr(0, pos);
+                out += style.point;
+                out += fixed.substr(pos + 1);
+            }
+        }
+
+        void write_float_p(std::string& out, size_t begin, bool complement, bool percent, const FloatStyle& style) {
+            // Complement the digits of 1-t, leaving any trailing zeros alone
+            if (complement) {
+                int a = 2 * '0' + 10;
+                int b = a - 1;
+                for (auto i = int(out.find_last_not_of('0')); i >= int(begin); --i, a = b)
+                    if (ascii_isdigit(out[i]))
+                        out[i] = char(a - out[i]);
+                if (percent)
+                    out.insert(begin, 1, '9');
+                else
+                    out[begin] = '0';
+            }
+            if (style.strip)
+                strip_fraction(out, begin, style.point);
         }
 
     }
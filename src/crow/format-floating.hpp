@@ -5,119 +5,148 @@
 #include "crow/string.hpp"
 #include "crow/types.hpp"
 #include <algorithm>
+#include <array>
+#include <charconv>
 #include <cmath>
 #include <complex>
 #include <concepts>
-#include <cstdio>
-#include <cstdlib>
+#include <limits>
 #include <numbers>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <type_traits>
 
 namespace Crow {
 
     namespace Detail {
 
-        std::string trim_exponent(const std::string& str, bool xsign);
-        std::string trim_zeros(const std::string& str);
-
-        template <std::floating_point T, std::floating_point U>
-        std::string native_format(const char* pattern, U u, int prec) {
-            std::string result(15, '\0');
-            int rc = 0;
-            for (;;) {
-                rc = std::snprintf(result.data(), result.size(), pattern, prec, T(u));
-                if (rc < int(result.size()))
-                    break;
-                result.resize(rc + 1);
+        // Layout options for the floating point writers, resolved once from
+        // the format spec. If the spec asks for digit grouping, the sign and
+        // decimal point are left to expand_formatted_number().
+
+        struct FloatStyle {
+            int prec = 6;           // Significant digits, or decimal places for fixed point
+            char point = '.';       // Decimal point
+            bool cap = false;       // Upper case exponent and special values
+            bool grouped = false;   // Needs expand_formatted_number()
+            bool plus = false;      // Show a sign on non-negative values
+            bool shortest = false;  // Shortest round trip digits, ignoring precision
+            bool strip = false;     // Strip trailing zeros
+            bool xsign = false;     // Show a sign on non-negative exponents
+            FloatStyle() = default;
+            explicit FloatStyle(const FormatSpec& spec) noexcept;
+        };
+
+        // Significant decimal digits of a floating point value, from the
+        // Ryu based std::to_chars(), so that value = d.ddd x 10^exponent.
+        // A negative precision gives the shortest representation that reads
+        // back as the same value.
+
+        class FloatDigits {
+        public:
+            template <std::floating_point T> FloatDigits(T t, int prec);
+            FloatDigits(const FloatDigits&) = delete;
+            FloatDigits& operator=(const FloatDigits&) = delete;
+            std::string_view digits() const noexcept { return digits_; } // Special values give inf or nan here
+            int exponent() const noexcept { return exponent_; }
+            bool finite() const noexcept { return finite_; }
+            bool negative() const noexcept { return negative_; }
+        private:
+            std::array<char, 64> fixed_;
+            std::string dynamic_;
+            std::string_view digits_;
+            int exponent_ = 0;
+            bool finite_ = true;
+            bool negative_ = false;
+            void parse(char* begin, char* end) noexcept;
+        };
+
+            template <std::floating_point T>
+            FloatDigits::FloatDigits(T t, int prec) {
+                auto begin = fixed_.data();
+                auto size = fixed_.size();
+                if (prec < 0) {
+                    auto rc = std::to_chars(begin, begin + size, t, std::chars_format::scientific);
+                    parse(begin, rc.ptr);
+                    return;
+                }
+                if (size_t(prec) + 16 > size) {
+                    size = size_t(prec) + 16;
+                    dynamic_.resize(size);
+                    begin = dynamic_.data();
+                }
+                auto rc = std::to_chars(begin, begin + size, t, std::chars_format::scientific, prec - 1);
+                parse(begin, rc.ptr);
             }
-            result.resize(rc);
-            return result;
-        }
+
+        void write_float_d(std::string& out, const FloatDigits& digits, const FloatStyle& style);
+        void write_float_e(std::string& out, const FloatDigits& digits, const FloatStyle& style);
+        void write_float_f(std::string& out, std::string_view fixed, const FloatStyle& style);
+        void write_float_p(std::string& out, size_t begin, bool complement, bool percent, const FloatStyle& style);
 
         template <std::floating_point T>
-        std::string format_float_d(T t, const FormatSpec& spec) {
-            int prec = std::max(spec.prec() - 1, 0);
-            std::string native;
-            if constexpr (sizeof(T) <= sizeof(double))
-                native = native_format<double>("%.*e", t, prec);
-            else
-                native = native_format<long double>("%.*Le", t, prec);
-            size_t sig_pos = size_t(native[0] == '-');
-            size_t exp_pos = native.find_first_of("Ee", sig_pos);
-            auto result = native.substr(sig_pos, exp_pos - sig_pos);
-            if (result[1] == '.')
-                result.erase(1, 1);
-            int exp = to_int(native.substr(exp_pos + 1));
-            if (exp < 0) {
-                result.insert(0, "0.");
-                result.insert(2, - exp - 1, '0');
-            } else if (exp < prec) {
-                result.insert(exp + 1, 1, '.');
-            } else if (exp > prec - 1) {
-                result.append(exp - prec, '0');
-            }
-            if (sig_pos > 0)
-                result.insert(0, 1, '-');
-            return result;
+        void format_float_d(std::string& out, T t, const FloatStyle& style) {
+            FloatDigits digits(t, style.shortest ? -1 : std::max(style.prec, 1));
+            write_float_d(out, digits, style);
         }
 
         template <std::floating_point T>
-        std::string format_float_e(T t, const FormatSpec& spec) {
-            bool cap = ascii_isupper(spec.mode());
-            int prec = std::max(spec.prec() - 1, 0);
-            std::string native;
-            if constexpr (sizeof(T) <= sizeof(double))
-                native = native_format<double>(cap ? "%.*E" : "%.*e", t, prec);
-            else
-                native = native_format<long double>(cap ? "%.*LE" : "%.*Le", t, prec);
-            return trim_exponent(native, spec.option('S'));
+        void format_float_e(std::string& out, T t, const FloatStyle& style) {
+            FloatDigits digits(t, style.shortest ? -1 : std::max(style.prec, 1));
+            write_float_e(out, digits, style);
         }
 
         template <std::floating_point T>
-        std::string format_float_f(T t, const FormatSpec& spec) {
-            std::string result;
-            if constexpr (sizeof(T) <= sizeof(double))
-                result = native_format<double>("%.*f", t, spec.prec());
-            else
-                result = native_format<long double>("%.*Lf", t, spec.prec());
-            if (result[0] == '-' && result.find_first_not_of("0.-") == npos)
-                result.erase(0, 1);
-            return result;
+        void format_float_f(std::string& out, T t, const FloatStyle& style) {
+            std::array<char, 64> buffer;
+            auto rc = std::to_chars(buffer.data(), buffer.data() + buffer.size(), t, std::chars_format::fixed, style.prec);
+            if (rc.ec == std::errc()) {
+                write_float_f(out, std::string_view(buffer.data(), size_t(rc.ptr - buffer.data())), style);
+            } else {
+                std::string large(size_t(std::numeric_limits<T>::max_exponent10 + style.prec + 4), '\0');
+                rc = std::to_chars(large.data(), large.data() + large.size(), t, std::chars_format::fixed, style.prec);
+                write_float_f(out, std::string_view(large.data(), size_t(rc.ptr - large.data())), style);
+            }
         }
 
         template <std::floating_point T>
-        std::string format_float_g(T t, const FormatSpec& spec) {
+        void format_float_g(std::string& out, T t, const FloatStyle& style) {
             auto y = std::abs(t);
-            if (y == 0 || (y >= 1e-3 && y < 1e6))
-                return format_float_d(t, spec);
+            if (y == 0 || (y >= T(1e-3) && y < T(1e6)))
+                format_float_d(out, t, style);
             else
-                return format_float_e(t, spec);
+                format_float_e(out, t, style);
         }
 
         template <std::floating_point T>
-        std::string format_float_p(T t, const FormatSpec& spec) {
-            bool pc = spec.mode() == 'P';
+        void format_float_p(std::string& out, T t, const FloatStyle& style, bool percent) {
             if (t < 0 || t > 1)
                 throw std::domain_error("Probability is out of range: expected 0-1, found " + std::to_string(t));
-            else if (t == 0)
-                return "0";
-            else if (t == 1)
-                return pc ? "100" : "1";
-            T k = T(pc ? 100 : 1);
-            if (t < T(0.9))
-                return format_float_d(k * t, spec);
-            auto result = format_float_d(k * (1 - t), spec);
-            int a = 2 * '0' + 10;
-            int b = a - 1;
-            for (auto i = int(result.find_last_not_of('0')); i >= 0; --i, a = b)
-                if (ascii_isdigit(result[i]))
-                    result[i] = char(a - result[i]);
-            if (pc)
-                result.insert(0, 1, '9');
-            else
-                result[0] = '0';
+            if (style.plus)
+                out += '+';
+            if (t == 0) {
+                out += '0';
+            } else if (t == 1) {
+                out += percent ? "100" : "1";
+            } else {
+                T k = T(percent ? 100 : 1);
+                auto inner = style;
+                inner.plus = inner.shortest = inner.strip = false;
+                auto begin = out.size();
+                bool complement = t >= T(0.9);
+                format_float_d(out, complement ? k * (1 - t) : k * t, inner);
+                write_float_p(out, begin, complement, percent, style);
+            }
+        }
+
+        template <std::floating_point T>
+        std::string format_float_d(T t, const FormatSpec& spec) {
+            FloatStyle style;
+            style.prec = spec.prec();
+            std::string result;
+            format_float_d(result, t, style);
             return result;
         }
 
@@ -141,19 +170,19 @@ namespace Crow {
             else if (spec.empty())
                 spec = default_spec;
             spec.default_prec(6);
+            Detail::FloatStyle style(spec);
             std::string result;
 
             switch (spec.lcmode()) {
-                case 'd':  result = Detail::format_float_d(t, spec); break;
-                case 'e':  result = Detail::format_float_e(t, spec); break;
-                case 'f':  result = Detail::format_float_f(t, spec); break;
-                case 'p':  result = Detail::format_float_p(t, spec); break;
-                default:   result = Detail::format_float_g(t, spec); break;
+                case 'd':  Detail::format_float_d(result, t, style); break;
+                case 'e':  Detail::format_float_e(result, t, style); break;
+                case 'f':  Detail::format_float_f(result, t, style); break;
+                case 'p':  Detail::format_float_p(result, t, style, spec.mode() == 'P'); break;
+                default:   Detail::format_float_g(result, t, style); break;
             }
 
-            if (spec.option('z'))
-                result = Detail::trim_zeros(result);
-            Detail::expand_formatted_number(result, spec);
+            if (style.grouped)
+                Detail::expand_formatted_number(result, spec);
 
             return result;
 
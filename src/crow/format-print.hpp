@@ -36,14 +36,14 @@ namespace Crow {
 
     template <typename... Args>
     void printct(std::ostream& out, const std::string& pattern, const Args&... args) {
-        auto str = Formatter(pattern)(args...);
+        auto str = fmt(pattern, args...);
         Detail::check_lf(str);
         out.write(str.data(), str.size());
     }
 
     template <typename... Args>
     void printct(FILE* out, const std::string& pattern, const Args&... args) {
-        auto str = Formatter(pattern)(args...);
+        auto str = fmt(pattern, args...);
         Detail::check_lf(str);
         std::fwrite(str.data(), 1, str.size(), out);
     }
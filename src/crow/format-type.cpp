@@ -1,5 +1,6 @@
 #include "crow/format-type.hpp"
 #include <algorithm>
+#include <functional>
 
 namespace Crow {
 
@@ -103,6 +104,47 @@ namespace Crow {
 
         }
 
+        for (auto& field: fields_)
+            if (field.index < 0)
+                text_size_ += field.text.size();
+
+    }
+
+    namespace Detail {
+
+        // Small per-thread cache of recently used patterns, so fmt() in a loop
+        // doesn't reparse the pattern every time. The entries are shared
+        // pointers because formatting an argument may call fmt() recursively
+        // and evict the entry currently in use.
+
+        std::shared_ptr<const Formatter> cached_formatter(const std::string& pattern) {
+
+            static constexpr size_t cache_size = 16;
+
+            struct entry {
+                size_t hash = 0;
+                std::string pattern;
+                std::shared_ptr<const Formatter> formatter;
+            };
+
+            static thread_local std::array<entry, cache_size> cache;
+            static thread_local size_t next = 0;
+
+            auto hash = std::hash<std::string>()(pattern);
+
+            for (auto& e: cache)
+                if (e.formatter && e.hash == hash && e.pattern == pattern)
+                    return e.formatter;
+
+            auto formatter = std::make_shared<const Formatter>(pattern);
+            auto& e = cache[next];
+            next = (next + 1) % cache_size;
+            e = {hash, pattern, formatter};
+
+            return formatter;
+
+        }
+
     }
 
 }
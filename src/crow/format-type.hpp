@@ -9,17 +9,24 @@
 #include "crow/time.hpp"
 #include "crow/types.hpp"
 #include "crow/unicode.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <chrono>
 #include <compare>
 #include <complex>
 #include <concepts>
 #include <cstddef>
 #include <exception>
+#include <iterator>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace Crow {
@@ -230,11 +237,63 @@ namespace Crow {
         return FormatType<T>()(t, spec);
     }
 
+    namespace Detail {
+
+        template <typename Out>
+        void format_write(Out& out, std::string_view text) {
+            if constexpr (std::same_as<Out, std::string>)
+                out += text;
+            else
+                out = std::copy(text.begin(), text.end(), out);
+        }
+
+        // Common cases with a default format spec are written directly,
+        // without going through an intermediate string
+
+        template <typename Out, typename T>
+        void format_append(Out& out, const T& t, const FormatSpec& spec) {
+            using U = std::decay_t<T>;
+            if (spec.empty()) {
+                if constexpr (std::integral<U> && ! std::same_as<U, bool> && ! std::same_as<U, char>
+                        && ! std::same_as<U, char8_t> && ! std::same_as<U, char16_t>
+                        && ! std::same_as<U, char32_t> && ! std::same_as<U, wchar_t>) {
+                    char buf[24];
+                    auto rc = std::to_chars(buf, buf + sizeof(buf), t);
+                    format_write(out, std::string_view(buf, rc.ptr - buf));
+                    return;
+                } else if constexpr (std::same_as<U, std::string> || std::same_as<U, std::string_view>) {
+                    format_write(out, t);
+                    return;
+                } else if constexpr (std::is_array_v<T> && (std::same_as<U, const char*> || std::same_as<U, char*>)) {
+                    format_write(out, t);
+                    return;
+                } else if constexpr (std::same_as<U, const char*> || std::same_as<U, char*>) {
+                    if (t != nullptr) {
+                        format_write(out, t);
+                        return;
+                    }
+                }
+            }
+            format_write(out, FormatType<T>()(t, spec));
+        }
+
+        template <typename Out>
+        using FormatThunk = void (*)(Out& out, const void* ptr, const FormatSpec& spec);
+
+        template <typename Out, typename T>
+        void format_thunk(Out& out, const void* ptr, const FormatSpec& spec) {
+            format_append(out, *static_cast<const T*>(ptr), spec);
+        }
+
+    }
+
     class Formatter {
     public:
         Formatter() = default;
         explicit Formatter(const std::string& pattern);
         template <typename... Args> std::string operator()(const Args&... args) const;
+        template <typename... Args> void format_to(std::string& out, const Args&... args) const;
+        template <std::output_iterator<char> Out, typename... Args> Out format_to(Out out, const Args&... args) const;
     private:
         struct field_type {
             FormatSpec spec;
@@ -243,43 +302,294 @@ namespace Crow {
         };
         std::vector<field_type> fields_;
         size_t required_args_ = 0;
-        static void handle_arg(std::string& /*result*/, const field_type& /*field*/, int /*index*/) {}
-        template <typename T, typename... Args>
-            static void handle_arg(std::string& result, const field_type& field, int index, const T& t, const Args&... args);
+        size_t text_size_ = 0;
+        template <typename Out, typename... Args> void format_fields(Out& out, const Args&... args) const;
     };
 
         template <typename... Args>
         std::string Formatter::operator()(const Args&... args) const {
+            std::string result;
+            result.reserve(text_size_ + 8 * sizeof...(Args));
+            format_fields(result, args...);
+            return result;
+        }
+
+        template <typename... Args>
+        void Formatter::format_to(std::string& out, const Args&... args) const {
+            format_fields(out, args...);
+        }
+
+        template <std::output_iterator<char> Out, typename... Args>
+        Out Formatter::format_to(Out out, const Args&... args) const {
+            format_fields(out, args...);
+            return out;
+        }
+
+        template <typename Out, typename... Args>
+        void Formatter::format_fields(Out& out, const Args&... args) const {
             if (sizeof...(args) < required_args_)
                 throw std::out_of_range("Not enough format arguments: "+ std::to_string(sizeof...(args)) + " supplied, "
                     + std::to_string(required_args_) + " required");
+            if constexpr (sizeof...(Args) == 0) {
+                for (auto& field: fields_)
+                    Detail::format_write(out, field.text);
+            } else {
+                static constexpr Detail::FormatThunk<Out> thunks[] = {&Detail::format_thunk<Out, Args>...};
+                const void* ptrs[] = {static_cast<const void*>(std::addressof(args))...};
+                for (auto& field: fields_) {
+                    if (field.index < 0)
+                        Detail::format_write(out, field.text);
+                    else
+                        thunks[field.index](out, ptrs[field.index], field.spec);
+                }
+            }
+        }
+
+    // Compile time format patterns
+
+    namespace Detail {
+
+        template <size_t N>
+        struct FormatLiteral {
+            char chars[N] = {};
+            consteval FormatLiteral(const char (&str)[N]) { std::copy_n(str, N, chars); }
+            constexpr std::string_view view() const noexcept { return {chars, N - 1}; }
+        };
+
+        struct StaticFormatField {
+            int index;   // Argument index, or -1 for literal text
+            size_t pos;  // Literal text or format spec, as an offset into the text table
+            size_t len;
+        };
+
+        struct StaticFormatSizes {
+            size_t fields = 0;
+            size_t text = 0;
+            size_t args = 0;
+        };
+
+        // Deliberately not constexpr, so reaching it at compile time is an
+        // error. The parsing functions below are only used to initialise
+        // constexpr tables.
+
+        [[noreturn]] inline void invalid_format_pattern() {
+            throw std::invalid_argument("Invalid format pattern");
+        }
+
+        constexpr size_t static_format_utf8_length(std::string_view str, size_t pos) {
+            auto c = static_cast<unsigned char>(str[pos]);
+            size_t n = c < 0x80 ? 1 : c < 0xc2 ? 0 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : c < 0xf5 ? 4 : 0;
+            if (n == 0 || pos + n > str.size())
+                invalid_format_pattern();
+            for (size_t i = 1; i < n; ++i)
+                if ((static_cast<unsigned char>(str[pos + i]) & 0xc0) != 0x80)
+                    invalid_format_pattern();
+            return n;
+        }
+
+        constexpr bool static_format_valid_spec(std::string_view spec) {
+            if (spec.empty())
+                return true;
+            if (spec[0] != '\0' && spec[0] != '*' && ! ascii_isalpha(spec[0]))
+                return false;
+            size_t i = 1;
+            while (i < spec.size() && ascii_isalpha(spec[i]))
+                ++i;
+            while (i < spec.size() && ascii_isdigit(spec[i]))
+                ++i;
+            return i == spec.size();
+        }
+
+        // Follows the same rules as the Formatter constructor. Called once with
+        // null pointers to find the table sizes, then again to fill them in.
+        // Adjacent literal text and escapes are merged into a single field.
+
+        constexpr StaticFormatSizes parse_static_format(std::string_view pattern, StaticFormatField* fields, char* text) {
+
+            StaticFormatSizes sizes;
+            bool last_literal = false;
+
+            auto add_text = [&] (std::string_view str, bool literal) {
+                if (literal && last_literal) {
+                    if (fields != nullptr)
+                        fields[sizes.fields - 1].len += str.size();
+                } else {
+                    if (fields != nullptr)
+                        fields[sizes.fields] = {-1, sizes.text, str.size()};
+                    ++sizes.fields;
+                }
+                if (text != nullptr)
+                    std::copy(str.begin(), str.end(), text + sizes.text);
+                sizes.text += str.size();
+                last_literal = literal;
+            };
+
+            for (size_t pos = 0; pos < pattern.size(); pos += static_format_utf8_length(pattern, pos)) {}
+
+            for (size_t current_pos = 0; current_pos < pattern.size();) {
+
+                auto field_pos = pattern.find_first_of("{\\", current_pos);
+
+                if (field_pos > current_pos)
+                    add_text(pattern.substr(current_pos, field_pos - current_pos), true);
+                if (field_pos == std::string_view::npos)
+                    break;
+
+                if (pattern[field_pos] == '{') {
+
+                    size_t end_field = pattern.find('}', field_pos + 1);
+                    if (end_field == std::string_view::npos)
+                        invalid_format_pattern();
+
+                    size_t end_index = field_pos + 1;
+                    int index = 0;
+                    for (; end_index < end_field && ascii_isdigit(pattern[end_index]); ++end_index)
+                        index = 10 * index + (pattern[end_index] - '0');
+                    if (end_index == field_pos + 1 || ! (end_index == end_field || pattern[end_index] == ':'))
+                        invalid_format_pattern();
+
+                    std::string_view spec;
+                    if (pattern[end_index] == ':')
+                        spec = pattern.substr(end_index + 1, end_field - end_index - 1);
+                    if (! static_format_valid_spec(spec))
+                        invalid_format_pattern();
+
+                    add_text(spec, false);
+                    if (fields != nullptr)
+                        fields[sizes.fields - 1].index = index;
+                    sizes.args = std::max(sizes.args, size_t(index + 1));
+                    current_pos = end_field + 1;
+
+                } else {
+
+                    if (pattern.size() - field_pos == 1)
+                        invalid_format_pattern();
+
+                    size_t len = static_format_utf8_length(pattern, field_pos + 1);
+                    add_text(pattern.substr(field_pos + 1, len), true);
+                    current_pos = field_pos + 1 + len;
+
+                }
+
+            }
+
+            return sizes;
+
+        }
+
+    }
+
+    template <Detail::FormatLiteral Pattern>
+    class StaticFormatter {
+
+    private:
+
+        static constexpr auto sizes = Detail::parse_static_format(Pattern.view(), nullptr, nullptr);
+
+    public:
+
+        static constexpr size_t required_args = sizes.args;
+
+        template <typename... Args> std::string operator()(const Args&... args) const;
+        template <typename... Args> void format_to(std::string& out, const Args&... args) const;
+        template <std::output_iterator<char> Out, typename... Args> Out format_to(Out out, const Args&... args) const;
+        static constexpr std::string_view pattern() noexcept { return Pattern.view(); }
+        operator Formatter() const { return Formatter(std::string(Pattern.view())); }
+
+    private:
+
+        struct table_type {
+            std::array<Detail::StaticFormatField, sizes.fields> fields;
+            std::array<char, sizes.text> text;
+        };
+
+        static constexpr table_type table = [] {
+            table_type t = {};
+            Detail::parse_static_format(Pattern.view(), t.fields.data(), t.text.data());
+            return t;
+        }();
+
+        static const std::array<FormatSpec, sizes.fields>& specs();
+        template <size_t I, typename Out, typename... Args> static void format_field(Out& out, const Args&... args);
+        template <typename Out, typename... Args> static void format_fields(Out& out, const Args&... args);
+
+    };
+
+        template <Detail::FormatLiteral Pattern>
+        template <typename... Args>
+        std::string StaticFormatter<Pattern>::operator()(const Args&... args) const {
             std::string result;
-            for (auto& field: fields_) {
-                if (field.index < 0)
-                    result += field.text;
+            result.reserve(sizes.text + 8 * sizeof...(Args));
+            format_fields(result, args...);
+            return result;
+        }
+
+        template <Detail::FormatLiteral Pattern>
+        template <typename... Args>
+        void StaticFormatter<Pattern>::format_to(std::string& out, const Args&... args) const {
+            format_fields(out, args...);
+        }
+
+        template <Detail::FormatLiteral Pattern>
+        template <std::output_iterator<char> Out, typename... Args>
+        Out StaticFormatter<Pattern>::format_to(Out out, const Args&... args) const {
+            format_fields(out, args...);
+            return out;
+        }
+
+        template <Detail::FormatLiteral Pattern>
+        const std::array<FormatSpec, StaticFormatter<Pattern>::sizes.fields>& StaticFormatter<Pattern>::specs() {
+            static const auto array = [] {
+                std::array<FormatSpec, sizes.fields> a;
+                for (size_t i = 0; i < sizes.fields; ++i)
+                    if (table.fields[i].index >= 0 && table.fields[i].len > 0)
+                        a[i] = FormatSpec(std::string_view(table.text.data() + table.fields[i].pos, table.fields[i].len));
+                return a;
+            }();
+            return array;
+        }
+
+        template <Detail::FormatLiteral Pattern>
+        template <size_t I, typename Out, typename... Args>
+        void StaticFormatter<Pattern>::format_field(Out& out, const Args&... args) {
+            static constexpr auto field = table.fields[I];
+            if constexpr (field.index < 0) {
+                Detail::format_write(out, std::string_view(table.text.data() + field.pos, field.len));
+            } else {
+                constexpr auto index = size_t(field.index);
+                auto& arg = std::get<index>(std::forward_as_tuple(args...));
+                if constexpr (field.len == 0)
+                    Detail::format_append(out, arg, FormatSpec());
                 else
-                    handle_arg(result, field, 0, args...);
+                    Detail::format_append(out, arg, specs()[I]);
             }
-            return result;
         }
 
-        template <typename T, typename... Args>
-        void Formatter::handle_arg(std::string& result, const field_type& field, int index, const T& t, const Args&... args) {
-            if (index == field.index)
-                result += format_object(t, field.spec);
-            else
-                handle_arg(result, field, index + 1, args...);
+        template <Detail::FormatLiteral Pattern>
+        template <typename Out, typename... Args>
+        void StaticFormatter<Pattern>::format_fields(Out& out, const Args&... args) {
+            static_assert(sizeof...(Args) >= required_args, "Not enough format arguments");
+            [&]<size_t... I>(std::index_sequence<I...>) {
+                (format_field<I>(out, args...), ...);
+            }(std::make_index_sequence<sizes.fields>());
         }
 
+    namespace Detail {
+
+        std::shared_ptr<const Formatter> cached_formatter(const std::string& pattern);
+
+    }
+
     template <typename... Args>
     std::string fmt(const std::string& pattern, const Args&... args) {
-        return Formatter(pattern)(args...);
+        return (*Detail::cached_formatter(pattern))(args...);
     }
 
     namespace Literals {
 
-        inline Formatter operator""_fmt(const char* ptr, size_t len) {
-            return Formatter(std::string(ptr, len));
+        template <Detail::FormatLiteral Pattern>
+        constexpr StaticFormatter<Pattern> operator""_fmt() noexcept {
+            return {};
         }
 
     }
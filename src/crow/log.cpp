@@ -0,0 +1,543 @@
+#include "crow/log.hpp"
+#include "crow/time.hpp"
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace Crow {
+
+    namespace {
+
+        struct log_header {
+            uint32_t size;
+            int32_t line;
+            system_clock::rep ticks;
+            const char* file;
+            const char* func;
+            FILE* stream;
+        };
+
+        constexpr size_t min_log_buffer = 256;
+
+        std::atomic<int>& tty_state() noexcept {
+            static std::atomic<int> state(-1); // -1 = not yet known
+            return state;
+        }
+
+        int thread_colour() noexcept {
+            static thread_local int colour = [] {
+                auto id = std::this_thread::get_id();
+                auto seed = uint32_t(std::hash<std::thread::id>()(id));
+                std::minstd_rand rng(seed);
+                std::uniform_int_distribution<int> rgb_dist(1, 4);
+                int r = rgb_dist(rng);
+                int g = rgb_dist(rng);
+                int b = rgb_dist(rng);
+                return 36 * r + 6 * g + b + 16;
+            }();
+            return colour;
+        }
+
+        void append_prefix(std::string& message, bool tty, int colour, system_clock::time_point tp,
+                const char* file, const char* func, int line) {
+
+            static constexpr const char* delimiters =
+                #ifdef _XOPEN_SOURCE
+                    "/";
+                #else
+                    "/\\";
+                #endif
+
+            if (tty) {
+                message += "\x1b[38;5;";
+                message += std::to_string(colour);
+                message += 'm';
+            }
+
+            message += '[';
+            message += iso_date(tp, 6);
+
+            if (file != nullptr) {
+                std::string_view name = file;
+                size_t cut = name.find_last_of(delimiters);
+                if (cut != std::string_view::npos)
+                    name.remove_prefix(cut + 1);
+                message += ' ';
+                message += name;
+                message += ' ';
+                message += func;
+                message += "() ";
+                message += std::to_string(line);
+            }
+
+            message += ']';
+
+        }
+
+        template <typename T>
+        T read_value(const char*& ptr) noexcept {
+            T t;
+            std::memcpy(&t, ptr, sizeof(T));
+            ptr += sizeof(T);
+            return t;
+        }
+
+        void format_record(std::string& message, const char* record, bool tty, int colour) {
+
+            using namespace Detail;
+
+            auto header = read_value<log_header>(record);
+            auto end = record + (header.size - sizeof(log_header));
+            auto tp = system_clock::time_point(system_clock::duration(header.ticks));
+
+            append_prefix(message, tty, colour, tp, header.file, header.func, header.line);
+
+            while (record < end) {
+
+                auto tag = log_tag(*record++);
+                message += ' ';
+
+                switch (tag) {
+                    case log_tag::boolean:
+                        message += *record++ ? "true" : "false";
+                        break;
+                    case log_tag::signed_int:
+                        message += std::to_string(read_value<int64_t>(record));
+                        break;
+                    case log_tag::unsigned_int:
+                        message += std::to_string(read_value<uint64_t>(record));
+                        break;
+                    case log_tag::floating:
+                        message += std::to_string(read_value<double>(record));
+                        break;
+                    case log_tag::long_floating:
+                        message += std::to_string(read_value<long double>(record));
+                        break;
+                    case log_tag::text: {
+                        auto len = read_value<uint32_t>(record);
+                        message.append(record, len);
+                        record += len;
+                        break;
+                    }
+                }
+
+            }
+
+            Detail::log_end(message, tty);
+
+        }
+
+        void start_record(std::string& record, FILE* stream, const char* file, const char* func, int line) {
+            log_header header = {0, int32_t(line), system_clock::now().time_since_epoch().count(), file, func, stream};
+            record.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+        }
+
+        void finish_record(std::string& record) noexcept {
+            auto size = uint32_t(record.size());
+            std::memcpy(record.data(), &size, sizeof(size));
+        }
+
+        // Single producer, single consumer ring buffer. Head and tail are
+        // running byte counts, reduced modulo the capacity (always a power
+        // of 2) to find the buffer position. Only the owning thread writes
+        // records, and only the background thread reads them.
+
+        class log_ring {
+        public:
+            log_ring(size_t capacity, int colour): buffer_(new char[capacity]), capacity_(capacity), colour_(colour) {}
+            size_t capacity() const noexcept { return capacity_; }
+            int colour() const noexcept { return colour_; }
+            bool has_data() const noexcept { return head_.load(std::memory_order_acquire) != tail_.load(std::memory_order_relaxed); }
+            bool try_push(const std::string& record) noexcept;
+            void pop_all(std::string& out);
+            std::atomic<uint64_t> dropped {0};
+            std::atomic<bool> closed {false};
+        private:
+            std::unique_ptr<char[]> buffer_;
+            size_t capacity_;
+            int colour_;
+            alignas(64) std::atomic<uint64_t> head_ {0};  // Written by the producer
+            uint64_t tail_cache_ = 0;                     // Producer's last view of the tail
+            alignas(64) std::atomic<uint64_t> tail_ {0};  // Written by the consumer
+        };
+
+            bool log_ring::try_push(const std::string& record) noexcept {
+
+                auto n = record.size();
+                auto head = head_.load(std::memory_order_relaxed);
+
+                if (head + n - tail_cache_ > capacity_) {
+                    tail_cache_ = tail_.load(std::memory_order_acquire);
+                    if (head + n - tail_cache_ > capacity_)
+                        return false;
+                }
+
+                auto pos = size_t(head & (capacity_ - 1));
+                auto first = std::min(n, capacity_ - pos);
+                std::memcpy(buffer_.get() + pos, record.data(), first);
+                std::memcpy(buffer_.get(), record.data() + first, n - first);
+                head_.store(head + n, std::memory_order_release);
+
+                return true;
+
+            }
+
+            void log_ring::pop_all(std::string& out) {
+
+                auto tail = tail_.load(std::memory_order_relaxed);
+                auto head = head_.load(std::memory_order_acquire);
+                auto n = size_t(head - tail);
+
+                if (n == 0)
+                    return;
+
+                auto pos = size_t(tail & (capacity_ - 1));
+                auto first = std::min(n, capacity_ - pos);
+                out.append(buffer_.get() + pos, first);
+                out.append(buffer_.get(), n - first);
+                tail_.store(head, std::memory_order_release);
+
+            }
+
+        struct ring_holder {
+            std::shared_ptr<log_ring> ring;
+            ~ring_holder() noexcept { if (ring) ring->closed = true; }
+        };
+
+        // The background thread collects everything queued on all threads'
+        // rings, merges it into timestamp order, and writes each batch with
+        // a single call per stream. The backend is deliberately never
+        // destroyed, so threads still logging during shutdown are safe; an
+        // exit handler drains the queues and stops the thread instead.
+
+        class log_backend {
+        public:
+            static log_backend* instance() noexcept { return instance_ptr(); }
+            static log_backend& get();
+            void configure(LogOverflow overflow, size_t buffer) noexcept;
+            void push(std::string& record);
+            void flush() noexcept;
+            void stop() noexcept;
+        private:
+            struct entry {
+                system_clock::rep ticks;
+                FILE* stream;
+                const char* record;
+                int colour;
+            };
+            std::mutex mutex_;
+            std::condition_variable wake_cv_;
+            std::condition_variable done_cv_;
+            std::vector<std::shared_ptr<log_ring>> rings_;
+            std::atomic<LogOverflow> overflow_ {LogOverflow::block};
+            std::atomic<size_t> buffer_ {default_log_buffer};
+            std::atomic<bool> sleeping_ {false};
+            std::atomic<bool> running_ {true};
+            bool stop_ = false;
+            bool wake_ = false;
+            uint64_t cycles_ = 0;
+            uint64_t flush_target_ = 0;
+            std::thread thread_;
+            log_backend(): thread_([this] { run(); }) {}
+            log_ring& local_ring();
+            void wake() noexcept;
+            void run() noexcept;
+            void write_direct(const std::string& record, int colour);
+            static log_backend*& instance_ptr() noexcept { static log_backend* ptr = nullptr; return ptr; }
+        };
+
+            log_backend& log_backend::get() {
+                static log_backend* backend = [] {
+                    auto ptr = new log_backend;
+                    instance_ptr() = ptr;
+                    std::atexit([] { log_backend::instance()->stop(); });
+                    return ptr;
+                }();
+                return *backend;
+            }
+
+            void log_backend::configure(LogOverflow overflow, size_t buffer) noexcept {
+                overflow_ = overflow;
+                buffer_ = std::bit_ceil(std::max(buffer, min_log_buffer));
+            }
+
+            void log_backend::push(std::string& record) {
+
+                auto& ring = local_ring();
+
+                if (record.size() > ring.capacity()) {
+                    write_direct(record, ring.colour());
+                    return;
+                }
+
+                while (! ring.try_push(record)) {
+                    auto overflow = overflow_.load(std::memory_order_relaxed);
+                    if (overflow == LogOverflow::count)
+                        ++ring.dropped;
+                    if (overflow != LogOverflow::block)
+                        return;
+                    if (! running_) {
+                        write_direct(record, ring.colour());
+                        return;
+                    }
+                    if (sleeping_)
+                        wake();
+                    std::this_thread::yield();
+                }
+
+                // Pairs with the fence in run() before the consumer goes to
+                // sleep, so one side always sees the other
+
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                if (sleeping_.load(std::memory_order_relaxed))
+                    wake();
+
+            }
+
+            void log_backend::flush() noexcept {
+                std::unique_lock lock(mutex_);
+                if (! running_)
+                    return;
+                auto target = cycles_ + 2; // The current cycle may have started before the call
+                flush_target_ = std::max(flush_target_, target);
+                wake_ = true;
+                wake_cv_.notify_one();
+                done_cv_.wait(lock, [this,target] { return cycles_ >= target || ! running_; });
+            }
+
+            void log_backend::stop() noexcept {
+                Detail::log_async() = false;
+                {
+                    std::unique_lock lock(mutex_);
+                    if (! running_)
+                        return;
+                    stop_ = true;
+                    wake_cv_.notify_one();
+                }
+                if (thread_.joinable())
+                    thread_.join();
+            }
+
+            log_ring& log_backend::local_ring() {
+                static thread_local ring_holder holder;
+                auto buffer = buffer_.load(std::memory_order_relaxed);
+                if (! holder.ring || holder.ring->capacity() != buffer) {
+                    if (holder.ring)
+                        holder.ring->closed = true;
+                    holder.ring = std::make_shared<log_ring>(buffer, thread_colour());
+                    std::unique_lock lock(mutex_);
+                    rings_.push_back(holder.ring);
+                }
+                return *holder.ring;
+            }
+
+            void log_backend::wake() noexcept {
+                std::unique_lock lock(mutex_);
+                wake_ = true;
+                wake_cv_.notify_one();
+            }
+
+            void log_backend::run() noexcept {
+
+                std::vector<std::shared_ptr<log_ring>> rings;
+                std::vector<std::string> queued;
+                std::vector<std::string> notices;
+                std::vector<entry> entries;
+                std::string out;
+                FILE* stream = nullptr;
+
+                auto write_out = [&out,&stream] {
+                    if (stream != nullptr && ! out.empty()) {
+                        std::fwrite(out.data(), 1, out.size(), stream);
+                        std::fflush(stream);
+                    }
+                    out.clear();
+                };
+
+                for (;;) {
+
+                    bool stopping = false;
+
+                    {
+                        std::unique_lock lock(mutex_);
+                        stopping = stop_;
+                        rings = rings_;
+                    }
+
+                    queued.resize(rings.size());
+                    notices.clear();
+                    entries.clear();
+
+                    for (size_t i = 0; i < rings.size(); ++i) {
+
+                        auto& ring = *rings[i];
+                        auto& bytes = queued[i];
+                        bytes.clear();
+                        ring.pop_all(bytes);
+
+                        for (size_t pos = 0; pos < bytes.size();) {
+                            const char* ptr = bytes.data() + pos;
+                            auto header = read_value<log_header>(ptr);
+                            entries.push_back({header.ticks, header.stream, bytes.data() + pos, ring.colour()});
+                            pos += header.size;
+                        }
+
+                        if (auto dropped = ring.dropped.exchange(0)) {
+                            auto& note = notices.emplace_back();
+                            start_record(note, Detail::log_stream(), nullptr, nullptr, -1);
+                            Detail::log_encode(note, dropped);
+                            Detail::log_encode(note, "log messages dropped");
+                            finish_record(note);
+                        }
+
+                    }
+
+                    // Notices are only added after all the ring data, so
+                    // pointers into the vector are stable from here
+
+                    for (auto& note: notices) {
+                        const char* ptr = note.data();
+                        auto header = read_value<log_header>(ptr);
+                        entries.push_back({header.ticks, header.stream, note.data(), thread_colour()});
+                    }
+
+                    std::stable_sort(entries.begin(), entries.end(),
+                        [] (const entry& a, const entry& b) { return a.ticks < b.ticks; });
+
+                    bool tty = false;
+
+                    for (auto& e: entries) {
+                        if (e.stream != stream) {
+                            write_out();
+                            stream = e.stream;
+                            tty = stream != nullptr && Detail::is_tty(stream);
+                        }
+                        format_record(out, e.record, tty, e.colour);
+                    }
+
+                    write_out();
+                    stream = nullptr;
+
+                    {
+                        std::unique_lock lock(mutex_);
+                        std::erase_if(rings_, [] (auto& r) { return r->closed && ! r->has_data(); });
+                    }
+
+                    rings.clear();
+
+                    std::unique_lock lock(mutex_);
+                    ++cycles_;
+
+                    if (stopping) {
+                        running_ = false;
+                        done_cv_.notify_all();
+                        return;
+                    }
+
+                    done_cv_.notify_all();
+
+                    if (entries.empty() && ! wake_ && cycles_ >= flush_target_) {
+                        sleeping_ = true;
+                        std::atomic_thread_fence(std::memory_order_seq_cst);
+                        bool pending = std::any_of(rings_.begin(), rings_.end(), [] (auto& r) { return r->has_data(); });
+                        if (! pending)
+                            wake_cv_.wait_for(lock, 100ms, [this] { return wake_ || stop_ || cycles_ < flush_target_; });
+                        sleeping_ = false;
+                    }
+
+                    wake_ = false;
+
+                }
+
+            }
+
+            void log_backend::write_direct(const std::string& record, int colour) {
+                flush();
+                const char* ptr = record.data();
+                auto header = read_value<log_header>(ptr);
+                std::string message;
+                format_record(message, record.data(), Detail::is_tty(header.stream), colour);
+                std::fwrite(message.data(), 1, message.size(), header.stream);
+            }
+
+    }
+
+    namespace Detail {
+
+        FILE* exchange_log_stream(FILE* stream) noexcept {
+            flush_log();
+            tty_state() = stream != nullptr && is_tty(stream);
+            return log_stream().exchange(stream);
+        }
+
+        bool is_tty(FILE* fp) noexcept {
+            #ifdef _WIN32
+                int fd = _fileno(fp);
+                return _isatty(fd) != 0;
+            #else
+                int fd = fileno(fp);
+                return isatty(fd) != 0;
+            #endif
+        }
+
+        bool log_is_tty() noexcept {
+            int state = tty_state();
+            if (state < 0) {
+                auto stream = log_stream().load();
+                state = stream != nullptr && is_tty(stream);
+                tty_state() = state;
+            }
+            return state != 0;
+        }
+
+        std::string timestamp() {
+            return iso_date(system_clock::now(), 6);
+        }
+
+        void log_begin(std::string& message, bool tty, system_clock::time_point tp,
+                const char* file, const char* func, int line) {
+            append_prefix(message, tty, thread_colour(), tp, file, func, line);
+        }
+
+        void log_end(std::string& message, bool tty) {
+            if (tty)
+                message += "\x1b[0m";
+            message += '\n';
+        }
+
+        std::string& log_record_begin(FILE* stream, const char* file, const char* func, int line) {
+            static thread_local std::string record;
+            start_record(record, stream, file, func, line);
+            return record;
+        }
+
+        void log_record_end(std::string& record) {
+            finish_record(record);
+            log_backend::get().push(record);
+        }
+
+    }
+
+    void set_log_async(bool async, LogOverflow overflow, size_t buffer) {
+        if (async) {
+            log_backend::get().configure(overflow, buffer);
+            Detail::log_async() = true;
+        } else if (Detail::log_async().exchange(false)) {
+            flush_log();
+        }
+    }
+
+    void flush_log() noexcept {
+        if (auto backend = log_backend::instance())
+            backend->flush();
+    }
+
+}
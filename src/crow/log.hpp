@@ -4,12 +4,14 @@
 #include <chrono>
 #include <cmath>
 #include <concepts>
+#include <cstdint>
 #include <cstdio>
 #include <ctime>
 #include <functional>
 #include <random>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <type_traits>
 
@@ -21,6 +23,12 @@
 
 namespace Crow {
 
+    enum class LogOverflow: int {
+        block,  // Wait for the background thread to make room
+        drop,   // Discard the message silently
+        count,  // Discard the message, and report the number discarded
+    };
+
     namespace Detail {
 
         template <typename T>
@@ -38,93 +46,102 @@ namespace Crow {
             }
         }
 
-        inline std::atomic<FILE*>& log_stream() noexcept {
-            static std::atomic<FILE*> stream(stderr);
-            return stream;
+        // Asynchronous log records are a fixed header followed by the
+        // arguments, each encoded as a tag byte and its value. Arithmetic
+        // and string arguments are captured raw and formatted on the
+        // background thread; anything else is formatted here.
+
+        enum class log_tag: uint8_t {
+            boolean,
+            signed_int,
+            unsigned_int,
+            floating,
+            long_floating,
+            text,
+        };
+
+        inline void log_append(std::string& record, const void* ptr, size_t len) {
+            record.append(static_cast<const char*>(ptr), len);
         }
 
-        inline bool is_tty(FILE* fp) noexcept {
-            #ifdef _WIN32
-                int fd = _fileno(fp);
-                return _isatty(fd) != 0;
-            #else
-                int fd = fileno(fp);
-                return isatty(fd) != 0;
-            #endif
+        inline void log_encode_text(std::string& record, std::string_view text) {
+            auto len = uint32_t(text.size());
+            record += char(log_tag::text);
+            log_append(record, &len, sizeof(len));
+            record += text;
         }
 
-        inline std::string timestamp() {
-
-            using namespace std::chrono;
-
-            auto now = system_clock::now();
-            auto t = system_clock::to_time_t(now);
-            std::tm tm = *std::gmtime(&t);
-            std::string text(30, '\0');
-            auto rc = std::strftime(&text[0], text.size(), "%Y-%m-%d %H:%M:%S", &tm);
-            text.resize(rc);
-
-            double sec = duration_cast<duration<double>>(now.time_since_epoch()).count();
-            double isec = 0;
-            double fsec = std::modf(sec, &isec);
-            std::string buf(9, '\0');
-            std::snprintf(&buf[0], buf.size(), "%.*f", 6, fsec);
-            text += buf.data() + 1;
+        template <typename T>
+        void log_encode(std::string& record, const T& t) {
+            if constexpr (std::is_same_v<T, bool>) {
+                record += char(log_tag::boolean);
+                record += char(t);
+            } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+                auto n = int64_t(t);
+                record += char(log_tag::signed_int);
+                log_append(record, &n, sizeof(n));
+            } else if constexpr (std::is_integral_v<T>) {
+                auto n = uint64_t(t);
+                record += char(log_tag::unsigned_int);
+                log_append(record, &n, sizeof(n));
+            } else if constexpr (std::is_same_v<T, long double>) {
+                record += char(log_tag::long_floating);
+                log_append(record, &t, sizeof(t));
+            } else if constexpr (std::is_floating_point_v<T>) {
+                auto x = double(t);
+                record += char(log_tag::floating);
+                log_append(record, &x, sizeof(x));
+            } else if constexpr (requires (T t) { { t.str() } -> std::convertible_to<std::string>; }) {
+                log_encode_text(record, t.str());
+            } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                log_encode_text(record, std::string_view(t));
+            } else {
+                auto text = log_format(t);
+                log_encode_text(record, std::string_view(text).substr(1));
+            }
+        }
 
-            return text;
+        inline std::atomic<FILE*>& log_stream() noexcept {
+            static std::atomic<FILE*> stream(stderr);
+            return stream;
+        }
 
+        inline std::atomic<bool>& log_async() noexcept {
+            static std::atomic<bool> flag(false);
+            return flag;
         }
 
+        FILE* exchange_log_stream(FILE* stream) noexcept;
+        bool is_tty(FILE* fp) noexcept;
+        bool log_is_tty() noexcept;
+        std::string timestamp();
+        void log_begin(std::string& message, bool tty, std::chrono::system_clock::time_point tp,
+            const char* file, const char* func, int line);
+        void log_end(std::string& message, bool tty);
+        std::string& log_record_begin(FILE* stream, const char* file, const char* func, int line);
+        void log_record_end(std::string& record);
+
         template <typename... Args>
         void log_helper(const char* file, const char* func, int line, const Args&... args) {
 
-            using namespace std::chrono;
+            auto stream = log_stream().load();
 
-            static constexpr const char* delimiters =
-                #ifdef _XOPEN_SOURCE
-                    "/";
-                #else
-                    "/\\";
-                #endif
-
-            if (! log_stream())
+            if (! stream)
                 return;
 
-            bool tty = is_tty(log_stream());
-            std::string message;
-
-            if (tty) {
-
-                static thread_local std::string prefix = [] {
-                    auto id = std::this_thread::get_id();
-                    auto seed = uint32_t(std::hash<std::thread::id>()(id));
-                    std::minstd_rand rng(seed);
-                    std::uniform_int_distribution<int> rgb_dist(1, 4);
-                    int r = rgb_dist(rng);
-                    int g = rgb_dist(rng);
-                    int b = rgb_dist(rng);
-                    int index = 36 * r + 6 * g + b + 16;
-                    return "\x1b[38;5;" + std::to_string(index) + 'm';
-                }();
-
-                message += prefix;
-            }
-
-            message += '[' + timestamp();
-
-            if (file != nullptr) {
-                std::string name = file;
-                size_t cut = name.find_last_of(delimiters);
-                if (cut != std::string::npos)
-                    name.erase(0, cut + 1);
-                message += ' ' + name + ' ' + func + "() " + std::to_string(line);
+            if (log_async().load(std::memory_order_relaxed)) {
+                auto& record = log_record_begin(stream, file, func, line);
+                (log_encode(record, args), ...);
+                log_record_end(record);
+                return;
             }
 
-            message += ']' + (log_format(args) + ...);
-            if (tty)
-                message += "\x1b[0m";
-            message += '\n';
-            std::fwrite(message.data(), 1, message.size(), log_stream());
+            bool tty = log_is_tty();
+            std::string message;
+            log_begin(message, tty, std::chrono::system_clock::now(), file, func, line);
+            ((message += log_format(args)), ...);
+            log_end(message, tty);
+            std::fwrite(message.data(), 1, message.size(), stream);
 
         }
 
@@ -133,8 +150,8 @@ namespace Crow {
     class SetLog {
     public:
         SetLog() noexcept: SetLog(nullptr) {}
-        explicit SetLog(FILE* stream) noexcept: saved_(Detail::log_stream().exchange(stream)) {}
-        ~SetLog() noexcept { Detail::log_stream() = saved_; }
+        explicit SetLog(FILE* stream) noexcept: saved_(Detail::exchange_log_stream(stream)) {}
+        ~SetLog() noexcept { Detail::exchange_log_stream(saved_); }
         SetLog(const SetLog&) = delete;
         SetLog(SetLog&&) = delete;
         SetLog& operator=(const SetLog&) = delete;
@@ -144,9 +161,14 @@ namespace Crow {
     };
 
     inline void set_log(FILE* stream = nullptr) noexcept {
-        Detail::log_stream() = stream;
+        Detail::exchange_log_stream(stream);
     }
 
+    constexpr size_t default_log_buffer = 65'536;
+
+    void set_log_async(bool async = true, LogOverflow overflow = LogOverflow::block, size_t buffer = default_log_buffer);
+    void flush_log() noexcept;
+
     template <typename... Args>
     void logx(const Args&... args) {
         Detail::log_helper(nullptr, nullptr, -1, args...);
@@ -3,11 +3,17 @@
 #include "crow/guard.hpp"
 #include "crow/regex.hpp"
 #include "crow/string.hpp"
+#include "crow/thread-pool.hpp"
 #include "crow/time.hpp"
 #include <algorithm>
 #include <cerrno>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <stdio.h>
 #include <system_error>
@@ -16,6 +22,12 @@
     #include <Availability.h>
 #endif
 
+#ifdef __linux__
+    #include <linux/fs.h>
+    #include <sys/ioctl.h>
+    #include <sys/sendfile.h>
+#endif
+
 #ifdef _XOPEN_SOURCE
 
     #include <dirent.h>
@@ -240,6 +252,246 @@ namespace Crow {
             #endif
         }
 
+        // Status for copy operations, collected with one lstat() (two for
+        // a symlink) instead of a separate call for every query
+
+        struct CopyStatus {
+            bool exists = false;
+            bool is_directory = false;
+            bool is_symlink = false;
+            Path::id_type id = {0, 0};
+        };
+
+        CopyStatus get_copy_status(const Path& file) noexcept {
+
+            CopyStatus status;
+
+            #ifdef _XOPEN_SOURCE
+
+                auto [st,ok] = get_stat(file.os_name(), Path::no_follow);
+                if (ok && S_ISLNK(st.st_mode)) {
+                    status.is_symlink = true;
+                    auto followed = get_stat(file.os_name(), Path::no_flags);
+                    st = followed.st;
+                    ok = followed.ok;
+                }
+                if (ok) {
+                    status.exists = true;
+                    status.is_directory = S_ISDIR(st.st_mode);
+                    status.id = {uint64_t(st.st_dev), uint64_t(st.st_ino)};
+                }
+
+            #else
+
+                status.exists = file.exists();
+                if (status.exists) {
+                    status.is_directory = file.is_directory();
+                    status.is_symlink = file.is_symlink();
+                    status.id = file.id();
+                }
+
+            #endif
+
+            return status;
+
+        }
+
+        // Copy the contents of a regular file, trying the fastest kernel
+        // mechanism first: a reflink clone, then copy_file_range(), then
+        // sendfile(), then a plain read/write loop
+
+        void copy_file_contents(const Path& src, const Path& dst) {
+
+            static constexpr size_t block_size = 1'048'576;
+
+            #ifdef _XOPEN_SOURCE
+
+                int in = open(src.c_name(), O_RDONLY | O_CLOEXEC);
+                int err = errno;
+                if (in == -1)
+                    throw std::system_error(err, std::generic_category(), src.name());
+                auto guard_in = on_scope_exit([=] { close(in); });
+
+                int out = open(dst.c_name(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+                err = errno;
+                if (out == -1)
+                    throw std::system_error(err, std::generic_category(), dst.name());
+                auto guard_out = on_scope_exit([=] { close(out); });
+
+                auto is_fallback_error = [] (int e) {
+                    return e == ENOSYS || e == EXDEV || e == EINVAL || e == EOPNOTSUPP
+                        || e == ENOTSUP || e == EBADF;
+                };
+
+                #ifdef __linux__
+
+                    if (ioctl(out, FICLONE, in) == 0)
+                        return;
+
+                    struct stat st;
+                    if (fstat(in, &st) == 0 && S_ISREG(st.st_mode)) {
+
+                        bool done = false;
+                        off_t copied = 0;
+
+                        for (;;) {
+                            auto n = copy_file_range(in, nullptr, out, nullptr, block_size, 0);
+                            if (n > 0) {
+                                copied += n;
+                                continue;
+                            }
+                            if (n == 0) {
+                                // Some virtual file systems report EOF
+                                // immediately, even for files such as those
+                                // in /proc that report a size of zero but
+                                // are not empty; retry from scratch if so
+                                done = copied > 0;
+                                break;
+                            }
+                            err = errno;
+                            if (err == EINTR)
+                                continue;
+                            if (copied == 0 && is_fallback_error(err))
+                                break;
+                            throw std::system_error(err, std::generic_category(), dst.name());
+                        }
+
+                        if (done)
+                            return;
+
+                        while (! done) {
+                            auto n = sendfile(out, in, nullptr, block_size);
+                            if (n > 0) {
+                                copied += n;
+                            } else if (n == 0) {
+                                done = copied > 0;
+                                break;
+                            } else {
+                                err = errno;
+                                if (err == EINTR)
+                                    continue;
+                                if (copied == 0 && is_fallback_error(err))
+                                    break;
+                                throw std::system_error(err, std::generic_category(), dst.name());
+                            }
+                        }
+
+                        if (done)
+                            return;
+
+                    }
+
+                #else
+
+                    (void)is_fallback_error;
+
+                #endif
+
+                std::unique_ptr<char[]> buf(new char[block_size]);
+
+                for (;;) {
+                    auto n = read(in, buf.get(), block_size);
+                    if (n == 0)
+                        break;
+                    err = errno;
+                    if (n < 0) {
+                        if (err == EINTR)
+                            continue;
+                        throw std::system_error(err, std::generic_category(), src.name());
+                    }
+                    for (ssize_t pos = 0; pos < n;) {
+                        auto m = write(out, buf.get() + pos, size_t(n - pos));
+                        err = errno;
+                        if (m < 0) {
+                            if (err == EINTR)
+                                continue;
+                            throw std::system_error(err, std::generic_category(), dst.name());
+                        }
+                        pos += m;
+                    }
+                }
+
+            #else
+
+                auto in = _wfopen(src.c_name(), L"rb");
+                int err = errno;
+
+                if (! in)
+                    throw std::system_error(err, std::generic_category(), src.name());
+
+                auto guard_in = on_scope_exit([=] { fclose(in); });
+                auto out = _wfopen(dst.c_name(), L"wb");
+                err = errno;
+
+                if (! out)
+                    throw std::system_error(err, std::generic_category(), dst.name());
+
+                auto guard_out = on_scope_exit([=] { fclose(out); });
+                std::string buf(block_size, '\0');
+
+                while (! feof(in)) {
+                    errno = 0;
+                    size_t n = fread(&buf[0], 1, buf.size(), in);
+                    err = errno;
+                    if (err)
+                        throw std::system_error(err, std::generic_category(), src.name());
+                    if (n) {
+                        errno = 0;
+                        fwrite(buf.data(), 1, n, out);
+                        err = errno;
+                        if (err)
+                            throw std::system_error(err, std::generic_category(), dst.name());
+                    }
+                }
+
+            #endif
+
+        }
+
+        // Shared by copy_to() and copy_tree(); regular files are passed to
+        // the supplied function, everything else is handled here
+
+        using CopyFunction = std::function<void(const Path& src, const Path& dst)>;
+
+        void copy_entry(const Path& src, const Path& dst, Path::flag_type flags, const CopyFunction& copy_file) {
+
+            auto src_status = get_copy_status(src);
+            auto dst_status = get_copy_status(dst);
+
+            if (! src_status.exists)
+                throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), src.name());
+
+            if (src == dst || (dst_status.exists && src_status.id == dst_status.id))
+                throw std::system_error(std::make_error_code(std::errc::file_exists), dst.name());
+
+            if (src_status.is_directory && ! has_bit(flags, Path::recurse))
+                throw std::system_error(std::make_error_code(std::errc::is_a_directory), src.name());
+
+            if (dst_status.exists) {
+                if (! has_bit(flags, Path::overwrite))
+                    throw std::system_error(std::make_error_code(std::errc::file_exists), dst.name());
+                dst.remove(Path::recurse);
+            }
+
+            if (src_status.is_symlink) {
+
+                src.resolve_symlink().make_symlink(dst);
+
+            } else if (src_status.is_directory) {
+
+                dst.make_directory();
+
+                for (auto& child: src.directory())
+                    copy_entry(child, dst / child.leaf(), Path::recurse, copy_file);
+
+            } else {
+
+                copy_file(src, dst);
+
+            }
+
+        }
+
     }
 
     // Member types
@@ -851,69 +1103,60 @@ namespace Crow {
     // File system update functions
 
     void Path::copy_to(const Path& dst, flag_type flags) const {
+        copy_entry(*this, dst, flags, copy_file_contents);
+    }
 
-        static constexpr size_t block_size = 16384;
+    void Path::copy_tree(const Path& dst, flag_type flags, int threads) const {
 
-        if (! exists())
-            throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), name());
+        // Directories and symlinks are created on the calling thread during
+        // a single walk; regular files are copied on the pool, with the
+        // number of queued copies bounded so a huge tree can't swamp memory
 
-        if (*this == dst || id() == dst.id())
-            throw std::system_error(std::make_error_code(std::errc::file_exists), dst.name());
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t queued = 0;
+        std::exception_ptr error;
+        ThreadPool pool(threads);
+        size_t max_queued = 4 * size_t(pool.threads());
 
-        if (is_directory() && ! has_bit(flags, recurse))
-            throw std::system_error(std::make_error_code(std::errc::is_a_directory), name());
+        auto copy_file = [&] (const Path& src, const Path& to) {
+            {
+                std::unique_lock lock(mutex);
+                cv.wait(lock, [&] { return queued < max_queued || error; });
+                if (error)
+                    std::rethrow_exception(error);
+                ++queued;
+            }
+            pool.insert([&mutex,&cv,&queued,&error,src,to] {
+                std::exception_ptr ex;
+                try {
+                    copy_file_contents(src, to);
+                }
+                catch (...) {
+                    ex = std::current_exception();
+                }
+                std::unique_lock lock(mutex);
+                if (ex && ! error)
+                    error = ex;
+                --queued;
+                cv.notify_all();
+            });
+        };
 
-        if (dst.exists()) {
-            if (! has_bit(flags, overwrite))
-                throw std::system_error(std::make_error_code(std::errc::file_exists), dst.name());
-            dst.remove(recurse);
+        try {
+            copy_entry(*this, dst, flags | recurse, copy_file);
+        }
+        catch (...) {
+            pool.wait();
+            std::unique_lock lock(mutex);
+            if (! error)
+                throw;
         }
 
-        if (is_symlink()) {
-
-            resolve_symlink().make_symlink(dst);
-
-        } else if (is_directory()) {
-
-            dst.make_directory();
-
-            for (auto& child: directory())
-                child.copy_to(dst / child.leaf(), recurse);
-
-        } else {
-
-            auto in = OS_FUNCTION(fopen)(c_name(), OS_CHAR("rb"));
-            int err = errno;
-
-            if (! in)
-                throw std::system_error(err, std::generic_category(), name());
-
-            auto guard_in = on_scope_exit([=] { fclose(in); });
-            auto out = OS_FUNCTION(fopen)(dst.c_name(), OS_CHAR("wb"));
-            err = errno;
+        pool.wait();
 
-            if (! out)
-                throw std::system_error(err, std::generic_category(), dst.name());
-
-            auto guard_out = on_scope_exit([=] { fclose(out); });
-            std::string buf(block_size, '\0');
-
-            while (! feof(in)) {
-                errno = 0;
-                size_t n = fread(&buf[0], 1, buf.size(), in);
-                err = errno;
-                if (err)
-                    throw std::system_error(err, std::generic_category(), name());
-                if (n) {
-                    errno = 0;
-                    fwrite(buf.data(), 1, n, out);
-                    err = errno;
-                    if (err)
-                        throw std::system_error(err, std::generic_category(), dst.name());
-                }
-            }
-
-        }
+        if (error)
+            std::rethrow_exception(error);
 
     }
 
@@ -1545,11 +1788,12 @@ namespace Crow {
         os_string leaf;
         flag_type flags = no_flags;
 
+        int is_dir = -1; // Cached for the current entry, -1 if not yet known
+
         #ifdef _XOPEN_SOURCE
 
             DIR* dirptr = nullptr;
-            dirent entry;
-            char padding[NAME_MAX + 1];
+            unsigned char type = DT_UNKNOWN;
 
             ~impl_type() { if (dirptr) closedir(dirptr); }
 
@@ -1573,8 +1817,6 @@ namespace Crow {
         #ifdef _XOPEN_SOURCE
 
             impl_ = std::make_shared<impl_type>();
-            memset(&impl_->entry, 0, sizeof(impl_->entry));
-            memset(impl_->padding, 0, sizeof(impl_->padding));
 
             if (dir.is_empty())
                 impl_->dirptr = opendir(".");
@@ -1630,23 +1872,16 @@ namespace Crow {
 
             #ifdef _XOPEN_SOURCE
 
-                dirent* entptr = nullptr;
-
-                #ifdef __GNUC__
-                    #pragma GCC diagnostic push
-                    #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-                #endif
-
-                int rc = readdir_r(impl_->dirptr, &impl_->entry, &entptr);
-
-                #ifdef __GNUC__
-                    #pragma GCC diagnostic pop
-                #endif
+                // readdir() is thread safe as long as the stream is not
+                // shared, and unlike readdir_r() it is not deprecated
 
-                bool ok = rc == 0 && entptr;
+                auto entptr = readdir(impl_->dirptr);
+                bool ok = entptr != nullptr;
 
-                if (ok)
-                    impl_->leaf = impl_->entry.d_name;
+                if (ok) {
+                    impl_->leaf = entptr->d_name;
+                    impl_->type = entptr->d_type;
+                }
 
             #else
 
@@ -1665,6 +1900,7 @@ namespace Crow {
 
             if (impl_->leaf != dot1 && impl_->leaf != dot2
                     && (! has_bit(impl_->flags, unicode) || is_valid_utf(impl_->leaf))) {
+                impl_->is_dir = -1;
                 impl_->current = impl_->prefix / impl_->leaf;
                 if (! skip_hidden || ! impl_->current.is_hidden())
                     break;
@@ -1676,6 +1912,34 @@ namespace Crow {
 
     }
 
+    bool Path::directory_iterator::is_directory_entry(flag_type flags) const noexcept {
+
+        // Use the file type from the directory entry where possible, and
+        // only stat the file if the entry doesn't tell us
+
+        if (impl_->is_dir == -1) {
+
+            #ifdef _XOPEN_SOURCE
+
+                if (impl_->type == DT_DIR)
+                    impl_->is_dir = 1;
+                else if (impl_->type == DT_UNKNOWN || (impl_->type == DT_LNK && ! has_bit(flags, no_follow)))
+                    impl_->is_dir = int(impl_->current.is_directory(flags));
+                else
+                    impl_->is_dir = 0;
+
+            #else
+
+                impl_->is_dir = int(impl_->current.is_directory(flags));
+
+            #endif
+
+        }
+
+        return impl_->is_dir == 1;
+
+    }
+
     // Deep search iterator
 
     struct Path::search_iterator::impl_type {
@@ -1724,7 +1988,7 @@ namespace Crow {
 
         do {
 
-            if ((**this).is_directory(impl_->flagset) && ! impl_->revisit) {
+            if (impl_->stack.back().first.is_directory_entry(impl_->flagset) && ! impl_->revisit) {
 
                 auto range = (**this).directory(impl_->flagset);
                 impl_->revisit = range.empty();
@@ -1743,7 +2007,7 @@ namespace Crow {
             }
 
         } while (! impl_->stack.empty()
-            && (**this).is_directory(impl_->flagset)
+            && impl_->stack.back().first.is_directory_entry(impl_->flagset)
             && impl_->revisit != has_bit(impl_->flagset, bottom_up));
 
         if (impl_->stack.empty())
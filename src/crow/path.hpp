@@ -74,6 +74,8 @@ namespace Crow {
         friend std::ostream& operator<<(std::ostream& out, form f);
         friend std::ostream& operator<<(std::ostream& out, kind k);
 
+        class search_iterator;
+
         class directory_iterator:
         public InputIterator<directory_iterator, const Path> {
         public:
@@ -83,8 +85,10 @@ namespace Crow {
             directory_iterator& operator++();
             bool operator==(const directory_iterator& i) const noexcept { return impl_ == i.impl_; }
         private:
+            friend class search_iterator;
             struct impl_type;
             std::shared_ptr<impl_type> impl_;
+            bool is_directory_entry(flag_type flags) const noexcept;
         };
 
         class search_iterator:
@@ -239,6 +243,7 @@ namespace Crow {
         // File system update functions
 
         void copy_to(const Path& dst, flag_type flags = no_flags) const;
+        void copy_tree(const Path& dst, flag_type flags = no_flags, int threads = 0) const;
         void create() const;
         void make_directory(flag_type flags = no_flags) const;
         void make_symlink(const Path& linkname, flag_type flags = no_flags) const;
@@ -5,7 +5,6 @@
 #include "crow/enum.hpp"
 #include "crow/maths.hpp"
 #include "crow/matrix.hpp"
-#include "crow/root-finding.hpp"
 #include "crow/transform.hpp"
 #include "crow/types.hpp"
 #include "crow/vector.hpp"
@@ -15,9 +14,11 @@
 #include <concepts>
 #include <cstdlib>
 #include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
 #include <numbers>
+#include <span>
 #include <string>
 #include <utility>
 #include <vector>
@@ -186,6 +187,65 @@ namespace Crow {
             }
         };
 
+        // Solve g(t)=c for the auxiliary angle used by the numerical
+        // pseudocylindrical projections. The equation supplies static g(t)
+        // and g'(t), where g is odd and increasing on [-pi/2,pi/2]. Newton's
+        // method is seeded by interpolating in a table of inverse values
+        // built on first use, so it normally converges in one or two steps.
+
+        template <std::floating_point T, typename Equation>
+        class AuxiliaryAngle {
+        public:
+            static T solve(T c) noexcept {
+                static const AuxiliaryAngle instance;
+                return instance.solve_impl(c);
+            }
+        private:
+            static constexpr int table_size = 256;
+            static constexpr int limit = 100;
+            static constexpr T half_pi = SN::pi_v<T> / 2;
+            static constexpr T epsilon = 16 * std::numeric_limits<T>::epsilon();
+            T c_max_;
+            T c_scale_;
+            std::array<T, table_size + 1> table_;
+            AuxiliaryAngle() noexcept {
+                c_max_ = Equation::g(half_pi);
+                c_scale_ = table_size / c_max_;
+                for (int i = 0; i <= table_size; ++i) {
+                    T c = c_max_ * T(i) / T(table_size);
+                    T t1 = 0;
+                    T t2 = half_pi;
+                    for (int j = 0; j < 2 * std::numeric_limits<T>::digits; ++j) {
+                        T t3 = (t1 + t2) / 2;
+                        if (Equation::g(t3) < c)
+                            t1 = t3;
+                        else
+                            t2 = t3;
+                    }
+                    table_[i] = (t1 + t2) / 2;
+                }
+            }
+            T solve_impl(T c) const noexcept {
+                T abs_c = std::abs(c);
+                if (abs_c >= c_max_)
+                    return std::copysign(half_pi, c);
+                T pos = abs_c * c_scale_;
+                int i = std::min(int(pos), table_size - 1);
+                T t = table_[i] + (pos - T(i)) * (table_[i + 1] - table_[i]);
+                T tolerance = epsilon * c_max_;
+                for (int n = 0; n < limit; ++n) {
+                    T y = Equation::g(t) - abs_c;
+                    if (std::abs(y) <= tolerance)
+                        break;
+                    T slope = Equation::dg(t);
+                    if (slope <= 0)
+                        break;
+                    t = std::clamp(t - y / slope, T(0), half_pi);
+                }
+                return std::copysign(t, c);
+            }
+        };
+
     }
 
     // Untyped abstract base class
@@ -222,6 +282,8 @@ namespace Crow {
         virtual T max_y() const noexcept { return 0; }
         vector_type globe_to_map(vector_type polar) const noexcept;
         vector_type map_to_globe(vector_type xy) const noexcept;
+        void globe_to_map(std::span<const vector_type> polar, std::span<vector_type> xy) const noexcept;
+        void map_to_globe(std::span<const vector_type> xy, std::span<vector_type> polar) const noexcept;
         bool is_on_globe(vector_type polar) const noexcept;
         bool is_on_map(vector_type xy) const noexcept;
         vector_type origin() const noexcept { return origin_.reference(); }
@@ -232,6 +294,8 @@ namespace Crow {
         virtual bool canonical_on_map(vector_type xy) const noexcept;
         virtual vector_type canonical_to_globe(vector_type xy) const noexcept = 0;
         virtual vector_type canonical_to_map(vector_type polar) const noexcept = 0;
+        virtual void canonical_to_globe_batch(std::span<vector_type> points) const noexcept;
+        virtual void canonical_to_map_batch(std::span<vector_type> points) const noexcept;
         T angle_from_origin(vector_type polar) const noexcept;
         void set_origin(vector_type origin) noexcept { origin_ = polar_reduce(origin); }
     private:
@@ -251,6 +315,24 @@ namespace Crow {
         return origin_.inverse_from_polar(rel_polar);
     }
 
+    template <std::floating_point T>
+    void BasicMapProjection<T>::globe_to_map(std::span<const Vector<T, 2>> polar, std::span<Vector<T, 2>> xy) const noexcept {
+        auto n = std::min(polar.size(), xy.size());
+        for (size_t i = 0; i < n; ++i)
+            xy[i] = origin_.reduce_to_polar(polar[i]);
+        canonical_to_map_batch(xy.first(n));
+    }
+
+    template <std::floating_point T>
+    void BasicMapProjection<T>::map_to_globe(std::span<const Vector<T, 2>> xy, std::span<Vector<T, 2>> polar) const noexcept {
+        auto n = std::min(xy.size(), polar.size());
+        if (polar.data() != xy.data())
+            std::copy_n(xy.begin(), n, polar.begin());
+        canonical_to_globe_batch(polar.first(n));
+        for (size_t i = 0; i < n; ++i)
+            polar[i] = origin_.inverse_from_polar(polar[i]);
+    }
+
     template <std::floating_point T>
     bool BasicMapProjection<T>::is_on_globe(Vector<T, 2> polar) const noexcept {
         auto rel_polar = origin_.reduce_to_polar(polar);
@@ -262,6 +344,18 @@ namespace Crow {
         return canonical_on_map(xy);
     }
 
+    template <std::floating_point T>
+    void BasicMapProjection<T>::canonical_to_globe_batch(std::span<Vector<T, 2>> points) const noexcept {
+        for (auto& p: points)
+            p = canonical_to_globe(p);
+    }
+
+    template <std::floating_point T>
+    void BasicMapProjection<T>::canonical_to_map_batch(std::span<Vector<T, 2>> points) const noexcept {
+        for (auto& p: points)
+            p = canonical_to_map(p);
+    }
+
     template <std::floating_point T>
     bool BasicMapProjection<T>::canonical_on_globe(Vector<T, 2> polar) const noexcept{
         using std::numbers::pi_v;
@@ -317,11 +411,37 @@ namespace Crow {
             friend class InterruptedProjection;
     };
 
+    namespace Detail {
+
+        // Supplies clone() and the batch conversions for a concrete
+        // projection class. The batch loops call the projection's own
+        // conversions directly, avoiding a virtual call per point; the
+        // projection must befriend this class, since those are protected.
+
+        template <typename Projection, typename Base>
+        class ConcreteProjection:
+        public BasicClone<Projection, Base, BasicMapProjection<typename Base::value_type>> {
+        protected:
+            using vector_type = typename Base::vector_type;
+            virtual void canonical_to_globe_batch(std::span<vector_type> points) const noexcept override {
+                auto& proj = static_cast<const Projection&>(*this);
+                for (auto& p: points)
+                    p = proj.Projection::canonical_to_globe(p);
+            }
+            virtual void canonical_to_map_batch(std::span<vector_type> points) const noexcept override {
+                auto& proj = static_cast<const Projection&>(*this);
+                for (auto& p: points)
+                    p = proj.Projection::canonical_to_map(p);
+            }
+        };
+
+    }
+
     // Azimuthal projection classes
 
     template <std::floating_point T>
     class AzimuthalEquidistantProjection:
-    public BasicClone<AzimuthalEquidistantProjection<T>, AzimuthalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<AzimuthalEquidistantProjection<T>, AzimuthalProjection<T>> {
     public:
         static constexpr Maps map_properties = Maps::azimuthal | Maps::sphere | Maps::circle | Maps::hemisphere_circle;
         AzimuthalEquidistantProjection() = default;
@@ -331,6 +451,7 @@ namespace Crow {
         virtual std::string name() const override { return "azimuthal equidistant projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<AzimuthalEquidistantProjection<T>, AzimuthalProjection<T>>;
         virtual bool canonical_on_globe(Vector<T, 2> /*polar*/) const noexcept override { return true; }
         virtual bool canonical_on_map(Vector<T, 2> xy) const noexcept override;
         virtual Vector<T, 2> canonical_to_globe(Vector<T, 2> xy) const noexcept override;
@@ -379,7 +500,7 @@ namespace Crow {
 
     template <std::floating_point T>
     class GnomonicProjection:
-    public BasicClone<GnomonicProjection<T>, AzimuthalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<GnomonicProjection<T>, AzimuthalProjection<T>> {
     public:
         static constexpr Maps map_properties = Maps::azimuthal | Maps::sub_hemisphere | Maps::plane;
         GnomonicProjection() = default;
@@ -387,6 +508,7 @@ namespace Crow {
         virtual std::string name() const override { return "gnomonic projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<GnomonicProjection<T>, AzimuthalProjection<T>>;
         virtual bool canonical_on_globe(Vector<T, 2> polar) const noexcept override;
         virtual bool canonical_on_map(Vector<T, 2> /*xy*/) const noexcept override { return true; }
         virtual Vector<T, 2> canonical_to_globe(Vector<T, 2> xy) const noexcept override;
@@ -432,7 +554,7 @@ namespace Crow {
 
     template <std::floating_point T>
     class LambertAzimuthalProjection:
-    public BasicClone<LambertAzimuthalProjection<T>, AzimuthalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<LambertAzimuthalProjection<T>, AzimuthalProjection<T>> {
     public:
         static constexpr Maps map_properties = Maps::azimuthal | Maps::sphere | Maps::circle | Maps::equal_area | Maps::hemisphere_circle;
         LambertAzimuthalProjection() = default;
@@ -442,6 +564,7 @@ namespace Crow {
         virtual std::string name() const override { return "Lambert azimuthal projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<LambertAzimuthalProjection<T>, AzimuthalProjection<T>>;
         virtual bool canonical_on_globe(Vector<T, 2> /*polar*/) const noexcept override { return true; }
         virtual bool canonical_on_map(Vector<T, 2> xy) const noexcept override { return xy.x() * xy.x() + xy.y() * xy.y() <= T(4); }
         virtual Vector<T, 2> canonical_to_globe(Vector<T, 2> xy) const noexcept override;
@@ -484,7 +607,7 @@ namespace Crow {
 
     template <std::floating_point T>
     class OrthographicProjection:
-    public BasicClone<OrthographicProjection<T>, AzimuthalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<OrthographicProjection<T>, AzimuthalProjection<T>> {
     public:
         static constexpr Maps map_properties = Maps::azimuthal | Maps::hemisphere | Maps::circle | Maps::hemisphere_circle;
         OrthographicProjection() = default;
@@ -494,6 +617,7 @@ namespace Crow {
         virtual std::string name() const override { return "orthographic projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<OrthographicProjection<T>, AzimuthalProjection<T>>;
         virtual bool canonical_on_globe(Vector<T, 2> polar) const noexcept override;
         virtual bool canonical_on_map(Vector<T, 2> xy) const noexcept override { return xy.x() * xy.x() + xy.y() * xy.y() <= 1; }
         virtual Vector<T, 2> canonical_to_globe(Vector<T, 2> xy) const noexcept override;
@@ -532,7 +656,7 @@ namespace Crow {
 
     template <std::floating_point T>
     class StereographicProjection:
-    public BasicClone<StereographicProjection<T>, AzimuthalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<StereographicProjection<T>, AzimuthalProjection<T>> {
     public:
         static constexpr Maps map_properties = Maps::azimuthal | Maps::sub_sphere | Maps::plane | Maps::conformal | Maps::hemisphere_circle;
         StereographicProjection() = default;
@@ -540,6 +664,7 @@ namespace Crow {
         virtual std::string name() const override { return "stereographic projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<StereographicProjection<T>, AzimuthalProjection<T>>;
         virtual bool canonical_on_globe(Vector<T, 2> polar) const noexcept override;
         virtual bool canonical_on_map(Vector<T, 2> /*xy*/) const noexcept override { return true; }
         virtual Vector<T, 2> canonical_to_globe(Vector<T, 2> xy) const noexcept override;
@@ -587,7 +712,7 @@ namespace Crow {
 
     template <std::floating_point T>
     class CylindricalEquidistantProjection:
-    public BasicClone<CylindricalEquidistantProjection<T>, CylindricalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<CylindricalEquidistantProjection<T>, CylindricalProjection<T>> {
     public:
         static constexpr Maps map_properties = Maps::cylindrical | Maps::sphere | Maps::rectangle;
         CylindricalEquidistantProjection() = default;
@@ -597,6 +722,7 @@ namespace Crow {
         virtual std::string name() const override { return "cylindrical equidistant projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<CylindricalEquidistantProjection<T>, CylindricalProjection<T>>;
         virtual bool canonical_on_globe(Vector<T, 2> /*polar*/) const noexcept override { return true; }
         virtual bool canonical_on_map(Vector<T, 2> xy) const noexcept override { return abs(xy.x()) <= max_x() && abs(xy.y()) <= max_y(); }
         virtual Vector<T, 2> canonical_to_globe(Vector<T, 2> xy) const noexcept override;
@@ -625,7 +751,7 @@ namespace Crow {
 
     template <std::floating_point T>
     class LambertCylindricalProjection:
-    public BasicClone<LambertCylindricalProjection<T>, CylindricalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<LambertCylindricalProjection<T>, CylindricalProjection<T>> {
     public:
         static constexpr Maps map_properties = Maps::cylindrical | Maps::sphere | Maps::rectangle | Maps::equal_area;
         LambertCylindricalProjection() = default;
@@ -635,6 +761,7 @@ namespace Crow {
         virtual std::string name() const override { return "Lambert cylindrical projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<LambertCylindricalProjection<T>, CylindricalProjection<T>>;
         friend class GallPetersProjection<T>;
         virtual bool canonical_on_globe(Vector<T, 2> /*polar*/) const noexcept override { return true; }
         virtual bool canonical_on_map(Vector<T, 2> xy) const noexcept override { return abs(xy.x()) <= max_x() && abs(xy.y()) <= max_y(); }
@@ -664,7 +791,7 @@ namespace Crow {
 
     template <std::floating_point T>
     class GallPetersProjection:
-    public BasicClone<GallPetersProjection<T>, CylindricalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<GallPetersProjection<T>, CylindricalProjection<T>> {
     public:
         static constexpr Maps map_properties = LambertCylindricalProjection<T>::map_properties;
         GallPetersProjection() = default;
@@ -674,6 +801,7 @@ namespace Crow {
         virtual std::string name() const override { return "Gall-Peters projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<GallPetersProjection<T>, CylindricalProjection<T>>;
         virtual bool canonical_on_globe(Vector<T, 2> /*polar*/) const noexcept override { return true; }
         virtual bool canonical_on_map(Vector<T, 2> xy) const noexcept override { return abs(xy.x()) <= max_x() && abs(xy.y()) <= max_y(); }
         virtual Vector<T, 2> canonical_to_globe(Vector<T, 2> xy) const noexcept override;
@@ -696,7 +824,7 @@ namespace Crow {
 
     template <std::floating_point T>
     class MercatorProjection:
-    public BasicClone<MercatorProjection<T>, CylindricalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<MercatorProjection<T>, CylindricalProjection<T>> {
     public:
         static constexpr Maps map_properties = Maps::cylindrical | Maps::sub_sphere | Maps::other_shape | Maps::conformal;
         MercatorProjection() = default;
@@ -707,6 +835,7 @@ namespace Crow {
         virtual std::string name() const override { return "Mercator projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<MercatorProjection<T>, CylindricalProjection<T>>;
         virtual bool canonical_on_globe(Vector<T, 2> polar) const noexcept override;
         virtual bool canonical_on_map(Vector<T, 2> xy) const noexcept override { return abs(xy.x()) <= max_x(); }
         virtual Vector<T, 2> canonical_to_globe(Vector<T, 2> xy) const noexcept override;
@@ -743,7 +872,7 @@ namespace Crow {
 
     template <std::floating_point T>
     class Eckert4Projection:
-    public BasicClone<Eckert4Projection<T>, PseudocylindricalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<Eckert4Projection<T>, PseudocylindricalProjection<T>> {
     public:
         static constexpr Maps map_properties = Maps::pseudocylindrical | Maps::sphere | Maps::other_shape | Maps::equal_area | Maps::numerical;
         Eckert4Projection() = default;
@@ -753,10 +882,16 @@ namespace Crow {
         virtual std::string name() const override { return "Eckert IV projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<Eckert4Projection<T>, PseudocylindricalProjection<T>>;
         virtual bool canonical_on_globe(Vector<T, 2> /*polar*/) const noexcept override { return true; }
         virtual bool canonical_on_map(Vector<T, 2> xy) const noexcept override;
         virtual Vector<T, 2> canonical_to_globe(Vector<T, 2> xy) const noexcept override;
         virtual Vector<T, 2> canonical_to_map(Vector<T, 2> polar) const noexcept override;
+    private:
+        struct equation {
+            static T g(T t) noexcept { return t + std::sin(t) * (2 + std::cos(t)); }
+            static T dg(T t) noexcept { auto cos_t = std::cos(t); return 2 * cos_t * (1 + cos_t); }
+        };
     };
 
     template <std::floating_point T>
@@ -791,10 +926,7 @@ namespace Crow {
         T ph = polar[0];
         T theta = std::clamp(polar[1], T(0), pi_v<T>);
         T c = (2 + pi_v<T> / 2) * std::cos(theta);
-        T t = newton_raphson<T>(
-            [c] (T x) { return x + std::sin(x) * (2 + std::cos(x)) - c; },
-            [] (T x) { return 2 * std::cos(x) * (1 + std::cos(x));
-        })->solve();
+        T t = Detail::AuxiliaryAngle<T, equation>::solve(c);
         T x = symmetric_remainder(ph, 2 * pi_v<T>) * (1 + std::cos(t)) / 2;
         T y = pi_v<T> * std::sin(t) / 2;
         return {x, y};
@@ -802,7 +934,7 @@ namespace Crow {
 
     template <std::floating_point T>
     class MollweideProjection:
-    public BasicClone<MollweideProjection<T>, PseudocylindricalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<MollweideProjection<T>, PseudocylindricalProjection<T>> {
     public:
         static constexpr Maps map_properties = Maps::pseudocylindrical | Maps::sphere | Maps::ellipse | Maps::equal_area
             | Maps::hemisphere_circle | Maps::numerical;
@@ -813,10 +945,16 @@ namespace Crow {
         virtual std::string name() const override { return "Mollweide projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<MollweideProjection<T>, PseudocylindricalProjection<T>>;
         virtual bool canonical_on_globe(Vector<T, 2> /*polar*/) const noexcept override { return true; }
         virtual bool canonical_on_map(Vector<T, 2> xy) const noexcept override;
         virtual Vector<T, 2> canonical_to_globe(Vector<T, 2> xy) const noexcept override;
         virtual Vector<T, 2> canonical_to_map(Vector<T, 2> polar) const noexcept override;
+    private:
+        struct equation {
+            static T g(T t) noexcept { return 2 * t + std::sin(2 * t); }
+            static T dg(T t) noexcept { return 2 + 2 * std::cos(2 * t); }
+        };
     };
 
     template <std::floating_point T>
@@ -846,11 +984,8 @@ namespace Crow {
         using std::numbers::pi_v;
         T ph = polar[0];
         T theta = std::clamp(polar[1], T(0), pi_v<T>);
-        T cos_theta = std::cos(theta);
-        T t = newton_raphson<T>(
-            [cos_theta] (T x) { return 2 * x + std::sin(2 * x) - pi_v<T> * cos_theta; },
-            [] (T x) { return 2 + 2 * std::cos(2 * x);
-        })->solve();
+        T c = pi_v<T> * std::cos(theta);
+        T t = Detail::AuxiliaryAngle<T, equation>::solve(c);
         T x = symmetric_remainder(ph, 2 * pi_v<T>) * std::cos(t);
         T y = pi_v<T> * std::sin(t) / 2;
         return {x, y};
@@ -858,7 +993,7 @@ namespace Crow {
 
     template <std::floating_point T>
     class SinusoidalProjection:
-    public BasicClone<SinusoidalProjection<T>, PseudocylindricalProjection<T>, BasicMapProjection<T>> {
+    public Detail::ConcreteProjection<SinusoidalProjection<T>, PseudocylindricalProjection<T>> {
     public:
         static constexpr Maps map_properties = Maps::pseudocylindrical | Maps::sphere | Maps::other_shape | Maps::equal_area;
         SinusoidalProjection() = default;
@@ -868,6 +1003,7 @@ namespace Crow {
         virtual std::string name() const override { return "sinusoidal projection"; }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<SinusoidalProjection<T>, PseudocylindricalProjection<T>>;
         virtual bool canonical_on_globe(Vector<T, 2> /*polar*/) const noexcept override { return true; }
         virtual bool canonical_on_map(Vector<T, 2> xy) const noexcept override;
         virtual Vector<T, 2> canonical_to_globe(Vector<T, 2> xy) const noexcept override;
@@ -961,8 +1097,7 @@ namespace Crow {
     template <typename Projection>
     requires (std::derived_from<Projection, PseudocylindricalProjection<typename Projection::value_type>>)
     class InterruptedProjection:
-    public BasicClone<InterruptedProjection<Projection>, BasicInterruptedProjection<typename Projection::value_type>,
-        BasicMapProjection<typename Projection::value_type>> {
+    public Detail::ConcreteProjection<InterruptedProjection<Projection>, BasicInterruptedProjection<typename Projection::value_type>> {
     private:
         using T = typename Projection::value_type;
         using base_type = BasicInterruptedProjection<T>;
@@ -980,6 +1115,7 @@ namespace Crow {
         virtual std::string name() const override { return "interrupted " + proj_.name(); }
         virtual Maps properties() const noexcept override { return map_properties; }
     protected:
+        friend class Detail::ConcreteProjection<InterruptedProjection, base_type>;
         virtual bool canonical_on_globe(vector_type /*polar*/) const noexcept override { return true; }
         virtual bool canonical_on_map(vector_type xy) const noexcept override;
         virtual vector_type canonical_to_globe(vector_type xy) const noexcept override;
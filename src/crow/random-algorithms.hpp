@@ -6,14 +6,157 @@
 #include "crow/random-continuous-distributions.hpp"
 #include "crow/random-discrete-distributions.hpp"
 #include "crow/random-engines.hpp"
+#include "crow/thread-pool.hpp"
 #include "crow/types.hpp"
 #include <algorithm>
 #include <cmath>
 #include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace Crow {
 
+    // Streaming reservoir samplers
+
+    template <typename T>
+    class ReservoirSample {
+
+    public:
+
+        ReservoirSample() = default;
+        explicit ReservoirSample(size_t k): k_(k) { values_.reserve(k); }
+
+        template <RandomEngineType RNG> void add(const T& t, RNG& rng);
+        size_t count() const noexcept { return count_; }
+        size_t size() const noexcept { return values_.size(); }
+        const std::vector<T>& values() const noexcept { return values_; }
+        std::vector<T> take() noexcept { return std::move(values_); }
+
+    private:
+
+        size_t k_ = 0;
+        size_t count_ = 0;
+        size_t skip_ = 0;
+        double w_ = 0;
+        std::vector<T> values_;
+
+        template <RandomEngineType RNG> void next_skip(RNG& rng);
+
+    };
+
+        // Algorithm L
+        // Kim-Hung Li (1994), "Reservoir-Sampling Algorithms of Time Complexity O(n(1+log(N/n)))"
+
+        template <typename T>
+        template <RandomEngineType RNG>
+        void ReservoirSample<T>::add(const T& t, RNG& rng) {
+            ++count_;
+            if (values_.size() < k_) {
+                values_.push_back(t);
+                if (values_.size() == k_) {
+                    UniformReal<double> unit;
+                    w_ = std::exp(std::log(unit(rng)) / double(k_));
+                    next_skip(rng);
+                }
+            } else if (k_ == 0) {
+                return;
+            } else if (skip_ > 0) {
+                --skip_;
+            } else {
+                UniformReal<double> unit;
+                UniformInteger<size_t> index_k(k_);
+                values_[index_k(rng)] = t;
+                w_ *= std::exp(std::log(unit(rng)) / double(k_));
+                next_skip(rng);
+            }
+        }
+
+        template <typename T>
+        template <RandomEngineType RNG>
+        void ReservoirSample<T>::next_skip(RNG& rng) {
+            UniformReal<double> unit;
+            auto skip = std::floor(std::log(unit(rng)) / std::log(1 - w_));
+            if (skip >= double(std::numeric_limits<size_t>::max()))
+                skip_ = std::numeric_limits<size_t>::max();
+            else
+                skip_ = size_t(skip);
+        }
+
+    template <typename T>
+    class WeightedReservoirSample {
+
+    public:
+
+        WeightedReservoirSample() = default;
+        explicit WeightedReservoirSample(size_t k): k_(k) { heap_.reserve(k); }
+
+        template <RandomEngineType RNG> void add(const T& t, double weight, RNG& rng);
+        void merge(const WeightedReservoirSample& other);
+        size_t count() const noexcept { return count_; }
+        size_t size() const noexcept { return heap_.size(); }
+        std::vector<T> values() const;
+
+    private:
+
+        using entry = std::pair<double, T>;
+
+        size_t k_ = 0;
+        size_t count_ = 0;
+        std::vector<entry> heap_; // Min-heap on key
+
+        void insert(double key, const T& t);
+
+        static bool compare(const entry& a, const entry& b) noexcept { return a.first > b.first; }
+
+    };
+
+        // Algorithm A-ES
+        // Pavlos S. Efraimidis and Paul G. Spirakis (2006), "Weighted random sampling with a reservoir"
+        // Keys are stored as log(u)/w instead of u^(1/w) to avoid underflow with small weights
+
+        template <typename T>
+        template <RandomEngineType RNG>
+        void WeightedReservoirSample<T>::add(const T& t, double weight, RNG& rng) {
+            ++count_;
+            if (k_ == 0 || weight <= 0)
+                return;
+            UniformReal<double> unit;
+            insert(std::log(unit(rng)) / weight, t);
+        }
+
+        template <typename T>
+        void WeightedReservoirSample<T>::merge(const WeightedReservoirSample& other) {
+            count_ += other.count_;
+            for (auto& [key,t]: other.heap_)
+                insert(key, t);
+        }
+
+        template <typename T>
+        std::vector<T> WeightedReservoirSample<T>::values() const {
+            std::vector<T> out;
+            out.reserve(heap_.size());
+            for (auto& e: heap_)
+                out.push_back(e.second);
+            return out;
+        }
+
+        template <typename T>
+        void WeightedReservoirSample<T>::insert(double key, const T& t) {
+            if (heap_.size() < k_) {
+                heap_.emplace_back(key, t);
+                std::push_heap(heap_.begin(), heap_.end(), compare);
+            } else if (key > heap_.front().first) {
+                std::pop_heap(heap_.begin(), heap_.end(), compare);
+                heap_.back() = {key, t};
+                std::push_heap(heap_.begin(), heap_.end(), compare);
+            }
+        }
+
+    // Sampling functions
+
     template <RangeType R, RandomEngineType RNG>
     std::vector<RangeValue<R>> sample(const R& range, RNG& rng, size_t k) {
 
@@ -22,42 +165,63 @@ namespace Crow {
         using std::begin;
         using std::end;
 
-        auto rb = begin(range);
-        auto re = end(range);
-        auto n = size_t(re - rb);
+        if constexpr (! RandomAccessRangeType<R>) {
 
-        if (k >= n)
-            return std::vector(rb, re);
+            ReservoirSample<V> reservoir(k);
 
-        std::vector<V> out(k);
-        size_t i = 0;
-        auto r = rb;
-        auto o = out.begin();
+            for (auto& x: range)
+                reservoir.add(x, rng);
 
-        for (; i < k; ++i, ++o, ++r)
-            *o = *r;
+            return reservoir.take();
 
-        UniformReal<double> unit;
-        UniformInteger<size_t> index_k(k);
-        double w = std::exp(std::log(unit(rng)) / k);
+        } else {
 
-        for (;;) {
+            auto rb = begin(range);
+            auto re = end(range);
+            auto n = size_t(re - rb);
 
-            auto delta = size_t(std::floor(std::log(unit(rng)) / std::log(1 - w))) + 1;
-            i += delta;
+            if (k >= n)
+                return std::vector(rb, re);
 
-            if (i >= n)
-                break;
+            std::vector<V> out(k);
+            size_t i = 0;
+            auto r = rb;
+            auto o = out.begin();
 
-            std::advance(r, delta);
-            auto j = index_k(rng);
-            out[j] = *r;
-            w *= std::exp(std::log(unit(rng)) / k);
+            for (; i < k; ++i, ++o, ++r)
+                *o = *r;
+
+            UniformReal<double> unit;
+            UniformInteger<size_t> index_k(k);
+            double w = std::exp(std::log(unit(rng)) / k);
+
+            for (;;) {
+
+                auto delta = size_t(std::floor(std::log(unit(rng)) / std::log(1 - w))) + 1;
+                i += delta;
+
+                if (i >= n)
+                    break;
+
+                std::advance(r, delta);
+                auto j = index_k(rng);
+                out[j] = *r;
+                w *= std::exp(std::log(unit(rng)) / k);
+
+            }
+
+            return out;
 
         }
 
-        return out;
+    }
 
+    template <RangeType R, typename F, RandomEngineType RNG>
+    std::vector<RangeValue<R>> weighted_sample(const R& range, F weight, RNG& rng, size_t k) {
+        WeightedReservoirSample<RangeValue<R>> reservoir(k);
+        for (auto& x: range)
+            reservoir.add(x, double(weight(x)), rng);
+        return reservoir.values();
     }
 
     template <MutableRandomAccessRangeType R, RandomEngineType RNG>
@@ -79,4 +243,167 @@ namespace Crow {
 
     }
 
+    // Parallel algorithms
+
+    namespace Detail {
+
+        constexpr size_t parallel_block_size = 65'536;
+
+        constexpr size_t parallel_blocks(size_t n) noexcept {
+            return (n + parallel_block_size - 1) / parallel_block_size;
+        }
+
+        // One stream per block, then one per merge at each level
+
+        constexpr size_t parallel_shuffle_streams(size_t n) noexcept {
+            size_t streams = parallel_blocks(n);
+            for (size_t width = parallel_block_size; width < n; width *= 2)
+                streams += (n + 2 * width - 1) / (2 * width);
+            return streams;
+        }
+
+        // Checked before any work is dispatched: stream() would throw inside
+        // a pool task, where the exception cannot be caught
+
+        template <typename RNG>
+        void check_parallel_streams(size_t streams, const char* function) {
+            if (streams > ParallelRng<RNG>::max_streams)
+                throw std::out_of_range("Input too large for " + std::string(function) + "(): needs "
+                    + std::to_string(streams) + " RNG streams, limit is " + std::to_string(ParallelRng<RNG>::max_streams));
+        }
+
+    }
+
+    template <RandomAccessRangeType R, typename RNG>
+    std::vector<RangeValue<R>> parallel_sample(const R& range, const ParallelRng<RNG>& prng, size_t k, ThreadPool& pool) {
+
+        using V = RangeValue<R>;
+
+        using std::begin;
+        using std::end;
+
+        auto rb = begin(range);
+        auto n = size_t(end(range) - rb);
+        auto blocks = Detail::parallel_blocks(n);
+        Detail::check_parallel_streams<RNG>(blocks, "parallel_sample");
+        std::vector<WeightedReservoirSample<V>> partials(blocks);
+
+        pool.each(int(blocks), [&] (int i) {
+            auto rng = prng(size_t(i));
+            auto j = size_t(i) * Detail::parallel_block_size;
+            auto j_end = std::min(j + Detail::parallel_block_size, n);
+            WeightedReservoirSample<V> reservoir(k);
+            for (; j < j_end; ++j)
+                reservoir.add(rb[j], 1, rng);
+            partials[size_t(i)] = std::move(reservoir);
+        });
+
+        pool.wait();
+        WeightedReservoirSample<V> result(k);
+
+        for (auto& partial: partials)
+            result.merge(partial);
+
+        return result.values();
+
+    }
+
+    // MergeShuffle
+    // Axel Bacher, Olivier Bodini, Alexandros Hollender, and Jérémie Lumbroso (2015),
+    // "MergeShuffle: A Very Fast, Parallel Random Permutation Algorithm"
+
+    template <MutableRandomAccessRangeType R, typename RNG>
+    void parallel_shuffle(R& range, const ParallelRng<RNG>& prng, ThreadPool& pool) {
+
+        using std::begin;
+        using std::end;
+
+        auto rb = begin(range);
+        auto n = size_t(end(range) - rb);
+        auto blocks = Detail::parallel_blocks(n);
+        Detail::check_parallel_streams<RNG>(Detail::parallel_shuffle_streams(n), "parallel_shuffle");
+
+        if (n < 2) {
+            return;
+        } else if (blocks == 1) {
+            auto rng = prng(0);
+            shuffle(range, rng);
+            return;
+        }
+
+        // Each block is shuffled independently, then adjacent runs are
+        // merged pairwise; every block and every merge draws from its own
+        // stream so the result does not depend on the thread count.
+
+        pool.each(int(blocks), [&] (int i) {
+            auto rng = prng(size_t(i));
+            auto first = size_t(i) * Detail::parallel_block_size;
+            auto last = std::min(first + Detail::parallel_block_size, n);
+            for (auto j = first; j + 1 < last; ++j) {
+                UniformInteger<size_t> dist(j, last - 1);
+                auto k = dist(rng);
+                if (j != k)
+                    std::swap(rb[j], rb[k]);
+            }
+        });
+
+        pool.wait();
+        size_t stream = blocks;
+
+        for (size_t width = Detail::parallel_block_size; width < n; width *= 2) {
+
+            auto merges = (n + 2 * width - 1) / (2 * width);
+
+            pool.each(int(merges), [&] (int i) {
+
+                auto first = size_t(i) * 2 * width;
+                auto mid = first + width;
+                auto last = std::min(mid + width, n);
+
+                if (mid >= last)
+                    return;
+
+                auto rng = prng(stream + size_t(i));
+                auto u = first;
+                auto v = mid;
+                uint64_t bits = 0;
+                int bit_count = 0;
+
+                for (;;) {
+                    // Use the high bits, the low bits of an LCG are weak
+                    if (bit_count == 0) {
+                        bit_count = std::min(64, 8 * int(sizeof(typename RNG::result_type)));
+                        bits = uint64_t(rng()) << (64 - bit_count);
+                    }
+                    auto flip = bits >> 63;
+                    bits <<= 1;
+                    --bit_count;
+                    if (flip == 0) {
+                        if (u == v)
+                            break;
+                    } else {
+                        if (v == last)
+                            break;
+                        std::swap(rb[u], rb[v]);
+                        ++v;
+                    }
+                    ++u;
+                }
+
+                for (; u < last; ++u) {
+                    UniformInteger<size_t> dist(first, u);
+                    auto k = dist(rng);
+                    if (k != u)
+                        std::swap(rb[u], rb[k]);
+                }
+
+            });
+
+            pool.wait();
+            stream += merges;
+
+        }
+
+    }
+
 }
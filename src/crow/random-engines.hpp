@@ -12,8 +12,12 @@
 #include <compare>
 #include <concepts>
 #include <functional>
+#include <mutex>
 #include <random>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 namespace Crow {
 
@@ -46,22 +50,49 @@ namespace Crow {
     // Pierre L'Ecuyer (1999), "Tables of Linear Congruential Generators of Different Sizes and Good Lattice Structure"
     // http://www.ams.org/journals/mcom/1999-68-225/S0025-5718-99-00996-5/S0025-5718-99-00996-5.pdf
 
+    namespace Detail {
+
+        constexpr uint32_t lcg32_multiplier = 32'310'901ul;
+        constexpr uint32_t lcg32_increment = 850'757'001ul;
+        constexpr uint64_t lcg64_multiplier = 3'935'559'000'370'003'845ull;
+        constexpr uint64_t lcg64_increment = 8'831'144'850'135'198'739ull;
+        constexpr Uint128 lcg128_multiplier = {0x2360'ed05'1fc6'5da4ull, 0x4385'df64'9fcc'f645ull};
+        constexpr Uint128 lcg128_increment = {0x55bf'e625'0318'f820ull, 0xe2d4'afe5'108d'a1e3ull};
+
+        // Jump ahead by any number of steps in O(log n) time
+        // Forrest B. Brown (1994), "Random Number Generation with Arbitrary Strides"
+
+        template <typename T>
+        constexpr T lcg_advance(T x, T m, T c, T delta) noexcept {
+            T mul = 1;
+            T add = 0;
+            while (delta != T(0)) {
+                if ((delta & T(1)) != T(0)) {
+                    mul *= m;
+                    add *= m;
+                    add += c;
+                }
+                auto m1 = m;
+                ++m1;
+                c *= m1;
+                m *= m;
+                delta >>= 1;
+            }
+            return mul * x + add;
+        }
+
+    }
+
     constexpr uint32_t lcg32(uint32_t x) noexcept {
-        constexpr uint32_t m = 32'310'901ul;
-        constexpr uint32_t c = 850'757'001ul;
-        return uint32_t(m * x + c);
+        return uint32_t(Detail::lcg32_multiplier * x + Detail::lcg32_increment);
     }
 
     constexpr uint64_t lcg64(uint64_t x) noexcept {
-        constexpr uint64_t m = 3'935'559'000'370'003'845ull;
-        constexpr uint64_t c = 8'831'144'850'135'198'739ull;
-        return uint64_t(m * x + c);
+        return uint64_t(Detail::lcg64_multiplier * x + Detail::lcg64_increment);
     }
 
     constexpr Uint128 lcg128(Uint128 x) noexcept {
-        constexpr Uint128 m = {0x2360'ed05'1fc6'5da4ull, 0x4385'df64'9fcc'f645ull};
-        constexpr Uint128 c = {0x55bf'e625'0318'f820ull, 0xe2d4'afe5'108d'a1e3ull};
-        return m * x + c;
+        return Detail::lcg128_multiplier * x + Detail::lcg128_increment;
     }
 
     class Lcg32 {
@@ -70,6 +101,8 @@ namespace Crow {
         constexpr Lcg32() noexcept {}
         explicit constexpr Lcg32(uint32_t s) noexcept: state_(s) {}
         constexpr uint32_t operator()() noexcept { state_ = lcg32(state_); return state_; }
+        constexpr void advance(int64_t offset) noexcept
+            { state_ = Detail::lcg_advance(state_, Detail::lcg32_multiplier, Detail::lcg32_increment, uint32_t(offset)); }
         constexpr bool operator==(const Lcg32& rhs) const noexcept { return state_ == rhs.state_; }
         constexpr bool operator!=(const Lcg32& rhs) const noexcept { return state_ != rhs.state_; }
         constexpr void seed(uint32_t s) noexcept { state_ = s; }
@@ -85,6 +118,8 @@ namespace Crow {
         constexpr Lcg64() noexcept {}
         explicit constexpr Lcg64(uint64_t s) noexcept: state_(s) {}
         uint64_t constexpr operator()() noexcept { state_ = lcg64(state_); return state_; }
+        void constexpr advance(int64_t offset) noexcept
+            { state_ = Detail::lcg_advance(state_, Detail::lcg64_multiplier, Detail::lcg64_increment, uint64_t(offset)); }
         bool constexpr operator==(const Lcg64& rhs) const noexcept { return state_ == rhs.state_; }
         bool constexpr operator!=(const Lcg64& rhs) const noexcept { return state_ != rhs.state_; }
         void constexpr seed(uint64_t s) noexcept { state_ = s; }
@@ -101,6 +136,12 @@ namespace Crow {
         explicit constexpr Lcg128(Uint128 s) noexcept: state_(s) {}
         explicit constexpr Lcg128(uint64_t s, uint64_t t) noexcept: state_{s, t} {}
         Uint128 constexpr operator()() noexcept { state_ = lcg128(state_); return state_; }
+        void constexpr advance(int64_t offset) noexcept {
+            Uint128 delta = uint64_t(offset);
+            if (offset < 0)
+                delta |= ~ Uint128(0) << 64;
+            state_ = Detail::lcg_advance(state_, Detail::lcg128_multiplier, Detail::lcg128_increment, delta);
+        }
         bool constexpr operator==(const Lcg128& rhs) const noexcept { return state_ == rhs.state_; }
         bool constexpr operator!=(const Lcg128& rhs) const noexcept { return state_ != rhs.state_; }
         void constexpr seed(Uint128 s) noexcept { state_ = s; }
@@ -265,6 +306,13 @@ namespace Crow {
             return hi;
         }
 
+        constexpr void advance(int64_t offset) noexcept {
+            state_type delta = uint64_t(offset);
+            if (offset < 0)
+                delta |= ~ Uint128(0) << 64;
+            state_ = Detail::lcg_advance(state_, state_type(mul), inc_, delta);
+        }
+
         constexpr void seed(uint64_t s) noexcept { seed(0, s, 0, 0); }
         constexpr void seed(uint64_t s0, uint64_t s1) noexcept { seed(s0, s1, 0, 0); }
 
@@ -342,6 +390,9 @@ namespace Crow {
             return x;
         }
 
+        constexpr void jump() noexcept { jump_by(jump_poly_); }
+        constexpr void long_jump() noexcept { jump_by(long_jump_poly_); }
+
         constexpr void seed(uint64_t s = 0) noexcept {
             Detail::SplitMix64 sm(s);
             state_[0] = sm();
@@ -371,8 +422,31 @@ namespace Crow {
 
     private:
 
+        using poly_type = std::array<uint64_t, 4>;
+
+        static constexpr poly_type jump_poly_ = {
+            0x180e'c6d3'3cfd'0abaull, 0xd5a6'1266'f0c9'392cull, 0xa958'2618'e03f'c9aaull, 0x39ab'dc45'29b1'661cull,
+        };
+
+        static constexpr poly_type long_jump_poly_ = {
+            0x76e1'5d3e'fefd'cbbfull, 0xc500'4e44'1c52'2fb3ull, 0x7771'0069'854e'e241ull, 0x3910'9bb0'2acb'e635ull,
+        };
+
         std::array<uint64_t, 4> state_;
 
+        constexpr void jump_by(const poly_type& poly) noexcept {
+            std::array<uint64_t, 4> jumped = {};
+            for (auto word: poly) {
+                for (int bit = 0; bit < 64; ++bit) {
+                    if ((word >> bit) & 1)
+                        for (int i = 0; i < 4; ++i)
+                            jumped[i] ^= state_[i];
+                    (*this)();
+                }
+            }
+            state_ = jumped;
+        }
+
     };
 
     // Default choice of RNG
@@ -438,4 +512,68 @@ namespace Crow {
 
     }
 
+    // Parallel streams
+
+    template <RandomEngineType RNG>
+    requires requires (RNG& rng) { { rng.jump() }; } || requires (RNG& rng) { { rng.advance(int64_t()) }; }
+    class ParallelRng {
+
+    private:
+
+        static constexpr bool use_jump_ = requires (RNG& rng) { { rng.jump() }; };
+        static constexpr bool small_engine_ = sizeof(typename RNG::result_type) <= sizeof(uint32_t);
+        static constexpr int64_t stride_ = small_engine_ ? int64_t(1) << 24 : int64_t(1) << 48;
+
+    public:
+
+        using engine_type = RNG;
+
+        // Advancing by stride_ per stream must neither wrap a 32-bit engine's
+        // 2^32 period nor overflow the int64_t offset passed to advance()
+
+        static constexpr size_t max_streams = use_jump_ ? npos : small_engine_ ? 256 : 32'768;
+
+        ParallelRng(): ParallelRng(RNG()) {}
+        explicit ParallelRng(const RNG& base);
+        explicit ParallelRng(uint64_t s) requires std::constructible_from<RNG, uint64_t>: ParallelRng(RNG(s)) {}
+
+        RNG operator()(size_t index) const { return stream(index); }
+        RNG stream(size_t index) const;
+
+    private:
+
+        RNG base_;
+        mutable std::mutex mutex_;
+        mutable std::vector<RNG> streams_; // Only used with jump()
+
+    };
+
+        template <RandomEngineType RNG>
+        requires requires (RNG& rng) { { rng.jump() }; } || requires (RNG& rng) { { rng.advance(int64_t()) }; }
+        ParallelRng<RNG>::ParallelRng(const RNG& base):
+        base_(base) {
+            if constexpr (use_jump_)
+                streams_.push_back(base);
+        }
+
+        template <RandomEngineType RNG>
+        requires requires (RNG& rng) { { rng.jump() }; } || requires (RNG& rng) { { rng.advance(int64_t()) }; }
+        RNG ParallelRng<RNG>::stream(size_t index) const {
+            if (index >= max_streams)
+                throw std::out_of_range("Parallel RNG stream index out of range: " + std::to_string(index));
+            if constexpr (use_jump_) {
+                std::unique_lock lock(mutex_);
+                while (streams_.size() <= index) {
+                    auto rng = streams_.back();
+                    rng.jump();
+                    streams_.push_back(rng);
+                }
+                return streams_[index];
+            } else {
+                auto rng = base_;
+                rng.advance(stride_ * int64_t(index));
+                return rng;
+            }
+        }
+
 }
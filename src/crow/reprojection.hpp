@@ -0,0 +1,502 @@
+#pragma once
+
+#include "crow/colour.hpp"
+#include "crow/enum.hpp"
+#include "crow/geometry.hpp"
+#include "crow/image.hpp"
+#include "crow/projection.hpp"
+#include "crow/thread-pool.hpp"
+#include "crow/types.hpp"
+#include "crow/vector.hpp"
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numbers>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace Crow {
+
+    CROW_ENUM_SCOPED(ReprojectFilter, int,
+        nearest,
+        bilinear,
+        bicubic,
+    )
+
+    namespace Detail {
+
+        // Catmull-Rom cubic convolution kernel (a = -1/2)
+
+        template <std::floating_point T>
+        T cubic_kernel(T t) noexcept {
+            t = std::abs(t);
+            if (t <= 1)
+                return (T(1.5) * t - T(2.5)) * t * t + 1;
+            else if (t < 2)
+                return ((T(-0.5) * t + T(2.5)) * t - 4) * t + 2;
+            else
+                return 0;
+        }
+
+    }
+
+    template <std::floating_point T = double>
+    class MapReprojection {
+
+    public:
+
+        using projection_type = BasicMapProjection<T>;
+        using value_type = T;
+        using vector_type = Vector<T, 2>;
+        using box_type = Box<T, 2>;
+
+        static constexpr int default_tile_size = 64;
+        static constexpr int default_grid_step = 8;
+        static constexpr T default_tolerance = T(0.125);
+
+        MapReprojection(const projection_type& source, const projection_type& target);
+
+        box_type source_extent() const noexcept { return source_extent_; }
+        void set_source_extent(const box_type& box);
+        box_type target_extent() const noexcept { return target_extent_; }
+        void set_target_extent(const box_type& box);
+        ReprojectFilter filter() const noexcept { return filter_; }
+        void set_filter(ReprojectFilter f) noexcept { filter_ = f; }
+        int tile_size() const noexcept { return tile_size_; }
+        void set_tile_size(int n);
+        int grid_step() const noexcept { return grid_step_; }
+        void set_grid_step(int n);
+        T tolerance() const noexcept { return tolerance_; }
+        void set_tolerance(T t);
+        bool wrap() const noexcept { return wrap_; }
+        void set_wrap(bool b = true) noexcept { wrap_ = b; }
+
+        template <ColourType CT, ImageFlags Flags>
+            void operator()(const Image<CT, Flags>& in, Image<CT, Flags>& out, ThreadPool& pool, CT background = {}) const;
+        template <ColourType CT, ImageFlags Flags, std::invocable<const Image<CT, Flags>&, int> F>
+            void strips(const Image<CT, Flags>& in, Point out_shape, int strip_height, ThreadPool& pool,
+                F callback, CT background = {}) const;
+
+    private:
+
+        // Affine maps between pixel and map coordinates for one job
+
+        struct frame_type {
+            Point in_shape;
+            Point out_shape;
+            T out_x0, out_dx, out_y0, out_dy;
+            T in_x0, in_sx, in_y0, in_sy;
+        };
+
+        std::shared_ptr<projection_type> source_;
+        std::shared_ptr<projection_type> target_;
+        box_type source_extent_;
+        box_type target_extent_;
+        ReprojectFilter filter_ = ReprojectFilter::bilinear;
+        int tile_size_ = default_tile_size;
+        int grid_step_ = default_grid_step;
+        T tolerance_ = default_tolerance;
+        bool wrap_ = false;
+
+        static box_type default_extent(const projection_type& proj) noexcept;
+        static bool is_valid_extent(const box_type& box) noexcept;
+
+        template <ImageFlags Flags> frame_type make_frame(Point in_shape, Point out_shape) const noexcept;
+        void locate(const frame_type& frame, std::span<vector_type> points, std::vector<uint8_t>& valid) const;
+        template <ColourType CT, ImageFlags Flags>
+            void render(const Image<CT, Flags>& in, Image<CT, Flags>& strip, Point out_shape, int y_offset,
+                ThreadPool& pool, CT background) const;
+        template <ColourType CT, ImageFlags Flags>
+            void render_tile(const Image<CT, Flags>& in, Image<CT, Flags>& strip, const frame_type& frame,
+                int y_offset, Box_i2 tile, CT background) const;
+        template <ColourType CT, ImageFlags Flags>
+            CT sample(const Image<CT, Flags>& in, vector_type pos, CT background) const noexcept;
+
+    };
+
+        template <std::floating_point T>
+        MapReprojection<T>::MapReprojection(const projection_type& source, const projection_type& target):
+        source_(source.clone()),
+        target_(target.clone()),
+        source_extent_(default_extent(source)),
+        target_extent_(default_extent(target)) {}
+
+        template <std::floating_point T>
+        void MapReprojection<T>::set_source_extent(const box_type& box) {
+            if (! is_valid_extent(box))
+                throw std::invalid_argument("Invalid source map extent");
+            source_extent_ = box;
+        }
+
+        template <std::floating_point T>
+        void MapReprojection<T>::set_target_extent(const box_type& box) {
+            if (! is_valid_extent(box))
+                throw std::invalid_argument("Invalid target map extent");
+            target_extent_ = box;
+        }
+
+        template <std::floating_point T>
+        void MapReprojection<T>::set_tile_size(int n) {
+            if (n < 1)
+                throw std::invalid_argument("Invalid reprojection tile size");
+            tile_size_ = n;
+        }
+
+        template <std::floating_point T>
+        void MapReprojection<T>::set_grid_step(int n) {
+            if (n < 1)
+                throw std::invalid_argument("Invalid reprojection grid step");
+            grid_step_ = n;
+        }
+
+        template <std::floating_point T>
+        void MapReprojection<T>::set_tolerance(T t) {
+            if (! (t >= 0))
+                throw std::invalid_argument("Invalid reprojection tolerance");
+            tolerance_ = t;
+        }
+
+        template <std::floating_point T>
+        template <ColourType CT, ImageFlags Flags>
+        void MapReprojection<T>::operator()(const Image<CT, Flags>& in, Image<CT, Flags>& out,
+                ThreadPool& pool, CT background) const {
+            if (in.empty())
+                throw std::invalid_argument("Reprojection input image is empty");
+            if (out.empty())
+                throw std::invalid_argument("Reprojection output image is empty");
+            render(in, out, out.shape(), 0, pool, background);
+        }
+
+        template <std::floating_point T>
+        template <ColourType CT, ImageFlags Flags, std::invocable<const Image<CT, Flags>&, int> F>
+        void MapReprojection<T>::strips(const Image<CT, Flags>& in, Point out_shape, int strip_height, ThreadPool& pool,
+                F callback, CT background) const {
+            if (in.empty())
+                throw std::invalid_argument("Reprojection input image is empty");
+            if (out_shape.x() <= 0 || out_shape.y() <= 0)
+                throw std::invalid_argument(fmt("Invalid image dimensions: {0}", out_shape));
+            if (strip_height < 1)
+                throw std::invalid_argument("Invalid reprojection strip height");
+            Image<CT, Flags> strip;
+            for (int y = 0; y < out_shape.y(); y += strip_height) {
+                int h = std::min(strip_height, out_shape.y() - y);
+                if (strip.height() != h)
+                    strip.reset(out_shape.x(), h);
+                render(in, strip, out_shape, y, pool, background);
+                callback(static_cast<const Image<CT, Flags>&>(strip), y);
+            }
+        }
+
+        template <std::floating_point T>
+        typename MapReprojection<T>::box_type MapReprojection<T>::default_extent(const projection_type& proj) noexcept {
+            using std::numbers::pi_v;
+            T max_x = proj.has_max_x() ? proj.max_x() : 0;
+            T max_y = proj.has_max_y() ? proj.max_y() : 0;
+            if (max_x == 0 && max_y == 0)
+                max_x = max_y = pi_v<T>;
+            else if (max_x == 0)
+                max_x = max_y;
+            else if (max_y == 0)
+                max_y = max_x;
+            return {{- max_x, - max_y}, {2 * max_x, 2 * max_y}};
+        }
+
+        template <std::floating_point T>
+        bool MapReprojection<T>::is_valid_extent(const box_type& box) noexcept {
+            return std::isfinite(box.base().x()) && std::isfinite(box.base().y())
+                && std::isfinite(box.shape().x()) && std::isfinite(box.shape().y())
+                && box.shape().x() > 0 && box.shape().y() > 0;
+        }
+
+        template <std::floating_point T>
+        template <ImageFlags Flags>
+        typename MapReprojection<T>::frame_type MapReprojection<T>::make_frame(Point in_shape, Point out_shape) const noexcept {
+            static constexpr bool top_down = ! has_bit(Flags, ImageFlags::invert);
+            frame_type frame;
+            frame.in_shape = in_shape;
+            frame.out_shape = out_shape;
+            frame.out_dx = target_extent_.shape().x() / T(out_shape.x());
+            frame.out_x0 = target_extent_.base().x() + frame.out_dx / 2;
+            frame.in_sx = T(in_shape.x()) / source_extent_.shape().x();
+            frame.in_x0 = source_extent_.base().x();
+            if constexpr (top_down) {
+                frame.out_dy = - target_extent_.shape().y() / T(out_shape.y());
+                frame.out_y0 = target_extent_.apex().y() + frame.out_dy / 2;
+                frame.in_sy = - T(in_shape.y()) / source_extent_.shape().y();
+                frame.in_y0 = source_extent_.apex().y();
+            } else {
+                frame.out_dy = target_extent_.shape().y() / T(out_shape.y());
+                frame.out_y0 = target_extent_.base().y() + frame.out_dy / 2;
+                frame.in_sy = T(in_shape.y()) / source_extent_.shape().y();
+                frame.in_y0 = source_extent_.base().y();
+            }
+            return frame;
+        }
+
+        // Converts output pixel positions in place to input pixel positions,
+        // with NaN for pixels that are not on the map in either projection.
+
+        template <std::floating_point T>
+        void MapReprojection<T>::locate(const frame_type& frame, std::span<vector_type> points, std::vector<uint8_t>& valid) const {
+
+            static constexpr T nan = std::numeric_limits<T>::quiet_NaN();
+
+            valid.resize(points.size());
+
+            for (size_t i = 0; i < points.size(); ++i) {
+                auto& p = points[i];
+                p = {frame.out_x0 + p.x() * frame.out_dx, frame.out_y0 + p.y() * frame.out_dy};
+                valid[i] = uint8_t(target_->is_on_map(p));
+                if (! valid[i])
+                    p = vector_type::null();
+            }
+
+            target_->map_to_globe(points, points);
+
+            for (size_t i = 0; i < points.size(); ++i)
+                if (valid[i])
+                    valid[i] = uint8_t(source_->is_on_globe(points[i]));
+
+            source_->globe_to_map(points, points);
+
+            for (size_t i = 0; i < points.size(); ++i) {
+                auto& p = points[i];
+                if (valid[i])
+                    p = {(p.x() - frame.in_x0) * frame.in_sx - T(0.5), (p.y() - frame.in_y0) * frame.in_sy - T(0.5)};
+                else
+                    p = {nan, nan};
+            }
+
+        }
+
+        template <std::floating_point T>
+        template <ColourType CT, ImageFlags Flags>
+        void MapReprojection<T>::render(const Image<CT, Flags>& in, Image<CT, Flags>& strip, Point out_shape, int y_offset,
+                ThreadPool& pool, CT background) const {
+            auto frame = make_frame<Flags>(in.shape(), out_shape);
+            int tiles_x = (strip.width() + tile_size_ - 1) / tile_size_;
+            int tiles_y = (strip.height() + tile_size_ - 1) / tile_size_;
+            pool.each(tiles_x * tiles_y, [&] (int i) {
+                Point base = {tile_size_ * (i % tiles_x), tile_size_ * (i / tiles_x)};
+                Point apex = {std::min(base.x() + tile_size_, strip.width()), std::min(base.y() + tile_size_, strip.height())};
+                render_tile(in, strip, frame, y_offset, {base, apex - base}, background);
+            });
+            pool.wait();
+        }
+
+        // Each tile is covered by a coarse grid of nodes where the inverse
+        // mapping is evaluated exactly. Inside a grid cell the source
+        // position is interpolated from the corners, unless a corner is off
+        // the map, the cell straddles a wrap seam in the source, or the
+        // interpolated centre misses the exact one by more than the
+        // tolerance, in which case every pixel in the cell is mapped exactly.
+
+        template <std::floating_point T>
+        template <ColourType CT, ImageFlags Flags>
+        void MapReprojection<T>::render_tile(const Image<CT, Flags>& in, Image<CT, Flags>& strip, const frame_type& frame,
+                int y_offset, Box_i2 tile, CT background) const {
+
+            const auto make_nodes = [this] (int begin, int size, int total) {
+                std::vector<int> nodes;
+                int last = begin + size - 1;
+                for (int n = begin / grid_step_ * grid_step_;; n += grid_step_) {
+                    if (n >= total - 1) {
+                        nodes.push_back(total - 1);
+                        break;
+                    }
+                    nodes.push_back(n);
+                    if (n > last)
+                        break;
+                }
+                if (nodes.size() == 1)
+                    nodes.push_back(nodes.back());
+                return nodes;
+            };
+
+            int out_width = frame.out_shape.x();
+            int out_height = frame.out_shape.y();
+            int tile_x1 = tile.base().x();
+            int tile_x2 = tile.apex().x();
+            int tile_y1 = tile.base().y() + y_offset;
+            int tile_y2 = tile.apex().y() + y_offset;
+            auto nodes_x = make_nodes(tile_x1, tile.shape().x(), out_width);
+            auto nodes_y = make_nodes(tile_y1, tile.shape().y(), out_height);
+            int cols = int(nodes_x.size());
+            int rows = int(nodes_y.size());
+            std::vector<vector_type> grid;
+            std::vector<vector_type> exact;
+            std::vector<uint8_t> valid;
+
+            for (int y: nodes_y)
+                for (int x: nodes_x)
+                    grid.push_back({T(x), T(y)});
+
+            locate(frame, grid, valid);
+
+            bool check_map = has_bit(target_->properties(), Maps::interrupted);
+            T seam = T(frame.in_shape.x()) / 2;
+
+            for (int j = 0; j < rows - 1; ++j) {
+
+                int cell_y1 = nodes_y[j];
+                int cell_y2 = nodes_y[j + 1] == out_height - 1 ? out_height : nodes_y[j + 1];
+                int y1 = std::max(cell_y1, tile_y1);
+                int y2 = std::min(cell_y2, tile_y2);
+                T dy = std::max(nodes_y[j + 1] - nodes_y[j], 1);
+
+                for (int i = 0; i < cols - 1; ++i) {
+
+                    int cell_x1 = nodes_x[i];
+                    int cell_x2 = nodes_x[i + 1] == out_width - 1 ? out_width : nodes_x[i + 1];
+                    int x1 = std::max(cell_x1, tile_x1);
+                    int x2 = std::min(cell_x2, tile_x2);
+                    T dx = std::max(nodes_x[i + 1] - nodes_x[i], 1);
+                    vector_type c00 = grid[j * cols + i];
+                    vector_type c10 = grid[j * cols + i + 1];
+                    vector_type c01 = grid[(j + 1) * cols + i];
+                    vector_type c11 = grid[(j + 1) * cols + i + 1];
+
+                    const auto interpolate = [&] (int x, int y) {
+                        T u = (x - cell_x1) / dx;
+                        T v = (y - cell_y1) / dy;
+                        return (1 - v) * ((1 - u) * c00 + u * c10) + v * ((1 - u) * c01 + u * c11);
+                    };
+
+                    bool use_grid = true;
+
+                    for (auto& c: {c00, c10, c01, c11})
+                        if (std::isnan(c.x()))
+                            use_grid = false;
+
+                    if (use_grid) {
+                        auto [min_x, max_x] = std::minmax({c00.x(), c10.x(), c01.x(), c11.x()});
+                        use_grid = max_x - min_x < seam;
+                    }
+
+                    if (use_grid && cell_x2 - cell_x1 > 1 && cell_y2 - cell_y1 > 1) {
+                        int xc = (cell_x1 + cell_x2) / 2;
+                        int yc = (cell_y1 + cell_y2) / 2;
+                        exact.assign(1, {T(xc), T(yc)});
+                        locate(frame, exact, valid);
+                        auto error = exact[0] - interpolate(xc, yc);
+                        use_grid = ! std::isnan(error.x()) && std::abs(error.x()) <= tolerance_ && std::abs(error.y()) <= tolerance_;
+                    }
+
+                    if (use_grid) {
+                        for (int y = y1; y < y2; ++y) {
+                            for (int x = x1; x < x2; ++x) {
+                                auto& pixel = strip(x, y - y_offset);
+                                if (check_map && ! target_->is_on_map({frame.out_x0 + x * frame.out_dx, frame.out_y0 + y * frame.out_dy}))
+                                    pixel = background;
+                                else
+                                    pixel = sample(in, interpolate(x, y), background);
+                            }
+                        }
+                    } else {
+                        exact.clear();
+                        for (int y = y1; y < y2; ++y)
+                            for (int x = x1; x < x2; ++x)
+                                exact.push_back({T(x), T(y)});
+                        locate(frame, exact, valid);
+                        auto pos = exact.begin();
+                        for (int y = y1; y < y2; ++y)
+                            for (int x = x1; x < x2; ++x, ++pos)
+                                strip(x, y - y_offset) = sample(in, *pos, background);
+                    }
+
+                }
+
+            }
+
+        }
+
+        template <std::floating_point T>
+        template <ColourType CT, ImageFlags Flags>
+        CT MapReprojection<T>::sample(const Image<CT, Flags>& in, vector_type pos, CT background) const noexcept {
+
+            using channel_type = typename CT::value_type;
+            using acc_type = Vector<T, CT::channels>;
+
+            int w = in.width();
+            int h = in.height();
+            T sx = pos.x();
+            T sy = pos.y();
+
+            if (std::isnan(sx) || sy < T(-0.5) || sy > h - T(0.5))
+                return background;
+            if (! wrap_ && (sx < T(-0.5) || sx > w - T(0.5)))
+                return background;
+
+            const auto fix_x = [this,w] (int x) {
+                return wrap_ ? (x % w + w) % w : std::clamp(x, 0, w - 1);
+            };
+
+            const auto fix_y = [h] (int y) {
+                return std::clamp(y, 0, h - 1);
+            };
+
+            if (filter_ == ReprojectFilter::nearest)
+                return in(fix_x(int(std::floor(sx + T(0.5)))), fix_y(int(std::floor(sy + T(0.5)))));
+
+            T fx = std::floor(sx);
+            T fy = std::floor(sy);
+            int ix = int(fx);
+            int iy = int(fy);
+            fx = sx - fx;
+            fy = sy - fy;
+            acc_type acc;
+
+            const auto add = [&] (int x, int y, T weight) {
+                auto& c = in(fix_x(x), fix_y(y));
+                for (int k = 0; k < CT::channels; ++k)
+                    acc[k] += weight * T(c[k]);
+            };
+
+            if (filter_ == ReprojectFilter::bilinear) {
+                add(ix, iy, (1 - fx) * (1 - fy));
+                add(ix + 1, iy, fx * (1 - fy));
+                add(ix, iy + 1, (1 - fx) * fy);
+                add(ix + 1, iy + 1, fx * fy);
+            } else {
+                T wx[4];
+                T wy[4];
+                for (int k = 0; k < 4; ++k) {
+                    wx[k] = Detail::cubic_kernel(fx - T(k - 1));
+                    wy[k] = Detail::cubic_kernel(fy - T(k - 1));
+                }
+                for (int b = 0; b < 4; ++b)
+                    for (int a = 0; a < 4; ++a)
+                        add(ix + a - 1, iy + b - 1, wx[a] * wy[b]);
+            }
+
+            CT result;
+
+            for (int k = 0; k < CT::channels; ++k) {
+                if constexpr (std::is_integral_v<channel_type>)
+                    result[k] = channel_type(std::clamp(std::round(acc[k]), T(std::numeric_limits<channel_type>::min()),
+                        T(std::numeric_limits<channel_type>::max())));
+                else
+                    result[k] = channel_type(acc[k]);
+            }
+
+            return result;
+
+        }
+
+    template <ColourType CT, ImageFlags Flags, std::floating_point T>
+    void reproject(const Image<CT, Flags>& in, const BasicMapProjection<T>& in_proj,
+            Image<CT, Flags>& out, const BasicMapProjection<T>& out_proj,
+            ReprojectFilter filter = ReprojectFilter::bilinear) {
+        MapReprojection<T> engine(in_proj, out_proj);
+        engine.set_filter(filter);
+        ThreadPool pool;
+        engine(in, out, pool);
+    }
+
+}
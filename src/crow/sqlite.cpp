@@ -53,7 +53,7 @@ namespace Crow::Sqlite {
         if (std::popcount(uint32_t(flags & open_flags)) > 1
                 || (has_bit(flags, Mode::memory | Mode::tempfile)
                     && has_bit(flags, Mode::nofollow | Mode::uri))
-                || has_bit(flags, Mode::persistent))
+                || has_bit(flags, Mode::persistent | Mode::bulk))
             throw InvalidArgument("Invalid Sqlite connection mode flags");
 
         auto name = file;
@@ -128,8 +128,6 @@ namespace Crow::Sqlite {
     }
 
     Query Connect::query(const std::string& sql, Mode flags) {
-        Query qry;
-        qry.sqlite_ = sqlite_;
         int stmt_flags = 0;
         if (has_bit(flags, ~ Mode::persistent))
             throw InvalidArgument("Flags other than persistent cannot be used when preparing a query");
@@ -138,12 +136,39 @@ namespace Crow::Sqlite {
         sqlite3_stmt* handle = nullptr;
         check_result(sqlite3_prepare_v3(native_handle(), sql.data(), int(sql.size()), stmt_flags, &handle, nullptr),
             "sqlite3_prepare_v3()", sqlite_);
-        qry.stmt_.reset(handle, [] (auto stmt) { if (stmt) sqlite3_finalize(stmt); });
-        int n_params = sqlite3_bind_parameter_count(qry.stmt_.get());
-        qry.params_.assign(size_t(n_params), false);
+        std::shared_ptr<sqlite3_stmt> stmt(handle, [] (auto stmt) { if (stmt) sqlite3_finalize(stmt); });
+        return make_query(stmt);
+    }
+
+    Query Connect::cached_query(const std::string& sql) {
+        if (cache_capacity_ == 0)
+            return query(sql, Mode::persistent);
+        auto it = cache_index_.find(sql);
+        if (it != cache_index_.end()) {
+            cache_list_.splice(cache_list_.begin(), cache_list_, it->second);
+            auto stmt = it->second->stmt.get();
+            sqlite3_reset(stmt);
+            check_result(sqlite3_clear_bindings(stmt),
+                "sqlite3_clear_bindings()", sqlite_);
+            return make_query(it->second->stmt);
+        }
+        auto qry = query(sql, Mode::persistent);
+        cache_list_.push_front({sql, qry.stmt_});
+        cache_index_[cache_list_.front().sql] = cache_list_.begin();
+        trim_cache();
         return qry;
     }
 
+    void Connect::set_cache_capacity(size_t n) {
+        cache_capacity_ = n;
+        trim_cache();
+    }
+
+    void Connect::clear_cache() noexcept {
+        cache_index_.clear();
+        cache_list_.clear();
+    }
+
     Result Connect::run(const std::string& sql) {
         Query qry = query(sql);
         return qry.run();
@@ -153,6 +178,25 @@ namespace Crow::Sqlite {
         return run(sql);
     }
 
+    bool Connect::in_transaction() const noexcept {
+        return sqlite_ && sqlite3_get_autocommit(native_handle()) == 0;
+    }
+
+    Connect::bulk_state Connect::begin_bulk() {
+        bulk_state saved = {
+            int(run("pragma synchronous").get<int>()),
+            int(run("pragma temp_store").get<int>()),
+        };
+        set_pragma("synchronous", 0);
+        set_pragma("temp_store", 2);
+        return saved;
+    }
+
+    void Connect::end_bulk(bulk_state saved) noexcept {
+        run_unchecked(fmt("pragma synchronous = {0}", saved[0]));
+        run_unchecked(fmt("pragma temp_store = {0}", saved[1]));
+    }
+
     void Connect::do_set_pragma(const std::string& name, const std::string& value) {
         auto sql = fmt("pragma {0} = {1}", name, value);
         Query qry = query(sql);
@@ -164,6 +208,15 @@ namespace Crow::Sqlite {
             "sqlite3_busy_timeout()", sqlite_);
     }
 
+    Query Connect::make_query(std::shared_ptr<sqlite3_stmt> stmt) const {
+        Query qry;
+        qry.sqlite_ = sqlite_;
+        qry.stmt_ = std::move(stmt);
+        int n_params = sqlite3_bind_parameter_count(qry.stmt_.get());
+        qry.params_.assign(size_t(n_params), false);
+        return qry;
+    }
+
     void Connect::run_unchecked(const std::string& sql) noexcept {
         sqlite3_stmt* stmt = nullptr;
         sqlite3_prepare_v3(native_handle(), sql.data(), int(sql.size()), 0, &stmt, nullptr);
@@ -173,6 +226,13 @@ namespace Crow::Sqlite {
         }
     }
 
+    void Connect::trim_cache() noexcept {
+        while (cache_list_.size() > cache_capacity_) {
+            cache_index_.erase(cache_list_.back().sql);
+            cache_list_.pop_back();
+        }
+    }
+
     // Query class
 
     int Query::get_index(const std::string& name) const noexcept {
@@ -221,8 +281,12 @@ namespace Crow::Sqlite {
             "sqlite3_bind_double()", sqlite_);
     }
 
-    void Query::bind_string(int index, const std::string& value) {
-        check_result(sqlite3_bind_blob64(native_handle(), index, value.data(), value.size(), SQLITE_TRANSIENT),
+    void Query::bind_blob(int index, const void* ptr, size_t len, bool copy) {
+        // Sqlite treats a null pointer as SQL null, so bind empty strings from a dummy pointer
+        static constexpr char empty = 0;
+        if (! ptr)
+            ptr = &empty;
+        check_result(sqlite3_bind_blob64(native_handle(), index, ptr, len, copy ? SQLITE_TRANSIENT : SQLITE_STATIC),
             "sqlite3_bind_blob64()", sqlite_);
     }
 
@@ -289,6 +353,14 @@ namespace Crow::Sqlite {
             sqlite3_reset(stmt_.get());
     }
 
+    std::span<const std::byte> Result::get_blob(int col) const {
+        auto ptr = static_cast<const std::byte*>(sqlite3_column_blob(stmt_.get(), col));
+        if (! ptr)
+            return {};
+        size_t len = sqlite3_column_bytes(stmt_.get(), col);
+        return {ptr, len};
+    }
+
     int64_t Result::get_int(int col) const {
         return sqlite3_column_int64(stmt_.get(), col);
     }
@@ -305,6 +377,14 @@ namespace Crow::Sqlite {
         return std::string(ptr, len);
     }
 
+    std::string_view Result::get_view(int col) const {
+        auto ptr = static_cast<const char*>(sqlite3_column_blob(stmt_.get(), col));
+        if (! ptr)
+            return {};
+        size_t len = sqlite3_column_bytes(stmt_.get(), col);
+        return {ptr, len};
+    }
+
     void Result::next() {
         if (! stmt_)
             return;
@@ -354,4 +434,115 @@ namespace Crow::Sqlite {
         std::exchange(con_, nullptr)->run("rollback transaction");
     }
 
+    // Pool class
+
+    Pool::Pool(const std::string& file, int readers, Mode flags):
+    file_(file) {
+
+        static constexpr auto busy_timeout = std::chrono::seconds(10);
+        static constexpr Mode pool_flags = Mode::write | Mode::create | Mode::nofollow | Mode::uri;
+
+        if (has_bit(flags, ~ pool_flags) || has_bits(flags, Mode::write | Mode::create))
+            throw InvalidArgument("Invalid Sqlite connection pool mode flags");
+        if (file.empty())
+            throw InvalidArgument("No file name was supplied for Sqlite connection pool");
+        if (! has_bit(flags, Mode::create))
+            flags |= Mode::write;
+
+        // Each connection is only used by one lease holder at a time,
+        // so Sqlite's own connection mutex is redundant
+
+        auto common = (flags & (Mode::nofollow | Mode::uri)) | Mode::nomutex;
+
+        writer_ = Connect(file, flags | Mode::nomutex);
+        writer_.set_timeout(busy_timeout);
+        auto journal = writer_.run("pragma journal_mode = wal").get<std::string>();
+        if (ascii_lowercase(journal) != "wal")
+            throw InvalidOperation("Sqlite connection pool could not enable WAL mode: " + quote(file));
+        writer_.set_pragma("synchronous", "normal");
+
+        if (readers <= 0)
+            readers = int(std::thread::hardware_concurrency());
+        readers = std::max(readers, 1);
+        readers_.reserve(size_t(readers));
+
+        for (int i = 0; i < readers; ++i) {
+            readers_.emplace_back(file, Mode::read | common);
+            readers_.back().set_timeout(busy_timeout);
+        }
+
+        for (auto& con: readers_)
+            idle_.push_back(&con);
+
+    }
+
+    Pool::lease Pool::read() {
+        std::unique_lock lock(mutex_);
+        read_cv_.wait(lock, [this] { return ! idle_.empty(); });
+        auto con = idle_.back();
+        idle_.pop_back();
+        return lease(*this, *con);
+    }
+
+    Pool::lease Pool::try_read() {
+        std::unique_lock lock(mutex_);
+        if (idle_.empty())
+            return {};
+        auto con = idle_.back();
+        idle_.pop_back();
+        return lease(*this, *con);
+    }
+
+    Pool::lease Pool::write() {
+        std::unique_lock lock(mutex_);
+        write_cv_.wait(lock, [this] { return ! writer_busy_; });
+        writer_busy_ = true;
+        return lease(*this, writer_);
+    }
+
+    Pool::lease Pool::try_write() {
+        std::unique_lock lock(mutex_);
+        if (writer_busy_)
+            return {};
+        writer_busy_ = true;
+        return lease(*this, writer_);
+    }
+
+    int Pool::idle_readers() const {
+        std::unique_lock lock(mutex_);
+        return int(idle_.size());
+    }
+
+    void Pool::release(Connect* con) noexcept {
+        bool is_writer = con == &writer_;
+        {
+            std::unique_lock lock(mutex_);
+            if (is_writer)
+                writer_busy_ = false;
+            else
+                idle_.push_back(con);
+        }
+        if (is_writer)
+            write_cv_.notify_one();
+        else
+            read_cv_.notify_one();
+    }
+
+    // Pool::lease class
+
+    Pool::lease& Pool::lease::operator=(lease&& l) noexcept {
+        if (&l != this) {
+            release();
+            pool_ = std::exchange(l.pool_, nullptr);
+            con_ = std::exchange(l.con_, nullptr);
+        }
+        return *this;
+    }
+
+    void Pool::lease::release() noexcept {
+        if (con_ != nullptr)
+            pool_->release(std::exchange(con_, nullptr));
+        pool_ = nullptr;
+    }
+
 }
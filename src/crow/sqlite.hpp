@@ -1,18 +1,31 @@
 #pragma once
 
+#include "crow/binary.hpp"
 #include "crow/enum.hpp"
 #include "crow/format.hpp"
+#include "crow/guard.hpp"
 #include "crow/iterator.hpp"
 #include "crow/string.hpp"
+#include "crow/thread-pool.hpp"
 #include "crow/types.hpp"
 #include <array>
 #include <chrono>
 #include <compare>
+#include <condition_variable>
 #include <cstddef>
+#include <iterator>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 struct sqlite3;
@@ -21,6 +34,7 @@ struct sqlite3_stmt;
 namespace Crow::Sqlite {
 
     class Connect;
+    class Pool;
     class Query;
     class Result;
     class Row;
@@ -43,6 +57,8 @@ namespace Crow::Sqlite {
         uri         = 1u << 7,  // Enable URI file names
         // Query usage hints
         persistent  = 1u << 8,  // Hint that a query should be persistent
+        // Bulk insert flags
+        bulk        = 1u << 9,  // Relax durability pragmas during insert_many()
     )
 
     class Exception:
@@ -79,6 +95,9 @@ namespace Crow::Sqlite {
 
     public:
 
+        static constexpr size_t default_batch = 10'000;
+        static constexpr size_t default_cache = 32;
+
         Connect() = default;
         explicit Connect(Mode flags): Connect({}, flags) {}
         explicit Connect(const std::string& file, Mode flags = Mode::read);
@@ -89,8 +108,16 @@ namespace Crow::Sqlite {
         Connect& operator=(Connect&&) = default;
 
         Query query(const std::string& sql, Mode flags = Mode::none);
+        Query cached_query(const std::string& sql);
+        size_t cache_capacity() const noexcept { return cache_capacity_; }
+        size_t cache_size() const noexcept { return cache_list_.size(); }
+        void set_cache_capacity(size_t n);
+        void clear_cache() noexcept;
         Result run(const std::string& sql);
         Result operator()(const std::string& sql);
+        template <typename Range> size_t insert_many(const std::string& sql, const Range& rows,
+            Mode flags = Mode::none, size_t batch = default_batch);
+        bool in_transaction() const noexcept;
         template <typename T> void set_pragma(const std::string& name, const T& value);
         template <typename R, typename P> void set_timeout(std::chrono::duration<R, P> t);
         sqlite3* native_handle() const noexcept { return sqlite_.get(); }
@@ -99,11 +126,29 @@ namespace Crow::Sqlite {
 
         friend class Transaction;
 
+        struct cache_entry {
+            std::string sql;
+            std::shared_ptr<sqlite3_stmt> stmt;
+        };
+
+        using cache_list = std::list<cache_entry>;
+        using cache_index = std::unordered_map<std::string_view, cache_list::iterator>;
+        using bulk_state = std::array<int, 2>;
+
+        template <typename T> static constexpr bool is_tuple_like = requires { std::tuple_size<T>::value; };
+
         std::shared_ptr<sqlite3> sqlite_;
+        cache_list cache_list_; // Most recently used first
+        cache_index cache_index_;
+        size_t cache_capacity_ = default_cache;
 
+        bulk_state begin_bulk();
+        void end_bulk(bulk_state saved) noexcept;
         void do_set_pragma(const std::string& name, const std::string& value);
         void do_set_timeout(std::chrono::milliseconds t);
+        Query make_query(std::shared_ptr<sqlite3_stmt> stmt) const;
         void run_unchecked(const std::string& sql) noexcept;
+        void trim_cache() noexcept;
 
     };
 
@@ -154,7 +199,7 @@ namespace Crow::Sqlite {
         void bind_null(int index);
         void bind_integer(int index, int64_t value);
         void bind_real(int index, double value);
-        void bind_string(int index, const std::string& value);
+        void bind_blob(int index, const void* ptr, size_t len, bool copy);
         void check_arg_bindings() const;
         void check_arg_count(int argc) const;
         void check_arg_index(int index) const;
@@ -180,13 +225,22 @@ namespace Crow::Sqlite {
             if constexpr (std::is_same_v<T, std::nullptr_t>)
                 bind_null(index);
             else if constexpr (std::is_same_v<T, char>)
-                bind_string(index, std::string{arg1});
+                bind_blob(index, &arg1, 1, true);
             else if constexpr (std::is_integral_v<T>)
                 bind_integer(index, int64_t(arg1));
             else if constexpr (std::is_floating_point_v<T>)
-                bind_real(index, float(arg1));
-            else if constexpr (std::is_convertible_v<T, std::string>)
-                bind_string(index, std::string(arg1));
+                bind_real(index, double(arg1));
+            else if constexpr (std::is_same_v<T, std::string_view>)
+                bind_blob(index, arg1.data(), arg1.size(), false);
+            else if constexpr (std::is_convertible_v<const T&, std::span<const std::byte>>)
+                bind_blob(index, std::span<const std::byte>(arg1).data(), std::span<const std::byte>(arg1).size(), false);
+            else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                std::string_view view(arg1);
+                bind_blob(index, view.data(), view.size(), true);
+            } else if constexpr (std::is_convertible_v<T, std::string>) {
+                std::string str(arg1);
+                bind_blob(index, str.data(), str.size(), true);
+            }
             else
                 static_assert(dependent_false<T>, "Unknown parameter type in Query::bind()");
             params_[index - 1] = true;
@@ -228,9 +282,11 @@ namespace Crow::Sqlite {
         void check_arg_count(int argc) const;
         void close() noexcept;
         template <typename T, typename... Args> void do_read(int col, T& t, Args&... args) const;
+        std::span<const std::byte> get_blob(int col) const;
         int64_t get_int(int col) const;
         double get_float(int col) const;
         std::string get_string(int col) const;
+        std::string_view get_view(int col) const;
         void next();
 
     };
@@ -241,6 +297,10 @@ namespace Crow::Sqlite {
                 t = static_cast<T>(get_int(col));
             else if constexpr (std::is_floating_point_v<T>)
                 t = static_cast<T>(get_float(col));
+            else if constexpr (std::is_same_v<T, std::string_view>)
+                t = get_view(col);
+            else if constexpr (std::is_same_v<T, std::span<const std::byte>>)
+                t = get_blob(col);
             else if constexpr (std::is_convertible_v<std::string, T>)
                 t = static_cast<T>(get_string(col));
             else
@@ -311,4 +371,117 @@ namespace Crow::Sqlite {
         Connect* con_;
     };
 
+        template <typename Range>
+        size_t Connect::insert_many(const std::string& sql, const Range& rows, Mode flags, size_t batch) {
+
+            using row_type = std::decay_t<decltype(*std::begin(rows))>;
+
+            if (has_bit(flags, ~ Mode::bulk))
+                throw InvalidArgument("Flags other than bulk cannot be used with insert_many()");
+            if (batch == 0)
+                throw InvalidArgument("Batch size for insert_many() must not be zero");
+
+            auto qry = cached_query(sql);
+            bool nested = in_transaction();
+            std::optional<bulk_state> saved;
+            if (has_bit(flags, Mode::bulk) && ! nested)
+                saved = begin_bulk();
+            auto guard = on_scope_exit([this,&saved] { if (saved) end_bulk(*saved); });
+            auto it = std::begin(rows);
+            auto end = std::end(rows);
+            size_t count = 0;
+
+            while (it != end) {
+                std::optional<Transaction> tx;
+                if (! nested)
+                    tx.emplace(*this);
+                for (size_t i = 0; i < batch && it != end; ++i, ++it, ++count) {
+                    if constexpr (is_tuple_like<row_type>)
+                        std::apply([&qry] (const auto&... args) { qry.run(args...); }, *it);
+                    else
+                        qry.run(*it);
+                }
+                if (tx)
+                    tx->commit();
+            }
+
+            return count;
+
+        }
+
+    class Pool {
+
+    public:
+
+        class lease;
+
+        explicit Pool(const std::string& file, int readers = 0, Mode flags = Mode::create);
+        ~Pool() = default;
+        Pool(const Pool&) = delete;
+        Pool(Pool&&) = delete;
+        Pool& operator=(const Pool&) = delete;
+        Pool& operator=(Pool&&) = delete;
+
+        lease read();
+        lease try_read();
+        lease write();
+        lease try_write();
+        template <typename F> void submit_read(ThreadPool& threads, F f);
+        template <typename F> void submit_write(ThreadPool& threads, F f);
+        int readers() const noexcept { return int(readers_.size()); }
+        int idle_readers() const;
+        std::string file() const { return file_; }
+
+    private:
+
+        std::string file_;
+        Connect writer_;
+        std::vector<Connect> readers_;
+        mutable std::mutex mutex_;
+        std::condition_variable read_cv_;
+        std::condition_variable write_cv_;
+        std::vector<Connect*> idle_;
+        bool writer_busy_ = false;
+
+        void release(Connect* con) noexcept;
+
+    };
+
+        class Pool::lease {
+        public:
+            lease() = default;
+            lease(const lease&) = delete;
+            lease(lease&& l) noexcept:
+                pool_(std::exchange(l.pool_, nullptr)), con_(std::exchange(l.con_, nullptr)) {}
+            ~lease() noexcept { release(); }
+            lease& operator=(const lease&) = delete;
+            lease& operator=(lease&& l) noexcept;
+            Connect& operator*() const noexcept { return *con_; }
+            Connect* operator->() const noexcept { return con_; }
+            explicit operator bool() const noexcept { return con_ != nullptr; }
+            bool is_writer() const noexcept { return con_ != nullptr && con_ == &pool_->writer_; }
+            void release() noexcept;
+        private:
+            friend class Pool;
+            Pool* pool_ = nullptr;
+            Connect* con_ = nullptr;
+            lease(Pool& pool, Connect& con) noexcept: pool_(&pool), con_(&con) {}
+        };
+
+        template <typename F>
+        void Pool::submit_read(ThreadPool& threads, F f) {
+            threads.insert([this,f] () mutable {
+                auto con = read();
+                f(*con);
+            });
+        }
+
+        template <typename F>
+        void Pool::submit_write(ThreadPool& threads, F f) {
+            threads.insert([this,f] () mutable {
+                auto con = write();
+                f(*con);
+            });
+        }
+
 }
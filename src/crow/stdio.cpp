@@ -1,12 +1,15 @@
 #include "crow/stdio.hpp"
+#include "crow/binary.hpp"
 #include "crow/unicode.hpp"
 #include <algorithm>
 #include <cerrno>
+#include <cstring>
 #include <fcntl.h>
 #include <random>
 
 #ifdef _XOPEN_SOURCE
 
+    #include <sys/mman.h>
     #include <sys/stat.h>
     #include <unistd.h>
 
@@ -71,6 +74,105 @@ namespace Crow {
         return *this;
     }
 
+    // Class Detail::InputBuffer
+
+    namespace Detail {
+
+        InputBuffer& InputBuffer::operator=(InputBuffer&& b) noexcept {
+            if (&b != this) {
+                buf_ = std::move(b.buf_);
+                cap_ = std::exchange(b.cap_, 0);
+                pos_ = std::exchange(b.pos_, 0);
+                end_ = std::exchange(b.end_, 0);
+                block_ = b.block_;
+            }
+            return *this;
+        }
+
+        size_t InputBuffer::take(void* ptr, size_t maxlen) noexcept {
+            size_t n = std::min(maxlen, available());
+            std::memcpy(ptr, buf_.get() + pos_, n);
+            pos_ += n;
+            return n;
+        }
+
+        template <typename F>
+        int InputBuffer::getc(F raw) {
+            if (pos_ == end_ && ! fill(raw))
+                return EOF;
+            return int(uint8_t(buf_[pos_++]));
+        }
+
+        template <typename F>
+        std::string InputBuffer::read_line(F raw) {
+            std::string line;
+            for (;;) {
+                if (pos_ == end_ && ! fill(raw))
+                    break;
+                auto begin = buf_.get() + pos_;
+                auto lf = static_cast<const char*>(std::memchr(begin, '\n', end_ - pos_));
+                size_t n = lf ? lf - begin + 1 : end_ - pos_;
+                line.append(begin, n);
+                pos_ += n;
+                if (lf)
+                    break;
+            }
+            return line;
+        }
+
+        template <typename F>
+        std::string_view InputBuffer::read_line_view(F raw) {
+            size_t scanned = 0;
+            for (;;) {
+                auto begin = buf_.get() + pos_;
+                size_t unscanned = end_ - pos_ - scanned;
+                // The buffer is null before the first fill
+                auto lf = unscanned == 0 ? nullptr : static_cast<const char*>(std::memchr(begin + scanned, '\n', unscanned));
+                if (lf) {
+                    std::string_view line(begin, lf - begin + 1);
+                    pos_ += line.size();
+                    return line;
+                }
+                scanned = end_ - pos_;
+                if (! fill(raw)) {
+                    // Unterminated last line
+                    std::string_view line(buf_.get() + pos_, end_ - pos_);
+                    pos_ = end_;
+                    return line;
+                }
+            }
+        }
+
+        // Append at least one more byte to the buffered data, keeping any
+        // unread data (a partial line) at the start of the buffer, and
+        // growing the buffer if a line is longer than the block size
+
+        template <typename F>
+        bool InputBuffer::fill(F raw) {
+            size_t block = std::max(block_, size_t(1));
+            size_t unread = end_ - pos_;
+            if (pos_ > 0) {
+                std::memmove(buf_.get(), buf_.get() + pos_, unread);
+                pos_ = 0;
+                end_ = unread;
+            }
+            if (cap_ - end_ < block) {
+                size_t new_cap = std::max(block, 2 * cap_);
+                while (new_cap - end_ < block)
+                    new_cap *= 2;
+                auto new_buf = std::make_unique_for_overwrite<char[]>(new_cap);
+                if (end_ > 0)
+                    std::memcpy(new_buf.get(), buf_.get(), end_);
+                buf_ = std::move(new_buf);
+                cap_ = new_cap;
+            }
+            size_t n = raw(buf_.get() + end_, cap_ - end_);
+            end_ += n;
+            return n != 0;
+        }
+
+    }
+
     // Class IoBase
 
     int IoBase::getc() {
@@ -391,6 +493,7 @@ namespace Crow {
     }
 
     void Fdio::close() {
+        ibuf_.clear();
         errno = 0;
         fd_.reset();
         check_for_error(errno);
@@ -410,14 +513,28 @@ namespace Crow {
         #endif
     }
 
+    int Fdio::getc() {
+        if (ibuf_.block() == 0)
+            return IoBase::getc();
+        return ibuf_.getc([this] (void* ptr, size_t maxlen) { return read_raw(ptr, maxlen); });
+    }
+
     size_t Fdio::read(void* ptr, size_t maxlen) {
-        errno = 0;
-        auto rc = IO_FUNCTION(read)(fd_.get(), ptr, iosize(maxlen));
-        check_for_error(errno);
-        return rc;
+        if (ibuf_.available() != 0)
+            return ibuf_.take(ptr, maxlen);
+        return read_raw(ptr, maxlen);
+    }
+
+    std::string Fdio::read_line() {
+        if (ibuf_.block() == 0)
+            return IoBase::read_line();
+        return ibuf_.read_line([this] (void* ptr, size_t maxlen) { return read_raw(ptr, maxlen); });
     }
 
     void Fdio::seek(ptrdiff_t offset, int which) {
+        if (which == SEEK_CUR)
+            offset -= ptrdiff_t(ibuf_.available());
+        ibuf_.clear();
         errno = 0;
         IO_FUNCTION(lseek)(fd_.get(), ofsize(offset), which);
         check_for_error(errno);
@@ -427,16 +544,21 @@ namespace Crow {
         errno = 0;
         auto offset = IO_FUNCTION(lseek)(fd_.get(), 0, SEEK_CUR);
         check_for_error(errno);
-        return offset;
+        return offset - ptrdiff_t(ibuf_.available());
     }
 
     size_t Fdio::write(const void* ptr, size_t len) {
+        unread();
         errno = 0;
         size_t n = IO_FUNCTION(write)(fd_.get(), ptr, iosize(len));
         check_for_error(errno);
         return n;
     }
 
+    std::string_view Fdio::read_line_view() {
+        return ibuf_.read_line_view([this] (void* ptr, size_t maxlen) { return read_raw(ptr, maxlen); });
+    }
+
     Fdio Fdio::dup() {
         errno = 0;
         int rc = IO_FUNCTION(dup)(fd_.get());
@@ -477,6 +599,25 @@ namespace Crow {
         return pair;
     }
 
+    size_t Fdio::read_raw(void* ptr, size_t maxlen) {
+        errno = 0;
+        auto rc = IO_FUNCTION(read)(fd_.get(), ptr, iosize(maxlen));
+        check_for_error(errno);
+        return rc;
+    }
+
+    // Return any read-ahead data to the file before writing, if the file
+    // is seekable; otherwise input and output are independent streams
+
+    void Fdio::unread() noexcept {
+        if (ibuf_.available() == 0)
+            return;
+        auto offset = -ofsize(ibuf_.available());
+        if (IO_FUNCTION(lseek)(fd_.get(), offset, SEEK_CUR) != -1)
+            ibuf_.clear();
+        errno = 0;
+    }
+
     #ifdef _WIN32
 
         // Class Winio
@@ -539,6 +680,7 @@ namespace Crow {
         }
 
         void Winio::close() {
+            ibuf_.clear();
             SetLastError(0);
             fh_.reset();
             check_for_error(GetLastError(), std::system_category());
@@ -549,15 +691,28 @@ namespace Crow {
                 check_for_error(GetLastError(), std::system_category());
         }
 
+        int Winio::getc() {
+            if (ibuf_.block() == 0)
+                return IoBase::getc();
+            return ibuf_.getc([this] (void* ptr, size_t maxlen) { return read_raw(ptr, maxlen); });
+        }
+
         size_t Winio::read(void* ptr, size_t maxlen) {
-            DWORD n = 0;
-            SetLastError(0);
-            ReadFile(fh_.get(), ptr, uint32_t(maxlen), &n, nullptr);
-            check_for_error(GetLastError(), std::system_category());
-            return n;
+            if (ibuf_.available() != 0)
+                return ibuf_.take(ptr, maxlen);
+            return read_raw(ptr, maxlen);
+        }
+
+        std::string Winio::read_line() {
+            if (ibuf_.block() == 0)
+                return IoBase::read_line();
+            return ibuf_.read_line([this] (void* ptr, size_t maxlen) { return read_raw(ptr, maxlen); });
         }
 
         void Winio::seek(ptrdiff_t offset, int which) {
+            if (which == SEEK_CUR)
+                offset -= ptrdiff_t(ibuf_.available());
+            ibuf_.clear();
             LARGE_INTEGER distance;
             distance.QuadPart = offset;
             DWORD method = 0;
@@ -578,10 +733,11 @@ namespace Crow {
             SetLastError(0);
             SetFilePointerEx(fh_.get(), distance, &result, FILE_CURRENT);
             check_for_error(GetLastError(), std::system_category());
-            return result.QuadPart;
+            return result.QuadPart - ptrdiff_t(ibuf_.available());
         }
 
         size_t Winio::write(const void* ptr, size_t len) {
+            unread();
             DWORD n = 0;
             SetLastError(0);
             WriteFile(fh_.get(), ptr, uint32_t(len), &n, nullptr);
@@ -589,6 +745,10 @@ namespace Crow {
             return n;
         }
 
+        std::string_view Winio::read_line_view() {
+            return ibuf_.read_line_view([this] (void* ptr, size_t maxlen) { return read_raw(ptr, maxlen); });
+        }
+
         Winio Winio::null() {
             return Winio(null_device, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING);
         }
@@ -605,8 +765,342 @@ namespace Crow {
             return Winio(GetStdHandle(STD_ERROR_HANDLE));
         }
 
+        size_t Winio::read_raw(void* ptr, size_t maxlen) {
+            DWORD n = 0;
+            SetLastError(0);
+            ReadFile(fh_.get(), ptr, uint32_t(maxlen), &n, nullptr);
+            check_for_error(GetLastError(), std::system_category());
+            return n;
+        }
+
+        void Winio::unread() noexcept {
+            if (ibuf_.available() == 0)
+                return;
+            LARGE_INTEGER distance;
+            distance.QuadPart = - ptrdiff_t(ibuf_.available());
+            if (SetFilePointerEx(fh_.get(), distance, nullptr, FILE_CURRENT))
+                ibuf_.clear();
+            SetLastError(0);
+        }
+
     #endif
 
+    // Class MappedFile
+
+    MappedFile::MappedFile(const Path& f, IoMode m, size_t window) {
+
+        if (m != IoMode::read && m != IoMode::open_existing)
+            throw IoError(std::errc::invalid_argument, "Invalid mode for mapped file: " + f.name());
+
+        writable_ = m == IoMode::open_existing;
+        window_ = window;
+
+        #ifdef _XOPEN_SOURCE
+
+            int fmode = writable_ ? O_RDWR : O_RDONLY;
+            #ifdef O_CLOEXEC
+                fmode |= O_CLOEXEC;
+            #endif
+            errno = 0;
+            fd_ = ::open(f.c_name(), fmode);
+            if (fd_ == -1)
+                throw IoError(errno, f.name());
+            open_ = true;
+            struct stat st;
+            if (::fstat(fd_, &st) != 0) {
+                int err = errno;
+                close();
+                throw IoError(err, f.name());
+            }
+            size_ = size_t(st.st_size);
+
+        #else
+
+            uint32_t access = writable_ ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+            file_ = CreateFileW(f.c_name(), access, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+            if (file_ == INVALID_HANDLE_VALUE) {
+                file_ = nullptr;
+                throw IoError(GetLastError(), f.name(), std::system_category());
+            }
+            open_ = true;
+            LARGE_INTEGER file_size;
+            if (! GetFileSizeEx(file_, &file_size)) {
+                int err = GetLastError();
+                close();
+                throw IoError(err, f.name(), std::system_category());
+            }
+            size_ = size_t(file_size.QuadPart);
+            if (size_ > 0) {
+                mapping_ = CreateFileMappingW(file_, nullptr, writable_ ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+                if (! mapping_) {
+                    int err = GetLastError();
+                    close();
+                    throw IoError(err, f.name(), std::system_category());
+                }
+            }
+
+        #endif
+
+        try {
+            remap(0, window_ == 0 ? npos : window_);
+        }
+        catch (...) {
+            close();
+            throw;
+        }
+
+    }
+
+    MappedFile::~MappedFile() noexcept {
+        try { close(); }
+        catch (...) {}
+    }
+
+    MappedFile::MappedFile(MappedFile&& mf) noexcept {
+        *this = std::move(mf);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& mf) noexcept {
+        if (&mf != this) {
+            try { close(); }
+            catch (...) {}
+            #ifdef _XOPEN_SOURCE
+                fd_ = std::exchange(mf.fd_, -1);
+            #else
+                file_ = std::exchange(mf.file_, nullptr);
+                mapping_ = std::exchange(mf.mapping_, nullptr);
+            #endif
+            map_ = std::exchange(mf.map_, nullptr);
+            map_size_ = std::exchange(mf.map_size_, 0);
+            data_ = std::exchange(mf.data_, nullptr);
+            window_offset_ = std::exchange(mf.window_offset_, 0);
+            window_size_ = std::exchange(mf.window_size_, 0);
+            window_ = std::exchange(mf.window_, 0);
+            size_ = std::exchange(mf.size_, 0);
+            pos_ = std::exchange(mf.pos_, 0);
+            hints_ = std::exchange(mf.hints_, MapHint::none);
+            open_ = std::exchange(mf.open_, false);
+            writable_ = std::exchange(mf.writable_, false);
+        }
+        return *this;
+    }
+
+    void MappedFile::close() {
+        unmap();
+        int err = 0;
+        #ifdef _XOPEN_SOURCE
+            if (fd_ != -1 && ::close(fd_) != 0)
+                err = errno;
+            fd_ = -1;
+        #else
+            if (mapping_)
+                CloseHandle(mapping_);
+            if (file_ && ! CloseHandle(file_))
+                err = GetLastError();
+            mapping_ = file_ = nullptr;
+        #endif
+        size_ = pos_ = window_offset_ = 0;
+        open_ = writable_ = false;
+        #ifdef _XOPEN_SOURCE
+            check_for_error(err);
+        #else
+            check_for_error(err, std::system_category());
+        #endif
+    }
+
+    void MappedFile::flush() {
+        if (! writable_ || ! map_)
+            return;
+        #ifdef _XOPEN_SOURCE
+            if (::msync(map_, map_size_, MS_SYNC) != 0)
+                check_for_error(errno);
+        #else
+            if (! FlushViewOfFile(map_, map_size_))
+                check_for_error(GetLastError(), std::system_category());
+            if (! FlushFileBuffers(file_))
+                check_for_error(GetLastError(), std::system_category());
+        #endif
+    }
+
+    int MappedFile::getc() {
+        if (! ensure_window(pos_))
+            return EOF;
+        return int(uint8_t(data_[pos_++ - window_offset_]));
+    }
+
+    size_t MappedFile::read(void* ptr, size_t maxlen) {
+        auto out = static_cast<std::byte*>(ptr);
+        size_t n = 0;
+        while (n < maxlen && ensure_window(pos_)) {
+            size_t offset = pos_ - window_offset_;
+            size_t len = std::min(maxlen - n, window_size_ - offset);
+            std::memcpy(out + n, data_ + offset, len);
+            n += len;
+            pos_ += len;
+        }
+        return n;
+    }
+
+    std::string MappedFile::read_line() {
+        std::string line;
+        while (ensure_window(pos_)) {
+            auto begin = reinterpret_cast<const char*>(data_) + (pos_ - window_offset_);
+            size_t avail = window_size_ - (pos_ - window_offset_);
+            auto lf = static_cast<const char*>(std::memchr(begin, '\n', avail));
+            size_t n = lf ? lf - begin + 1 : avail;
+            line.append(begin, n);
+            pos_ += n;
+            if (lf)
+                break;
+        }
+        return line;
+    }
+
+    void MappedFile::seek(ptrdiff_t offset, int which) {
+        ptrdiff_t base = 0;
+        if (which == SEEK_CUR)
+            base = ptrdiff_t(pos_);
+        else if (which == SEEK_END)
+            base = ptrdiff_t(size_);
+        if (base + offset < 0)
+            throw IoError(std::errc::invalid_argument);
+        pos_ = size_t(base + offset);
+    }
+
+    size_t MappedFile::write(const void* ptr, size_t len) {
+        if (! writable_)
+            throw IoError(std::errc::bad_file_descriptor);
+        auto in = static_cast<const std::byte*>(ptr);
+        size_t n = 0;
+        while (n < len && ensure_window(pos_)) {
+            size_t offset = pos_ - window_offset_;
+            size_t chunk = std::min(len - n, window_size_ - offset);
+            std::memcpy(data_ + offset, in + n, chunk);
+            n += chunk;
+            pos_ += chunk;
+        }
+        return n;
+    }
+
+    void MappedFile::advise(MapHint hints) {
+        if (has_bits(hints, MapHint::sequential | MapHint::random))
+            throw IoError(std::errc::invalid_argument, "Inconsistent mapped file hints");
+        hints_ = hints;
+        apply_hints();
+    }
+
+    std::span<std::byte> MappedFile::mutable_bytes() {
+        if (! writable_)
+            throw IoError(std::errc::bad_file_descriptor);
+        return {data_, window_size_};
+    }
+
+    void MappedFile::remap(size_t offset, size_t length) {
+
+        if (! open_)
+            throw IoError(std::errc::bad_file_descriptor);
+
+        offset = std::min(offset, size_);
+        length = std::min(length, size_ - offset);
+        size_t base = offset - offset % granularity();
+        size_t map_size = length + (offset - base);
+        unmap();
+
+        if (length > 0) {
+
+            #ifdef _XOPEN_SOURCE
+
+                int prot = writable_ ? PROT_READ | PROT_WRITE : PROT_READ;
+                auto ptr = ::mmap(nullptr, map_size, prot, MAP_SHARED, fd_, off_t(base));
+                if (ptr == MAP_FAILED)
+                    check_for_error(errno);
+
+            #else
+
+                auto access = writable_ ? FILE_MAP_WRITE : FILE_MAP_READ;
+                auto base64 = uint64_t(base);
+                auto ptr = MapViewOfFile(mapping_, access, DWORD(base64 >> 32), DWORD(base64), map_size);
+                if (! ptr)
+                    check_for_error(GetLastError(), std::system_category());
+
+            #endif
+
+            map_ = ptr;
+            map_size_ = map_size;
+            data_ = static_cast<std::byte*>(ptr) + (offset - base);
+
+        }
+
+        window_offset_ = offset;
+        window_size_ = length;
+        apply_hints();
+
+    }
+
+    size_t MappedFile::granularity() noexcept {
+        static const size_t size = [] {
+            #ifdef _XOPEN_SOURCE
+                return size_t(::sysconf(_SC_PAGESIZE));
+            #else
+                SYSTEM_INFO info;
+                GetSystemInfo(&info);
+                return size_t(info.dwAllocationGranularity);
+            #endif
+        }();
+        return size;
+    }
+
+    // Hints are advisory, so failures are ignored
+
+    void MappedFile::apply_hints() noexcept {
+        if (! map_)
+            return;
+        #ifdef _XOPEN_SOURCE
+            if (has_bit(hints_, MapHint::sequential))
+                ::posix_madvise(map_, map_size_, POSIX_MADV_SEQUENTIAL);
+            if (has_bit(hints_, MapHint::random))
+                ::posix_madvise(map_, map_size_, POSIX_MADV_RANDOM);
+            if (has_bit(hints_, MapHint::willneed))
+                ::posix_madvise(map_, map_size_, POSIX_MADV_WILLNEED);
+            #ifdef MADV_HUGEPAGE
+                if (has_bit(hints_, MapHint::hugepages))
+                    ::madvise(map_, map_size_, MADV_HUGEPAGE);
+            #endif
+        #else
+            if (has_bit(hints_, MapHint::willneed)) {
+                WIN32_MEMORY_RANGE_ENTRY range;
+                range.VirtualAddress = map_;
+                range.NumberOfBytes = map_size_;
+                PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+            }
+        #endif
+    }
+
+    // Make sure the byte at pos is in the current window, sliding the
+    // window if necessary; returns false at EOF
+
+    bool MappedFile::ensure_window(size_t pos) {
+        if (pos >= size_)
+            return false;
+        if (pos >= window_offset_ && pos < window_offset_ + window_size_)
+            return true;
+        remap(pos, window_ == 0 ? npos : window_);
+        return true;
+    }
+
+    void MappedFile::unmap() noexcept {
+        if (map_) {
+            #ifdef _XOPEN_SOURCE
+                ::munmap(map_, map_size_);
+            #else
+                UnmapViewOfFile(map_);
+            #endif
+        }
+        map_ = nullptr;
+        data_ = nullptr;
+        map_size_ = window_size_ = 0;
+    }
+
     // Class TempFile
 
     TempFile::TempFile() {
@@ -8,8 +8,12 @@
 #include "crow/string.hpp"
 #include "crow/types.hpp"
 #include <compare>
+#include <cstddef>
 #include <cstdio>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <system_error>
 #include <utility>
 
@@ -28,6 +32,14 @@ namespace Crow {
         open_existing
     )
 
+    CROW_ENUM_BITMASK(MapHint, int,
+        none        = 0,
+        sequential  = 1,  // Expect sequential access
+        random      = 2,  // Expect random access
+        willneed    = 4,  // Read ahead the mapped range now
+        hugepages   = 8,  // Use huge pages if possible
+    )
+
     class IoError:
     public std::system_error {
     public:
@@ -50,6 +62,57 @@ namespace Crow {
         std::string line_;
     };
 
+    template <typename IO>
+    class LineViewIterator:
+    public InputIterator<LineViewIterator<IO>, const std::string_view> {
+    public:
+        LineViewIterator() = default;
+        explicit LineViewIterator(IO& io): io_(&io), line_() { ++*this; }
+        const std::string_view& operator*() const noexcept { return line_; }
+        LineViewIterator& operator++() {
+            if (io_) {
+                line_ = io_->read_line_view();
+                if (line_.empty())
+                    io_ = nullptr;
+            }
+            return *this;
+        }
+        bool operator==(const LineViewIterator& rhs) const noexcept { return io_ == rhs.io_; }
+    private:
+        IO* io_ = nullptr;
+        std::string_view line_;
+    };
+
+    namespace Detail {
+
+        // Read buffer for unbuffered system handles. The raw read function
+        // is supplied by the owner; member templates are only instantiated
+        // in stdio.cpp.
+
+        class InputBuffer {
+        public:
+            InputBuffer() = default;
+            InputBuffer(InputBuffer&& b) noexcept { *this = std::move(b); }
+            InputBuffer& operator=(InputBuffer&& b) noexcept;
+            size_t available() const noexcept { return end_ - pos_; }
+            size_t block() const noexcept { return block_; }
+            void clear() noexcept { pos_ = end_ = 0; }
+            void set_block(size_t n) noexcept { block_ = n; }
+            size_t take(void* ptr, size_t maxlen) noexcept;
+            template <typename F> int getc(F raw);
+            template <typename F> std::string read_line(F raw);
+            template <typename F> std::string_view read_line_view(F raw);
+        private:
+            std::unique_ptr<char[]> buf_;
+            size_t cap_ = 0;
+            size_t pos_ = 0;
+            size_t end_ = 0;
+            size_t block_ = 65'536;
+            template <typename F> bool fill(F raw);
+        };
+
+    }
+
     // I/O abstract base class
 
     class IoBase {
@@ -163,12 +226,18 @@ namespace Crow {
 
         void close() override;
         void flush() override;
+        int getc() override;
         bool is_open() const override { return bool(fd_); }
         size_t read(void* ptr, size_t maxlen) override;
+        std::string read_line() override;
         void seek(ptrdiff_t offset, int which = SEEK_CUR) override;
         ptrdiff_t tell() override;
         size_t write(const void* ptr, size_t len) override;
 
+        size_t buffer_size() const noexcept { return ibuf_.block(); }
+        void set_buffer_size(size_t n) noexcept { ibuf_.set_block(n); }
+        Irange<LineViewIterator<Fdio>> lines_view() { return {LineViewIterator<Fdio>(*this), {}}; }
+        std::string_view read_line_view();
         Fdio dup();
         Fdio dup(int f);
         int get() const noexcept { return fd_.get(); }
@@ -187,6 +256,10 @@ namespace Crow {
         };
 
         Resource<int, deleter, -1> fd_;
+        Detail::InputBuffer ibuf_;
+
+        size_t read_raw(void* ptr, size_t maxlen);
+        void unread() noexcept;
 
         #ifdef _MSC_VER
             using iosize = unsigned;
@@ -222,12 +295,18 @@ namespace Crow {
 
             void close() override;
             void flush() override;
+            int getc() override;
             bool is_open() const override { return bool(fh_); }
             size_t read(void* ptr, size_t maxlen) override;
+            std::string read_line() override;
             void seek(ptrdiff_t offset, int which = SEEK_CUR) override;
             ptrdiff_t tell() override;
             size_t write(const void* ptr, size_t len) override;
 
+            size_t buffer_size() const noexcept { return ibuf_.block(); }
+            void set_buffer_size(size_t n) noexcept { ibuf_.set_block(n); }
+            Irange<LineViewIterator<Winio>> lines_view() { return {LineViewIterator<Winio>(*this), {}}; }
+            std::string_view read_line_view();
             void* get() const noexcept { return fh_.get(); }
             void* release() noexcept { return fh_.release(); }
 
@@ -243,11 +322,81 @@ namespace Crow {
             };
 
             Resource<void*, deleter> fh_;
+            Detail::InputBuffer ibuf_;
+
+            size_t read_raw(void* ptr, size_t maxlen);
+            void unread() noexcept;
 
         };
 
     #endif
 
+    // Memory mapped file
+
+    class MappedFile:
+    public IoBase {
+
+    public:
+
+        MappedFile() = default;
+        explicit MappedFile(const Path& f, IoMode m = IoMode::read, size_t window = 0);
+        ~MappedFile() noexcept override;
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile(MappedFile&& mf) noexcept;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile& operator=(MappedFile&& mf) noexcept;
+
+        void close() override;
+        void flush() override;
+        int getc() override;
+        bool is_open() const override { return open_; }
+        size_t read(void* ptr, size_t maxlen) override;
+        std::string read_line() override;
+        void seek(ptrdiff_t offset, int which = SEEK_CUR) override;
+        ptrdiff_t tell() override { return ptrdiff_t(pos_); }
+        size_t write(const void* ptr, size_t len) override;
+
+        void advise(MapHint hints);
+        std::span<const std::byte> bytes() const noexcept { return {data_, window_size_}; }
+        std::span<std::byte> mutable_bytes();
+        bool is_writable() const noexcept { return writable_; }
+        void remap(size_t offset, size_t length = npos);
+        size_t size() const noexcept { return size_; }
+        std::string_view view() const noexcept { return {reinterpret_cast<const char*>(data_), window_size_}; }
+        size_t window() const noexcept { return window_; }
+        size_t window_offset() const noexcept { return window_offset_; }
+        size_t window_size() const noexcept { return window_size_; }
+
+        static size_t granularity() noexcept;
+
+    private:
+
+        #ifdef _XOPEN_SOURCE
+            int fd_ = -1;
+        #else
+            void* file_ = nullptr;
+            void* mapping_ = nullptr;
+        #endif
+
+        void* map_ = nullptr;           // Start of the actual mapping (aligned)
+        size_t map_size_ = 0;           // Length of the actual mapping
+        std::byte* data_ = nullptr;     // Start of the requested window
+        size_t window_offset_ = 0;      // File offset of the window
+        size_t window_size_ = 0;        // Length of the window
+        size_t window_ = 0;             // Default window length (0 = whole file)
+        size_t size_ = 0;               // File size
+        size_t pos_ = 0;                // Current position for IoBase functions
+        MapHint hints_ = MapHint::none;
+        bool open_ = false;
+        bool writable_ = false;
+
+        void apply_hints() noexcept;
+        bool ensure_window(size_t pos);
+        void unmap() noexcept;
+
+    };
+
     // Temporary file
 
     class TempFile:
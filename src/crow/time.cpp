@@ -1,11 +1,14 @@
 #include "crow/time.hpp"
 #include "crow/binary.hpp"
 #include <algorithm>
+#include <climits>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <stdexcept>
-#include <unordered_set>
+#include <string_view>
+#include <unordered_map>
 
 #ifdef _WIN32
     #include <windows.h>
@@ -19,6 +22,161 @@ using namespace std::chrono;
 
 namespace Crow {
 
+    namespace {
+
+        constexpr int64_t ns_per_sec = 1'000'000'000;
+
+        constexpr int64_t powers_of_10[] = {
+            1, 10, 100, 1'000, 10'000, 100'000, 1'000'000, 10'000'000, 100'000'000, 1'000'000'000,
+        };
+
+        int64_t floor_div(int64_t x, int64_t y) noexcept {
+            auto q = x / y;
+            if (x % y < 0)
+                --q;
+            return q;
+        }
+
+        // Broken down time, without going through std::tm except to find
+        // the local time zone offset
+
+        struct civil_time {
+            int64_t year = 1970;
+            int month = 1;
+            int day = 1;
+            int hour = 0;
+            int min = 0;
+            int sec = 0;
+            int wday = 4;    // 0 = Sunday
+            int offset = 0;  // Seconds east of UTC
+        };
+
+        civil_time make_civil(int64_t t, bool local) noexcept {
+
+            civil_time ct;
+            int64_t lt = t;
+
+            if (local) {
+
+                auto tt = std::time_t(t);
+                std::tm tm;
+
+                #ifdef _WIN32
+                    bool ok = localtime_s(&tm, &tt) == 0;
+                #else
+                    bool ok = localtime_r(&tt, &tm) != nullptr;
+                #endif
+
+                if (ok) {
+                    lt = 86'400 * Detail::days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday)
+                        + 3'600 * tm.tm_hour + 60 * tm.tm_min + tm.tm_sec;
+                    ct.offset = int(lt - t);
+                }
+
+            }
+
+            int64_t days = floor_div(lt, 86'400);
+            int64_t secs = lt - 86'400 * days;
+            Detail::civil_from_days(days, ct.year, ct.month, ct.day);
+            ct.hour = int(secs / 3'600);
+            ct.min = int(secs / 60 % 60);
+            ct.sec = int(secs % 60);
+            ct.wday = int((days % 7 + 11) % 7);
+
+            return ct;
+
+        }
+
+        void append_number(std::string& str, int64_t n, int width) {
+            char buf[24];
+            auto end = buf + sizeof(buf);
+            auto ptr = end;
+            auto u = n < 0 ? - uint64_t(n) : uint64_t(n);
+            do {
+                *--ptr = char('0' + u % 10);
+                u /= 10;
+            } while (u != 0);
+            while (end - ptr < width)
+                *--ptr = '0';
+            if (n < 0)
+                *--ptr = '-';
+            str.append(ptr, end);
+        }
+
+        void append_fraction(std::string& str, int64_t frac, int prec) {
+            append_number(str, frac, std::min(prec, 9));
+            if (prec > 9)
+                str.append(prec - 9, '0');
+        }
+
+        // Formatting the same second over and over is the common case (log
+        // timestamps), so each thread keeps the last second it formatted in
+        // each time zone
+
+        struct time_cache {
+            int64_t sec = std::numeric_limits<int64_t>::min();
+            civil_time civil;
+            std::string iso;  // yyyy-mm-dd HH:MM:SS
+        };
+
+        const time_cache& cached_time(int64_t t, bool local) {
+
+            thread_local time_cache caches[2];
+            auto& c = caches[int(local)];
+
+            if (c.sec != t) {
+                auto& ct = c.civil = make_civil(t, local);
+                c.iso.clear();
+                append_number(c.iso, ct.year, 4);
+                c.iso += '-';
+                append_number(c.iso, ct.month, 2);
+                c.iso += '-';
+                append_number(c.iso, ct.day, 2);
+                c.iso += ' ';
+                append_number(c.iso, ct.hour, 2);
+                c.iso += ':';
+                append_number(c.iso, ct.min, 2);
+                c.iso += ':';
+                append_number(c.iso, ct.sec, 2);
+                c.sec = t;
+            }
+
+            return c;
+
+        }
+
+        // Splits a time point into whole seconds and a fraction in units of
+        // 10^-prec. The fraction is rounded to nearest, carrying into the
+        // seconds if necessary; with no decimal places the seconds are just
+        // truncated.
+
+        void split_time(system_clock::time_point tp, int prec, int64_t& sec, int64_t& frac) noexcept {
+            auto ns = duration_cast<nanoseconds>(tp.time_since_epoch()).count();
+            sec = floor_div(ns, ns_per_sec);
+            frac = 0;
+            if (prec <= 0)
+                return;
+            int digits = std::min(prec, 9);
+            int64_t unit = powers_of_10[9 - digits];
+            frac = (ns - sec * ns_per_sec + unit / 2) / unit;
+            if (frac == powers_of_10[digits]) {
+                ++sec;
+                frac = 0;
+            }
+        }
+
+        system_clock::time_point make_utc_date(int64_t year, int64_t month, int64_t day,
+                int64_t hour, int64_t min, int64_t sec, int64_t ns) noexcept {
+            int64_t years = floor_div(month - 1, 12);
+            year += years;
+            month -= 12 * years;
+            int64_t days = Detail::days_from_civil(year, int(month), 1) + day - 1;
+            int64_t t = 86'400 * days + 3'600 * hour + 60 * min + sec;
+            return system_clock::time_point(duration_cast<system_clock::duration>(seconds(t) + nanoseconds(ns)));
+        }
+
+    }
+
     // Utility functions
 
     system_clock::time_point make_date(int year, int month, int day, int hour, int min, double sec, DT flags) {
@@ -40,6 +198,11 @@ namespace Crow {
             fsec += 1;
         }
 
+        system_clock::time_point::rep extra(int64_t(fsec * system_clock::time_point::duration(seconds(1)).count()));
+
+        if (zone != DT::local)
+            return make_utc_date(year, month, day, hour, min, int64_t(isec), 0) + system_clock::time_point::duration(extra);
+
         std::tm tm;
         std::memset(&tm, 0, sizeof(tm));
         tm.tm_sec = int(isec);
@@ -55,18 +218,7 @@ namespace Crow {
             default:        tm.tm_isdst = -1; break;
         }
 
-        time_t t;
-
-        if (zone == DT::local)
-            t = std::mktime(&tm);
-        else
-            #ifdef _XOPEN_SOURCE
-                t = timegm(&tm);
-            #else
-                t = _mkgmtime(&tm);
-            #endif
-
-        system_clock::time_point::rep extra(int64_t(fsec * system_clock::time_point::duration(seconds(1)).count()));
+        auto t = std::mktime(&tm);
 
         return system_clock::from_time_t(t) + system_clock::time_point::duration(extra);
 
@@ -75,11 +227,28 @@ namespace Crow {
     // Date formatting
 
     DateFormatter::DateFormatter(const std::string& format, DT flags):
-    expanded_(), flags_(flags) {
-
-        static const std::unordered_set<std::string> valid_codes = {
-            "yy", "yyyy", "m", "mm", "mmm", "Mmm", "MMM", "d", "dd", "www", "Www", "WWW",
-            "H", "HH", "M", "MM", "S", "SS", "ZZZZ"
+    elements_(), flags_(flags) {
+
+        static const std::unordered_map<std::string, field> codes = {
+            { "yyyy",  field::year },
+            { "yy",    field::year2 },
+            { "m",     field::month },
+            { "mm",    field::month2 },
+            { "mmm",   field::month_lower },
+            { "Mmm",   field::month_title },
+            { "MMM",   field::month_upper },
+            { "d",     field::day },
+            { "dd",    field::day2 },
+            { "www",   field::weekday_lower },
+            { "Www",   field::weekday_title },
+            { "WWW",   field::weekday_upper },
+            { "H",     field::hour },
+            { "HH",    field::hour2 },
+            { "M",     field::minute },
+            { "MM",    field::minute2 },
+            { "S",     field::second },
+            { "SS",    field::second2 },
+            { "ZZZZ",  field::zone },
         };
 
         for (auto i = format.begin(), end = format.end(); i != end;) {
@@ -87,16 +256,26 @@ namespace Crow {
             auto j = std::find_if(i, format.end(), ascii_isalnum);
 
             if (j != i)
-                expanded_.emplace_back(i, j);
+                elements_.push_back({field::literal, std::string(i, j)});
+
+            if (j == end)
+                break;
 
             char initial = ascii_toupper(*j);
             i = std::find_if(j, end, [initial] (char c) { return ascii_toupper(c) != initial; });
             std::string code(j, i);
 
-            if (code[0] != 's' && valid_codes.count(code) == 0)
-                throw std::invalid_argument("Invalid date format: " + quote(format));
-
-            expanded_.push_back(code);
+            if (code[0] == 's') {
+                if (code.find_first_not_of('s') != npos)
+                    throw std::invalid_argument("Invalid date format: " + quote(format));
+                prec_ = std::max(prec_, int(code.size()));
+                elements_.push_back({field::fraction, code});
+            } else {
+                auto it = codes.find(code);
+                if (it == codes.end())
+                    throw std::invalid_argument("Invalid date format: " + quote(format));
+                elements_.push_back({it->second, {}});
+            }
 
         }
 
@@ -118,58 +297,65 @@ namespace Crow {
             "sun", "mon", "tue", "wed", "thu", "fri", "sat",
         };
 
-        static const auto fraction_str = [] (double x, size_t len) {
-            x *= std::pow(10.0, double(len));
-            auto str = std::to_string(std::llround(x));
-            return pad_left(str, len, '0');
+        static const auto append_name = [] (std::string& str, const char* name, int mode) {
+            size_t pos = str.size();
+            str += name;
+            if (mode >= 1)
+                str[pos] = ascii_toupper(str[pos]);
+            if (mode == 2)
+                for (size_t i = pos + 1; i < str.size(); ++i)
+                    str[i] = ascii_toupper(str[i]);
         };
 
-        static const auto zone_offset = [] (std::tm& tm) {
-            std::string buf(10, '\0');
-            size_t n = std::strftime(buf.data(), buf.size(), "%z", &tm);
-            buf.resize(n);
-            return buf;
-        };
-
-        std::time_t tt = system_clock::to_time_t(tp);
-        auto diff = tp - system_clock::from_time_t(tt);
-
-        if (diff.count() < 0) {
-            --tt;
-            diff += 1s;
-        }
+        bool local = has_bit(flags_, DT::local);
+        int64_t isec = 0, frac = 0;
+        split_time(tp, prec_, isec, frac);
+        auto& ct = cached_time(isec, local).civil;
+        std::string result;
 
-        double fraction = duration_cast<duration<double>>(diff).count();
-        std::tm tm;
+        for (auto& e: elements_) {
+
+            switch (e.kind) {
+
+                case field::literal:        result += e.text; break;
+                case field::year:           append_number(result, ct.year, 1); break;
+                case field::year2:          append_number(result, (ct.year % 100 + 100) % 100, 2); break;
+                case field::month:          append_number(result, ct.month, 1); break;
+                case field::month2:         append_number(result, ct.month, 2); break;
+                case field::month_lower:    append_name(result, month_name[ct.month - 1], 0); break;
+                case field::month_title:    append_name(result, month_name[ct.month - 1], 1); break;
+                case field::month_upper:    append_name(result, month_name[ct.month - 1], 2); break;
+                case field::day:            append_number(result, ct.day, 1); break;
+                case field::day2:           append_number(result, ct.day, 2); break;
+                case field::weekday_lower:  append_name(result, weekday_name[ct.wday], 0); break;
+                case field::weekday_title:  append_name(result, weekday_name[ct.wday], 1); break;
+                case field::weekday_upper:  append_name(result, weekday_name[ct.wday], 2); break;
+                case field::hour:           append_number(result, ct.hour, 1); break;
+                case field::hour2:          append_number(result, ct.hour, 2); break;
+                case field::minute:         append_number(result, ct.min, 1); break;
+                case field::minute2:        append_number(result, ct.min, 2); break;
+                case field::second:         append_number(result, ct.sec, 1); break;
+                case field::second2:        append_number(result, ct.sec, 2); break;
+
+                case field::fraction: {
+                    int len = int(e.text.size());
+                    int64_t f = frac;
+                    if (len < 9 && len < prec_)
+                        f /= powers_of_10[std::min(prec_, 9) - len];
+                    append_fraction(result, f, len);
+                    break;
+                }
 
-        if (has_bit(flags_, DT::local))
-            tm = *std::localtime(&tt);
-        else
-            tm = *std::gmtime(&tt);
+                case field::zone: {
+                    int offset = std::abs(ct.offset);
+                    result += ct.offset < 0 ? '-' : '+';
+                    append_number(result, offset / 3'600, 2);
+                    append_number(result, offset / 60 % 60, 2);
+                    break;
+                }
 
-        std::string result;
+            }
 
-        for (auto& code: expanded_) {
-
-            if (! ascii_isalnum(code[0]))  result += code;
-            else if (code == "yyyy")       result += std::to_string(tm.tm_year + 1900);
-            else if (code == "yy")         result += format_integer(tm.tm_year % 100, "n2");
-            else if (code == "m")          result += std::to_string(tm.tm_mon + 1);
-            else if (code == "mm")         result += format_integer(tm.tm_mon + 1, "n2");
-            else if (code == "mmm")        result += month_name[tm.tm_mon];
-            else if (code == "Mmm")        result += ascii_titlecase(month_name[tm.tm_mon]);
-            else if (code == "MMM")        result += ascii_uppercase(month_name[tm.tm_mon]);
-            else if (code == "d")          result += std::to_string(tm.tm_mday);
-            else if (code == "dd")         result += format_integer(tm.tm_mday, "n2");
-            else if (code == "www")        result += weekday_name[tm.tm_wday];
-            else if (code == "Www")        result += ascii_titlecase(weekday_name[tm.tm_wday]);
-            else if (code == "WWW")        result += ascii_uppercase(weekday_name[tm.tm_wday]);
-            else if (code == "H")          result += std::to_string(tm.tm_hour);
-            else if (code == "HH")         result += format_integer(tm.tm_hour, "n2");
-            else if (code == "MM")         result += format_integer(tm.tm_min, "n2");
-            else if (code == "SS")         result += format_integer(tm.tm_sec, "n2");
-            else if (code[0] == 's')       result += fraction_str(fraction, code.size());
-            else if (code == "ZZZZ")       result += has_bit(flags_, DT::local) ? zone_offset(tm) : "+0000";
         }
 
         return result;
@@ -186,19 +372,16 @@ namespace Crow {
         if (zone != DT::none && zone != DT::utc && zone != DT::local)
             throw std::invalid_argument("Invalid date flags: 0x" + format_integer(int(flags), "x"));
 
-        auto t = system_clock::to_time_t(tp);
-        std::tm tm = zone == DT::local ? *localtime(&t) : *gmtime(&t);
-        std::string result(30, '\0');
-        auto rc = strftime(&result[0], result.size(), "%Y-%m-%d %H:%M:%S", &tm);
-        result.resize(rc);
+        int64_t isec = 0, frac = 0;
+        split_time(tp, prec, isec, frac);
+        auto& prefix = cached_time(isec, zone == DT::local).iso;
+        std::string result;
+        result.reserve(prefix.size() + (prec > 0 ? size_t(prec) + 1 : 0));
+        result = prefix;
 
         if (prec > 0) {
-            double sec = duration_cast<duration<double>>(tp.time_since_epoch()).count();
-            double isec = 0;
-            double fsec = std::modf(sec, &isec);
-            std::string buf(prec + 3, '\0');
-            snprintf(&buf[0], buf.size(), "%.*f", prec, fsec);
-            result += buf.data() + 1;
+            result += '.';
+            append_fraction(result, frac, prec);
         }
 
         return result;
@@ -312,30 +495,51 @@ namespace Crow {
 
         bool date_read_number(const char*& ptr, const char* end, int& result) {
             date_skip_punct(ptr, end);
-            auto next = std::find_if_not(ptr, end, ascii_isdigit);
-            if (next == ptr)
+            if (ptr == end || ! ascii_isdigit(*ptr))
                 return false;
-            std::string sub(ptr, next);
-            char* dummy = nullptr;
-            result = int(std::strtoul(sub.data(), &dummy, 10));
-            ptr = next;
+            int64_t n = 0;
+            for (; ptr != end && ascii_isdigit(*ptr); ++ptr)
+                n = std::min(10 * n + (*ptr - '0'), int64_t(INT_MAX));
+            result = int(n);
             return true;
         };
 
-        bool date_read_number(const char*& ptr, const char* end, double& result) {
-            date_skip_punct(ptr, end);
-            if (ptr == end || ! ascii_isdigit(*ptr))
+        // Reads up to 9 decimal places exactly, ignoring any more
+
+        void date_read_fraction(const char*& ptr, const char* end, int64_t& ns) {
+            ns = 0;
+            int digits = 0;
+            for (; ptr != end && ascii_isdigit(*ptr); ++ptr) {
+                if (digits < 9) {
+                    ns = 10 * ns + (*ptr - '0');
+                    ++digits;
+                }
+            }
+            ns *= powers_of_10[9 - digits];
+        }
+
+        bool date_read_seconds(const char*& ptr, const char* end, int& sec, int64_t& ns) {
+            if (! date_read_number(ptr, end, sec))
                 return false;
-            auto next = std::find_if_not(ptr, end, ascii_isdigit);
-            if (next != end && *next == '.')
-                next = std::find_if_not(next + 1, end, ascii_isdigit);
-            std::string sub(ptr, next);
-            char* dummy = nullptr;
-            result = std::strtod(sub.data(), &dummy);
-            ptr = next;
+            if (ptr != end && *ptr == '.') {
+                ++ptr;
+                date_read_fraction(ptr, end, ns);
+            }
             return true;
         };
 
+        bool read_digits(const char*& ptr, const char* end, int n, int& result) noexcept {
+            if (end - ptr < n)
+                return false;
+            result = 0;
+            for (int i = 0; i < n; ++i, ++ptr) {
+                if (! ascii_isdigit(*ptr))
+                    return false;
+                result = 10 * result + (*ptr - '0');
+            }
+            return true;
+        }
+
         bool date_read_month(const char*& ptr, const char* end, int& result) {
 
             date_skip_punct(ptr, end);
@@ -370,6 +574,82 @@ namespace Crow {
 
         };
 
+        // Strict ISO 8601 extended format, the common case:
+        // yyyy-mm-dd[(T| )HH:MM[:SS[(.|,)fff]]][Z|(+|-)HH[[:]MM]]
+        // Returns false if the string doesn't match, so the caller can fall
+        // back on the general parser.
+
+        bool parse_iso_date(std::string_view str, DT zone, DT dst, system_clock::time_point& tp) {
+
+            auto ptr = str.data();
+            auto end = ptr + str.size();
+            int year = 0, month = 0, day = 0, hour = 0, min = 0, sec = 0;
+            int64_t ns = 0;
+
+            if (! read_digits(ptr, end, 4, year) || ptr == end || *ptr++ != '-'
+                    || ! read_digits(ptr, end, 2, month) || ptr == end || *ptr++ != '-'
+                    || ! read_digits(ptr, end, 2, day))
+                return false;
+
+            if (ptr != end && (*ptr == 'T' || *ptr == 't' || *ptr == ' ')) {
+
+                ++ptr;
+
+                if (! read_digits(ptr, end, 2, hour) || ptr == end || *ptr++ != ':' || ! read_digits(ptr, end, 2, min))
+                    return false;
+
+                if (ptr != end && *ptr == ':') {
+                    ++ptr;
+                    if (! read_digits(ptr, end, 2, sec))
+                        return false;
+                    if (ptr != end && (*ptr == '.' || *ptr == ',')) {
+                        ++ptr;
+                        if (ptr == end || ! ascii_isdigit(*ptr))
+                            return false;
+                        date_read_fraction(ptr, end, ns);
+                    }
+                }
+
+            }
+
+            int offset = 0;
+            bool has_zone = false;
+
+            if (ptr != end) {
+
+                if (*ptr == 'Z' || *ptr == 'z') {
+                    ++ptr;
+                } else if (*ptr == '+' || *ptr == '-') {
+                    int sign = *ptr++ == '-' ? -1 : 1;
+                    int oh = 0, om = 0;
+                    if (! read_digits(ptr, end, 2, oh))
+                        return false;
+                    if (ptr != end && *ptr == ':')
+                        ++ptr;
+                    if (ptr != end && ! read_digits(ptr, end, 2, om))
+                        return false;
+                    offset = sign * (3'600 * oh + 60 * om);
+                } else {
+                    return false;
+                }
+
+                if (ptr != end)
+                    return false;
+
+                has_zone = true;
+
+            }
+
+            if (has_zone || zone != DT::local)
+                tp = make_utc_date(year, month, day, hour, min, sec, ns) - seconds(offset);
+            else
+                tp = make_date(year, month, day, hour, min, sec, dst | zone)
+                    + duration_cast<system_clock::duration>(nanoseconds(ns));
+
+            return true;
+
+        }
+
     }
 
     system_clock::time_point parse_date(const std::string& str, DT flags) {
@@ -389,8 +669,13 @@ namespace Crow {
                 throw std::invalid_argument("Invalid date flags: 0x" + format_integer(int(flags), "x"));
         }
 
-        int year = 0, month = 0, day = 0, hour = 0, min = 0;
-        double sec = 0;
+        system_clock::time_point tp;
+
+        if (order != DT::dmy_order && order != DT::mdy_order && parse_iso_date(str, zone, dst, tp))
+            return tp;
+
+        int year = 0, month = 0, day = 0, hour = 0, min = 0, sec = 0;
+        int64_t ns = 0;
         auto ptr = str.data();
         auto end = ptr + str.size();
         bool ok = true;
@@ -417,9 +702,13 @@ namespace Crow {
 
         date_read_number(ptr, end, hour);
         date_read_number(ptr, end, min);
-        date_read_number(ptr, end, sec);
+        date_read_seconds(ptr, end, sec, ns);
 
-        return make_date(year, month, day, hour, min, sec, dst | zone);
+        if (zone == DT::local)
+            return make_date(year, month, day, hour, min, sec, dst | zone)
+                + duration_cast<system_clock::duration>(nanoseconds(ns));
+        else
+            return make_utc_date(year, month, day, hour, min, sec, ns);
 
     }
 
@@ -39,6 +39,36 @@ namespace Crow {
         local      = 1 << 7,
     )
 
+    // Calendar arithmetic
+
+    namespace Detail {
+
+        // Proleptic Gregorian calendar, counting days from 1970-01-01
+        // (Howard Hinnant, "chrono-Compatible Low-Level Date Algorithms")
+
+        constexpr int64_t days_from_civil(int64_t year, int month, int day) noexcept {
+            year -= month <= 2;
+            int64_t era = (year >= 0 ? year : year - 399) / 400;
+            int64_t yoe = year - era * 400;
+            int64_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+            int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+            return era * 146'097 + doe - 719'468;
+        }
+
+        constexpr void civil_from_days(int64_t days, int64_t& year, int& month, int& day) noexcept {
+            days += 719'468;
+            int64_t era = (days >= 0 ? days : days - 146'096) / 146'097;
+            int64_t doe = days - era * 146'097;
+            int64_t yoe = (doe - doe / 1'460 + doe / 36'524 - doe / 146'096) / 365;
+            int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+            int64_t mp = (5 * doy + 2) / 153;
+            day = int(doy - (153 * mp + 2) / 5 + 1);
+            month = int(mp < 10 ? mp + 3 : mp - 9);
+            year = yoe + era * 400 + (month <= 2);
+        }
+
+    }
+
     // Utility functions
 
     std::chrono::system_clock::time_point make_date(int year, int month, int day,
@@ -52,7 +82,17 @@ namespace Crow {
         explicit DateFormatter(const std::string& format, DT flags = DT::utc);
         std::string operator()(std::chrono::system_clock::time_point tp) const;
     private:
-        std::vector<std::string> expanded_;
+        enum class field: int {
+            literal, year, year2, month, month2, month_lower, month_title, month_upper, day, day2,
+            weekday_lower, weekday_title, weekday_upper, hour, hour2, minute, minute2, second, second2,
+            fraction, zone,
+        };
+        struct element {
+            field kind;
+            std::string text;
+        };
+        std::vector<element> elements_;
+        int prec_ = 0;
         DT flags_ = DT::utc;
     };
 
@@ -2,9 +2,9 @@
 #include "crow/format.hpp"
 #include "crow/regex.hpp"
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <stdexcept>
-#include <stdexcept>
 
 using namespace Crow::Literals;
 
@@ -22,6 +22,177 @@ namespace Crow {
             return h;
         }
 
+        // Offsets of the URI elements, as stored in the Uri class
+
+        struct UriOffsets {
+            size_t user = 0;
+            size_t password = 0;
+            size_t host = 0;
+            size_t port = 0;
+            size_t path = 0;
+            size_t query = 0;
+            size_t fragment = 0;
+        };
+
+        // The parsing functions below reproduce the result of matching this
+        // regex (including its backtracking behaviour), in a single pass
+        // with no allocation:
+        //
+        //     ([a-z][a-z0-9+.-]*:(?://)?)     # scheme
+        //     (?:
+        //         (?:
+        //             ([^/:@]+)                # user
+        //             ([^/@]*@)                # password
+        //         )?
+        //         ([^/:@]+)                    # host
+        //         (:\d+)?                      # port
+        //     )?
+        //     (/[^#?]*)?                       # path
+        //     (\?[^#]*)?                       # query
+        //     (\#.*)?                          # fragment
+
+        bool is_scheme_char(char c) noexcept {
+            return ascii_isalnum(c) || c == '+' || c == '-' || c == '.';
+        }
+
+        // [/path][?query][#fragment], which can match anything that is
+        // empty or starts with one of the three delimiters
+
+        bool parse_uri_tail(std::string_view s, size_t pos, UriOffsets& ofs) noexcept {
+            size_t n = s.size();
+            if (pos < n && s[pos] != '/' && s[pos] != '?' && s[pos] != '#')
+                return false;
+            ofs.path = pos;
+            if (pos < n && s[pos] == '/')
+                pos = std::min(s.find_first_of("?#", pos), n);
+            ofs.query = pos;
+            if (pos < n && s[pos] == '?')
+                pos = std::min(s.find('#', pos), n);
+            ofs.fragment = pos;
+            return true;
+        }
+
+        // host[:port] followed by the tail. The host is greedy but can
+        // include '?' and '#', so if the continuation fails, the regex would
+        // backtrack to the last of those and treat the rest as query or
+        // fragment.
+
+        bool parse_uri_host(std::string_view s, size_t pos, UriOffsets& ofs) noexcept {
+
+            size_t n = s.size();
+            size_t end = std::min(s.find_first_of("/:@", pos), n);
+
+            if (end == pos)
+                return false;
+
+            ofs.host = pos;
+
+            if (end < n && s[end] == ':') {
+                size_t digits = end + 1;
+                while (digits < n && ascii_isdigit(s[digits]))
+                    ++digits;
+                if (digits > end + 1 && parse_uri_tail(s, digits, ofs)) {
+                    ofs.port = end;
+                    return true;
+                }
+            } else if (parse_uri_tail(s, end, ofs)) {
+                ofs.port = end;
+                return true;
+            }
+
+            for (size_t i = end - 1; i > pos; --i) {
+                if (s[i] == '?' || s[i] == '#') {
+                    ofs.port = i;
+                    return parse_uri_tail(s, i, ofs);
+                }
+            }
+
+            return false;
+
+        }
+
+        // Everything after the scheme
+
+        bool parse_uri_authority(std::string_view s, size_t pos, UriOffsets& ofs) noexcept {
+
+            size_t n = s.size();
+            ofs.user = pos;
+
+            // user[:password]@
+
+            size_t user_end = std::min(s.find_first_of("/:@", pos), n);
+
+            if (user_end > pos && user_end < n && s[user_end] != '/') {
+                size_t at = s.find_first_of("/@", user_end);
+                if (at < n && s[at] == '@') {
+                    ofs.password = user_end;
+                    if (parse_uri_host(s, at + 1, ofs))
+                        return true;
+                }
+            }
+
+            ofs.password = pos;
+
+            if (parse_uri_host(s, pos, ofs))
+                return true;
+
+            ofs.host = ofs.port = pos;
+
+            return parse_uri_tail(s, pos, ofs);
+
+        }
+
+        bool parse_uri(std::string_view s, UriOffsets& ofs) noexcept {
+
+            if (s.empty() || ! ascii_isalpha(s[0]))
+                return false;
+
+            size_t pos = 1;
+            while (pos < s.size() && is_scheme_char(s[pos]))
+                ++pos;
+
+            if (pos == s.size() || s[pos] != ':')
+                return false;
+
+            ++pos;
+
+            // If the authority fails to parse after "//", the regex would
+            // backtrack and take the slashes as the start of the path
+
+            if (s.substr(pos, 2) == "//" && parse_uri_authority(s, pos + 2, ofs))
+                return true;
+
+            return parse_uri_authority(s, pos, ofs);
+
+        }
+
+        int hex_digit_value(char c) noexcept {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            else if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+            else
+                return -1;
+        }
+
+        uint16_t default_port(std::string_view scheme) noexcept {
+            if (scheme == "http" || scheme == "ws")
+                return 80;
+            else if (scheme == "https" || scheme == "wss")
+                return 443;
+            else if (scheme == "ftp")
+                return 21;
+            else
+                return 0;
+        }
+
+        void lowercase_range(std::string& s, size_t pos, size_t end) noexcept {
+            for (; pos < end; ++pos)
+                s[pos] = ascii_tolower(s[pos]);
+        }
+
     }
 
     Uri::Uri(std::string_view s) {
@@ -44,19 +215,19 @@ namespace Crow {
     }
 
     std::string Uri::scheme() const {
-        return empty() ? std::string() : ascii_lowercase(text_.substr(0, ofs_user_ - (has_slashes() ? 3 : 1)));
+        return ascii_lowercase(scheme_view());
     }
 
     std::string Uri::user() const {
-        return decode(text_.substr(ofs_user_, ofs_password_ - ofs_user_));
+        return decode(user_view());
     }
 
     std::string Uri::password() const {
-        return has_password() ? decode(text_.substr(ofs_password_ + 1, ofs_host_ - ofs_password_ - 2)) : std::string();
+        return decode(password_view());
     }
 
     std::string Uri::host() const {
-        return decode(text_.substr(ofs_host_, ofs_port_ - ofs_host_));
+        return decode(host_view());
     }
 
     uint16_t Uri::port() const noexcept {
@@ -64,15 +235,43 @@ namespace Crow {
     }
 
     std::string Uri::path() const {
-        return decode(text_.substr(ofs_path_, ofs_query_ - ofs_path_));
+        return decode(path_view());
     }
 
     std::string Uri::query() const {
-        return has_query() ? decode(text_.substr(ofs_query_ + 1, ofs_fragment_ - ofs_query_ - 1)) : std::string();
+        return decode(query_view());
     }
 
     std::string Uri::fragment() const {
-        return has_fragment() ? decode(text_.substr(ofs_fragment_ + 1, npos)) : std::string();
+        return decode(fragment_view());
+    }
+
+    std::string_view Uri::scheme_view() const noexcept {
+        return empty() ? std::string_view() : std::string_view(text_).substr(0, ofs_user_ - (has_slashes() ? 3 : 1));
+    }
+
+    std::string_view Uri::user_view() const noexcept {
+        return std::string_view(text_).substr(ofs_user_, ofs_password_ - ofs_user_);
+    }
+
+    std::string_view Uri::password_view() const noexcept {
+        return has_password() ? std::string_view(text_).substr(ofs_password_ + 1, ofs_host_ - ofs_password_ - 2) : std::string_view();
+    }
+
+    std::string_view Uri::host_view() const noexcept {
+        return std::string_view(text_).substr(ofs_host_, ofs_port_ - ofs_host_);
+    }
+
+    std::string_view Uri::path_view() const noexcept {
+        return std::string_view(text_).substr(ofs_path_, ofs_query_ - ofs_path_);
+    }
+
+    std::string_view Uri::query_view() const noexcept {
+        return has_query() ? std::string_view(text_).substr(ofs_query_ + 1, ofs_fragment_ - ofs_query_ - 1) : std::string_view();
+    }
+
+    std::string_view Uri::fragment_view() const noexcept {
+        return has_fragment() ? std::string_view(text_).substr(ofs_fragment_ + 1) : std::string_view();
     }
 
     void Uri::set_scheme(std::string_view new_scheme, bool smart) {
@@ -353,6 +552,63 @@ namespace Crow {
         ofs_user_ = ofs_password_ = ofs_host_ = ofs_port_ = ofs_path_ = ofs_query_ = ofs_fragment_ = 0;
     }
 
+    void Uri::normalize() {
+
+        if (empty())
+            return;
+
+        // Lower case scheme and host
+
+        lowercase_range(text_, 0, ofs_user_);
+        lowercase_range(text_, ofs_host_, ofs_port_);
+
+        // Remove the default port for the scheme
+
+        if (has_port()) {
+            auto dp = default_port(scheme_view());
+            if (dp != 0 && port() == dp)
+                clear_port();
+        }
+
+        // Remove dot segments (RFC 3986 section 5.2.4). The result is never
+        // longer than the original path, so it can be done in place.
+
+        if (has_path()) {
+
+            size_t r = ofs_path_, w = ofs_path_, end = ofs_query_;
+
+            while (r < end) {
+                size_t next = std::min(text_.find('/', r + 1), end);
+                std::string_view segment(text_.data() + r + 1, next - r - 1);
+                bool last = next == end;
+                if (segment == ".") {
+                    if (last)
+                        text_[w++] = '/';
+                } else if (segment == "..") {
+                    while (w > size_t(ofs_path_) && text_[w - 1] != '/')
+                        --w;
+                    if (w > size_t(ofs_path_))
+                        --w;
+                    if (last)
+                        text_[w++] = '/';
+                } else {
+                    std::memmove(text_.data() + w, text_.data() + r, next - r);
+                    w += next - r;
+                }
+                r = next;
+            }
+
+            if (w < end) {
+                int delta = int(end - w);
+                text_.erase(w, delta);
+                ofs_query_ -= delta;
+                ofs_fragment_ -= delta;
+            }
+
+        }
+
+    }
+
     Uri Uri::doc() const {
         Uri u = *this;
         u.text_.resize(ofs_fragment_);
@@ -408,38 +664,21 @@ namespace Crow {
 
     bool Uri::try_parse(std::string_view s) {
 
-        // scheme:[//][[user[:password]@]host[:port]][/path][?query][#fragment]
-
-        static const Regex pattern(R"(
-            ([a-z][a-z0-9+.-]*:(?://)?)  # scheme
-            (?:
-                (?:
-                    ([^/:@]+)            # user
-                    ([^/@]*@)            # password
-                )?
-                ([^/:@]+)                # host
-                (:\d+)?                  # port
-            )?
-            (/[^#?]*)?                   # path
-            (\?[^#]*)?                   # query
-            (\#.*)?                      # fragment
-        )", Regex::extended | Regex::full | Regex::icase);
-
         if (std::find_if(s.begin(), s.end(), ascii_iscntrl) != s.end())
             return false;
 
-        auto match = pattern(s);
-        if (! match)
+        UriOffsets ofs;
+        if (! parse_uri(s, ofs))
             return false;
 
-        text_ = std::string(s);
-        ofs_user_ = int(match.count(1));
-        ofs_password_ = ofs_user_ + int(match.count(2));
-        ofs_host_ = ofs_password_ + int(match.count(3));
-        ofs_port_ = ofs_host_ + int(match.count(4));
-        ofs_path_ = ofs_port_ + int(match.count(5));
-        ofs_query_ = ofs_path_ + int(match.count(6));
-        ofs_fragment_ = ofs_query_ + int(match.count(7));
+        text_.assign(s);
+        ofs_user_ = int(ofs.user);
+        ofs_password_ = int(ofs.password);
+        ofs_host_ = int(ofs.host);
+        ofs_port_ = int(ofs.port);
+        ofs_path_ = int(ofs.path);
+        ofs_query_ = int(ofs.query);
+        ofs_fragment_ = int(ofs.fragment);
 
         return true;
 
@@ -461,24 +700,27 @@ namespace Crow {
     }
 
     std::string Uri::decode(std::string_view s) {
-        size_t i = 0, j = 0, len = s.size();
-        if (len < 3)
+        size_t i = 0, j = s.find('%'), len = s.size();
+        if (j == npos || len < 3)
             return std::string(s);
         std::string out;
+        out.reserve(len);
         while (i < len) {
-            j = s.find('%', i);
             if (j > len - 3) {
                 out.append(s, i, npos);
                 break;
             }
             out.append(s, i, j - i);
-            if (ascii_isxdigit(s[j + 1]) && ascii_isxdigit(s[j + 2])) {
-                out += char(to_uint8(std::string(s, j + 1, 2), 16));
+            int hi = hex_digit_value(s[j + 1]);
+            int lo = hex_digit_value(s[j + 2]);
+            if (hi >= 0 && lo >= 0) {
+                out += char(16 * hi + lo);
                 i = j + 3;
             } else {
                 out += '%';
                 i = j + 1;
             }
+            j = s.find('%', i);
         }
         return out;
     }
@@ -45,6 +45,14 @@ namespace Crow {
         std::string query() const;
         std::string fragment() const;
 
+        std::string_view scheme_view() const noexcept;
+        std::string_view user_view() const noexcept;
+        std::string_view password_view() const noexcept;
+        std::string_view host_view() const noexcept;
+        std::string_view path_view() const noexcept;
+        std::string_view query_view() const noexcept;
+        std::string_view fragment_view() const noexcept;
+
         void set_scheme(std::string_view new_scheme, bool smart = true);
         void set_user(std::string_view new_user);
         void set_password(std::string_view new_password);
@@ -64,6 +72,7 @@ namespace Crow {
 
         void append_path(std::string_view new_path);
         void clear() noexcept;
+        void normalize();
         Uri doc() const;
         Uri base() const;
         Uri parent() const;
@@ -81,6 +90,7 @@ namespace Crow {
         static std::string decode(std::string_view s);
         template <std::ranges::range R> static std::string make_query(const R& range, char delimiter = '&', int flags = 0);
         static std::vector<std::pair<std::string, std::string>> parse_query(std::string_view query, char delimiter = '\0');
+        template <std::ranges::range R> static std::vector<std::string> normalize_all(const R& range);
 
         friend Uri operator/(const Uri& u, std::string_view s) { Uri v = u; v.append_path(s); return v; }
         friend bool operator==(const Uri& u, const Uri& v) noexcept { return u.text_ == v.text_; }
@@ -120,6 +130,23 @@ namespace Crow {
             return q;
         }
 
+        template <std::ranges::range R>
+        std::vector<std::string> Uri::normalize_all(const R& range) {
+            std::vector<std::string> out;
+            if constexpr (std::ranges::sized_range<R>)
+                out.reserve(std::ranges::size(range));
+            Uri u;
+            for (auto& s: range) {
+                if (u.try_parse(std::string_view(s))) {
+                    u.normalize();
+                    out.push_back(u.text_);
+                } else {
+                    out.emplace_back();
+                }
+            }
+            return out;
+        }
+
     namespace Literals {
 
         inline Uri operator""_uri(const char* p, size_t n) { return Uri(std::string(p, n)); }
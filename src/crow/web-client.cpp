@@ -1,9 +1,12 @@
 #include "crow/web-client.hpp"
 #include "crow/curl-api.hpp"
+#include "crow/guard.hpp"
 #include "crow/string.hpp"
 #include <algorithm>
 #include <cstring>
+#include <iterator>
 #include <memory>
+#include <system_error>
 #include <vector>
 
 namespace Crow {
@@ -32,6 +35,37 @@ namespace Crow {
             return {cs, {}};
         }
 
+        // Header lines starting with whitespace are continuations of the
+        // previous header
+
+        void add_header_line(std::string_view buffer, WebClient::headers& head, WebClient::headers::iterator& prev) {
+
+            auto line = trim_right_v(buffer);
+
+            if (line.empty())
+                return;
+
+            if (! head.empty() && ascii_isspace(line[0])) {
+                prev->second += ' ';
+                prev->second += trim_left_v(line);
+            } else {
+                auto [key,value] = partition(line, ":");
+                prev = head.insert(std::string(trim_v(key)), std::string(trim_left_v(value))).first;
+            }
+
+        }
+
+        void append_body(std::string& body, const char* ptr, size_t n) {
+            size_t offset = body.size();
+            body.resize(offset + n);
+            std::memcpy(body.data() + offset, ptr, n);
+        }
+
+        void check_multi(CURLMcode rc, const char* function) {
+            if (rc != CURLM_OK)
+                throw CurlError(0, function, curl_multi_strerror(rc));
+        }
+
     }
 
     // WebClient class
@@ -53,6 +87,8 @@ namespace Crow {
         Detail::set_curl_option<CURLOPT_HEADERDATA>(*this, this);
         Detail::set_curl_option<CURLOPT_WRITEFUNCTION>(*this, write_callback);
         Detail::set_curl_option<CURLOPT_WRITEDATA>(*this, this);
+        Detail::set_curl_option<CURLOPT_XFERINFOFUNCTION>(*this, xferinfo_callback);
+        Detail::set_curl_option<CURLOPT_XFERINFODATA>(*this, this);
         Detail::set_curl_option<CURLOPT_ACCEPT_ENCODING>(*this, "");
 
         set_connect_timeout(default_connect_timeout);
@@ -61,43 +97,77 @@ namespace Crow {
 
     }
 
+    // The callbacks are given a pointer to the client, which needs to be
+    // updated when the handle changes hands
+
+    WebClient::WebClient(WebClient&& c) noexcept:
+    curl_(std::exchange(c.curl_, nullptr)),
+    error_buffer_(std::move(c.error_buffer_)) {
+        if (curl_ != nullptr) {
+            curl_easy_setopt(curl_, CURLOPT_HEADERDATA, this);
+            curl_easy_setopt(curl_, CURLOPT_WRITEDATA, this);
+            curl_easy_setopt(curl_, CURLOPT_XFERINFODATA, this);
+        }
+    }
+
     WebClient& WebClient::operator=(WebClient&& c) noexcept {
         if (&c != this) {
             close();
             curl_ = std::exchange(c.curl_, nullptr);
+            error_buffer_ = std::move(c.error_buffer_);
+            if (curl_ != nullptr) {
+                curl_easy_setopt(curl_, CURLOPT_HEADERDATA, this);
+                curl_easy_setopt(curl_, CURLOPT_WRITEDATA, this);
+                curl_easy_setopt(curl_, CURLOPT_XFERINFODATA, this);
+            }
         }
         return *this;
     }
 
     HttpStatus WebClient::request(const Uri& uri, parameters& response,
             const parameters& params, method m) {
-
-        // TODO - handle DELETE, POST, PUT
-
         response.clear();
-        response_ = &response;
-        Detail::set_curl_option<CURLOPT_URL>(*this, uri.str());
-        std::vector<std::string> send_headers;
-        SlistPtr slist_ptr;
+        head_ = &response.head;
+        body_ = &response.body;
+        auto guard = on_scope_exit([this] { head_ = nullptr; body_ = nullptr; });
+        return perform(uri, params, m);
+    }
 
-        if (! params.head.empty()) {
-            for (auto& [key,value]: params.head)
-                send_headers.push_back(key + ": " + value);
-            slist_ptr = make_slist(send_headers);
-            Detail::set_curl_option<CURLOPT_HTTPHEADER>(*this, slist_ptr.get());
+    // Resumption is left to libcurl, which fails with CURLE_RANGE_ERROR if
+    // the server ignores the range and sends the whole resource. The
+    // progress callback is always enabled while a sink is attached, since
+    // that is where a paused transfer is resumed.
+
+    HttpStatus WebClient::download(const Uri& uri, sink& body, headers& head,
+            const parameters& params, int64_t offset) {
+
+        head.clear();
+        head_ = &head;
+        sink_ = &body;
+        sink_error_ = nullptr;
+        offset_ = std::max(offset, int64_t(0));
+        sink_started_ = sink_discard_ = paused_ = false;
+
+        auto guard = on_scope_exit([this] {
+            head_ = nullptr;
+            sink_ = nullptr;
+            sink_error_ = nullptr;
+            curl_easy_setopt(curl_, CURLOPT_RESUME_FROM_LARGE, curl_off_t(0));
+            curl_easy_setopt(curl_, CURLOPT_NOPROGRESS, long(progress_ == nullptr));
+        });
+
+        Detail::set_curl_option<CURLOPT_RESUME_FROM_LARGE>(*this, curl_off_t(offset_));
+        Detail::set_curl_option<CURLOPT_NOPROGRESS>(*this, false);
+
+        auto status = perform(uri, params, method::get);
+
+        if (! sink_discard_) {
+            if (! sink_started_)
+                body.start(offset_, 0);
+            body.finish();
         }
 
-        if (m == method::head)
-            Detail::set_curl_option<CURLOPT_NOBODY>(*this, true);
-        else
-            Detail::set_curl_option<CURLOPT_HTTPGET>(*this, true);
-
-        Detail::check_curl_api(*this, curl_easy_perform(curl_), "curl_easy_perform()", uri.str());
-        response_ = nullptr;
-        int rc = 0;
-        Detail::get_curl_info<CURLINFO_RESPONSE_CODE>(*this, rc);
-
-        return HttpStatus(rc);
+        return status;
 
     }
 
@@ -119,6 +189,39 @@ namespace Crow {
             curl_easy_cleanup(curl_);
     }
 
+    HttpStatus WebClient::perform(const Uri& uri, const parameters& params, method m) {
+
+        // TODO - handle DELETE, POST, PUT
+
+        Detail::set_curl_option<CURLOPT_URL>(*this, uri.str());
+        std::vector<std::string> send_headers;
+        SlistPtr slist_ptr;
+
+        if (! params.head.empty()) {
+            for (auto& [key,value]: params.head)
+                send_headers.push_back(key + ": " + value);
+            slist_ptr = make_slist(send_headers);
+            Detail::set_curl_option<CURLOPT_HTTPHEADER>(*this, slist_ptr.get());
+        }
+
+        if (m == method::head)
+            Detail::set_curl_option<CURLOPT_NOBODY>(*this, true);
+        else
+            Detail::set_curl_option<CURLOPT_HTTPGET>(*this, true);
+
+        auto rc = curl_easy_perform(curl_);
+
+        if (sink_error_)
+            std::rethrow_exception(sink_error_);
+
+        Detail::check_curl_api(*this, rc, "curl_easy_perform()", uri.str());
+        int status = 0;
+        Detail::get_curl_info<CURLINFO_RESPONSE_CODE>(*this, status);
+
+        return HttpStatus(status);
+
+    }
+
     void WebClient::set_connect_timeout_ms(std::chrono::milliseconds ms) {
         Detail::set_curl_option<CURLOPT_CONNECTTIMEOUT_MS>(*this, ms.count());
     }
@@ -128,54 +231,409 @@ namespace Crow {
     }
 
     size_t WebClient::header_callback(char* buffer, size_t /*size*/, size_t n_items, WebClient* client_ptr) {
+        add_header_line(std::string_view(buffer, n_items), *client_ptr->head_, client_ptr->prev_header_);
+        return n_items;
+    }
 
-        auto line = trim_right(std::string(buffer, n_items));
+    // Exceptions from a sink cannot pass through libcurl, so they are saved
+    // and the transfer aborted. An HTTP body that arrives with anything but
+    // a success status is read and thrown away.
 
-        if (line.empty())
-            return n_items;
+    size_t WebClient::write_callback(char* ptr, size_t /*size*/, size_t n_members, WebClient* client_ptr) {
 
-        auto& head = client_ptr->response_->head;
-        auto& prev = client_ptr->prev_header_;
+        auto& c = *client_ptr;
 
-        if (! head.empty() && ascii_isspace(line[0])) {
-            prev->second += ' ' + trim_left(line);
-        } else {
-            auto [key,value] = partition(line, ":");
-            prev = head.insert(trim(key), trim_left(value)).first;
+        if (c.sink_ == nullptr) {
+            append_body(*c.body_, ptr, n_members);
+            return n_members;
         }
 
-        return n_items;
+        try {
+
+            if (! c.sink_started_) {
+                long status = 0;
+                curl_off_t length = -1;
+                char* scheme = nullptr;
+                curl_easy_getinfo(c.curl_, CURLINFO_RESPONSE_CODE, &status);
+                curl_easy_getinfo(c.curl_, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+                curl_easy_getinfo(c.curl_, CURLINFO_SCHEME, &scheme);
+                bool http = scheme != nullptr && ascii_lowercase(std::string_view(scheme)).starts_with("http");
+                c.sink_started_ = true;
+                c.sink_discard_ = http && (status < 200 || status >= 300);
+                if (! c.sink_discard_)
+                    c.sink_->start(c.offset_, length);
+            }
+
+            if (c.sink_discard_ || c.sink_->write(ptr, n_members))
+                return n_members;
+
+            c.paused_ = true;
+            return CURL_WRITEFUNC_PAUSE;
+
+        }
+
+        catch (...) {
+            c.sink_error_ = std::current_exception();
+            return 0;
+        }
 
     }
 
-    size_t WebClient::write_callback(char* ptr, size_t /*size*/, size_t n_members, WebClient* client_ptr) {
-        auto& body = client_ptr->response_->body;
-        size_t offset = body.size();
-        body.resize(offset + n_members);
-        std::memcpy(body.data() + offset, ptr, n_members);
-        return n_members;
+    int WebClient::xferinfo_callback(WebClient* client_ptr, int64_t dl_total, int64_t dl_now,
+            int64_t /*ul_total*/, int64_t /*ul_now*/) noexcept {
+
+        auto& c = *client_ptr;
+
+        if (c.paused_) {
+            bool ready = false;
+            try {
+                ready = c.sink_->ready();
+            }
+            catch (...) {
+                c.sink_error_ = std::current_exception();
+                return 1;
+            }
+            if (ready) {
+                c.paused_ = false;
+                curl_easy_pause(c.curl_, CURLPAUSE_CONT);
+            }
+        }
+
+        // Returning CURL_PROGRESSFUNC_CONTINUE would switch on libcurl's own
+        // progress meter; any value other than zero aborts the transfer
+
+        if (c.progress_ != nullptr && c.progress_->on_download_ && ! c.progress_->on_download_(dl_total, dl_now))
+            return 1;
+
+        return 0;
+
     }
 
     // WebClient::progress class
 
     WebClient::progress::progress(WebClient& c, callback on_download):
     client_(c), on_download_(on_download) {
-        Detail::set_curl_option<CURLOPT_XFERINFOFUNCTION>(c, progress_callback);
-        Detail::set_curl_option<CURLOPT_XFERINFODATA>(c, this);
         Detail::set_curl_option<CURLOPT_NOPROGRESS>(c, false);
+        c.progress_ = this;
     }
 
     WebClient::progress::~progress() noexcept {
-        curl_easy_setopt(client_.native_handle(), CURLOPT_NOPROGRESS, 0L);
+        client_.progress_ = nullptr;
+        if (client_.sink_ == nullptr)
+            curl_easy_setopt(client_.native_handle(), CURLOPT_NOPROGRESS, 1L);
     }
 
-    int WebClient::progress::progress_callback(progress* ptr, int64_t dl_total, int64_t dl_now,
-            int64_t /*ul_total*/, int64_t /*ul_now*/) noexcept {
-        bool dl_ok = ! ptr->on_download_ || ptr->on_download_(dl_total, dl_now);
-        if (dl_ok)
-            return CURL_PROGRESSFUNC_CONTINUE;
-        else
-            return CURL_PROGRESSFUNC_CONTINUE - 1;
+    // Sink classes
+
+    void WebClient::buffer_sink::start(int64_t offset, int64_t length) {
+        if (offset == 0)
+            buffer_.clear();
+        if (length > 0)
+            buffer_.reserve(buffer_.size() + size_t(length));
+    }
+
+    void WebClient::fdio_sink::start(int64_t offset, int64_t /*length*/) {
+        if (offset > 0)
+            io_.seek(ptrdiff_t(offset), SEEK_SET);
+    }
+
+    bool WebClient::fdio_sink::write(const char* ptr, size_t len) {
+        while (len > 0) {
+            size_t n = io_.write(ptr, len);
+            if (n == 0)
+                throw std::system_error(std::make_error_code(std::errc::io_error), "Fdio::write()");
+            ptr += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    void WebClient::hash_sink::start(int64_t offset, int64_t /*length*/) {
+        if (offset == 0)
+            hash_.clear();
+    }
+
+    // WebClient::batch class
+
+    struct WebClient::batch::transfer {
+
+        Curl_easy* curl = nullptr;
+        result res;
+        parameters params;
+        method m = method::get;
+        callback done;
+        std::string host;
+        std::string error_buffer;
+        SlistPtr slist;
+        headers::iterator prev_header;
+
+        Curl_easy* native_handle() const noexcept { return curl; }
+        const std::string& native_error() const noexcept { return error_buffer; }
+
+        static size_t header_callback(char* buffer, size_t /*size*/, size_t n_items, transfer* t) {
+            add_header_line(std::string_view(buffer, n_items), t->res.response.head, t->prev_header);
+            return n_items;
+        }
+
+        static size_t write_callback(char* ptr, size_t /*size*/, size_t n_members, transfer* t) {
+            append_body(t->res.response.body, ptr, n_members);
+            return n_members;
+        }
+
+    };
+
+    WebClient::batch::batch() {
+
+        auto multi = curl_multi_init();
+
+        if (multi == nullptr)
+            throw CurlError(0, "curl_multi_init()");
+
+        multi_ = multi;
+
+        // Allow HTTP/2 transfers to the same host to share a connection
+
+        curl_multi_setopt(multi_, CURLMOPT_PIPELINING, long(CURLPIPE_MULTIPLEX));
+
+    }
+
+    WebClient::batch::~batch() noexcept {
+        for (auto& [curl,t]: active_) {
+            curl_multi_remove_handle(multi_, curl);
+            curl_easy_cleanup(curl);
+        }
+        for (auto curl: idle_)
+            curl_easy_cleanup(curl);
+        curl_multi_cleanup(multi_);
+    }
+
+    void WebClient::batch::add(const Uri& uri, callback done, const parameters& params, method m) {
+        auto t = std::make_unique<transfer>();
+        t->res.uri = uri;
+        t->params = params;
+        t->m = m;
+        t->done = std::move(done);
+        t->host = ascii_lowercase(uri.host_view());
+        queue_.push_back(std::move(t));
+    }
+
+    std::future<WebClient::batch::result> WebClient::batch::request(const Uri& uri, const parameters& params, method m) {
+        auto promise = std::make_shared<std::promise<result>>();
+        auto future = promise->get_future();
+        add(uri, [promise] (result& r, std::exception_ptr error) {
+            if (error)
+                promise->set_exception(error);
+            else
+                promise->set_value(std::move(r));
+        }, params, m);
+        return future;
+    }
+
+    void WebClient::batch::run() {
+
+        // The connection cache is sized so that every active transfer's
+        // connection can be kept alive for reuse
+
+        check_multi(curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, long(total_limit_)), "curl_multi_setopt()");
+
+        // The limits may have changed since a previous run, so every host
+        // with waiting transfers gets another chance to start them
+
+        host_ready_.clear();
+
+        for (auto& [host,waiting]: host_queue_)
+            if (! waiting.empty())
+                host_ready_.push_back(host);
+
+        // A callback may queue more requests after the last active transfer
+        // has finished, so check the queue again before giving up
+
+        for (;;) {
+
+            start_queued();
+
+            if (active_.empty())
+                break;
+
+            int running = 0;
+            check_multi(curl_multi_perform(multi_, &running), "curl_multi_perform()");
+
+            int n_messages = 0;
+
+            while (auto msg = curl_multi_info_read(multi_, &n_messages))
+                if (msg->msg == CURLMSG_DONE)
+                    complete(msg->easy_handle, int(msg->data.result));
+
+            if (running > 0)
+                check_multi(curl_multi_poll(multi_, nullptr, 0, 100, nullptr), "curl_multi_poll()");
+
+        }
+
+    }
+
+    // The callback is called only after the transfer has been removed and
+    // its successor started, so the batch is left in a consistent state if
+    // the callback throws
+
+    void WebClient::batch::complete(Curl_easy* curl, int code) {
+
+        auto it = active_.find(curl);
+
+        if (it == active_.end())
+            return;
+
+        auto t = std::move(it->second);
+        active_.erase(it);
+        curl_multi_remove_handle(multi_, curl);
+
+        auto host_it = host_active_.find(t->host);
+
+        if (host_it != host_active_.end() && --host_it->second <= 0)
+            host_active_.erase(host_it);
+
+        if (host_queue_.contains(t->host))
+            host_ready_.push_back(t->host);
+
+        std::exception_ptr error;
+
+        if (code == CURLE_OK) {
+            long rc = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &rc);
+            t->res.status = HttpStatus(rc);
+        } else {
+            error = std::make_exception_ptr(CurlError(code, "curl_multi_perform()",
+                t->error_buffer.data(), t->res.uri.str()));
+            t->res.response.clear();
+        }
+
+        t->curl = nullptr;
+
+        if (idle_.size() < size_t(total_limit_)) {
+            curl_easy_reset(curl);
+            idle_.push_back(curl);
+        } else {
+            curl_easy_cleanup(curl);
+        }
+
+        start_queued();
+
+        if (t->done)
+            t->done(t->res, error);
+
+    }
+
+    // Easy handles are recycled; the connections themselves belong to the
+    // multi handle's cache, so they survive the handle being reset
+
+    void WebClient::batch::start(transfer_ptr t) {
+
+        try {
+
+            if (idle_.empty()) {
+                t->curl = curl_easy_init();
+                if (t->curl == nullptr)
+                    throw CurlError(0, "curl_easy_init()");
+            } else {
+                t->curl = idle_.back();
+                idle_.pop_back();
+            }
+
+            auto& tr = *t;
+            tr.error_buffer.assign(CURL_ERROR_SIZE, '\0');
+
+            Detail::set_curl_option<CURLOPT_ERRORBUFFER>(tr, tr.error_buffer.data());
+            Detail::set_curl_option<CURLOPT_NOPROGRESS>(tr, true);
+            Detail::set_curl_option<CURLOPT_NOSIGNAL>(tr, true);
+            Detail::set_curl_option<CURLOPT_HEADERFUNCTION>(tr, transfer::header_callback);
+            Detail::set_curl_option<CURLOPT_HEADERDATA>(tr, &tr);
+            Detail::set_curl_option<CURLOPT_WRITEFUNCTION>(tr, transfer::write_callback);
+            Detail::set_curl_option<CURLOPT_WRITEDATA>(tr, &tr);
+            Detail::set_curl_option<CURLOPT_ACCEPT_ENCODING>(tr, "");
+            Detail::set_curl_option<CURLOPT_PIPEWAIT>(tr, true);
+            Detail::set_curl_option<CURLOPT_CONNECTTIMEOUT_MS>(tr, connect_timeout_.count());
+            Detail::set_curl_option<CURLOPT_TIMEOUT_MS>(tr, request_timeout_.count());
+            Detail::set_curl_option<CURLOPT_FOLLOWLOCATION>(tr, true);
+            Detail::set_curl_option<CURLOPT_MAXREDIRS>(tr, redirect_limit_);
+            Detail::set_curl_option<CURLOPT_VERBOSE>(tr, verbose_);
+            Detail::set_curl_option<CURLOPT_URL>(tr, tr.res.uri.str());
+
+            if (! user_agent_.empty())
+                Detail::set_curl_option<CURLOPT_USERAGENT>(tr, user_agent_);
+
+            if (! tr.params.head.empty()) {
+                std::vector<std::string> send_headers;
+                for (auto& [key,value]: tr.params.head)
+                    send_headers.push_back(key + ": " + value);
+                tr.slist = make_slist(send_headers);
+                Detail::set_curl_option<CURLOPT_HTTPHEADER>(tr, tr.slist.get());
+            }
+
+            if (tr.m == method::head)
+                Detail::set_curl_option<CURLOPT_NOBODY>(tr, true);
+            else
+                Detail::set_curl_option<CURLOPT_HTTPGET>(tr, true);
+
+            check_multi(curl_multi_add_handle(multi_, tr.curl), "curl_multi_add_handle()");
+
+        }
+
+        catch (...) {
+            if (t->curl != nullptr)
+                curl_easy_cleanup(t->curl);
+            t->curl = nullptr;
+            if (t->done)
+                t->done(t->res, std::current_exception());
+            return;
+        }
+
+        ++host_active_[t->host];
+        auto curl = t->curl;
+        active_.insert({curl, std::move(t)});
+
+    }
+
+    // Transfers held back by the host limit wait in a separate queue for
+    // each host, so a completion only has to look at its own host's queue.
+    // A host is listed as ready when one of its slots is freed; stale
+    // entries are skipped when they reach the front. New transfers to a
+    // host with others already waiting join the back of its queue, so each
+    // host's requests still start in the order they were added.
+
+    void WebClient::batch::start_queued() {
+
+        while (active_.size() < size_t(total_limit_) && ! host_ready_.empty()) {
+            auto host = std::move(host_ready_.front());
+            host_ready_.pop_front();
+            auto queue_it = host_queue_.find(host);
+            if (queue_it == host_queue_.end())
+                continue;
+            auto active_it = host_active_.find(host);
+            if (active_it != host_active_.end() && active_it->second >= host_limit_)
+                continue;
+            auto t = std::move(queue_it->second.front());
+            queue_it->second.pop_front();
+            --host_waiting_;
+            if (queue_it->second.empty())
+                host_queue_.erase(queue_it);
+            else
+                host_ready_.push_back(host);
+            start(std::move(t));
+        }
+
+        while (active_.size() < size_t(total_limit_) && ! queue_.empty()) {
+            auto t = std::move(queue_.front());
+            queue_.pop_front();
+            auto queue_it = host_queue_.find(t->host);
+            auto active_it = host_active_.find(t->host);
+            if (queue_it == host_queue_.end() && (active_it == host_active_.end() || active_it->second < host_limit_)) {
+                start(std::move(t));
+            } else {
+                auto& waiting = host_queue_[t->host];
+                waiting.push_back(std::move(t));
+                ++host_waiting_;
+            }
+        }
+
     }
 
 }
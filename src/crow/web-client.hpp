@@ -1,14 +1,26 @@
 #pragma once
 
 #include "crow/curl-utility.hpp"
+#include "crow/hash.hpp"
 #include "crow/http.hpp"
 #include "crow/stable-map.hpp"
+#include "crow/stdio.hpp"
 #include "crow/types.hpp"
 #include "crow/uri.hpp"
 #include <chrono>
+#include <cstddef>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <future>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
+#include <vector>
+
+struct Curl_multi;
 
 namespace Crow {
 
@@ -37,6 +49,13 @@ namespace Crow {
             void clear() noexcept { head.clear(); body.clear(); }
         };
 
+        class batch;
+        class sink;
+        class buffer_sink;
+        class fdio_sink;
+        class function_sink;
+        class hash_sink;
+
         class progress {
         public:
             using callback = std::function<bool(int64_t dltotal, int64_t dlnow)>;
@@ -47,10 +66,9 @@ namespace Crow {
             progress& operator=(const progress&) = delete;
             progress& operator=(progress&&) = delete;
         private:
+            friend class WebClient;
             WebClient& client_;
             callback on_download_;
-            static int progress_callback(progress* ptr, int64_t dl_total, int64_t dl_now,
-                int64_t ul_total, int64_t ul_now) noexcept;
         };
 
         static constexpr auto default_connect_timeout = std::chrono::seconds(15);
@@ -60,7 +78,7 @@ namespace Crow {
         WebClient();
         ~WebClient() noexcept { close(); }
         WebClient(const WebClient& c) = delete;
-        WebClient(WebClient&& c) noexcept: curl_(std::exchange(c.curl_, nullptr)) {}
+        WebClient(WebClient&& c) noexcept;
         WebClient& operator=(const WebClient& c) = delete;
         WebClient& operator=(WebClient&& c) noexcept;
 
@@ -70,6 +88,8 @@ namespace Crow {
             const parameters& params = {}, method m = method::get) {
                 return request(uri, response, params, m);
             }
+        HttpStatus download(const Uri& uri, sink& body, headers& head,
+            const parameters& params = {}, int64_t offset = 0);
 
         template <typename R, typename P> void set_connect_timeout(std::chrono::duration<R, P> t);
         template <typename R, typename P> void set_request_timeout(std::chrono::duration<R, P> t);
@@ -83,16 +103,144 @@ namespace Crow {
     private:
 
         Curl_easy* curl_ = nullptr;
-        parameters* response_ = nullptr;
+        headers* head_ = nullptr;
+        std::string* body_ = nullptr;
+        sink* sink_ = nullptr;
+        progress* progress_ = nullptr;
+        std::exception_ptr sink_error_;
+        int64_t offset_ = 0;
+        bool sink_started_ = false;
+        bool sink_discard_ = false;
+        bool paused_ = false;
         std::string error_buffer_;
         headers::iterator prev_header_;
 
         void close() noexcept;
+        HttpStatus perform(const Uri& uri, const parameters& params, method m);
         void set_connect_timeout_ms(std::chrono::milliseconds ms);
         void set_request_timeout_ms(std::chrono::milliseconds ms);
 
         static size_t header_callback(char* buffer, size_t size, size_t n_items, WebClient* client_ptr);
         static size_t write_callback(char* ptr, size_t size, size_t n_members, WebClient* client_ptr);
+        static int xferinfo_callback(WebClient* client_ptr, int64_t dl_total, int64_t dl_now,
+            int64_t ul_total, int64_t ul_now) noexcept;
+
+    };
+
+    class WebClient::sink {
+    public:
+        virtual ~sink() noexcept {}
+        virtual void start(int64_t /*offset*/, int64_t /*length*/) {}
+        virtual bool write(const char* ptr, size_t len) = 0;
+        virtual bool ready() { return true; }
+        virtual void finish() {}
+    };
+
+    class WebClient::buffer_sink:
+    public sink {
+    public:
+        explicit buffer_sink(std::string& buffer) noexcept: buffer_(buffer) {}
+        void start(int64_t offset, int64_t length) override;
+        bool write(const char* ptr, size_t len) override { buffer_.append(ptr, len); return true; }
+    private:
+        std::string& buffer_;
+    };
+
+    class WebClient::fdio_sink:
+    public sink {
+    public:
+        explicit fdio_sink(Fdio& io) noexcept: io_(io) {}
+        void start(int64_t offset, int64_t length) override;
+        bool write(const char* ptr, size_t len) override;
+        void finish() override { io_.flush(); }
+    private:
+        Fdio& io_;
+    };
+
+    class WebClient::function_sink:
+    public sink {
+    public:
+        using callback = std::function<bool(std::string_view chunk)>;
+        explicit function_sink(callback f): callback_(std::move(f)) {}
+        bool write(const char* ptr, size_t len) override { return callback_(std::string_view(ptr, len)); }
+    private:
+        callback callback_;
+    };
+
+    class WebClient::hash_sink:
+    public sink {
+    public:
+        explicit hash_sink(CryptographicHash& hash) noexcept: hash_(hash) {}
+        void start(int64_t offset, int64_t length) override;
+        bool write(const char* ptr, size_t len) override { hash_.add(ptr, len); return true; }
+    private:
+        CryptographicHash& hash_;
+    };
+
+    class WebClient::batch:
+    private Detail::CurlInit {
+
+    public:
+
+        struct result {
+            Uri uri;
+            HttpStatus status = {};
+            parameters response;
+        };
+
+        using callback = std::function<void(result& r, std::exception_ptr error)>;
+
+        static constexpr int default_host_limit = 32;
+        static constexpr int default_total_limit = 256;
+
+        batch();
+        ~batch() noexcept;
+        batch(const batch&) = delete;
+        batch(batch&&) = delete;
+        batch& operator=(const batch&) = delete;
+        batch& operator=(batch&&) = delete;
+
+        void add(const Uri& uri, callback done, const parameters& params = {}, method m = method::get);
+        std::future<result> request(const Uri& uri, const parameters& params = {}, method m = method::get);
+        void run();
+        size_t pending() const noexcept { return queue_.size() + host_waiting_ + active_.size(); }
+
+        int host_limit() const noexcept { return host_limit_; }
+        void set_host_limit(int n) noexcept { host_limit_ = n < 1 ? 1 : n; }
+        int total_limit() const noexcept { return total_limit_; }
+        void set_total_limit(int n) noexcept { total_limit_ = n < 1 ? 1 : n; }
+        template <typename R, typename P> void set_connect_timeout(std::chrono::duration<R, P> t);
+        template <typename R, typename P> void set_request_timeout(std::chrono::duration<R, P> t);
+        void set_redirect_limit(int n) noexcept { redirect_limit_ = n < 0 ? 0 : n; }
+        void set_user_agent(const std::string& user_agent) { user_agent_ = user_agent; }
+        void set_verbose(bool flag) noexcept { verbose_ = flag; }
+
+        Curl_multi* native_handle() const noexcept { return multi_; }
+
+    private:
+
+        struct transfer;
+        using transfer_ptr = std::unique_ptr<transfer>;
+
+        Curl_multi* multi_ = nullptr;
+        std::deque<transfer_ptr> queue_;
+        std::unordered_map<Curl_easy*, transfer_ptr> active_;
+        std::unordered_map<std::string, int> host_active_;
+        std::unordered_map<std::string, std::deque<transfer_ptr>> host_queue_;
+        std::deque<std::string> host_ready_;
+        size_t host_waiting_ = 0;
+        std::vector<Curl_easy*> idle_;
+        int host_limit_ = default_host_limit;
+        int total_limit_ = default_total_limit;
+        std::chrono::milliseconds connect_timeout_ = default_connect_timeout;
+        std::chrono::milliseconds request_timeout_ = default_request_timeout;
+        int redirect_limit_ = default_redirect_limit;
+        std::string user_agent_;
+        bool verbose_ = false;
+
+        void complete(Curl_easy* curl, int code);
+        void start(transfer_ptr t);
+        void start_queued();
 
     };
 
@@ -108,4 +256,16 @@ namespace Crow {
             set_connect_timeout_ms(duration_cast<milliseconds>(t));
         }
 
+        template <typename R, typename P>
+        void WebClient::batch::set_request_timeout(std::chrono::duration<R, P> t) {
+            using namespace std::chrono;
+            request_timeout_ = duration_cast<milliseconds>(t);
+        }
+
+        template <typename R, typename P>
+        void WebClient::batch::set_connect_timeout(std::chrono::duration<R, P> t) {
+            using namespace std::chrono;
+            connect_timeout_ = duration_cast<milliseconds>(t);
+        }
+
 }
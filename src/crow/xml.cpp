@@ -4,6 +4,15 @@
 #include "crow/string.hpp"
 #include "crow/unicode.hpp"
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <limits>
+#include <mutex>
+#include <numeric>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+    #include <immintrin.h>
+#endif
 
 using namespace Crow;
 
@@ -48,6 +57,99 @@ namespace Crow::Xml {
 
         }
 
+        // Vectorised scanning for structural characters. The match function
+        // receives a block of bytes and returns a vector with the matching
+        // bytes set to all ones; the scalar predicate handles the tail.
+
+        #if defined(__AVX2__)
+
+            #define CROW_XML_SIMD 1
+
+            using simd_vector = __m256i;
+
+            constexpr size_t simd_width = 32;
+
+            simd_vector simd_load(const char* ptr) noexcept { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr)); }
+            simd_vector simd_splat(char c) noexcept { return _mm256_set1_epi8(c); }
+            simd_vector simd_eq(simd_vector a, char c) noexcept { return _mm256_cmpeq_epi8(a, simd_splat(c)); }
+            simd_vector simd_le(simd_vector a, char c) noexcept { return _mm256_cmpeq_epi8(_mm256_max_epu8(a, simd_splat(c)), simd_splat(c)); }
+            simd_vector simd_or(simd_vector a, simd_vector b) noexcept { return _mm256_or_si256(a, b); }
+            simd_vector simd_andnot(simd_vector a, simd_vector b) noexcept { return _mm256_andnot_si256(a, b); }
+            uint32_t simd_mask(simd_vector a) noexcept { return uint32_t(_mm256_movemask_epi8(a)); }
+
+        #elif defined(__SSE2__) || defined(_M_X64)
+
+            #define CROW_XML_SIMD 1
+
+            using simd_vector = __m128i;
+
+            constexpr size_t simd_width = 16;
+
+            simd_vector simd_load(const char* ptr) noexcept { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr)); }
+            simd_vector simd_splat(char c) noexcept { return _mm_set1_epi8(c); }
+            simd_vector simd_eq(simd_vector a, char c) noexcept { return _mm_cmpeq_epi8(a, simd_splat(c)); }
+            simd_vector simd_le(simd_vector a, char c) noexcept { return _mm_cmpeq_epi8(_mm_max_epu8(a, simd_splat(c)), simd_splat(c)); }
+            simd_vector simd_or(simd_vector a, simd_vector b) noexcept { return _mm_or_si128(a, b); }
+            simd_vector simd_andnot(simd_vector a, simd_vector b) noexcept { return _mm_andnot_si128(a, b); }
+            uint32_t simd_mask(simd_vector a) noexcept { return uint32_t(_mm_movemask_epi8(a)); }
+
+        #else
+
+            // Placeholders so the match functions still compile
+
+            struct simd_vector {};
+
+            simd_vector simd_eq(simd_vector, char) noexcept { return {}; }
+            simd_vector simd_le(simd_vector, char) noexcept { return {}; }
+            simd_vector simd_or(simd_vector, simd_vector) noexcept { return {}; }
+            simd_vector simd_andnot(simd_vector, simd_vector) noexcept { return {}; }
+
+        #endif
+
+        template <typename Match, typename Scalar>
+        size_t simd_scan(std::string_view str, size_t pos, Match match, Scalar scalar) noexcept {
+
+            #ifdef CROW_XML_SIMD
+
+                while (pos + simd_width <= str.size()) {
+                    auto mask = simd_mask(match(simd_load(str.data() + pos)));
+                    if (mask != 0)
+                        return pos + size_t(std::countr_zero(mask));
+                    pos += simd_width;
+                }
+
+            #else
+
+                (void)match;
+
+            #endif
+
+            for (; pos < str.size(); ++pos)
+                if (scalar(str[pos]))
+                    return pos;
+
+            return npos;
+
+        }
+
+        // Equivalent to str.find_first_of("\"<>", pos)
+
+        size_t find_tag_char(std::string_view str, size_t pos = 0) noexcept {
+            return simd_scan(str, pos,
+                [] (simd_vector x) { return simd_or(simd_or(simd_eq(x, '\"'), simd_eq(x, '<')), simd_eq(x, '>')); },
+                [] (char c) { return c == '\"' || c == '<' || c == '>'; });
+        }
+
+        // Equivalent to str.find_first_of(xml_whitespace, pos)
+
+        size_t find_whitespace(std::string_view str, size_t pos = 0) noexcept {
+            return simd_scan(str, pos,
+                [] (simd_vector x) {
+                    return simd_or(simd_or(simd_eq(x, ' '), simd_eq(x, '\t')), simd_or(simd_eq(x, '\n'), simd_eq(x, '\r')));
+                },
+                [] (char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; });
+        }
+
         size_t find_end(std::string_view xml, size_t start = 0) noexcept {
 
             if (start >= xml.size() || xml[start] != '<')
@@ -58,7 +160,7 @@ namespace Crow::Xml {
 
             while (i < xml.size()) {
 
-                size_t j = xml.find_first_of("\"<>", i);
+                size_t j = find_tag_char(xml, i);
 
                 if (j == npos) {
 
@@ -100,6 +202,20 @@ namespace Crow::Xml {
                 return c == '&' || c == '<' || c == '>' || c == '\"' || c == '\'' || c == '\x7f';
         }
 
+        // Equivalent to std::find_if(str, is_special_char)
+
+        size_t find_special(std::string_view str, size_t pos = 0) noexcept {
+            return simd_scan(str, pos,
+                [] (simd_vector x) {
+                    auto ws = simd_or(simd_eq(x, '\t'), simd_or(simd_eq(x, '\n'), simd_eq(x, '\r')));
+                    auto control = simd_andnot(ws, simd_le(x, '\x1f'));
+                    auto markup = simd_or(simd_or(simd_eq(x, '&'), simd_eq(x, '<')), simd_eq(x, '>'));
+                    auto other = simd_or(simd_or(simd_eq(x, '\"'), simd_eq(x, '\'')), simd_eq(x, '\x7f'));
+                    return simd_or(control, simd_or(markup, other));
+                },
+                is_special_char);
+        }
+
         constexpr bool is_valid_name_start(char c, bool digits = false) noexcept {
             // This is a cheat, we just accept all non-ASCII characters
             return ascii_isalpha(c)
@@ -182,7 +298,7 @@ namespace Crow::Xml {
 
             while (i < str.size()) {
 
-                auto j = str.find_first_of(xml_whitespace, i);
+                auto j = find_whitespace(str, i);
                 out.append(str, i, j - i);
 
                 if (j == npos)
@@ -455,7 +571,7 @@ namespace Crow::Xml {
 
                 } else {
 
-                    auto end = std::find_if(xml_.begin(), xml_.end(), is_special_char) - xml_.begin();
+                    auto end = find_special(xml_);
                     auto view = read(end);
 
                     if (has_bit(opt_, Options::foldws)) {
@@ -587,6 +703,340 @@ namespace Crow::Xml {
 
             }
 
+
+        bool names_equal(std::string_view a, std::string_view b, Options opt) noexcept {
+            if (has_bit(opt, Options::icase))
+                return AsciiIcaseEqual()(a, b);
+            else
+                return a == b;
+        }
+
+        std::string_view read_attr_view(std::string_view& xml, bool digits) {
+
+            if (xml[0] != '\"' && xml[0] != '\'')
+                return read_name(xml, digits);
+
+            auto end = xml.find(xml[0], 1);
+
+            if (end == npos)
+                throw Error("Invalid string", xml);
+
+            auto text = xml.substr(1, end - 1);
+            xml = xml.substr(end + 1, npos);
+
+            return text;
+
+        }
+
+        std::string cdata_content(std::string_view raw) {
+            if (raw.size() < 12)
+                return {};
+            else
+                return std::string(raw.substr(9, raw.size() - 12));
+        }
+
+        struct TagView {
+            std::string_view name;
+            bool closing = false;
+            bool empty = false;
+        };
+
+        // Parse a complete start or end tag, appending any attributes to the
+        // list. A closing tag leaves the list unchanged. Attribute keys and
+        // values refer to the tag text and are not decoded.
+
+        TagView read_tag_view(std::string_view text, Options opt, std::vector<AttributeView>& attrs) {
+
+            TagView tag;
+            auto rest = text.substr(1, text.size() - 2);
+            view_trim(rest, xml_whitespace);
+
+            if (rest.empty())
+                throw Error("Invalid element", text);
+
+            if (rest[0] == '/') {
+                tag.closing = true;
+                rest = rest.substr(1, npos);
+            }
+
+            if (! rest.empty() && rest.back() == '/') {
+                if (tag.closing)
+                    throw Error("Invalid element", text);
+                tag.empty = true;
+                rest = rest.substr(0, rest.size() - 1);
+            }
+
+            view_trim_left(rest, xml_whitespace);
+            tag.name = read_name(rest);
+
+            if (tag.name.empty())
+                throw Error("Invalid element", text);
+
+            auto attr_begin = attrs.size();
+
+            for (;;) {
+
+                view_trim_left(rest, xml_whitespace);
+
+                if (rest.empty())
+                    break;
+
+                auto key = read_attr_view(rest, false);
+                std::string_view value;
+
+                if (key.empty())
+                    throw Error("Invalid element", text);
+
+                if (! rest.empty() && rest[0] == '=') {
+                    rest = rest.substr(1, npos);
+                    if (rest.empty())
+                        throw Error("Invalid attribute", text);
+                    value = read_attr_view(rest, true);
+                } else if (has_bit(opt, Options::keyonly)) {
+                    value = key;
+                } else {
+                    throw Error("Invalid attribute", text);
+                }
+
+                for (auto i = attr_begin; i < attrs.size(); ++i)
+                    if (names_equal(attrs[i].key, key, opt))
+                        throw Error("Duplicate attribute", text);
+
+                attrs.push_back({key, value});
+
+            }
+
+            if (tag.closing)
+                attrs.resize(attr_begin);
+            else if (! tag.empty && has_bit(opt, Options::selfclose)
+                    && Detail::html_self_closing_tags().contains(ascii_lowercase(tag.name)))
+                tag.empty = true;
+
+            return tag;
+
+        }
+
+        // Parser for the read-only document view. This follows the same
+        // grammar as ParseState, but records views into the source text in a
+        // flat node array instead of building a tree of node objects. Text
+        // runs are kept whole, with entities left to be decoded on demand.
+
+        class ViewParseState {
+
+        public:
+
+            explicit ViewParseState(Detail::ViewData& data):
+                data_(&data), xml_(data.source), opt_(data.opt) {}
+
+            void parse();
+
+        private:
+
+            Detail::ViewData* data_;
+            std::string_view xml_;
+            Options opt_;
+            std::vector<uint32_t> context_;
+
+            uint32_t append(NodeType type, std::string_view raw, std::string_view name = {});
+            void close_element(const char* end) noexcept;
+            std::string_view read(size_t len) noexcept;
+            void read_markup();
+            void read_simple(NodeType type, std::string_view terminator, size_t min_size, const char* message);
+            void read_tag();
+            void read_text();
+
+        };
+
+            void ViewParseState::parse() {
+
+                data_->nodes.clear();
+                data_->attrs.clear();
+
+                // Every node except a text node starts with a tag, and every
+                // text node ends at one, so the number of tags is a close
+                // estimate of the final node count. The margin avoids a
+                // reallocation when there are a few more text nodes than end
+                // tags, which would double the size of the largest buffer.
+
+                auto tags = size_t(std::count(xml_.begin(), xml_.end(), '<'));
+                data_->nodes.reserve(tags + tags / 4 + 16);
+                data_->nodes.push_back({});
+                data_->nodes[0].type = NodeType::document;
+                data_->nodes[0].raw = xml_;
+                context_.assign(1, 0);
+
+                while (! xml_.empty()) {
+                    if (xml_[0] == '<' && xml_.size() >= 3)
+                        read_markup();
+                    else
+                        read_text();
+                }
+
+                while (context_.size() > 1)
+                    close_element(xml_.data());
+
+            }
+
+            uint32_t ViewParseState::append(NodeType type, std::string_view raw, std::string_view name) {
+
+                auto& nodes = data_->nodes;
+
+                if (nodes.size() >= std::numeric_limits<uint32_t>::max())
+                    throw Error("Document is too large");
+
+                auto index = uint32_t(nodes.size());
+                auto parent_index = context_.back();
+                auto& node = nodes.emplace_back();
+                node.type = type;
+                node.raw = raw;
+                node.name = name;
+                node.parent = parent_index;
+                auto& parent = nodes[parent_index];
+
+                if (parent.children == 0)
+                    parent.first_child = index;
+                else
+                    nodes[parent.last_child].next_sibling = index;
+
+                parent.last_child = index;
+                ++parent.children;
+
+                return index;
+
+            }
+
+            void ViewParseState::close_element(const char* end) noexcept {
+                auto& node = data_->nodes[context_.back()];
+                node.raw = std::string_view(node.raw.data(), size_t(end - node.raw.data()));
+                context_.pop_back();
+            }
+
+            std::string_view ViewParseState::read(size_t len) noexcept {
+                auto prefix = xml_.substr(0, len);
+                xml_ = xml_.substr(prefix.size(), npos);
+                return prefix;
+            }
+
+            void ViewParseState::read_markup() {
+
+                if (xml_[1] == '!') {
+
+                    if (xml_[2] == '-') {
+                        read_simple(NodeType::comment, "-->", 4, "Invalid comment");
+                    } else if (xml_[2] == '[') {
+                        read_simple(NodeType::cdata, "]]>", 0, "Invalid character data");
+                    } else if (xml_[2] == 'D') {
+                        size_t end = find_end(xml_);
+                        if (end == npos)
+                            throw Error("Invalid document type definition", xml_);
+                        append(NodeType::dtd, read(end));
+                        skip_line_break(xml_);
+                    } else {
+                        throw Error({}, xml_);
+                    }
+
+                } else if (xml_[1] == '?') {
+
+                    if (ascii_lowercase(xml_.substr(2, 3)) == "xml") {
+                        size_t end = find_end(xml_);
+                        if (end == npos)
+                            throw Error("Invalid XML declaration", xml_);
+                        append(NodeType::xmldecl, read(end));
+                        skip_line_break(xml_);
+                    } else {
+                        read_simple(NodeType::processing, "?>", 0, "Invalid processing instruction");
+                    }
+
+                } else if (xml_[1] == '/' || is_valid_name_start(xml_[1])) {
+
+                    read_tag();
+
+                } else {
+
+                    throw Error({}, xml_);
+
+                }
+
+            }
+
+            void ViewParseState::read_simple(NodeType type, std::string_view terminator, size_t min_size, const char* message) {
+
+                auto end = xml_.find(terminator);
+
+                if (end == npos || end < min_size)
+                    throw Error(message, xml_);
+
+                auto text = read(end + terminator.size());
+
+                if (type != NodeType::comment || has_bit(opt_, Options::comments))
+                    append(type, text);
+
+            }
+
+            void ViewParseState::read_tag() {
+
+                size_t end = find_end(xml_);
+
+                if (end == npos)
+                    throw Error("Invalid element", xml_);
+
+                auto text = read(end);
+                auto& attrs = data_->attrs;
+                auto attr_begin = attrs.size();
+                auto tag = read_tag_view(text, opt_, attrs);
+
+                if (tag.closing) {
+
+                    auto i = context_.size();
+
+                    while (i > 1 && ! names_equal(data_->nodes[context_[i - 1]].name, tag.name, opt_))
+                        --i;
+
+                    if (has_bit(opt_, Options::autoclose)) {
+                        if (i > 1) {
+                            while (context_.size() > i)
+                                close_element(text.data());
+                            close_element(text.data() + text.size());
+                        }
+                    } else {
+                        if (i == 1 || i != context_.size())
+                            throw Error("Unmatched closing tag", text);
+                        close_element(text.data() + text.size());
+                    }
+
+                } else {
+
+                    auto index = append(NodeType::element, text, tag.name);
+                    auto& node = data_->nodes[index];
+                    node.attr_begin = uint32_t(attr_begin);
+                    node.attr_count = uint32_t(attrs.size() - attr_begin);
+
+                    if (! tag.empty)
+                        context_.push_back(index);
+
+                }
+
+            }
+
+            void ViewParseState::read_text() {
+
+                auto end = xml_.find('<', 1);
+                auto text = read(end);
+                auto& nodes = data_->nodes;
+                auto& parent = nodes[context_.back()];
+
+                if (parent.children != 0) {
+                    auto& prev = nodes[parent.last_child];
+                    if (prev.type == NodeType::text && prev.raw.data() + prev.raw.size() == text.data()) {
+                        prev.raw = std::string_view(prev.raw.data(), prev.raw.size() + text.size());
+                        return;
+                    }
+                }
+
+                append(NodeType::text, text);
+
+            }
+
     }
 
     namespace Detail {
@@ -603,8 +1053,14 @@ namespace Crow::Xml {
 
     std::string decode_text(std::string_view str, Options opt) {
 
+        size_t i = str.find('&');
+
+        if (i == npos)
+            return std::string(str);
+
         std::string text;
-        size_t i = 0;
+        text.reserve(str.size());
+        text.append(str, 0, i);
         size_t len = str.size();
 
         while (i < len) {
@@ -633,20 +1089,21 @@ namespace Crow::Xml {
 
     std::string encode_text(std::string_view str) {
 
-        std::string xml;
-        auto i = str.begin();
-        auto end = str.end();
+        auto i = find_special(str);
 
-        while (i != end) {
+        if (i == npos)
+            return std::string(str);
 
-            auto j = std::find_if(i, end, is_special_char);
-            xml.append(i, j);
+        std::string xml;
+        xml.reserve(str.size() + str.size() / 8);
+        xml.append(str, 0, i);
 
-            if (j == end)
-                break;
+        while (i != npos) {
 
-            xml_encode_char(uint8_t(*j), xml);
-            i = j + 1;
+            xml_encode_char(uint8_t(str[i]), xml);
+            auto j = find_special(str, i + 1);
+            xml.append(str, i + 1, j - i - 1);
+            i = j;
 
         }
 
@@ -902,6 +1359,133 @@ namespace Crow::Xml {
 
     }
 
+    // Element index
+
+    namespace Detail {
+
+        struct IndexStamp {
+            std::atomic<bool> stale = false;
+        };
+
+        struct ElementIndex {
+
+            struct name_list {
+                std::vector<ElementPtr> elements;
+                std::vector<uint32_t> positions;
+            };
+
+            static constexpr uint32_t none = ~ uint32_t(0);
+
+            std::shared_ptr<IndexStamp> stamp = std::make_shared<IndexStamp>();
+            std::vector<ElementPtr> elements;
+            std::vector<std::string> names;
+            std::vector<uint32_t> parents;
+            std::vector<uint32_t> ends;
+            std::unordered_map<std::string, name_list> by_name;
+            std::unordered_map<std::string, name_list> by_folded_name;
+            bool folded = false;
+
+            bool stale() const noexcept { return stamp->stale.load(std::memory_order_acquire); }
+            void build(const CompoundNode& root);
+            void fold();
+            const name_list* find(const std::string& name, Options opt) const;
+            void watch(const CompoundNode& node) const;
+
+        };
+
+            void ElementIndex::build(const CompoundNode& root) {
+
+                // Elements are numbered in document order, so the descendants
+                // of each element occupy the range of positions up to its end.
+                // Every compound node is stamped, so that a structural change
+                // to any of them invalidates this index and no other.
+
+                struct frame {
+                    CompoundNode::iterator current;
+                    CompoundNode::iterator end;
+                    uint32_t parent;
+                };
+
+                static std::mutex watch_mutex;
+                std::unique_lock lock(watch_mutex);
+                watch(root);
+                std::vector<frame> stack = {{root.begin(), root.end(), none}};
+
+                while (! stack.empty()) {
+
+                    auto& top = stack.back();
+
+                    if (top.current == top.end) {
+                        if (top.parent != none)
+                            ends[top.parent] = uint32_t(elements.size());
+                        stack.pop_back();
+                        continue;
+                    }
+
+                    auto& node = *top.current++;
+
+                    if (node->type() != NodeType::element)
+                        continue;
+
+                    if (elements.size() >= none)
+                        throw Error("Document is too large to index");
+
+                    auto element = std::static_pointer_cast<Element>(node);
+                    auto pos = uint32_t(elements.size());
+                    watch(*element);
+                    elements.push_back(element);
+                    names.push_back(element->name());
+                    parents.push_back(top.parent);
+                    ends.push_back(pos + 1);
+                    auto& list = by_name[names.back()];
+                    list.elements.push_back(element);
+                    list.positions.push_back(pos);
+
+                    if (! element->empty())
+                        stack.push_back({element->begin(), element->end(), pos});
+
+                }
+
+            }
+
+            void ElementIndex::fold() {
+
+                for (uint32_t pos = 0; pos < elements.size(); ++pos) {
+                    auto& list = by_folded_name[ascii_lowercase(names[pos])];
+                    list.elements.push_back(elements[pos]);
+                    list.positions.push_back(pos);
+                }
+
+                folded = true;
+
+            }
+
+            const ElementIndex::name_list* ElementIndex::find(const std::string& name, Options opt) const {
+
+                if (has_bit(opt, Options::icase)) {
+                    auto it = by_folded_name.find(ascii_lowercase(name));
+                    return it == by_folded_name.end() ? nullptr : &it->second;
+                } else {
+                    auto it = by_name.find(name);
+                    return it == by_name.end() ? nullptr : &it->second;
+                }
+
+            }
+
+            void ElementIndex::watch(const CompoundNode& node) const {
+                std::erase_if(node.watchers_, [] (auto& w) { return w.expired(); });
+                node.watchers_.push_back(stamp);
+            }
+
+    }
+
+    void CompoundNode::notify_watchers() noexcept {
+        for (auto& w: watchers_)
+            if (auto stamp = w.lock())
+                stamp->stale.store(true, std::memory_order_release);
+        watchers_.clear();
+    }
+
     // Document class
 
     Document::Document(hidden, std::string_view xml, Options opt) {
@@ -932,10 +1516,673 @@ namespace Crow::Xml {
             return nullptr;
     }
 
-    void Document::init_xmldecl(Options opt) {
-        if (! has_bit(opt, Options::noxmldecl)
-                && (empty() || front()->type() != NodeType::xmldecl))
-            insert(begin(), Xmldecl::create());
+    Document::Document(const Document& doc):
+    DerivedNode(doc) {}
+
+    std::span<const ElementPtr> Document::elements(const std::string& name, Options opt) const {
+        auto list = index(opt)->find(name, opt);
+        if (list == nullptr)
+            return {};
+        else
+            return list->elements;
+    }
+
+    std::vector<ElementPtr> Document::query(const Query& q) const {
+        return q.evaluate(*index(q.options()));
+    }
+
+    std::shared_ptr<const Detail::ElementIndex> Document::index(Options opt) const {
+
+        // The index is built or rebuilt under the document's lock, and so
+        // are the case folded name lists, the first time a case insensitive
+        // lookup needs them. A copied document starts without an index.
+
+        std::unique_lock lock(index_mutex_);
+
+        if (! index_ || index_->stale()) {
+            auto index = std::make_shared<Detail::ElementIndex>();
+            index->build(*this);
+            index_ = index;
+        }
+
+        if (has_bit(opt, Options::icase) && ! index_->folded)
+            index_->fold();
+
+        return index_;
+
+    }
+
+    void Document::init_xmldecl(Options opt) {
+        if (! has_bit(opt, Options::noxmldecl)
+                && (empty() || front()->type() != NodeType::xmldecl))
+            insert(begin(), Xmldecl::create());
+    }
+
+    // Query class
+
+    Query::Query(std::string_view path, Options opt):
+    opt_(opt & Options::icase) {
+
+        auto fail = [path] { throw Error("Invalid query", path); };
+        auto rest = path;
+        bool icase = has_bit(opt_, Options::icase);
+
+        if (rest.empty())
+            fail();
+
+        while (! rest.empty()) {
+
+            step s;
+
+            if (rest.starts_with("//")) {
+                s.descendant = true;
+                rest = rest.substr(2);
+            } else if (rest[0] == '/') {
+                rest = rest.substr(1);
+            } else if (steps_.empty()) {
+                s.descendant = true;
+            } else {
+                fail();
+            }
+
+            if (rest.starts_with('*')) {
+                s.name = "*";
+                rest = rest.substr(1);
+            } else {
+                s.name = read_name(rest);
+                if (s.name.empty())
+                    fail();
+                if (icase)
+                    s.name = ascii_lowercase(s.name);
+            }
+
+            while (rest.starts_with("[@")) {
+
+                rest = rest.substr(2);
+                predicate p;
+                p.key = read_name(rest);
+
+                if (p.key.empty())
+                    fail();
+
+                if (icase)
+                    p.key = ascii_lowercase(p.key);
+
+                if (rest.starts_with('=')) {
+                    rest = rest.substr(1);
+                    if (rest.empty() || (rest[0] != '\'' && rest[0] != '\"'))
+                        fail();
+                    auto end = rest.find(rest[0], 1);
+                    if (end == npos)
+                        fail();
+                    p.value = rest.substr(1, end - 1);
+                    p.has_value = true;
+                    rest = rest.substr(end + 1);
+                }
+
+                if (! rest.starts_with(']'))
+                    fail();
+
+                rest = rest.substr(1);
+                s.predicates.push_back(std::move(p));
+
+            }
+
+            steps_.push_back(std::move(s));
+
+        }
+
+    }
+
+    std::string Query::str() const {
+
+        std::string out;
+
+        for (auto& s: steps_) {
+            out += s.descendant ? "//" : "/";
+            out += s.name;
+            for (auto& p: s.predicates) {
+                out += "[@" + p.key;
+                if (p.has_value) {
+                    char q = p.value.find('\'') == npos ? '\'' : '\"';
+                    out += '=';
+                    out += q;
+                    out += p.value;
+                    out += q;
+                }
+                out += ']';
+            }
+        }
+
+        return out;
+
+    }
+
+    std::vector<ElementPtr> Query::evaluate(const Detail::ElementIndex& index) const {
+
+        // Each step maps a set of context elements (initially the document
+        // root) to the matching elements within their subtrees. Candidates
+        // for a step come from the index, and the descendants of a context
+        // element are a contiguous range of positions, so each context only
+        // costs a binary search plus the candidates inside its range.
+
+        static constexpr auto none = Detail::ElementIndex::none;
+
+        auto total = uint32_t(index.elements.size());
+        std::vector<uint32_t> contexts = {none};
+        std::vector<uint32_t> next;
+        std::vector<uint32_t> all;
+
+        for (auto& s: steps_) {
+
+            const std::vector<uint32_t>* candidates = nullptr;
+
+            if (s.name == "*") {
+                if (all.empty()) {
+                    all.resize(total);
+                    std::iota(all.begin(), all.end(), 0);
+                }
+                candidates = &all;
+            } else if (auto list = index.find(s.name, opt_)) {
+                candidates = &list->positions;
+            } else {
+                return {};
+            }
+
+            next.clear();
+            uint32_t covered = 0;
+
+            for (auto c: contexts) {
+
+                uint32_t begin = c == none ? 0 : c + 1;
+                uint32_t end = c == none ? total : index.ends[c];
+
+                // A descendant step from a context inside the range already
+                // searched would only find the same elements again
+
+                if (s.descendant) {
+                    if (begin < covered)
+                        continue;
+                    covered = end;
+                }
+
+                auto it = std::lower_bound(candidates->begin(), candidates->end(), begin);
+
+                for (; it != candidates->end() && *it < end; ++it)
+                    if ((s.descendant || index.parents[*it] == c)
+                            && match_predicates(*index.elements[*it], s))
+                        next.push_back(*it);
+
+            }
+
+            // Child steps from nested contexts can interleave
+
+            if (! s.descendant) {
+                std::sort(next.begin(), next.end());
+                next.erase(std::unique(next.begin(), next.end()), next.end());
+            }
+
+            contexts.swap(next);
+
+            if (contexts.empty())
+                break;
+
+        }
+
+        std::vector<ElementPtr> result;
+        result.reserve(contexts.size());
+
+        for (auto pos: contexts)
+            result.push_back(index.elements[pos]);
+
+        return result;
+
+    }
+
+    bool Query::match_predicates(const Element& element, const step& s) const {
+
+        for (auto& p: s.predicates) {
+
+            std::string value;
+
+            if (element.has_attr(p.key)) {
+                value = element.attr(p.key);
+            } else if (has_bit(opt_, Options::icase)) {
+                auto range = element.attr_range();
+                auto it = std::find_if(range.begin(), range.end(),
+                    [&p] (auto& attr) { return AsciiIcaseEqual()(attr.first, p.key); });
+                if (it == range.end())
+                    return false;
+                value = it->second;
+            } else {
+                return false;
+            }
+
+            if (p.has_value && value != p.value)
+                return false;
+
+        }
+
+        return true;
+
+    }
+
+    // NodeView class
+
+    std::string NodeView::text() const {
+
+        if (! data_)
+            return {};
+
+        auto& rec = record();
+
+        switch (rec.type) {
+            case NodeType::text:
+                if (has_bit(data_->opt, Options::foldws))
+                    return decode_text(fold_ws(rec.raw), data_->opt);
+                else
+                    return decode_text(rec.raw, data_->opt);
+            case NodeType::cdata:
+                return cdata_content(rec.raw);
+            case NodeType::element:
+            case NodeType::document: {
+                std::string out;
+                append_text(out);
+                return out;
+            }
+            default:
+                return {};
+        }
+
+    }
+
+    NodeView NodeView::parent() const noexcept {
+        if (! data_ || index_ == 0)
+            return {};
+        else
+            return {data_, record().parent};
+    }
+
+    NodeView NodeView::child(std::string_view element) const noexcept {
+        for (auto node = first_child(); node; node = node.next_sibling())
+            if (node.type() == NodeType::element && name_equal(node.name(), element))
+                return node;
+        return {};
+    }
+
+    std::string NodeView::attr(std::string_view key) const {
+        auto ptr = find_attr(key);
+        if (ptr == nullptr)
+            return {};
+        else
+            return decode_text(ptr->value, data_->opt);
+    }
+
+    std::string_view NodeView::attr_view(std::string_view key) const noexcept {
+        auto ptr = find_attr(key);
+        return ptr == nullptr ? std::string_view() : ptr->value;
+    }
+
+    std::span<const AttributeView> NodeView::attrs() const noexcept {
+        if (! data_)
+            return {};
+        auto& rec = record();
+        return {data_->attrs.data() + rec.attr_begin, rec.attr_count};
+    }
+
+    const AttributeView* NodeView::find_attr(std::string_view key) const noexcept {
+        for (auto& a: attrs())
+            if (name_equal(a.key, key))
+                return &a;
+        return nullptr;
+    }
+
+    bool NodeView::name_equal(std::string_view a, std::string_view b) const noexcept {
+        return names_equal(a, b, data_->opt);
+    }
+
+    NodeView NodeView::related(uint32_t Detail::ViewRecord::*link) const noexcept {
+        if (! data_)
+            return {};
+        auto index = record().*link;
+        if (index == 0)
+            return {};
+        else
+            return {data_, index};
+    }
+
+    void NodeView::append_text(std::string& out) const {
+        for (auto node = first_child(); node; node = node.next_sibling()) {
+            auto type = node.type();
+            if (type == NodeType::text || type == NodeType::cdata)
+                out += node.text();
+            else if (type == NodeType::element)
+                node.append_text(out);
+        }
+    }
+
+    // DocumentView class
+
+    DocumentView::DocumentView():
+    data_(std::make_unique<Detail::ViewData>()) {
+        data_->nodes.emplace_back();
+        data_->nodes[0].type = NodeType::document;
+    }
+
+    DocumentView::DocumentView(std::string xml, Options opt):
+    data_(std::make_unique<Detail::ViewData>()) {
+        data_->source = std::move(xml);
+        data_->opt = opt;
+        ViewParseState state(*data_);
+        state.parse();
+    }
+
+    NodeView DocumentView::document_element() const noexcept {
+        for (auto node: root())
+            if (node.type() == NodeType::element)
+                return node;
+        return {};
+    }
+
+    size_t DocumentView::memory() const noexcept {
+        return sizeof(Detail::ViewData)
+            + data_->source.capacity()
+            + data_->nodes.capacity() * sizeof(Detail::ViewRecord)
+            + data_->attrs.capacity() * sizeof(AttributeView);
+    }
+
+    // Reader class
+
+    Reader::Reader(IoBase& in, Options opt, size_t block):
+    in_(&in), block_(std::max(block, size_t(16))), opt_(opt), eof_(false) {}
+
+    Reader::Reader(std::string_view xml, Options opt) noexcept:
+    src_(xml), opt_(opt) {}
+
+    bool Reader::next() {
+
+        name_ = raw_ = {};
+        attrs_.clear();
+
+        if (pop_pending_) {
+            stack_.pop_back();
+            pop_pending_ = false;
+        }
+
+        if (pending_ends_ > 0) {
+            --pending_ends_;
+            return end_event(pending_ends_ == 0 ? close_raw_ : std::string_view());
+        }
+
+        if (skip_break_) {
+            while (available().size() < 2 && fill()) {}
+            auto xml = available();
+            auto size = xml.size();
+            skip_line_break(xml);
+            pos_ += size - xml.size();
+            skip_break_ = false;
+        }
+
+        for (;;) {
+
+            while (available().size() < 3 && fill()) {}
+            auto xml = available();
+
+            if (xml.empty()) {
+                if (stack_.empty()) {
+                    event_ = ReaderEvent::none;
+                    return false;
+                }
+                pending_ends_ = stack_.size() - 1;
+                close_raw_ = {};
+                return end_event({});
+            }
+
+            if (xml[0] != '<' || xml.size() < 3) {
+                read_text();
+                return true;
+            }
+
+            if (read_markup())
+                return true;
+
+        }
+
+    }
+
+    void Reader::skip() {
+
+        if (event_ != ReaderEvent::start)
+            return;
+
+        auto target = depth();
+
+        while (next())
+            if (event_ == ReaderEvent::end && depth() == target)
+                return;
+
+    }
+
+    std::string Reader::text() const {
+        switch (event_) {
+            case ReaderEvent::text:
+                if (has_bit(opt_, Options::foldws))
+                    return decode_text(fold_ws(raw_), opt_);
+                else
+                    return decode_text(raw_, opt_);
+            case ReaderEvent::cdata:
+                return cdata_content(raw_);
+            default:
+                return {};
+        }
+    }
+
+    std::string Reader::attr(std::string_view key) const {
+        auto ptr = find_attr(key);
+        if (ptr == nullptr)
+            return {};
+        else
+            return decode_text(ptr->value, opt_);
+    }
+
+    std::string_view Reader::attr_view(std::string_view key) const noexcept {
+        auto ptr = find_attr(key);
+        return ptr == nullptr ? std::string_view() : ptr->value;
+    }
+
+    bool Reader::end_event(std::string_view raw) {
+        event_ = ReaderEvent::end;
+        name_ = stack_.back();
+        raw_ = raw;
+        pop_pending_ = true;
+        return true;
+    }
+
+    bool Reader::fill() {
+
+        // Discarding the consumed prefix here invalidates the views from
+        // the previous event, so this must only be called between events
+
+        if (eof_)
+            return false;
+
+        if (pos_ > 0) {
+            buf_.erase(0, pos_);
+            pos_ = 0;
+        }
+
+        auto n = in_->read_some(buf_, block_);
+        src_ = buf_;
+        eof_ = n == 0;
+
+        return ! eof_;
+
+    }
+
+    const AttributeView* Reader::find_attr(std::string_view key) const noexcept {
+        for (auto& a: attrs_)
+            if (names_equal(a.key, key, opt_))
+                return &a;
+        return nullptr;
+    }
+
+    size_t Reader::find_terminator(std::string_view terminator, size_t from) {
+
+        for (;;) {
+
+            auto xml = available();
+            auto i = xml.find(terminator, from);
+
+            if (i != npos)
+                return i;
+
+            if (xml.size() >= from + terminator.size())
+                from = xml.size() - terminator.size() + 1;
+
+            if (! fill())
+                return npos;
+
+        }
+
+    }
+
+    size_t Reader::find_tag_end() {
+
+        for (;;) {
+
+            auto i = find_end(available());
+
+            if (i != npos || ! fill())
+                return i;
+
+        }
+
+    }
+
+    bool Reader::read_markup() {
+
+        auto xml = available();
+
+        if (xml[1] == '!') {
+
+            if (xml[2] == '-') {
+                return read_simple(ReaderEvent::comment, "-->", 4, "Invalid comment");
+            } else if (xml[2] == '[') {
+                return read_simple(ReaderEvent::cdata, "]]>", 0, "Invalid character data");
+            } else if (xml[2] == 'D') {
+                auto end = find_tag_end();
+                if (end == npos)
+                    throw Error("Invalid document type definition", available());
+                event_ = ReaderEvent::dtd;
+                raw_ = take(end);
+                skip_break_ = true;
+                return true;
+            } else {
+                throw Error({}, xml);
+            }
+
+        } else if (xml[1] == '?') {
+
+            while (available().size() < 5 && fill()) {}
+
+            if (ascii_lowercase(available().substr(2, 3)) == "xml") {
+                auto end = find_tag_end();
+                if (end == npos)
+                    throw Error("Invalid XML declaration", available());
+                event_ = ReaderEvent::xmldecl;
+                raw_ = take(end);
+                skip_break_ = true;
+                return true;
+            } else {
+                return read_simple(ReaderEvent::processing, "?>", 0, "Invalid processing instruction");
+            }
+
+        } else if (xml[1] == '/' || is_valid_name_start(xml[1])) {
+
+            return read_tag();
+
+        } else {
+
+            throw Error({}, xml);
+
+        }
+
+    }
+
+    bool Reader::read_simple(ReaderEvent event, std::string_view terminator, size_t min_size, const char* message) {
+
+        auto end = find_terminator(terminator);
+
+        if (end == npos || end < min_size)
+            throw Error(message, available());
+
+        auto text = take(end + terminator.size());
+
+        if (event == ReaderEvent::comment && ! has_bit(opt_, Options::comments))
+            return false;
+
+        event_ = event;
+        raw_ = text;
+
+        return true;
+
+    }
+
+    bool Reader::read_tag() {
+
+        auto end = find_tag_end();
+
+        if (end == npos)
+            throw Error("Invalid element", available());
+
+        auto text = take(end);
+        auto tag = read_tag_view(text, opt_, attrs_);
+
+        if (tag.closing) {
+
+            auto i = stack_.size();
+
+            while (i > 0 && ! names_equal(stack_[i - 1], tag.name, opt_))
+                --i;
+
+            if (has_bit(opt_, Options::autoclose)) {
+                if (i == 0)
+                    return false;
+            } else if (i == 0 || i != stack_.size()) {
+                throw Error("Unmatched closing tag", text);
+            }
+
+            pending_ends_ = stack_.size() - i;
+            close_raw_ = text;
+
+            return end_event(pending_ends_ == 0 ? text : std::string_view());
+
+        }
+
+        event_ = ReaderEvent::start;
+        name_ = tag.name;
+        raw_ = text;
+        stack_.emplace_back(tag.name);
+
+        if (tag.empty) {
+            pending_ends_ = 1;
+            close_raw_ = {};
+        }
+
+        return true;
+
+    }
+
+    void Reader::read_text() {
+        auto end = find_terminator("<", 1);
+        event_ = ReaderEvent::text;
+        raw_ = take(end);
+    }
+
+    std::string_view Reader::take(size_t len) noexcept {
+        auto prefix = available().substr(0, len);
+        pos_ += prefix.size();
+        return prefix;
     }
 
 }
@@ -2,13 +2,17 @@
 
 #include "crow/enum.hpp"
 #include "crow/iterator.hpp"
+#include "crow/stdio.hpp"
 #include "crow/types.hpp"
 #include <compare>
 #include <concepts>
+#include <cstdint>
 #include <functional>
 #include <iterator>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -24,9 +28,13 @@ namespace Crow::Xml {
     // Forward declarations
 
     class AttributeMap;
+    class DocumentView;
     class Error;
     class NodeIterator;
+    class NodeView;
     class PathIterator;
+    class Query;
+    class Reader;
 
     class Node;
         class SimpleNode;
@@ -65,6 +73,9 @@ namespace Crow::Xml {
         using StringViewSet = std::unordered_set<std::string_view>;
         using StringViewMap = std::unordered_map<std::string_view, std::string_view>;
 
+        struct ElementIndex;
+        struct IndexStamp;
+
         std::string dump(NodePtr node);
         const StringViewSet& html_self_closing_tags();
         const StringViewMap& xml_entity_table();
@@ -282,12 +293,12 @@ namespace Crow::Xml {
         iterator end() const noexcept { return iterator(children_.end()); }
         NodePtr child(size_t i) const noexcept { return i < children_.size() ? children_[i] : NodePtr(); }
         size_t children() const noexcept { return children_.size(); }
-        void clear() noexcept { children_.clear(); }
+        void clear() noexcept { children_.clear(); changed(); }
         bool empty() const noexcept { return children_.empty(); }
-        void erase(iterator i) noexcept { children_.erase(i); }
+        void erase(iterator i) noexcept { children_.erase(i); changed(); }
         const NodePtr& front() const noexcept { return *begin(); }
         const NodePtr& back() const noexcept { return end()[-1]; }
-        iterator insert(iterator i, NodePtr node) { return children_.insert(i, node); }
+        iterator insert(iterator i, NodePtr node) { changed(); return children_.insert(i, node); }
         void pop_back() noexcept { erase(std::prev(end())); }
         void push_back(NodePtr node) { insert(end(), node); }
         CompoundNode& operator+=(NodePtr node) { push_back(node); return *this; }
@@ -299,9 +310,18 @@ namespace Crow::Xml {
 
     private:
 
+        friend struct Detail::ElementIndex;
+
+        // Stamps of the document indexes that cover this node
+
+        using watcher_list = std::vector<std::weak_ptr<Detail::IndexStamp>>;
+
         Detail::NodeList children_;
+        mutable watcher_list watchers_;
 
         void check_insert(NodePtr node) const;
+        void changed() noexcept { if (! watchers_.empty()) notify_watchers(); }
+        void notify_watchers() noexcept;
 
     };
 
@@ -364,18 +384,251 @@ namespace Crow::Xml {
 
         explicit Document(hidden, Options opt = {}) { init_xmldecl(opt); }
         explicit Document(hidden, std::string_view xml, Options opt = {});
+        Document(const Document& doc);
+        Document& operator=(const Document&) = delete;
 
         XmldeclPtr xmldecl() const noexcept;
         DtdPtr dtd() const noexcept;
 
+        std::span<const ElementPtr> elements(const std::string& name, Options opt = {}) const;
+        std::vector<ElementPtr> query(const Query& q) const;
+
     protected:
 
         std::string outer_core(Options opt) const override { return inner(opt); }
 
     private:
 
+        friend class Query;
+
+        mutable std::mutex index_mutex_;
+        mutable std::shared_ptr<Detail::ElementIndex> index_;
+
+        std::shared_ptr<const Detail::ElementIndex> index(Options opt) const;
         void init_xmldecl(Options opt);
 
     };
 
+    class Query {
+
+    public:
+
+        Query() = default;
+        explicit Query(std::string_view path, Options opt = {});
+
+        bool empty() const noexcept { return steps_.empty(); }
+        Options options() const noexcept { return opt_; }
+        std::string str() const;
+
+    private:
+
+        friend class Document;
+
+        struct predicate {
+            std::string key;
+            std::string value;
+            bool has_value = false;
+        };
+
+        struct step {
+            std::string name;
+            std::vector<predicate> predicates;
+            bool descendant = false;
+        };
+
+        std::vector<step> steps_;
+        Options opt_ = Options::none;
+
+        std::vector<ElementPtr> evaluate(const Detail::ElementIndex& index) const;
+        bool match_predicates(const Element& element, const step& s) const;
+
+    };
+
+    // Read-only document view
+
+    struct AttributeView {
+        std::string_view key;
+        std::string_view value;
+    };
+
+    namespace Detail {
+
+        struct ViewRecord {
+            std::string_view name;
+            std::string_view raw;
+            uint32_t parent = 0;
+            uint32_t first_child = 0;
+            uint32_t last_child = 0;
+            uint32_t next_sibling = 0;
+            uint32_t children = 0;
+            uint32_t attr_begin = 0;
+            uint32_t attr_count = 0;
+            NodeType type = NodeType::null;
+        };
+
+        struct ViewData {
+            std::string source;
+            std::vector<ViewRecord> nodes;
+            std::vector<AttributeView> attrs;
+            Options opt = Options::none;
+        };
+
+    }
+
+    class NodeView {
+
+    public:
+
+        class iterator;
+
+        NodeView() = default;
+
+        explicit operator bool() const noexcept { return data_ != nullptr; }
+
+        NodeType type() const noexcept { return data_ ? record().type : NodeType::null; }
+        std::string_view name() const noexcept { return data_ ? record().name : std::string_view(); }
+        std::string_view raw() const noexcept { return data_ ? record().raw : std::string_view(); }
+        std::string text() const;
+
+        NodeView parent() const noexcept;
+        NodeView first_child() const noexcept { return related(&Detail::ViewRecord::first_child); }
+        NodeView last_child() const noexcept { return related(&Detail::ViewRecord::last_child); }
+        NodeView next_sibling() const noexcept { return related(&Detail::ViewRecord::next_sibling); }
+        NodeView child(std::string_view element) const noexcept;
+        size_t children() const noexcept { return data_ ? record().children : 0; }
+        bool empty() const noexcept { return children() == 0; }
+        iterator begin() const noexcept;
+        iterator end() const noexcept;
+
+        std::string attr(std::string_view key) const;
+        std::string_view attr_view(std::string_view key) const noexcept;
+        std::span<const AttributeView> attrs() const noexcept;
+        bool has_attr(std::string_view key) const noexcept { return find_attr(key) != nullptr; }
+        size_t num_attrs() const noexcept { return data_ ? record().attr_count : 0; }
+
+        bool operator==(const NodeView& n) const noexcept { return data_ == n.data_ && index_ == n.index_; }
+
+    private:
+
+        friend class DocumentView;
+
+        const Detail::ViewData* data_ = nullptr;
+        uint32_t index_ = 0;
+
+        NodeView(const Detail::ViewData* data, uint32_t index) noexcept: data_(data), index_(index) {}
+
+        const Detail::ViewRecord& record() const noexcept { return data_->nodes[index_]; }
+        const AttributeView* find_attr(std::string_view key) const noexcept;
+        bool name_equal(std::string_view a, std::string_view b) const noexcept;
+        NodeView related(uint32_t Detail::ViewRecord::*link) const noexcept;
+        void append_text(std::string& out) const;
+
+    };
+
+    class NodeView::iterator:
+    public ForwardIterator<iterator, const NodeView> {
+    public:
+        iterator() = default;
+        explicit iterator(NodeView node) noexcept: node_(node) {}
+        const NodeView& operator*() const noexcept { return node_; }
+        iterator& operator++() noexcept { node_ = node_.next_sibling(); return *this; }
+        bool operator==(const iterator& i) const noexcept { return node_ == i.node_; }
+    private:
+        NodeView node_;
+    };
+
+    inline NodeView::iterator NodeView::begin() const noexcept { return iterator(first_child()); }
+    inline NodeView::iterator NodeView::end() const noexcept { return {}; }
+
+    class DocumentView {
+
+    public:
+
+        DocumentView();
+        explicit DocumentView(std::string xml, Options opt = {});
+
+        NodeView root() const noexcept { return {data_.get(), 0}; }
+        NodeView document_element() const noexcept;
+        size_t nodes() const noexcept { return data_->nodes.size(); }
+        size_t memory() const noexcept;
+        Options options() const noexcept { return data_->opt; }
+        std::string_view source() const noexcept { return data_->source; }
+
+    private:
+
+        std::unique_ptr<Detail::ViewData> data_;
+
+    };
+
+    // Streaming reader
+
+    CROW_ENUM_SCOPED(ReaderEvent, int,
+        none,
+        xmldecl,
+        dtd,
+        start,
+        end,
+        text,
+        cdata,
+        comment,
+        processing,
+    )
+
+    class Reader {
+
+    public:
+
+        Reader() = default;
+        explicit Reader(IoBase& in, Options opt = {}, size_t block = IoBase::default_length);
+        explicit Reader(std::string_view xml, Options opt = {}) noexcept;
+
+        bool next();
+        void skip();
+
+        ReaderEvent event() const noexcept { return event_; }
+        std::string_view name() const noexcept { return name_; }
+        std::string_view raw() const noexcept { return raw_; }
+        std::string text() const;
+        size_t depth() const noexcept { return stack_.size(); }
+        bool is_empty() const noexcept { return event_ == ReaderEvent::start && pending_ends_ > 0; }
+        Options options() const noexcept { return opt_; }
+
+        std::string attr(std::string_view key) const;
+        std::string_view attr_view(std::string_view key) const noexcept;
+        std::span<const AttributeView> attrs() const noexcept { return attrs_; }
+        bool has_attr(std::string_view key) const noexcept { return find_attr(key) != nullptr; }
+
+    private:
+
+        IoBase* in_ = nullptr;
+        size_t block_ = IoBase::default_length;
+        std::string buf_;
+        std::string_view src_;
+        size_t pos_ = 0;
+        Options opt_ = Options::none;
+        ReaderEvent event_ = ReaderEvent::none;
+        std::string_view name_;
+        std::string_view raw_;
+        std::string_view close_raw_;
+        std::vector<AttributeView> attrs_;
+        std::vector<std::string> stack_;
+        size_t pending_ends_ = 0;
+        bool pop_pending_ = false;
+        bool skip_break_ = false;
+        bool eof_ = true;
+
+        std::string_view available() const noexcept { return src_.substr(pos_); }
+        bool end_event(std::string_view raw);
+        bool fill();
+        const AttributeView* find_attr(std::string_view key) const noexcept;
+        size_t find_terminator(std::string_view terminator, size_t from = 0);
+        size_t find_tag_end();
+        bool read_markup();
+        bool read_simple(ReaderEvent event, std::string_view terminator, size_t min_size, const char* message);
+        bool read_tag();
+        void read_text();
+        std::string_view take(size_t len) noexcept;
+
+    };
+
 }
@@ -0,0 +1,219 @@
+#include "crow/async-io.hpp"
+#include "crow/guard.hpp"
+#include "crow/path.hpp"
+#include "crow/stdio.hpp"
+#include "crow/unit-test.hpp"
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <future>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+using namespace Crow;
+using namespace std::chrono;
+
+namespace {
+
+    void check_backend(AsyncBackend backend) {
+
+        Path dir = "__test_async_io__";
+        TRY(dir.remove(Path::recurse));
+        auto guard = on_scope_exit([=] { dir.remove(Path::recurse); });
+        TRY(dir.make_directory());
+
+        AsyncIo aio(backend, 4, 16);
+        TEST(aio.backend() == backend);
+        TEST_EQUAL(aio.pending(), 0u);
+
+        Path file1 = dir / "hello.txt";
+        Path file2 = dir / "copy.txt";
+        Path file3 = dir / "empty.txt";
+        Path no_file = dir / "no-such-file.txt";
+        std::string big(3'000'000, 'x');
+        for (size_t i = 0; i < big.size(); i += 997)
+            big[i] = char('a' + i % 26);
+
+        std::future<void> saved;
+        std::future<std::string> loaded;
+        std::string text;
+
+        TRY(saved = aio.save(file1, "Hello world\n"));
+        TRY(saved.get());
+        TEST_EQUAL(file1.load(), "Hello world\n");
+        TRY(loaded = aio.load(file1));
+        TRY(text = loaded.get());
+        TEST_EQUAL(text, "Hello world\n");
+
+        TRY(saved = aio.save(file1, big));
+        TRY(saved.get());
+        TRY(loaded = aio.load(file1));
+        TRY(text = loaded.get());
+        TEST_EQUAL(text.size(), big.size());
+        TEST(text == big);
+
+        TRY(saved = aio.copy(file1, file2));
+        TRY(saved.get());
+        TEST(file2.load() == big);
+
+        TRY(saved = aio.save(file3, ""));
+        TRY(saved.get());
+        TEST(file3.is_file());
+        TRY(loaded = aio.load(file3));
+        TRY(text = loaded.get());
+        TEST_EQUAL(text, "");
+
+        TRY(loaded = aio.load(no_file));
+        TEST_THROW(loaded.get(), std::system_error);
+        TRY(saved = aio.copy(no_file, file2));
+        TEST_THROW(saved.get(), std::system_error);
+
+        std::vector<std::pair<Path, std::string>> outputs;
+        std::vector<Path> inputs;
+        for (int i = 0; i < 100; ++i) {
+            Path file = dir / ("batch-" + std::to_string(i) + ".txt");
+            outputs.push_back({file, "File " + std::to_string(i) + "\n"});
+            inputs.push_back(file);
+        }
+
+        std::vector<std::future<void>> save_futures;
+        std::vector<std::future<std::string>> load_futures;
+
+        TRY(save_futures = aio.save_all(outputs));
+        TEST_EQUAL(save_futures.size(), 100u);
+        for (auto& f: save_futures)
+            TRY(f.get());
+        TRY(load_futures = aio.load_all(inputs));
+        TEST_EQUAL(load_futures.size(), 100u);
+        for (int i = 0; i < 100; ++i) {
+            TRY(text = load_futures[i].get());
+            TEST_EQUAL(text, "File " + std::to_string(i) + "\n");
+        }
+
+        Fdio io(file1, O_RDWR);
+        std::string buf(5, '\0');
+        std::atomic<size_t> got = 0;
+        std::atomic<int> error = -1;
+
+        aio.read(io.get(), buf.data(), buf.size(), 6, [&] (size_t n, std::error_code ec) {
+            got = n;
+            error = ec.value();
+        });
+        TRY(aio.wait());
+        TEST_EQUAL(got.load(), 5u);
+        TEST_EQUAL(error.load(), 0);
+        TEST_EQUAL(buf, big.substr(6, 5));
+
+        std::future<size_t> count;
+        TRY(count = aio.write(io.get(), "HELLO", 5, 1000));
+        TEST_EQUAL(count.get(), 5u);
+        TRY(count = aio.read(io.get(), buf.data(), buf.size(), 1000));
+        TEST_EQUAL(count.get(), 5u);
+        TEST_EQUAL(buf, "HELLO");
+        TRY(count = aio.read(io.get(), buf.data(), buf.size(), big.size() - 2));
+        TEST_EQUAL(count.get(), 2u);
+        TRY(count = aio.read(io.get(), buf.data(), buf.size(), big.size() + 100));
+        TEST_EQUAL(count.get(), 0u);
+        io.close();
+
+        Path tree = dir / "tree";
+        Path tree_copy = dir / "tree-copy";
+        TRY((tree / "a" / "b").make_directory(Path::recurse));
+        TRY((tree / "c").make_directory(Path::recurse));
+        TRY((tree / "one").save("1"));
+        TRY((tree / "a" / "two").save("22"));
+        TRY((tree / "a" / "b" / "three").save("333"));
+        TRY((tree / "c" / "four").save(big));
+
+        size_t n_files = 0;
+        TRY(count = aio.copy_directory(tree, tree_copy));
+        TRY(n_files = count.get());
+        TEST_EQUAL(n_files, 4u);
+        TEST((tree_copy / "a" / "b").is_directory());
+        TEST_EQUAL((tree_copy / "one").load(), "1");
+        TEST_EQUAL((tree_copy / "a" / "two").load(), "22");
+        TEST_EQUAL((tree_copy / "a" / "b" / "three").load(), "333");
+        TEST((tree_copy / "c" / "four").load() == big);
+
+        TRY(count = aio.copy_directory(no_file, tree_copy));
+        TEST_THROW(count.get(), std::system_error);
+
+        TRY(aio.wait());
+        TEST_EQUAL(aio.pending(), 0u);
+
+    }
+
+}
+
+void test_crow_async_io_threads() {
+
+    check_backend(AsyncBackend::threads);
+
+}
+
+void test_crow_async_io_uring() {
+
+    std::unique_ptr<AsyncIo> aio;
+
+    try {
+        aio = std::make_unique<AsyncIo>(AsyncBackend::uring);
+    }
+    catch (const std::system_error& ex) {
+        std::cout << "... io_uring is not available: " << ex.what() << "\n";
+        return;
+    }
+
+    aio.reset();
+    check_backend(AsyncBackend::uring);
+
+}
+
+void test_crow_async_io_benchmark() {
+
+    static constexpr int n_files = 2'000;
+    static constexpr size_t file_size = 4'096;
+
+    Path dir = "__test_async_io_benchmark__";
+    TRY(dir.remove(Path::recurse));
+    auto guard = on_scope_exit([=] { dir.remove(Path::recurse); });
+    TRY(dir.make_directory());
+
+    std::vector<Path> files;
+    for (int i = 0; i < n_files; ++i) {
+        files.push_back(dir / ("file-" + std::to_string(i)));
+        files.back().save(std::string(file_size, char('a' + i % 26)));
+    }
+
+    auto report = [] (const std::string& what, auto start) {
+        auto secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+        std::cout << "... " << what << ": " << int(n_files / secs) << " files/s\n";
+    };
+
+    size_t total = 0;
+    auto start = steady_clock::now();
+    for (auto& file: files)
+        total += file.load().size();
+    report("Path::load()", start);
+    TEST_EQUAL(total, n_files * file_size);
+
+    for (auto backend: {AsyncBackend::threads, AsyncBackend::uring}) {
+        std::unique_ptr<AsyncIo> aio;
+        try {
+            aio = std::make_unique<AsyncIo>(backend);
+        }
+        catch (const std::system_error&) {
+            continue;
+        }
+        total = 0;
+        start = steady_clock::now();
+        auto futures = aio->load_all(files);
+        for (auto& f: futures)
+            total += f.get().size();
+        report("AsyncIo::load_all() (" + to_string(backend) + ")", start);
+        TEST_EQUAL(total, n_files * file_size);
+    }
+
+}
@@ -1,11 +1,17 @@
 #include "crow/dice.hpp"
+#include "crow/mp-integer.hpp"
 #include "crow/rational.hpp"
 #include "crow/statistics.hpp"
 #include "crow/unit-test.hpp"
+#include <chrono>
+#include <iostream>
+#include <map>
 #include <random>
+#include <stdexcept>
 
 using namespace Crow;
 using namespace Crow::Literals;
+using namespace std::chrono;
 
 void test_crow_dice_arithmetic() {
 
@@ -251,6 +257,108 @@ void test_crow_dice_pdf() {
 
 }
 
+void test_crow_dice_exact_pdf() {
+
+    // 3d4 + 2*1d6 + 1d3/2, checked against brute force enumeration
+
+    Dice d;
+    TRY(d = Dice("3d4+1d6*2+1d3/2"));
+
+    std::map<Rational, int> table;
+    int total = 0;
+
+    for (int a = 1; a <= 4; ++a)
+        for (int b = 1; b <= 4; ++b)
+            for (int c = 1; c <= 4; ++c)
+                for (int e = 1; e <= 6; ++e)
+                    for (int f = 1; f <= 3; ++f, ++total)
+                        ++table[Rational(a + b + c + 2 * e) + Rational(f, 2)];
+
+    int sum = 0;
+
+    for (auto& [x,n]: table) {
+        sum += n;
+        TEST_EQUAL(d.pdf(x), Rational(n, total));
+        TEST_EQUAL(d.cdf(x), Rational(sum, total));
+        TEST_EQUAL(d.ccdf(x), Rational(total - sum + n, total));
+        TEST_EQUAL(d.exact_pdf(x), MPQ(n, total));
+        TEST_EQUAL(d.pdf(x + Rational(1, 4)), 0);
+    }
+
+    TEST_EQUAL(table.begin()->first, d.min());
+    TEST_EQUAL(table.rbegin()->first, d.max());
+    TEST_EQUAL(d.cdf(d.min() - 1), 0);
+    TEST_EQUAL(d.ccdf(d.max() + 1), 0);
+
+    // 100d100 has 100^100 combinations
+
+    TRY(d = Dice(100, 100));
+
+    MPN combinations = 1;
+    for (int i = 0; i < 100; ++i)
+        combinations *= 100;
+
+    TEST_EQUAL(d.exact_pdf(100), MPQ(MPZ(1), MPZ(combinations)));
+    TEST_EQUAL(d.exact_cdf(100), MPQ(MPZ(1), MPZ(combinations)));
+    TEST_EQUAL(d.exact_ccdf(100), MPQ(1));
+    TEST_EQUAL(d.exact_cdf(10'000), MPQ(1));
+    TEST_EQUAL(d.exact_ccdf(10'000), MPQ(MPZ(1), MPZ(combinations)));
+    TEST_EQUAL(d.exact_pdf(99), MPQ());
+    TEST_EQUAL(d.exact_pdf(10'001), MPQ());
+    TEST_EQUAL(d.exact_pdf(101), MPQ(MPZ(100), MPZ(combinations)));
+    TEST_EQUAL(d.exact_pdf(3'000), d.exact_pdf(7'100));
+    TEST_EQUAL(d.exact_pdf(5'050), d.exact_pdf(5'050));
+    TEST(d.exact_pdf(5'050) > d.exact_pdf(5'049));
+    TEST_THROW(d.pdf(100), std::overflow_error);
+    TEST_THROW(d.cdf(5'000), std::overflow_error);
+
+}
+
+void test_crow_dice_large_generation() {
+
+    static constexpr int iterations = 100'000;
+    static constexpr double tolerance = 2;
+
+    Dice d;
+    std::minstd_rand rng(42);
+    Statistics<double> stats;
+    Rational x;
+
+    TRY(d = Dice(100, 100));
+
+    for (int i = 0; i < iterations; ++i) {
+        TRY(x = d(rng));
+        TRY(stats(double(x)));
+    }
+
+    TEST(stats.min() >= double(d.min()));
+    TEST(stats.max() <= double(d.max()));
+    TEST_NEAR(stats.mean(), double(d.mean()), tolerance);
+    TEST_NEAR(stats.sd(), d.sd(), tolerance);
+
+}
+
+void test_crow_dice_benchmark() {
+
+    static constexpr int iterations = 1'000'000;
+
+    std::minstd_rand rng(42);
+    Rational x;
+
+    for (auto& expr: {"2d6", "3d6+2d8", "100d100"}) {
+        Dice d(expr);
+        TRY(x = d(rng));
+        double sum = 0;
+        auto start = steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            sum += double(d(rng));
+        auto secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+        std::cout << "... " << expr << ": " << int(iterations / secs) << " rolls/s\n";
+        TEST_NEAR(sum / iterations, double(d.mean()), 2);
+    }
+
+}
+
 void test_crow_dice_integer_arithmetic() {
 
     IntDice a, b, c;
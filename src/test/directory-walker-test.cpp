@@ -0,0 +1,191 @@
+#include "crow/directory-walker.hpp"
+#include "crow/format.hpp"
+#include "crow/guard.hpp"
+#include "crow/path.hpp"
+#include "crow/unit-test.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace Crow;
+using namespace std::chrono;
+
+namespace {
+
+    const Path root = "__test_walker__";
+
+    void make_tree() {
+        root.remove(Path::recurse);
+        (root / "a" / "b" / "c").make_directory(Path::recurse);
+        (root / "d").make_directory();
+        (root / ".hidden").make_directory();
+        (root / "one").save("1");
+        (root / "a" / "two").save("2");
+        (root / "a" / "b" / "three").save("3");
+        (root / "a" / "b" / "c" / "four").save("4");
+        (root / "d" / "five").save("5");
+        (root / ".hidden" / "six").save("6");
+        #ifdef _XOPEN_SOURCE
+            Path("a").make_symlink(root / "link");
+        #endif
+    }
+
+    std::string names(const std::vector<DirectoryWalker::entry>& entries) {
+        std::vector<std::string> list;
+        for (auto& e: entries)
+            list.push_back(e.path.relative_to(root).name() + ":" + std::to_string(e.depth));
+        std::sort(list.begin(), list.end());
+        std::string text;
+        for (auto& s: list)
+            text += s + " ";
+        if (! text.empty())
+            text.pop_back();
+        #ifndef _XOPEN_SOURCE
+            std::replace(text.begin(), text.end(), '\\', '/');
+        #endif
+        return text;
+    }
+
+}
+
+void test_crow_directory_walker_serial() {
+
+    TRY(make_tree());
+    auto guard = on_scope_exit([] { root.remove(Path::recurse); });
+
+    DirectoryWalker walker;
+    std::vector<DirectoryWalker::entry> entries;
+
+    TRY(entries = walker.search(root));
+
+    #ifdef _XOPEN_SOURCE
+        TEST_EQUAL(names(entries),
+            ".hidden/six:2 .hidden:1 a/b/c/four:4 a/b/c:3 a/b/three:3 a/b:2 a/two:2 a:1 d/five:2 d:1 "
+            "link/b/c/four:4 link/b/c:3 link/b/three:3 link/b:2 link/two:2 link:1 one:1");
+    #else
+        TEST_EQUAL(names(entries),
+            ".hidden/six:2 .hidden:1 a/b/c/four:4 a/b/c:3 a/b/three:3 a/b:2 a/two:2 a:1 d/five:2 d:1 one:1");
+    #endif
+
+    // Top down order
+    auto find = [&] (const std::string& name) {
+        return std::find_if(entries.begin(), entries.end(),
+            [&] (auto& e) { return e.path == root / name; }) - entries.begin();
+    };
+    TEST(find("a") < find("a/b"));
+    TEST(find("a/b") < find("a/b/c/four"));
+
+    for (auto& e: entries) {
+        if (e.path.leaf().name() == "b" || e.path.leaf().name() == "c") {
+            TEST_EQUAL(e.kind, Path::kind::directory);
+        } else if (e.path.leaf().name() == "one") {
+            TEST_EQUAL(e.kind, Path::kind::file);
+        }
+    }
+
+    TRY(walker.set_flags(Path::no_follow | Path::no_hidden));
+    TRY(entries = walker.search(root));
+
+    #ifdef _XOPEN_SOURCE
+        TEST_EQUAL(names(entries), "a/b/c/four:4 a/b/c:3 a/b/three:3 a/b:2 a/two:2 a:1 d/five:2 d:1 link:1 one:1");
+        auto link = std::find_if(entries.begin(), entries.end(), [] (auto& e) { return e.path.leaf().name() == "link"; });
+        REQUIRE(link != entries.end());
+        TEST_EQUAL(link->kind, Path::kind::symlink);
+    #else
+        TEST_EQUAL(names(entries), "a/b/c/four:4 a/b/c:3 a/b/three:3 a/b:2 a/two:2 a:1 d/five:2 d:1 one:1");
+    #endif
+
+    TRY(walker.set_filter([] (auto& e) { return e.path.leaf().name() != "b"; }));
+    TRY(entries = walker.search(root));
+    #ifdef _XOPEN_SOURCE
+        TEST_EQUAL(names(entries), "a/two:2 a:1 d/five:2 d:1 link:1 one:1");
+    #else
+        TEST_EQUAL(names(entries), "a/two:2 a:1 d/five:2 d:1 one:1");
+    #endif
+
+    TRY(entries = walker.search(root / "no-such-dir"));
+    TEST(entries.empty());
+    TRY(entries = walker.search(root / "one"));
+    TEST(entries.empty());
+
+}
+
+void test_crow_directory_walker_parallel() {
+
+    TRY(make_tree());
+    auto guard = on_scope_exit([] { root.remove(Path::recurse); });
+
+    DirectoryWalker walker(Path::no_follow, 4);
+    std::vector<DirectoryWalker::entry> entries;
+
+    TEST_EQUAL(walker.threads(), 4);
+    TRY(walker.set_queue_size(2));
+    TRY(entries = walker.search(root));
+
+    #ifdef _XOPEN_SOURCE
+        TEST_EQUAL(names(entries),
+            ".hidden/six:2 .hidden:1 a/b/c/four:4 a/b/c:3 a/b/three:3 a/b:2 a/two:2 a:1 d/five:2 d:1 link:1 one:1");
+    #else
+        TEST_EQUAL(names(entries),
+            ".hidden/six:2 .hidden:1 a/b/c/four:4 a/b/c:3 a/b/three:3 a/b:2 a/two:2 a:1 d/five:2 d:1 one:1");
+    #endif
+
+    TRY(walker.set_filter([] (auto& e) { return e.path.leaf().name() != "a"; }));
+    TRY(entries = walker.search(root));
+    #ifdef _XOPEN_SOURCE
+        TEST_EQUAL(names(entries), ".hidden/six:2 .hidden:1 d/five:2 d:1 link:1 one:1");
+    #else
+        TEST_EQUAL(names(entries), ".hidden/six:2 .hidden:1 d/five:2 d:1 one:1");
+    #endif
+
+    int count = 0;
+    TEST_THROW(walker.walk(root, [&] (auto&) { if (++count == 3) throw std::runtime_error("Stop"); }),
+        std::runtime_error);
+    TEST_EQUAL(count, 3);
+
+}
+
+void test_crow_directory_walker_benchmark() {
+
+    static constexpr int n_dirs = 50;
+    static constexpr int n_files = 100;
+
+    TRY(root.remove(Path::recurse));
+    auto guard = on_scope_exit([] { root.remove(Path::recurse); });
+
+    for (int i = 0; i < n_dirs; ++i) {
+        auto dir = root / ("dir-" + std::to_string(i / 10)) / ("sub-" + std::to_string(i));
+        dir.make_directory(Path::recurse);
+        for (int j = 0; j < n_files; ++j)
+            (dir / ("file-" + std::to_string(j))).create();
+    }
+
+    auto report = [] (const std::string& what, size_t n, auto start) {
+        auto secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+        std::cout << "... " << what << ": " << int(double(n) / secs) << " entries/s\n";
+    };
+
+    size_t expect = n_dirs * (n_files + 1) + n_dirs / 10;
+    size_t count = 0;
+    auto start = steady_clock::now();
+    for (auto& file: root.deep_search()) {
+        (void)file;
+        ++count;
+    }
+    report("Path::deep_search()", count, start);
+    TEST_EQUAL(count, expect);
+
+    for (int threads: {1, 4}) {
+        DirectoryWalker walker(Path::no_flags, threads);
+        count = 0;
+        start = steady_clock::now();
+        walker.walk(root, [&] (auto&) { ++count; });
+        report("DirectoryWalker (" + std::to_string(threads) + " threads)", count, start);
+        TEST_EQUAL(count, expect);
+    }
+
+}
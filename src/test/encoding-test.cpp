@@ -1,11 +1,23 @@
 #include "crow/encoding.hpp"
+#include "crow/format.hpp"
+#include "crow/stdio.hpp"
 #include "crow/string.hpp"
 #include "crow/unit-test.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <span>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 using namespace Crow;
+using namespace std::chrono;
 
 void test_crow_encoding_hexcode() {
 
@@ -67,3 +79,253 @@ void test_crow_encoding_base64() {
     }
 
 }
+
+namespace {
+
+    std::string reference_hex(const std::string& in) {
+        static constexpr const char* xdigits = "0123456789abcdef";
+        std::string out;
+        for (auto c: in) {
+            out += xdigits[uint8_t(c) / 16];
+            out += xdigits[uint8_t(c) % 16];
+        }
+        return out;
+    }
+
+    std::string reference_base64(const std::string& in, const std::string& last2, bool padding) {
+        auto digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789" + last2;
+        std::string out;
+        for (size_t i = 0; i < in.size(); i += 3) {
+            size_t n = std::min(in.size() - i, size_t(3));
+            uint32_t g = 0;
+            for (size_t j = 0; j < 3; ++j)
+                g = (g << 8) + (j < n ? uint8_t(in[i + j]) : 0);
+            for (size_t j = 0; j <= n; ++j)
+                out += digits[(g >> (18 - 6 * j)) & 0x3f];
+            if (padding)
+                out.append(3 - n, '=');
+        }
+        return out;
+    }
+
+    std::string random_bytes(std::minstd_rand& rng, size_t n) {
+        std::uniform_int_distribution<int> dist(0, 255);
+        std::string s(n, '\0');
+        for (auto& c: s)
+            c = char(dist(rng));
+        return s;
+    }
+
+}
+
+void test_crow_encoding_random() {
+
+    std::minstd_rand rng(42);
+    Hexcode hex;
+    Base64 b64;
+    Base64 b64_url(npos, "-_", false);
+    std::string plain, str;
+
+    for (size_t n = 0; n <= 300; ++n) {
+
+        plain = random_bytes(rng, n);
+
+        TRY(str = hex.encode(plain));
+        TEST_EQUAL(str, reference_hex(plain));
+        TEST_EQUAL(str.size(), hex.encoded_length(n));
+        TRY(str = hex.decode(str));
+        TEST(str == plain);
+        TRY(str = hex.decode(ascii_uppercase(reference_hex(plain))));
+        TEST(str == plain);
+
+        TRY(str = b64.encode(plain));
+        TEST_EQUAL(str, reference_base64(plain, "+/", true));
+        TEST_EQUAL(str.size(), b64.encoded_length(n));
+        TRY(str = b64.decode(str));
+        TEST(str == plain);
+
+        TRY(str = b64_url.encode(plain));
+        TEST_EQUAL(str, reference_base64(plain, "-_", false));
+        TEST_EQUAL(str.size(), b64_url.encoded_length(n));
+        TRY(str = b64_url.decode(str));
+        TEST(str == plain);
+
+    }
+
+    // Line breaks and separators break up the vector blocks
+
+    plain = random_bytes(rng, 1000);
+    TRY(str = Base64(76).decode(Base64(76).encode(plain)));
+    TEST(str == plain);
+    TRY(str = Base64(5).decode(Base64(5).encode(plain)));
+    TEST(str == plain);
+    TRY(str = Hexcode(64).decode(Hexcode(64).encode(plain)));
+    TEST(str == plain);
+    TRY(str = Hexcode(7).decode(Hexcode(7).encode(plain)));
+    TEST(str == plain);
+    TRY(str = hex.decode("48 65:6c-6c\n6f\n"));
+    TEST_EQUAL(str, "Hello");
+
+    auto bad_hex = reference_hex(plain);
+    bad_hex[70] = 'g';
+    TEST_THROW(hex.decode(bad_hex), EncodingError);
+    TEST_THROW(hex.decode(reference_hex(plain) + "4"), EncodingError);
+    TEST_THROW(hex.decode("4g"), EncodingError);
+
+    auto bad_b64 = b64.encode(plain);
+    bad_b64[100] = '*';
+    TEST_THROW(b64.decode(bad_b64), EncodingError);
+    bad_b64 = b64.encode(plain);
+    bad_b64[100] = '\xff';
+    TEST_THROW(b64.decode(bad_b64), EncodingError);
+    TEST_THROW(b64.decode("YQ=A"), EncodingError);
+    TEST_THROW(b64.decode("YQ==YQ=="), EncodingError);
+    TEST_THROW(b64.decode("YWJjZ"), EncodingError);
+
+}
+
+void test_crow_encoding_spans() {
+
+    std::minstd_rand rng(86);
+    auto plain = random_bytes(rng, 100);
+    std::span<const std::byte> in(reinterpret_cast<const std::byte*>(plain.data()), plain.size());
+    std::vector<char> text(200);
+    std::vector<std::byte> bytes(200);
+    Hexcode hex;
+    Base64 b64;
+    size_t n = 0;
+
+    TRY(n = hex.encode(in, text));
+    TEST_EQUAL(n, 200u);
+    TEST_EQUAL(std::string(text.data(), n), reference_hex(plain));
+    TRY(n = hex.encode(in, std::span<char>(text.data(), 199)));
+    TEST_EQUAL(n, npos);
+    TEST_EQUAL(hex.max_decoded_length(200), 100u);
+    TRY(n = hex.decode(std::string_view(text.data(), 200), bytes));
+    TEST_EQUAL(n, 100u);
+    TEST(std::equal(in.begin(), in.end(), bytes.begin()));
+    TRY(n = hex.decode(std::string_view(text.data(), 200), std::span<std::byte>(bytes.data(), 99)));
+    TEST_EQUAL(n, npos);
+
+    TRY(n = b64.encode(in, text));
+    TEST_EQUAL(n, 136u);
+    TEST_EQUAL(std::string(text.data(), n), reference_base64(plain, "+/", true));
+    TRY(n = b64.encode(in, std::span<char>(text.data(), 135)));
+    TEST_EQUAL(n, npos);
+    TEST_EQUAL(b64.max_decoded_length(136), 102u);
+    TRY(n = b64.decode(std::string_view(text.data(), 136), bytes));
+    TEST_EQUAL(n, 100u);
+    TEST(std::equal(in.begin(), in.end(), bytes.begin()));
+    TRY(n = b64.decode(std::string_view(text.data(), 136), std::span<std::byte>(bytes.data(), 100)));
+    TEST_EQUAL(n, 100u);
+    TRY(n = b64.decode(std::string_view(text.data(), 136), std::span<std::byte>(bytes.data(), 99)));
+    TEST_EQUAL(n, npos);
+
+}
+
+void test_crow_encoding_streaming() {
+
+    std::minstd_rand rng(99);
+    std::uniform_int_distribution<size_t> chunk(0, 50);
+    auto plain = random_bytes(rng, 2000);
+
+    for (const Encoding* code: std::initializer_list<const Encoding*>{
+            new Hexcode, new Hexcode(11), new Base64, new Base64(7), new Base64(76, "-_", false)}) {
+
+        std::unique_ptr<const Encoding> guard(code);
+        std::string encoded, decoded;
+        auto expect = code->encode(plain);
+        Encoding::encoder enc(*code);
+
+        for (size_t pos = 0; pos < plain.size();) {
+            size_t n = std::min(chunk(rng), plain.size() - pos);
+            TRY(encoded += enc.update(plain.data() + pos, n));
+            pos += n;
+        }
+
+        TRY(encoded += enc.finish());
+        TEST_EQUAL(encoded, expect);
+
+        Encoding::decoder dec(*code);
+        std::span<const std::byte> bytes;
+
+        for (size_t pos = 0; pos < encoded.size();) {
+            size_t n = std::min(chunk(rng), encoded.size() - pos);
+            TRY(bytes = dec.update(std::string_view(encoded).substr(pos, n)));
+            decoded.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+            pos += n;
+        }
+
+        TRY(bytes = dec.finish());
+        decoded.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        TEST(decoded == plain);
+
+        TempFile in, mid, out;
+        in.writes(plain);
+        in.seek(0, SEEK_SET);
+        TRY(code->encode(in, mid, 100));
+        mid.seek(0, SEEK_SET);
+        TEST_EQUAL(mid.read_all(), expect);
+        mid.seek(0, SEEK_SET);
+        TRY(code->decode(mid, out, 33));
+        out.seek(0, SEEK_SET);
+        TEST(out.read_all() == plain);
+
+    }
+
+    Base64 b64;
+    Encoding::decoder dec(b64);
+    TRY(dec.update("YWJj"));
+    TRY(dec.update("Z"));
+    TEST_THROW(dec.finish(), EncodingError);
+
+    // An output stream that accepts nothing must not hang the encoder
+
+    struct FullSink:
+    public IoBase {
+        void close() override {}
+        void flush() override {}
+        bool is_open() const override { return true; }
+        size_t read(void*, size_t) override { return 0; }
+        void seek(ptrdiff_t, int) override {}
+        ptrdiff_t tell() override { return 0; }
+        size_t write(const void*, size_t) override { return 0; }
+    };
+
+    TempFile in;
+    FullSink sink;
+    in.writes(plain);
+    in.seek(0, SEEK_SET);
+    TEST_THROW(b64.encode(in, sink), IoError);
+
+}
+
+void test_crow_encoding_benchmark() {
+
+    static constexpr size_t size = 4'000'000;
+    static constexpr int iterations = 10;
+
+    std::minstd_rand rng(42);
+    auto plain = random_bytes(rng, size);
+    Hexcode hex;
+    Base64 b64;
+    std::string encoded, decoded;
+
+    auto report = [] (const std::string& what, auto start) {
+        auto secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+        std::cout << "... " << what << ": " << fmt("{0:f3}", iterations * double(size) / secs / 1e9) << " GB/s\n";
+    };
+
+    for (const Encoding* code: std::initializer_list<const Encoding*>{&hex, &b64}) {
+        auto start = steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            encoded = code->encode(plain);
+        report(code->name() + " encode", start);
+        start = steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            decoded = code->decode(encoded);
+        report(code->name() + " decode", start);
+        TEST(decoded == plain);
+    }
+
+}
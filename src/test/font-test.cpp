@@ -5,6 +5,7 @@
 #include "crow/unit-test.hpp"
 #include "crow/vector.hpp"
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace Crow;
@@ -353,6 +354,54 @@ void test_crow_font_rendering() {
 
 }
 
+void test_crow_font_glyph_cache() {
+
+    static const std::string text = "Hello world\nGoodbye";
+
+    Font serif;
+    ScaledFont s_serif;
+    Image<Rgbaf> image1, image2;
+    Point offset1, offset2;
+
+    TRY(serif = Font(serif_file));
+    TRY(s_serif = ScaledFont(serif, 100));
+    TEST_EQUAL(s_serif.cache_limit(), ScaledFont::default_cache_limit);
+    TRY(s_serif.render(image1, offset1, text, 0, Rgbaf::blue()));
+    TRY(s_serif.render(image2, offset2, text, 0, Rgbaf::blue()));
+    TEST_EQUAL(offset1, offset2);
+    TEST(image1 == image2);
+
+    TRY(s_serif.clear_cache());
+    TRY(s_serif.render(image2, offset2, text, 0, Rgbaf::blue()));
+    TEST_EQUAL(offset1, offset2);
+    TEST(image1 == image2);
+
+    TRY(s_serif.set_cache_limit(1));
+    TEST_EQUAL(s_serif.cache_limit(), 1u);
+    TRY(s_serif.render(image2, offset2, text, 0, Rgbaf::blue()));
+    TEST_EQUAL(offset1, offset2);
+    TEST(image1 == image2);
+    TRY(s_serif.set_cache_limit(ScaledFont::default_cache_limit));
+
+    std::vector<Image<Rgbaf>> images(8);
+    std::vector<std::thread> threads;
+    ScaledFont s_shared(serif, 100);
+
+    for (auto& image: images)
+        threads.emplace_back([&] {
+            Point offset;
+            for (int i = 0; i < 10; ++i)
+                s_shared.render(image, offset, text, 0, Rgbaf::blue());
+        });
+
+    for (auto& t: threads)
+        t.join();
+
+    for (auto& image: images)
+        TEST(image == image1);
+
+}
+
 void test_crow_font_map() {
 
     FontMap map;
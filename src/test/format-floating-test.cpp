@@ -1,7 +1,17 @@
 #include "crow/format-floating.hpp"
 #include "crow/unit-test.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
 
 using namespace Crow;
+using namespace std::chrono;
 
 void test_crow_format_floating_point_significant_digits_format() {
 
@@ -305,3 +315,163 @@ void test_crow_format_floating_point_probability_format() {
     TEST_EQUAL(format_floating_point(1.0,              "P1"),  "100");
 
 }
+
+void test_crow_format_floating_point_round_trip() {
+
+    TEST_EQUAL(format_floating_point(0.0,                   "dr"),   "0");
+    TEST_EQUAL(format_floating_point(-0.0,                  "dr"),   "-0");
+    TEST_EQUAL(format_floating_point(0.1,                   "dr"),   "0.1");
+    TEST_EQUAL(format_floating_point(0.1f,                  "dr"),   "0.1");
+    TEST_EQUAL(format_floating_point(100.0,                 "dr"),   "100");
+    TEST_EQUAL(format_floating_point(123.456,               "dr"),   "123.456");
+    TEST_EQUAL(format_floating_point(1.0 / 3.0,             "dr"),   "0.3333333333333333");
+    TEST_EQUAL(format_floating_point(1.0 / 3.0,             "dr3"),  "0.3333333333333333");
+    TEST_EQUAL(format_floating_point(2.0 / 3.0,             "dr"),   "0.6666666666666666");
+    TEST_EQUAL(format_floating_point(0.1 + 0.2,             "dr"),   "0.30000000000000004");
+    TEST_EQUAL(format_floating_point(1e21,                  "dr"),   "1000000000000000000000");
+    TEST_EQUAL(format_floating_point(1.5e-7,                "dr"),   "0.00000015");
+    TEST_EQUAL(format_floating_point(0.0,                   "er"),   "0e0");
+    TEST_EQUAL(format_floating_point(0.1,                   "er"),   "1e-1");
+    TEST_EQUAL(format_floating_point(123.456,               "er"),   "1.23456e2");
+    TEST_EQUAL(format_floating_point(-123.456,              "ErS"),  "-1.23456E+2");
+    TEST_EQUAL(format_floating_point(5e-324,                "er"),   "5e-324");
+    TEST_EQUAL(format_floating_point(1.7976931348623157e308, "er"),  "1.7976931348623157e308");
+    TEST_EQUAL(format_floating_point(0.1 + 0.2,             "gr"),   "0.30000000000000004");
+    TEST_EQUAL(format_floating_point(1.25e10,               "gr"),   "1.25e10");
+    TEST_EQUAL(format_floating_point(1234.5,                "grs"),  "+1234.5");
+    TEST_EQUAL(format_floating_point(1234.5,                "gre"),  "1234,5");
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> mantissa(-10, 10);
+    std::uniform_int_distribution<int> exponent(-300, 300);
+    std::string s;
+
+    for (int i = 0; i < 10'000; ++i) {
+        double x = mantissa(rng) * std::pow(10.0, exponent(rng));
+        TRY(s = format_floating_point(x, "er"));
+        TEST_EQUAL(std::strtod(s.data(), nullptr), x);
+        float y = float(x);
+        TRY(s = format_floating_point(y, "er"));
+        TEST_EQUAL(std::strtof(s.data(), nullptr), y);
+    }
+
+}
+
+void test_crow_format_floating_point_special_values() {
+
+    static constexpr double inf = std::numeric_limits<double>::infinity();
+    static constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+    TEST_EQUAL(format_floating_point(inf,                   "d"),    "inf");
+    TEST_EQUAL(format_floating_point(- inf,                 "d"),    "-inf");
+    TEST_EQUAL(format_floating_point(inf,                   "ds"),   "+inf");
+    TEST_EQUAL(format_floating_point(nan,                   "d"),    "nan");
+    TEST_EQUAL(format_floating_point(inf,                   "e"),    "inf");
+    TEST_EQUAL(format_floating_point(- inf,                 "E"),    "-INF");
+    TEST_EQUAL(format_floating_point(inf,                   "f"),    "inf");
+    TEST_EQUAL(format_floating_point(inf,                   "g"),    "inf");
+    TEST_EQUAL(format_floating_point(nan,                   "G"),    "NAN");
+    TEST_EQUAL(format_floating_point(inf,                   ""),     "inf");
+    TEST_MATCH(format_floating_point(5e-324,                "d3"),   R"(^0\.0{323}494$)");
+    TEST_EQUAL(format_floating_point(5e-324,                "e3"),   "4.94e-324");
+    TEST_MATCH(format_floating_point(1e300,                 "f0"),   R"(^10{16}525047602552\d{272}$)");
+    TEST_EQUAL(format_floating_point(1e300L,                "e3"),   "1.00e300");
+    TEST_EQUAL(format_floating_point(1e-3000L,              "e3"),   "1.00e-3000");
+    TEST_EQUAL(format_floating_point(1e4000L,               "er"),   "1e4000");
+
+}
+
+namespace {
+
+    // The snprintf based formatter that the std::to_chars engine replaced,
+    // reduced to the default "gz6" and "f2" formats for positive values
+
+    std::string legacy_snprintf(const char* pattern, int prec, double x) {
+        std::string result(15, '\0');
+        int rc = 0;
+        for (;;) {
+            rc = std::snprintf(result.data(), result.size(), pattern, prec, x);
+            if (rc < int(result.size()))
+                break;
+            result.resize(rc + 1);
+        }
+        result.resize(rc);
+        return result;
+    }
+
+    std::string legacy_trim_zeros(const std::string& str) {
+        size_t dec_point = str.find('.');
+        if (dec_point == npos)
+            return str;
+        size_t end_sig = str.find_first_not_of("0123456789", dec_point + 1);
+        if (end_sig == npos)
+            end_sig = str.size();
+        size_t last_digit = end_sig - 1;
+        while (str[last_digit] == '0')
+            --last_digit;
+        if (str[last_digit] != '.')
+            ++last_digit;
+        return str.substr(0, last_digit) + str.substr(end_sig);
+    }
+
+    std::string legacy_format_gz6(double x) {
+        static constexpr int prec = 5;
+        auto native = legacy_snprintf("%.*e", prec, x);
+        size_t exp_pos = native.find('e');
+        auto result = native.substr(0, exp_pos);
+        result.erase(1, 1);
+        int exp = std::atoi(native.data() + exp_pos + 1);
+        if (exp < 0) {
+            result.insert(0, "0.");
+            result.insert(2, - exp - 1, '0');
+        } else if (exp < prec) {
+            result.insert(exp + 1, 1, '.');
+        } else if (exp > prec - 1) {
+            result.append(exp - prec, '0');
+        }
+        return legacy_trim_zeros(result);
+    }
+
+    std::string legacy_format_f2(double x) {
+        return legacy_snprintf("%.*f", 2, x);
+    }
+
+}
+
+void test_crow_format_floating_point_benchmark() {
+
+    static constexpr int iterations = 1'000'000;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> mantissa(1, 10);
+    std::uniform_int_distribution<int> exponent(-3, 5);
+    std::vector<double> values(1024);
+
+    for (auto& x: values)
+        x = mantissa(rng) * std::pow(10.0, exponent(rng));
+    for (size_t i = 0; i < values.size(); i += 2)
+        values[i] = std::round(values[i] * 100) / 100;
+
+    for (auto x: values) {
+        TEST_EQUAL(format_floating_point(x), legacy_format_gz6(x));
+        TEST_EQUAL(format_floating_point(x, "f2"), legacy_format_f2(x));
+    }
+
+    auto run = [&] (const char* label, auto&& f) {
+        size_t total = 0;
+        auto start = steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            total += f(values[i % values.size()]).size();
+        auto secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+        std::cout << "... " << label << ": " << int(iterations / secs) << " calls/s\n";
+        TEST(total > 0);
+    };
+
+    run("snprintf gz6", legacy_format_gz6);
+    run("to_chars gz6", [] (double x) { return format_floating_point(x); });
+    run("snprintf f2", legacy_format_f2);
+    run("to_chars f2", [] (double x) { return format_floating_point(x, "f2"); });
+    run("to_chars e4", [] (double x) { return format_floating_point(x, "e4"); });
+    run("to_chars gr", [] (double x) { return format_floating_point(x, "gr"); });
+
+}
@@ -1,9 +1,14 @@
 #include "crow/format.hpp"
 #include "crow/unit-test.hpp"
+#include <chrono>
 #include <compare>
+#include <iostream>
 #include <optional>
+#include <string>
 
 using namespace Crow;
+using namespace Crow::Literals;
+using namespace std::chrono;
 using namespace std::literals;
 
 void test_crow_format_null_values() {
@@ -68,3 +73,59 @@ void test_crow_format_std_optional() {
     oi = 42;  TEST_EQUAL(format_object(oi, "NZ"),  "42");
 
 }
+
+void test_crow_format_benchmark() {
+
+    static constexpr int iterations = 1'000'000;
+    static const std::string pattern = "Item {0}: {1} of {2} ({3:f2}%)";
+    static const std::string expect = "Item 999999: widget of 1000000 (100.00%)";
+
+    const std::string name = "widget";
+    std::string result;
+    size_t total = 0;
+
+    auto run = [&] (const char* label, auto&& f) {
+        total = 0;
+        auto start = steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            total += f(i);
+        auto secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+        std::cout << "... " << label << ": " << int(iterations / secs) << " calls/s\n";
+        TEST_EQUAL(result, expect);
+    };
+
+    run("Formatter(pattern)", [&] (int i) {
+        result = Formatter(pattern)(i, name, iterations, 100.0 * (i + 1) / iterations);
+        return result.size();
+    });
+
+    run("fmt()", [&] (int i) {
+        result = fmt(pattern, i, name, iterations, 100.0 * (i + 1) / iterations);
+        return result.size();
+    });
+
+    Formatter f(pattern);
+
+    run("Formatter reused", [&] (int i) {
+        result = f(i, name, iterations, 100.0 * (i + 1) / iterations);
+        return result.size();
+    });
+
+    run("_fmt literal", [&] (int i) {
+        result = "Item {0}: {1} of {2} ({3:f2}%)"_fmt(i, name, iterations, 100.0 * (i + 1) / iterations);
+        return result.size();
+    });
+
+    run("_fmt format_to reused buffer", [&] (int i) {
+        result.clear();
+        "Item {0}: {1} of {2} ({3:f2}%)"_fmt.format_to(result, i, name, iterations, 100.0 * (i + 1) / iterations);
+        return result.size();
+    });
+
+    run("_fmt integers only", [&] (int i) {
+        result.clear();
+        "Item {0}: {1} of {2} ({3}%)"_fmt.format_to(result, i, name, iterations, "100.00");
+        return result.size();
+    });
+
+}
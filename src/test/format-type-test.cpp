@@ -1,5 +1,6 @@
 #include "crow/format.hpp"
 #include "crow/unit-test.hpp"
+#include <iterator>
 #include <map>
 #include <stdexcept>
 #include <string>
@@ -7,6 +8,7 @@
 
 using namespace Crow;
 using namespace Crow::Literals;
+using namespace std::literals;
 
 namespace {
 
@@ -348,3 +350,62 @@ void test_crow_format_literals() {
     TRY(f = "{0} {1} {2}"_fmt);          TEST_THROW(f(86, 99),       std::out_of_range);
 
 }
+
+void test_crow_format_static_formatter() {
+
+    std::vector<int> v = {123,456,789};
+
+    TEST_EQUAL(""_fmt(),                     "");
+    TEST_EQUAL("Hello world!"_fmt(),         "Hello world!");
+    TEST_EQUAL("Hello {0}!"_fmt("world"),    "Hello world!");
+    TEST_EQUAL("Hello {0}!"_fmt(42),         "Hello 42!");
+    TEST_EQUAL("Hello {0}!"_fmt(-42ll),      "Hello -42!");
+    TEST_EQUAL("Hello \\{0\\}!"_fmt(42),     "Hello {0}!");
+    TEST_EQUAL("Hello \\{{0}\\}!"_fmt(42),   "Hello {42}!");
+    TEST_EQUAL("Hello \\αβγ"_fmt(),          "Hello αβγ");
+    TEST_EQUAL("Hello {0} {1}!"_fmt("world", 42),  "Hello world 42!");
+    TEST_EQUAL("Hello {1} {0}!"_fmt("world", 42),  "Hello 42 world!");
+    TEST_EQUAL("({0})"_fmt(0.0),                   "(0)");
+    TEST_EQUAL("({0}) ({1})"_fmt(42.0, 86.99),     "(42) (86.99)");
+    TEST_EQUAL("({0})"_fmt(42.0, 86.99),           "(42)");
+    TEST_EQUAL("({1})"_fmt(42.0, 86.99),           "(86.99)");
+    TEST_EQUAL("({0:e4}) ({1:e4})"_fmt(42.0, 86.99),    "(4.200e1) (8.699e1)");
+    TEST_EQUAL("({0:f4}) ({1:f4})"_fmt(42.0, 86.99),    "(42.0000) (86.9900)");
+    TEST_EQUAL("({0:gz4}) ({1:gz4})"_fmt(42.0, 86.99),  "(42) (86.99)");
+    TEST_EQUAL("{0:T} = {0}"_fmt(1234.5),          "double = 1234.5");
+    TEST_EQUAL("{0} {0:x} {0:X4}"_fmt(255),        "255 ff 00FF");
+    TEST_EQUAL("{0}"_fmt(v),                       "[123,456,789]");
+    TEST_EQUAL("{0:x4}"_fmt(v),                    "[007b,01c8,0315]");
+    TEST_EQUAL("[{0}] [{0:sZ}]"_fmt(""s),          "[] [--]");
+    TEST_EQUAL("{0} {1} {2}"_fmt('a', true, nullptr),  "a true <null>");
+
+    TEST_EQUAL("{0} {1} {2}"_fmt.required_args, 3u);
+    TEST_EQUAL("({0})"_fmt.pattern(), "({0})");
+
+}
+
+void test_crow_format_output_functions() {
+
+    std::string s;
+    std::vector<char> chars;
+    Formatter f("<{0}:{1:f2}>");
+
+    TRY(f.format_to(s, 42, 1.5));                          TEST_EQUAL(s, "<42:1.50>");
+    TRY(f.format_to(s, "abc", 2));                         TEST_EQUAL(s, "<42:1.50><abc:2.00>");
+    TRY("<{0}:{1:f2}>"_fmt.format_to(s, 1, 2));            TEST_EQUAL(s, "<42:1.50><abc:2.00><1:2.00>");
+    TRY(f.format_to(std::back_inserter(chars), 42, 1.5));  TEST_EQUAL(std::string(chars.begin(), chars.end()), "<42:1.50>");
+    TRY(chars.clear());
+    TRY("[{0}]"_fmt.format_to(std::back_inserter(chars), "xyz"s));
+    TEST_EQUAL(std::string(chars.begin(), chars.end()), "[xyz]");
+    TEST_THROW(f.format_to(s, 1), std::out_of_range);
+
+    // Reusing the buffer keeps its capacity
+
+    std::string buf;
+    for (int i = 0; i < 100; ++i) {
+        buf.clear();
+        "Item {0}: {1}"_fmt.format_to(buf, i, i * i);
+        TEST_EQUAL(buf, "Item " + std::to_string(i) + ": " + std::to_string(i * i));
+    }
+
+}
@@ -3,12 +3,14 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdio>
+#include <iostream>
 #include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
 
 using namespace Crow;
+using namespace std::chrono;
 using namespace std::literals;
 
 namespace {
@@ -132,3 +134,167 @@ void test_crow_logging_output() {
         t.join();
 
 }
+
+void test_crow_logging_async() {
+
+    LogFile log("_log.txt");
+    SetLog guard(log);
+    std::vector<std::string> lines;
+
+    TRY(set_log_async());
+    TRY(logx("Hello", "world"));
+    TRY(logx(123, -456, 7.5, true));
+    TRY(CROW_LOG("Hello"s, "world"sv));
+    TRY(CROW_LOG(std::string(500, 'x')));
+    TRY(flush_log());
+
+    TRY(lines = log.content());
+    TEST_EQUAL(lines.size(), 4u);
+    lines.resize(4);
+    TEST_MATCH(lines[0], short_prefix + " Hello world$");
+    TEST_MATCH(lines[1], short_prefix + " 123 -456 7.500000 true$");
+    TEST_MATCH(lines[2], long_prefix + " Hello world$");
+    TEST_MATCH(lines[3], long_prefix + " x{500}$");
+
+    // Each thread's messages are written in order
+
+    static constexpr int n_threads = 4;
+    static constexpr int n_messages = 1000;
+
+    TRY(log.reset());
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < n_threads; ++i)
+        threads.emplace_back([i] {
+            for (int j = 0; j < n_messages; ++j)
+                logx("Thread", i, "message", j);
+        });
+
+    for (auto& t: threads)
+        t.join();
+
+    TRY(flush_log());
+    TRY(lines = log.content());
+    TEST_EQUAL(lines.size(), size_t(n_threads * n_messages));
+    std::vector<int> next(n_threads, 0);
+
+    for (auto& line: lines) {
+        int i = -1, j = -1;
+        auto pos = line.find("] Thread ");
+        REQUIRE(pos != std::string::npos);
+        REQUIRE(std::sscanf(line.data() + pos, "] Thread %d message %d", &i, &j) == 2);
+        REQUIRE(i >= 0 && i < n_threads);
+        TEST_EQUAL(j, next[i]);
+        next[i] = j + 1;
+    }
+
+    for (int i = 0; i < n_threads; ++i)
+        TEST_EQUAL(next[i], n_messages);
+
+    TRY(set_log_async(false));
+    TRY(logx("Sync"));
+    TRY(lines = log.content());
+    REQUIRE(! lines.empty());
+    TEST_MATCH(lines.back(), short_prefix + " Sync$");
+
+}
+
+void test_crow_logging_async_overflow() {
+
+    static constexpr int n_messages = 1000;
+
+    LogFile log("_log.txt");
+    SetLog guard(log);
+    std::vector<std::string> lines;
+    std::string text(100, 'x');
+    size_t kept = 0, reported = 0;
+
+    TRY(set_log_async(true, LogOverflow::block, 512));
+    TRY(std::thread([&] { for (int i = 0; i < n_messages; ++i) logx(text); }).join());
+    TRY(flush_log());
+    TRY(lines = log.content());
+    TEST_EQUAL(lines.size(), size_t(n_messages));
+
+    TRY(log.reset());
+    TRY(set_log_async(true, LogOverflow::drop, 512));
+    TRY(std::thread([&] { for (int i = 0; i < n_messages; ++i) logx(text); }).join());
+    TRY(flush_log());
+    TRY(lines = log.content());
+    TEST(! lines.empty());
+    TEST(lines.size() <= size_t(n_messages));
+
+    TRY(log.reset());
+    TRY(set_log_async(true, LogOverflow::count, 512));
+    TRY(std::thread([&] { for (int i = 0; i < n_messages; ++i) logx(text); }).join());
+    TRY(flush_log());
+    TRY(lines = log.content());
+
+    for (auto& line: lines) {
+        auto pos = line.find("] ");
+        REQUIRE(pos != std::string::npos);
+        if (line[pos + 2] == 'x') {
+            ++kept;
+        } else {
+            TEST_MATCH(line, short_prefix + " \\d+ log messages dropped$");
+            reported += std::stoul(line.substr(pos + 2));
+        }
+    }
+
+    TEST(kept > 0);
+    TEST_EQUAL(kept + reported, size_t(n_messages));
+
+    TRY(set_log_async(false));
+
+}
+
+void test_crow_logging_benchmark() {
+
+    static constexpr int n_threads = 16;
+    static constexpr int n_messages = 5'000;
+
+    LogFile log("_log.txt");
+    SetLog guard(log);
+
+    for (bool async: {false, true}) {
+
+        TRY(log.reset());
+        TRY(set_log_async(async));
+        std::vector<std::thread> threads;
+        std::vector<std::vector<int64_t>> times(n_threads);
+
+        for (int i = 0; i < n_threads; ++i) {
+            threads.emplace_back([&times,i] {
+                auto& t = times[i];
+                t.reserve(n_messages);
+                for (int j = 0; j < n_messages; ++j) {
+                    auto start = steady_clock::now();
+                    CROW_LOG("Thread", i, "message", j, "value", j * 0.5);
+                    t.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+                }
+            });
+        }
+
+        for (auto& t: threads)
+            t.join();
+
+        TRY(flush_log());
+        std::vector<int64_t> all;
+        for (auto& t: times)
+            all.insert(all.end(), t.begin(), t.end());
+        std::sort(all.begin(), all.end());
+        double mean = 0;
+        for (auto t: all)
+            mean += double(t);
+        mean /= double(all.size());
+
+        std::cout << "... " << (async ? "async" : "sync") << " CROW_LOG x" << n_threads << " threads: mean "
+            << int64_t(mean) << " ns, median " << all[all.size() / 2]
+            << " ns, p99 " << all[all.size() * 99 / 100] << " ns\n";
+
+        TEST_EQUAL(log.content().size(), size_t(n_threads * n_messages));
+
+    }
+
+    TRY(set_log_async(false));
+
+}
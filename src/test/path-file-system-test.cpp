@@ -1,10 +1,12 @@
 #include "crow/path.hpp"
 #include "crow/format.hpp"
+#include "crow/guard.hpp"
 #include "crow/unicode.hpp"
 #include "crow/unit-test.hpp"
 #include <algorithm>
 #include <chrono>
 #include <cstdlib>
+#include <iostream>
 #include <iterator>
 #include <string>
 #include <system_error>
@@ -268,6 +270,105 @@ void test_crow_path_file_system_updates() {
 
 }
 
+void test_crow_path_file_system_copy() {
+
+    Path src = "__test_copy_src__", dst = "__test_copy_dst__";
+    TRY(src.remove(Path::recurse));
+    TRY(dst.remove(Path::recurse));
+    auto guard = on_scope_exit([=] {
+        src.remove(Path::recurse);
+        dst.remove(Path::recurse);
+    });
+
+    std::string big(5'000'000, '\0');
+    for (size_t i = 0; i < big.size(); ++i)
+        big[i] = char(i * 31 % 251);
+
+    TRY((src / "a" / "b").make_directory(Path::recurse));
+    TRY((src / "empty").make_directory());
+    TRY((src / "one").save("1"));
+    TRY((src / "zero").save(""));
+    TRY((src / "a" / "two").save("22"));
+    TRY((src / "a" / "b" / "big").save(big));
+
+    #ifdef _XOPEN_SOURCE
+        TRY(Path("one").make_symlink(src / "link"));
+    #endif
+
+    Path file1 = src / "a" / "b" / "big", file2 = "__test_copy_file__";
+    auto file_guard = on_scope_exit([=] { file2.remove(); });
+
+    TRY(file1.copy_to(file2));
+    TEST(file2.load() == big);
+    TEST_THROW(file1.copy_to(file2), std::system_error);
+    TRY((src / "one").copy_to(file2, Path::overwrite));
+    TEST_EQUAL(file2.load(), "1");
+    TEST_THROW(file2.copy_to(file2, Path::overwrite), std::system_error);
+
+    #ifdef __linux__
+        // Reports a size of zero but is not empty
+        std::string status;
+        TRY(Path("/proc/self/status").copy_to(file2, Path::overwrite));
+        TRY(status = file2.load());
+        TEST(status.starts_with("Name:"));
+    #endif
+
+    TEST_THROW(src.copy_tree(src), std::system_error);
+    TRY(src.copy_tree(dst));
+    TEST((dst / "empty").is_directory());
+    TEST_EQUAL((dst / "one").load(), "1");
+    TEST_EQUAL((dst / "zero").load(), "");
+    TEST_EQUAL((dst / "a" / "two").load(), "22");
+    TEST((dst / "a" / "b" / "big").load() == big);
+
+    #ifdef _XOPEN_SOURCE
+        TEST((dst / "link").is_symlink());
+    #endif
+
+    TEST_THROW(src.copy_tree(dst), std::system_error);
+    TRY((dst / "one").save("changed", Path::overwrite));
+    TRY(src.copy_tree(dst, Path::overwrite, 2));
+    TEST_EQUAL((dst / "one").load(), "1");
+    TEST_THROW(Path("__no_such_dir__").copy_tree(dst, Path::overwrite), std::system_error);
+
+}
+
+void test_crow_path_file_system_copy_benchmark() {
+
+    static constexpr int n_dirs = 20;
+    static constexpr int n_files = 100;
+    static constexpr size_t file_size = 16'384;
+
+    Path src = "__test_copy_benchmark__", dst1 = "__test_copy_benchmark_1__", dst2 = "__test_copy_benchmark_2__";
+    TRY(src.remove(Path::recurse));
+    auto guard = on_scope_exit([=] {
+        src.remove(Path::recurse);
+        dst1.remove(Path::recurse);
+        dst2.remove(Path::recurse);
+    });
+
+    std::string content(file_size, 'x');
+    for (int i = 0; i < n_dirs; ++i) {
+        auto dir = src / ("dir-" + std::to_string(i));
+        dir.make_directory(Path::recurse);
+        for (int j = 0; j < n_files; ++j)
+            (dir / ("file-" + std::to_string(j))).save(content);
+    }
+
+    auto start = steady_clock::now();
+    TRY(src.copy_to(dst1, Path::recurse));
+    auto serial = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    start = steady_clock::now();
+    TRY(src.copy_tree(dst2));
+    auto parallel = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+    std::cout << "... copy_to(recurse): " << int(n_dirs * n_files / serial) << " files/s\n";
+    std::cout << "... copy_tree(): " << int(n_dirs * n_files / parallel) << " files/s\n";
+
+    TEST_EQUAL((dst2 / "dir-7" / "file-42").load(), content);
+
+}
+
 void test_crow_path_io() {
 
     Path cmcache = "CMakeCache.txt";
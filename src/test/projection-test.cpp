@@ -1,4 +1,5 @@
 #include "crow/projection.hpp"
+#include "crow/benchmark.hpp"
 #include "crow/colour.hpp"
 #include "crow/image.hpp"
 #include "crow/string.hpp"
@@ -10,12 +11,14 @@
 #include <iostream>
 #include <memory>
 #include <numbers>
+#include <span>
 #include <string>
 #include <vector>
 
 using namespace Crow;
 using namespace Crow::Literals;
 
+using namespace std::literals;
 using std::numbers::pi;
 
 namespace {
@@ -520,6 +523,123 @@ void test_crow_projection_interrupted_sinusoidal() {
 
 }
 
+namespace {
+
+    std::vector<Double2> globe_grid(int n) {
+        std::vector<Double2> points;
+        for (int i = 0; i <= n; ++i) {
+            double theta = pi * i / n;
+            for (int j = 0; j < 2 * n; ++j)
+                points.push_back({pi * j / n, theta});
+        }
+        return points;
+    }
+
+    void check_batch(const BasicMapProjection<double>& proj) {
+
+        auto polar = globe_grid(36);
+        std::vector<Double2> xy(polar.size());
+        std::vector<Double2> back(polar.size());
+
+        TRY(proj.globe_to_map(polar, xy));
+        TRY(proj.map_to_globe(xy, back));
+
+        for (size_t i = 0; i < polar.size(); ++i) {
+            auto scalar_xy = proj.globe_to_map(polar[i]);
+            auto scalar_polar = proj.map_to_globe(xy[i]);
+            TEST_NEAR(xy[i].x(), scalar_xy.x(), epsilon);
+            TEST_NEAR(xy[i].y(), scalar_xy.y(), epsilon);
+            TEST_NEAR(back[i].x(), scalar_polar.x(), epsilon);
+            TEST_NEAR(back[i].y(), scalar_polar.y(), epsilon);
+        }
+
+        std::vector<Double2> in_place = polar;
+        TRY(proj.globe_to_map(in_place, in_place));
+        TEST_EQUAL_RANGES(in_place, xy);
+
+    }
+
+    void check_round_trip(const BasicMapProjection<double>& proj) {
+
+        std::vector<Double2> polar;
+        for (int i = 1; i < 36; ++i)
+            for (int j = 1; j < 36; ++j)
+                polar.push_back({pi * (j - 18) / 18, pi * i / 36});
+        std::vector<Double2> xy(polar.size());
+        std::vector<Double2> back(polar.size());
+
+        TRY(proj.globe_to_map(polar, xy));
+        TRY(proj.map_to_globe(xy, back));
+
+        for (size_t i = 0; i < polar.size(); ++i) {
+            TEST_NEAR(symmetric_remainder(back[i].x() - polar[i].x(), 2 * pi), 0, 1e-8);
+            TEST_NEAR(back[i].y(), polar[i].y(), 1e-8);
+        }
+
+    }
+
+    void benchmark_projection(const BasicMapProjection<double>& proj) {
+
+        static constexpr int grid = 50;
+
+        auto polar = globe_grid(grid);
+        std::vector<Double2> xy(polar.size());
+        Benchmark<> bench(1);
+
+        auto scalar = bench.run([&] {
+            for (size_t i = 0; i < polar.size(); ++i)
+                xy[i] = proj.globe_to_map(polar[i]);
+            return polar.size();
+        }, 100ms);
+
+        auto batch = bench.run([&] {
+            proj.globe_to_map(polar, xy);
+            return polar.size();
+        }, 100ms);
+
+        auto scalar_rate = int64_t(1e9 * double(polar.size()) / double(scalar.average.count()));
+        auto batch_rate = int64_t(1e9 * double(polar.size()) / double(batch.average.count()));
+        std::cout << "... " << proj.name() << ": scalar " << scalar_rate << " points/s, batch " << batch_rate << " points/s\n";
+
+    }
+
+}
+
+void test_crow_projection_batch_conversion() {
+
+    check_batch(AzimuthalEquidistantProjection<double>(pcentre));
+    check_batch(LambertAzimuthalProjection<double>(pcentre));
+    check_batch(CylindricalEquidistantProjection<double>(pcentre));
+    check_batch(MercatorProjection<double>(pcentre));
+    check_batch(Eckert4Projection<double>(pcentre));
+    check_batch(MollweideProjection<double>(pcentre));
+    check_batch(SinusoidalProjection<double>(pcentre));
+    check_batch(InterruptedProjection<MollweideProjection<double>>(pcentre, std::vector<double>{-20_degd}));
+
+    check_round_trip(Eckert4Projection<double>());
+    check_round_trip(MollweideProjection<double>());
+
+    std::vector<Double2> polar(10, pcentre);
+    std::vector<Double2> xy(5, {42, 42});
+    MollweideProjection<double> proj(pcentre);
+    TRY(proj.globe_to_map(polar, xy));
+    for (auto& p: xy) {
+        TEST_NEAR(p.x(), 0, epsilon);
+        TEST_NEAR(p.y(), 0, epsilon);
+    }
+
+}
+
+void test_crow_projection_batch_benchmark() {
+
+    benchmark_projection(LambertAzimuthalProjection<double>());
+    benchmark_projection(MercatorProjection<double>());
+    benchmark_projection(Eckert4Projection<double>());
+    benchmark_projection(MollweideProjection<double>());
+    benchmark_projection(SinusoidalProjection<double>());
+
+}
+
 namespace {
 
     constexpr int max_size = 500;
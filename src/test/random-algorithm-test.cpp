@@ -1,8 +1,11 @@
 #include "crow/random-algorithms.hpp"
 #include "crow/random-engines.hpp"
+#include "crow/thread-pool.hpp"
 #include "crow/unit-test.hpp"
 #include <algorithm>
+#include <list>
 #include <numeric>
+#include <stdexcept>
 #include <vector>
 
 using namespace Crow;
@@ -48,3 +51,176 @@ void test_crow_random_shuffle() {
     }
 
 }
+
+void test_crow_random_streaming_sample() {
+
+    StdRng rng(42);
+    std::vector<int> u(100);
+    std::iota(u.begin(), u.end(), 0);
+    std::list<int> list(u.begin(), u.end());
+    std::vector<int> v, w;
+    std::vector<int> counts(100, 0);
+
+    for (size_t k = 5; k < 100; k += 5) {
+        for (int i = 0; i < 100; ++i) {
+            w = v;
+            TRY(v = sample(list, rng, k));
+            TEST_EQUAL(v.size(), k);
+            for (auto x: v) {
+                TEST_IN_RANGE(x, 0, 99);
+                ++counts[size_t(x)];
+            }
+            std::sort(v.begin(), v.end());
+            TEST(v != w);
+            for (size_t i = 0; i + 1 < k; ++i)
+                TEST(v[i] < v[i + 1]);
+        }
+    }
+
+    // Each element should be picked about 950 times
+
+    for (auto c: counts)
+        TEST_IN_RANGE(c, 800, 1100);
+
+    ReservoirSample<int> reservoir(10);
+
+    for (int i = 0; i < 5; ++i)
+        TRY(reservoir.add(i, rng));
+
+    TEST_EQUAL(reservoir.count(), 5u);
+    TEST_EQUAL(reservoir.size(), 5u);
+    TEST_EQUAL(format_range(reservoir.values()), "[0,1,2,3,4]");
+
+    for (int i = 5; i < 1000; ++i)
+        TRY(reservoir.add(i, rng));
+
+    TEST_EQUAL(reservoir.count(), 1000u);
+    TEST_EQUAL(reservoir.size(), 10u);
+
+}
+
+void test_crow_random_weighted_sample() {
+
+    static constexpr int iterations = 10'000;
+
+    StdRng rng(42);
+    std::vector<int> u = {1, 2, 3, 4};
+    std::vector<int> v;
+    std::vector<int> counts(5, 0);
+
+    for (int i = 0; i < iterations; ++i) {
+        TRY(v = weighted_sample(u, [] (int x) { return x; }, rng, 1));
+        TEST_EQUAL(v.size(), 1u);
+        if (v.size() == 1)
+            ++counts[size_t(v[0])];
+    }
+
+    TEST_EQUAL(counts[0], 0);
+    TEST_NEAR(counts[1] / double(iterations), 0.1, 0.02);
+    TEST_NEAR(counts[2] / double(iterations), 0.2, 0.02);
+    TEST_NEAR(counts[3] / double(iterations), 0.3, 0.02);
+    TEST_NEAR(counts[4] / double(iterations), 0.4, 0.02);
+
+    TRY(v = weighted_sample(u, [] (int x) { return x; }, rng, 10));
+    TEST_EQUAL(v.size(), 4u);
+    std::sort(v.begin(), v.end());
+    TEST(v == u);
+
+}
+
+void test_crow_random_parallel_sample() {
+
+    static constexpr int n = 200'000;
+    static constexpr size_t k = 100;
+
+    ParallelRng<Xoshiro> prng(42);
+    std::vector<int> u(n);
+    std::iota(u.begin(), u.end(), 0);
+    std::vector<int> v, w;
+
+    {
+        ThreadPool pool(1);
+        TRY(v = parallel_sample(u, prng, k, pool));
+    }
+
+    {
+        ThreadPool pool(4);
+        TRY(w = parallel_sample(u, prng, k, pool));
+    }
+
+    TEST_EQUAL(v.size(), k);
+    TEST(v == w);
+    std::sort(v.begin(), v.end());
+    TEST(std::adjacent_find(v.begin(), v.end()) == v.end());
+    TEST(v.back() >= 65'536);
+
+}
+
+void test_crow_random_parallel_shuffle() {
+
+    static constexpr int n = 300'000;
+
+    ParallelRng<Xoshiro> prng(42);
+    std::vector<int> u(n);
+    std::iota(u.begin(), u.end(), 0);
+    std::vector<int> v = u;
+    std::vector<int> w = u;
+
+    {
+        ThreadPool pool(1);
+        TRY(parallel_shuffle(v, prng, pool));
+    }
+
+    {
+        ThreadPool pool(4);
+        TRY(parallel_shuffle(w, prng, pool));
+    }
+
+    TEST(v != u);
+    TEST(v == w);
+
+    // Elements from the first block should be spread over the whole range
+
+    size_t low = 0;
+    for (int i = 0; i < n; ++i)
+        if (v[i] < n / 2 && i >= n / 2)
+            ++low;
+    TEST_NEAR(double(low) / n, 0.25, 0.01);
+
+    std::sort(v.begin(), v.end());
+    TEST(v == u);
+
+    std::vector<int> small = {1, 2, 3};
+    ThreadPool pool;
+    TRY(parallel_shuffle(small, prng, pool));
+    std::sort(small.begin(), small.end());
+    TEST_EQUAL(format_range(small), "[1,2,3]");
+    small.clear();
+    TRY(parallel_shuffle(small, prng, pool));
+    TEST(small.empty());
+
+}
+
+void test_crow_random_parallel_limits() {
+
+    static constexpr size_t sample_limit = ParallelRng<Lcg32>::max_streams * 65'536;
+    static constexpr size_t shuffle_limit = sample_limit / 2;
+
+    ParallelRng<Lcg32> prng(42);
+    ThreadPool pool(2);
+    std::vector<int> u(shuffle_limit);
+    std::iota(u.begin(), u.end(), 0);
+    std::vector<int> v;
+
+    TRY(parallel_shuffle(u, prng, pool));
+    TEST(u[0] != 0 || u[1] != 1);
+    u.push_back(0);
+    TEST_THROW(parallel_shuffle(u, prng, pool), std::out_of_range);
+
+    u.resize(sample_limit);
+    TRY(v = parallel_sample(u, prng, 10, pool));
+    TEST_EQUAL(v.size(), 10u);
+    u.push_back(0);
+    TEST_THROW(parallel_sample(u, prng, 10, pool), std::out_of_range);
+
+}
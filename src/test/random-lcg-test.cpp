@@ -95,3 +95,42 @@ void test_crow_random_lcg_128() {
     TEST_NEAR(stats.sd(), sd, epsilon);
 
 }
+
+void test_crow_random_lcg_advance() {
+
+    static constexpr int n = 1000;
+
+    {
+        Lcg32 rng1(42), rng2(42);
+        for (int i = 0; i < n; ++i)
+            rng1();
+        TRY(rng2.advance(n));
+        TEST(rng1 == rng2);
+        TEST_EQUAL(rng1(), rng2());
+        TRY(rng2.advance(- n - 1));
+        TEST(rng2 == Lcg32(42));
+    }
+
+    {
+        Lcg64 rng1(42), rng2(42);
+        for (int i = 0; i < n; ++i)
+            rng1();
+        TRY(rng2.advance(n));
+        TEST(rng1 == rng2);
+        TEST_EQUAL(rng1(), rng2());
+        TRY(rng2.advance(- n - 1));
+        TEST(rng2 == Lcg64(42));
+    }
+
+    {
+        Lcg128 rng1(42, 86), rng2(42, 86);
+        for (int i = 0; i < n; ++i)
+            rng1();
+        TRY(rng2.advance(n));
+        TEST(rng1 == rng2);
+        TEST_EQUAL(rng1(), rng2());
+        TRY(rng2.advance(- n - 1));
+        TEST(rng2 == Lcg128(42, 86));
+    }
+
+}
@@ -0,0 +1,108 @@
+#include "crow/random.hpp"
+#include "crow/thread-pool.hpp"
+#include "crow/unit-test.hpp"
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+using namespace Crow;
+
+namespace {
+
+    template <typename RNG>
+    std::vector<uint64_t> run_tasks(int threads, int tasks) {
+        ParallelRng<RNG> prng(42);
+        std::vector<uint64_t> out(tasks);
+        ThreadPool pool(threads);
+        pool.each(tasks, [&] (int i) {
+            auto rng = prng(i);
+            uint64_t sum = 0;
+            for (int j = 0; j < 1000; ++j)
+                sum += rng();
+            out[i] = sum;
+        });
+        pool.wait();
+        return out;
+    }
+
+}
+
+void test_crow_random_parallel_streams() {
+
+    static constexpr int n = 100;
+
+    ParallelRng<Xoshiro> prng1(42);
+    ParallelRng<Pcg64dxsm> prng2(42);
+    std::set<uint64_t> set1, set2;
+    Xoshiro x;
+    Pcg64dxsm p;
+
+    for (int i = n - 1; i >= 0; --i) {
+        TRY(x = prng1(i));
+        TRY(p = prng2(i));
+        set1.insert(x());
+        set2.insert(p());
+    }
+
+    TEST_EQUAL(set1.size(), size_t(n));
+    TEST_EQUAL(set2.size(), size_t(n));
+
+    Xoshiro x0(42);
+    TEST_EQUAL(prng1(0)(), x0());
+    x0.seed(42);
+    x0.jump();
+    x0.jump();
+    TEST_EQUAL(prng1(2)(), x0());
+
+    Pcg64dxsm p0(42);
+    TEST_EQUAL(prng2(0)(), p0());
+    p0.seed(42);
+    p0.advance(int64_t(1) << 48);
+    TEST_EQUAL(prng2(1)(), p0());
+
+}
+
+void test_crow_random_parallel_thread_pool() {
+
+    static constexpr int tasks = 50;
+
+    std::vector<uint64_t> v1, v2, v3, v4;
+
+    TRY(v1 = run_tasks<Xoshiro>(1, tasks));
+    TRY(v2 = run_tasks<Xoshiro>(4, tasks));
+    TEST(v1 == v2);
+    TRY(v3 = run_tasks<Pcg64>(1, tasks));
+    TRY(v4 = run_tasks<Pcg64>(4, tasks));
+    TEST(v3 == v4);
+    TEST(v1 != v3);
+
+}
+
+void test_crow_random_parallel_stream_limits() {
+
+    ParallelRng<Lcg32> prng1(42);
+    ParallelRng<Pcg64dxsm> prng2(42);
+    ParallelRng<Xoshiro> prng3(42);
+    Lcg32 x;
+    Pcg64dxsm p;
+
+    TEST_EQUAL(ParallelRng<Lcg32>::max_streams, 256u);
+    TEST_EQUAL(ParallelRng<Pcg64dxsm>::max_streams, 32'768u);
+    TEST_EQUAL(ParallelRng<Xoshiro>::max_streams, npos);
+
+    TRY(x = prng1(255));
+    Lcg32 x0(42);
+    x0.advance(int64_t(255) << 24);
+    TEST_EQUAL(x(), x0());
+    TEST_THROW(prng1(256), std::out_of_range);
+
+    TRY(p = prng2(32'767));
+    Pcg64dxsm p0(42);
+    for (int i = 0; i < 32'767; ++i)
+        p0.advance(int64_t(1) << 48);
+    TEST_EQUAL(p(), p0());
+    TEST_THROW(prng2(32'768), std::out_of_range);
+
+    TRY(prng3(1000));
+
+}
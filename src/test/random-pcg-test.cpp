@@ -98,3 +98,32 @@ void test_crow_random_pcg64dxsm() {
     }
 
 }
+
+void test_crow_random_pcg64dxsm_advance() {
+
+    static constexpr int n = 1000;
+
+    Pcg64dxsm rng1(42, 86), rng2(42, 86);
+    std::vector<uint64_t> v1, v2;
+
+    for (int i = 0; i < n; ++i)
+        rng1();
+    for (int i = 0; i < 10; ++i)
+        v1.push_back(rng1());
+
+    TRY(rng2.advance(n));
+    for (int i = 0; i < 10; ++i)
+        v2.push_back(rng2());
+    TEST(v1 == v2);
+
+    TRY(rng2.advance(- n - 10));
+    v2.clear();
+    for (int i = 0; i < 10; ++i)
+        v2.push_back(rng2());
+    rng1.seed(42, 86);
+    v1.clear();
+    for (int i = 0; i < 10; ++i)
+        v1.push_back(rng1());
+    TEST(v1 == v2);
+
+}
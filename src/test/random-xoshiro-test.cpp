@@ -66,3 +66,33 @@ void test_crow_random_xoshiro256ss() {
     }
 
 }
+
+void test_crow_random_xoshiro_jump() {
+
+    static const std::vector<uint64_t> expect1 = {
+        0xbbd2'f312'2984'43d8ull, 0x62e5'7db2'd570'6577ull, 0x34d1'8903'74a6'd72bull, 0xa042'5028'ca8b'66a0ull,
+    };
+
+    static const std::vector<uint64_t> expect2 = {
+        0x5277'52a1'd792'704dull, 0xd8d8'bdec'5759'9e64ull, 0x601c'b926'727e'b003ull, 0xe0cd'980a'8425'3102ull,
+    };
+
+    Xoshiro rng(1, 2, 3, 4);
+    uint64_t x = 0;
+
+    TRY(rng.jump());
+
+    for (auto y: expect1) {
+        TRY(x = rng());
+        TEST_EQUAL(x, y);
+    }
+
+    TRY(rng.seed(1, 2, 3, 4));
+    TRY(rng.long_jump());
+
+    for (auto y: expect2) {
+        TRY(x = rng());
+        TEST_EQUAL(x, y);
+    }
+
+}
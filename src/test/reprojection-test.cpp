@@ -0,0 +1,158 @@
+#include "crow/reprojection.hpp"
+#include "crow/colour.hpp"
+#include "crow/image.hpp"
+#include "crow/projection.hpp"
+#include "crow/random.hpp"
+#include "crow/thread-pool.hpp"
+#include "crow/unit-test.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+using namespace Crow;
+
+namespace {
+
+    const std::string test_image_dir = "../src/test/images/";
+    const std::string earth_map = test_image_dir + "nasa-earth.png";
+
+    Image<Rgba8> random_image(Point shape) {
+        Pcg64 rng(42);
+        UniformInteger<int> dist(0, 255);
+        Image<Rgba8> image(shape);
+        for (auto& pixel: image)
+            pixel = Rgba8(uint8_t(dist(rng)), uint8_t(dist(rng)), uint8_t(dist(rng)), 255);
+        return image;
+    }
+
+    double mismatch(const Image<Rgba8>& a, const Image<Rgba8>& b, int threshold) {
+        size_t count = 0;
+        auto j = b.begin();
+        for (auto i = a.begin(); i != a.end(); ++i, ++j) {
+            for (int k = 0; k < Rgba8::channels; ++k) {
+                if (std::abs(int((*i)[k]) - int((*j)[k])) > threshold) {
+                    ++count;
+                    break;
+                }
+            }
+        }
+        return double(count) / double(a.size());
+    }
+
+}
+
+void test_crow_reprojection_identity() {
+
+    CylindricalEquidistantProjection<double> proj;
+    ThreadPool pool(4);
+    auto in = random_image(Point(120, 60));
+    Image<Rgba8> out(120, 60);
+
+    MapReprojection<double> engine(proj, proj);
+    TEST_EQUAL(engine.filter(), ReprojectFilter::bilinear);
+    TEST_EQUAL(engine.tile_size(), 64);
+    TEST_EQUAL(engine.grid_step(), 8);
+
+    TRY(engine.set_filter(ReprojectFilter::nearest));
+    TRY(engine(in, out, pool));
+    TEST(out == in);
+
+    TRY(engine.set_filter(ReprojectFilter::bilinear));
+    TRY(engine(in, out, pool));
+    TEST(out == in);
+
+    TRY(engine.set_filter(ReprojectFilter::bicubic));
+    TRY(engine(in, out, pool));
+    TEST(out == in);
+
+}
+
+void test_crow_reprojection_grid_interpolation() {
+
+    Image<Rgba8> in;
+    TRY(in.load(earth_map));
+    TRY(in.resize({360, 180}, ImageResize::unlock));
+
+    CylindricalEquidistantProjection<double> source;
+    MollweideProjection<double> target;
+    ThreadPool pool;
+    Image<Rgba8> fast(400, 200);
+    Image<Rgba8> exact(400, 200);
+
+    MapReprojection<double> engine(source, target);
+    TRY(engine.set_wrap());
+    TRY(engine(in, fast, pool));
+    TRY(engine.set_grid_step(1));
+    TRY(engine(in, exact, pool));
+
+    TEST(mismatch(fast, exact, 8) < 0.01);
+    TEST_EQUAL(fast(0, 0), Rgba8());
+    TEST_EQUAL(fast(399, 199), Rgba8());
+    TEST_EQUAL(fast(200, 100).alpha(), 255);
+
+    AzimuthalEquidistantProjection<double> polar_target(Double2{0, 0});
+    MapReprojection<double> polar_engine(source, polar_target);
+    Image<Rgba8> polar_fast(256, 256);
+    Image<Rgba8> polar_exact(256, 256);
+
+    TRY(polar_engine.set_wrap());
+    TRY(polar_engine(in, polar_fast, pool));
+    TRY(polar_engine.set_grid_step(1));
+    TRY(polar_engine(in, polar_exact, pool));
+
+    TEST(mismatch(polar_fast, polar_exact, 8) < 0.01);
+
+}
+
+void test_crow_reprojection_strips() {
+
+    auto in = random_image(Point(180, 90));
+    CylindricalEquidistantProjection<double> source;
+    Eckert4Projection<double> target;
+    ThreadPool pool(4);
+    Image<Rgba8> whole(250, 125);
+    Image<Rgba8> joined(250, 125);
+    int calls = 0;
+    int next_row = 0;
+
+    MapReprojection<double> engine(source, target);
+    TRY(engine.set_tile_size(32));
+    TRY(engine(in, whole, pool));
+
+    TRY(engine.strips(in, whole.shape(), 37, pool, [&] (const Image<Rgba8>& strip, int y) {
+        ++calls;
+        TEST_EQUAL(y, next_row);
+        TEST_EQUAL(strip.width(), 250);
+        next_row += strip.height();
+        std::copy(strip.begin(), strip.end(), joined.locate(0, y));
+    }));
+
+    TEST_EQUAL(calls, 4);
+    TEST_EQUAL(next_row, 125);
+    TEST(joined == whole);
+
+}
+
+void test_crow_reprojection_function() {
+
+    auto in = random_image(Point(100, 50));
+    CylindricalEquidistantProjection<double> source;
+    MollweideProjection<double> target;
+    Image<Rgba8> out(100, 50);
+    Image<Rgba8> empty;
+
+    TRY(reproject(in, source, out, target, ReprojectFilter::bicubic));
+    TEST_EQUAL(out(0, 0), Rgba8());
+    TEST_EQUAL(out(50, 25).alpha(), 255);
+
+    TEST_THROW(reproject(in, source, empty, target), std::invalid_argument);
+    TEST_THROW(reproject(empty, source, out, target), std::invalid_argument);
+
+    MapReprojection<double> engine(source, target);
+    TEST_THROW(engine.set_tile_size(0), std::invalid_argument);
+    TEST_THROW(engine.set_grid_step(0), std::invalid_argument);
+    TEST_THROW(engine.set_tolerance(-1), std::invalid_argument);
+    TEST_THROW(engine.set_source_extent({{0, 0}, {0, 1}}), std::invalid_argument);
+
+}
@@ -0,0 +1,195 @@
+#include "crow/sqlite.hpp"
+#include "crow/format.hpp"
+#include "crow/guard.hpp"
+#include "crow/path.hpp"
+#include "crow/thread-pool.hpp"
+#include "crow/unit-test.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace Crow;
+using namespace Crow::Sqlite;
+using namespace std::chrono;
+using namespace std::literals;
+
+namespace {
+
+    const Path test_dir = "__test_sqlite_pool__";
+
+    std::string test_file() {
+        test_dir.remove(Path::recurse);
+        test_dir.make_directory();
+        return (test_dir / "pool.db").name();
+    }
+
+}
+
+void test_crow_sqlite_pool_leases() {
+
+    auto guard = on_scope_exit([] { test_dir.remove(Path::recurse); });
+    auto file = test_file();
+    int count = 0;
+
+    TEST_THROW(Pool("", 2), InvalidArgument);
+    TEST_THROW(Pool(file, 2, Mode::memory), InvalidArgument);
+    TEST_THROW(Pool(file, 2, Mode::write | Mode::create), InvalidArgument);
+
+    Pool pool(file, 2);
+    TEST_EQUAL(pool.readers(), 2);
+    TEST_EQUAL(pool.idle_readers(), 2);
+    TEST_EQUAL(pool.file(), file);
+
+    {
+        auto writer = pool.write();
+        REQUIRE(writer);
+        TEST(writer.is_writer());
+        TEST(! pool.try_write());
+        TRY(writer->run("create table items(id integer primary key, name text)"));
+        TRY(writer->insert_many("insert into items values(?,?)",
+            std::vector<std::tuple<int, std::string>>{{1, "alpha"}, {2, "bravo"}, {3, "charlie"}}));
+    }
+
+    {
+        auto writer = pool.try_write();
+        TEST(writer);
+    }
+
+    {
+        auto r1 = pool.read();
+        auto r2 = pool.try_read();
+        REQUIRE(r1);
+        REQUIRE(r2);
+        TEST(! r1.is_writer());
+        TEST(&*r1 != &*r2);
+        TEST_EQUAL(pool.idle_readers(), 0);
+        TEST(! pool.try_read());
+        TRY(count = int(r1->cached_query("select count(*) from items").run()));
+        TEST_EQUAL(count, 3);
+        TEST_EQUAL(r1->cache_size(), 1u);
+        TEST_EQUAL(r2->cache_size(), 0u);
+        TEST_THROW(r2->run("insert into items values(4,'delta')"), SqliteError);
+        auto r3 = std::move(r2);
+        TEST(! r2);
+        TEST(r3);
+        r3.release();
+        TEST(! r3);
+        TEST_EQUAL(pool.idle_readers(), 1);
+    }
+
+    TEST_EQUAL(pool.idle_readers(), 2);
+
+    // A reader blocked on an empty pool wakes when a lease is returned
+
+    {
+        auto r1 = pool.read();
+        auto r2 = pool.read();
+        std::atomic<bool> done = false;
+        std::thread t([&] {
+            auto r3 = pool.read();
+            done = true;
+        });
+        std::this_thread::sleep_for(20ms);
+        TEST(! done);
+        r1.release();
+        t.join();
+        TEST(done);
+    }
+
+    // Readers see committed writes while a write transaction is open
+
+    {
+        auto writer = pool.write();
+        Transaction tx(*writer);
+        TRY(writer->run("insert into items values(4,'delta')"));
+        auto reader = pool.read();
+        TRY(count = int((*reader)("select count(*) from items")));
+        TEST_EQUAL(count, 3);
+        TRY(tx.commit());
+        TRY(count = int((*reader)("select count(*) from items")));
+        TEST_EQUAL(count, 4);
+    }
+
+}
+
+void test_crow_sqlite_pool_thread_pool() {
+
+    auto guard = on_scope_exit([] { test_dir.remove(Path::recurse); });
+    auto file = test_file();
+    Pool pool(file, 4);
+    ThreadPool threads(8);
+    std::atomic<int> total = 0;
+
+    {
+        auto writer = pool.write();
+        TRY(writer->run("create table numbers(value integer)"));
+    }
+
+    for (int i = 1; i <= 100; ++i)
+        pool.submit_write(threads, [i] (Connect& con) {
+            con.cached_query("insert into numbers values(?)").run(i);
+        });
+    threads.wait();
+
+    for (int i = 0; i < 50; ++i)
+        pool.submit_read(threads, [&total] (Connect& con) {
+            total += int(con.cached_query("select sum(value) from numbers").run());
+        });
+    threads.wait();
+
+    TEST_EQUAL(total.load(), 50 * 5050);
+    TEST_EQUAL(pool.idle_readers(), 4);
+
+}
+
+void test_crow_sqlite_pool_benchmark() {
+
+    static constexpr int rows = 10'000;
+    static constexpr int queries_per_thread = 4'000;
+
+    auto guard = on_scope_exit([] { test_dir.remove(Path::recurse); });
+    auto file = test_file();
+    int max_threads = std::clamp(int(std::thread::hardware_concurrency()), 4, 8);
+    Pool pool(file, max_threads);
+
+    {
+        auto writer = pool.write();
+        std::vector<std::tuple<int, std::string>> data;
+        for (int i = 0; i < rows; ++i)
+            data.push_back({i, fmt("Record number {0}", i)});
+        TRY(writer->run("create table records(id integer primary key, name text)"));
+        TRY(writer->insert_many("insert into records values(?,?)", data, Mode::bulk));
+    }
+
+    double base_rate = 0;
+
+    for (int n = 1; n <= max_threads; n *= 2) {
+        std::atomic<int> found = 0;
+        std::vector<std::thread> workers;
+        auto start = steady_clock::now();
+        for (int t = 0; t < n; ++t)
+            workers.emplace_back([&pool,&found,t] {
+                auto con = pool.read();
+                for (int i = 0; i < queries_per_thread; ++i) {
+                    auto id = (i * 7919 + t * 104729) % rows;
+                    auto name = con->cached_query("select name from records where id=?").run(id).get<std::string>();
+                    found += int(! name.empty());
+                }
+            });
+        for (auto& w: workers)
+            w.join();
+        auto secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+        TEST_EQUAL(found.load(), n * queries_per_thread);
+        auto rate = n * queries_per_thread / secs;
+        if (n == 1)
+            base_rate = rate;
+        std::cout << "... Sqlite pool read: " << n << " threads " << int(rate) << " queries/s ("
+            << fmt("{0:f2}", rate / base_rate) << "x)\n";
+    }
+
+}
@@ -2,8 +2,12 @@
 #include "crow/format.hpp"
 #include "crow/unit-test.hpp"
 #include <chrono>
+#include <cstddef>
 #include <iostream>
+#include <span>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <vector>
 
 using namespace Crow;
@@ -112,3 +116,201 @@ void test_crow_sqlite_connection() {
         "CREATE TABLE tango(number integer not null primary key,name text not null)");
 
 }
+
+void test_crow_sqlite_statement_cache() {
+
+    Connect dbc(Mode::memory);
+    Query query;
+    int count = 0;
+
+    TRY(dbc.run("create table items(id integer primary key, name text)"));
+    TEST_EQUAL(dbc.cache_capacity(), Connect::default_cache);
+    TEST_EQUAL(dbc.cache_size(), 0u);
+
+    TRY(query = dbc.cached_query("insert into items values(?,?)"));
+    TEST_EQUAL(dbc.cache_size(), 1u);
+    TRY(query(1, "alpha"));
+    auto handle = query.native_handle();
+
+    TRY(query = dbc.cached_query("insert into items values(?,?)"));
+    TEST_EQUAL(dbc.cache_size(), 1u);
+    TEST(query.native_handle() == handle);
+    TEST_THROW(query.run(), InvalidArgument);
+    TRY(query(2, "bravo"));
+    TRY(count = int(dbc.cached_query("select count(*) from items").run()));
+    TEST_EQUAL(count, 2);
+    TEST_EQUAL(dbc.cache_size(), 2u);
+
+    TRY(dbc.set_cache_capacity(2));
+    TRY(dbc.cached_query("select name from items where id=?"));
+    TEST_EQUAL(dbc.cache_size(), 2u);
+    TRY(query = dbc.cached_query("insert into items values(?,?)"));
+    TEST(query.native_handle() != handle);
+
+    TRY(dbc.set_cache_capacity(1));
+    TEST_EQUAL(dbc.cache_size(), 1u);
+    TRY(dbc.clear_cache());
+    TEST_EQUAL(dbc.cache_size(), 0u);
+    TRY(dbc.set_cache_capacity(0));
+    TRY(query = dbc.cached_query("insert into items values(?,?)"));
+    TRY(query(3, "charlie"));
+    TEST_EQUAL(dbc.cache_size(), 0u);
+
+}
+
+void test_crow_sqlite_binding() {
+
+    Connect dbc(Mode::memory);
+    Query query;
+    Result result;
+
+    TRY(dbc.run("create table data(id integer primary key, value)"));
+    TRY(query = dbc.query("insert into data values(?,?)"));
+
+    std::string str = "hello";
+    std::string_view view = "world";
+    std::vector<std::byte> bytes = {std::byte(0), std::byte(0xff), std::byte(42)};
+    double pi = 3.141592653589793;
+    float third = 1.0f / 3.0f;
+
+    TRY(query(1, str));
+    TRY(query(2, view));
+    TRY(query(3, std::span<const std::byte>(bytes)));
+    TRY(query(4, pi));
+    TRY(query(5, third));
+    TRY(query(6, nullptr));
+    TRY(query(7, 'x'));
+    TRY(query(8, ""));
+
+    std::string s;
+    std::string_view sv;
+    std::span<const std::byte> span;
+    double x = 0;
+    int n = 0;
+
+    TRY(query = dbc.query("select value from data where id=?"));
+    TRY(s = query(1).get<std::string>());                       TEST_EQUAL(s, "hello");
+    TRY(s = query(2).get<std::string>());                       TEST_EQUAL(s, "world");
+    TRY(s = query(7).get<std::string>());                       TEST_EQUAL(s, "x");
+    TRY(s = query(8).get<std::string>());                       TEST_EQUAL(s, "");
+    TRY(x = query(4).get<double>());                            TEST_EQUAL(x, pi);
+    TRY(x = query(5).get<double>());                            TEST_EQUAL(x, double(third));
+    TRY(x = query(6).get<double>());                            TEST_EQUAL(x, 0.0);
+    TRY(n = int(dbc("select count(*) from data where value is null")));
+    TEST_EQUAL(n, 1);
+
+    TRY(result = query(1));
+    TRY(sv = result.get<std::string_view>());
+    TEST_EQUAL(sv, "hello");
+    TRY(result = {});
+    TRY(result = query(3));
+    TRY(span = result.get<std::span<const std::byte>>());
+    TEST_EQUAL(span.size(), 3u);
+    TEST(std::equal(span.begin(), span.end(), bytes.begin(), bytes.end()));
+    TRY(result = {});
+    TRY(result = query(6));
+    TRY(sv = result.get<std::string_view>());
+    TEST(sv.empty());
+
+    for (auto& row: dbc("select value from data where id<=2 order by id")) {
+        TRY(sv = row.get<std::string_view>(0));
+        TEST(sv == "hello" || sv == "world");
+    }
+
+}
+
+void test_crow_sqlite_insert_many() {
+
+    Connect dbc(Mode::memory);
+    std::vector<std::tuple<int, std::string>> rows;
+    std::vector<int> numbers = {10, 20, 30};
+    size_t n = 0;
+    int count = 0;
+
+    for (int i = 1; i <= 25; ++i)
+        rows.push_back({i, fmt("Item {0}", i)});
+
+    TRY(dbc.run("create table items(id integer primary key, name text)"));
+    TRY(dbc.run("create table numbers(value integer)"));
+
+    TEST_THROW(dbc.insert_many("insert into items values(?,?)", rows, Mode::persistent), InvalidArgument);
+    TEST_THROW(dbc.insert_many("insert into items values(?,?)", rows, Mode::none, 0), InvalidArgument);
+
+    TRY(n = dbc.insert_many("insert into items values(?,?)", rows, Mode::none, 10));
+    TEST_EQUAL(n, 25u);
+    TRY(count = int(dbc("select count(*) from items")));
+    TEST_EQUAL(count, 25);
+    TEST(! dbc.in_transaction());
+
+    TRY(n = dbc.insert_many("insert into numbers values(?)", numbers, Mode::bulk));
+    TEST_EQUAL(n, 3u);
+    TRY(count = int(dbc("select sum(value) from numbers")));
+    TEST_EQUAL(count, 60);
+
+    // A failing row rolls back its own batch, but earlier batches remain committed
+
+    rows.clear();
+    for (int i = 101; i <= 125; ++i)
+        rows.push_back({i, "new"});
+    rows.push_back({1, "duplicate"});
+    TEST_THROW(dbc.insert_many("insert into items values(?,?)", rows, Mode::none, 20), SqliteError);
+    TRY(count = int(dbc("select count(*) from items")));
+    TEST_EQUAL(count, 45);
+    TEST(! dbc.in_transaction());
+
+    // Inside an existing transaction the rows join it instead
+
+    {
+        Transaction tx(dbc);
+        TEST(dbc.in_transaction());
+        TRY(n = dbc.insert_many("insert into numbers values(?)", numbers, Mode::bulk, 2));
+        TEST_EQUAL(n, 3u);
+        TEST(dbc.in_transaction());
+    }
+
+    TRY(count = int(dbc("select count(*) from numbers")));
+    TEST_EQUAL(count, 3);
+
+}
+
+void test_crow_sqlite_insert_benchmark() {
+
+    using namespace std::chrono;
+
+    static constexpr int naive_rows = 500;
+    static constexpr int batch_rows = 100'000;
+
+    Connect dbc(Mode::tempfile);
+    std::vector<std::tuple<int, std::string, double>> rows;
+    int count = 0;
+
+    for (int i = 0; i < batch_rows; ++i)
+        rows.push_back({i, fmt("Record number {0}", i), i * 0.25});
+
+    TRY(dbc.run("create table naive(id integer primary key, name text, value real)"));
+    TRY(dbc.run("create table batch(id integer primary key, name text, value real)"));
+
+    auto rate = [] (int n, auto start) {
+        auto secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+        return int(n / secs);
+    };
+
+    auto start = steady_clock::now();
+    for (int i = 0; i < naive_rows; ++i) {
+        auto& [a, b, c] = rows[size_t(i)];
+        TRY(dbc.query("insert into naive values(?,?,?)").run(a, b, c));
+    }
+    auto naive_rate = rate(naive_rows, start);
+
+    start = steady_clock::now();
+    TRY(dbc.insert_many("insert into batch values(?,?,?)", rows, Mode::bulk));
+    auto batch_rate = rate(batch_rows, start);
+
+    TRY(count = int(dbc("select count(*) from naive")));
+    TEST_EQUAL(count, naive_rows);
+    TRY(count = int(dbc("select count(*) from batch")));
+    TEST_EQUAL(count, batch_rows);
+
+    std::cout << "... Sqlite insert: per row " << naive_rate << " rows/s, insert_many " << batch_rate << " rows/s\n";
+
+}
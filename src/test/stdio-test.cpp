@@ -3,13 +3,17 @@
 #include "crow/path.hpp"
 #include "crow/unit-test.hpp"
 #include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <iterator>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 using namespace Crow;
+using namespace std::chrono;
 
 #ifdef _XOPEN_SOURCE
     #define SLASH "/"
@@ -223,6 +227,106 @@ void test_crow_stdio_pipe() {
 
 }
 
+void test_crow_stdio_fdio_buffering() {
+
+    Fdio io;
+    Path file = "__fdio_test__";
+    std::string text, expect;
+    std::string_view view;
+    std::vector<std::string> vec;
+    ptrdiff_t offset = 0;
+    char buf[10];
+    auto guard = on_scope_exit([=] { file.remove(); });
+
+    for (int i = 0; i < 100; ++i)
+        expect += "Line " + std::to_string(i) + ' ' + std::string(size_t(i), '*') + '\n';
+    expect += "Last line";
+
+    TRY(io = Fdio(file, IoMode::write));
+    TRY(io.writes(expect));
+    TRY(io.close());
+
+    for (size_t block: {0, 1, 7, 64, 65'536}) {
+
+        TRY(io = Fdio(file));
+        TRY(io.set_buffer_size(block));
+        TEST_EQUAL(io.buffer_size(), block);
+        text.clear();
+        for (auto& line: io.lines())
+            text += line;
+        TEST_EQUAL(text, expect);
+
+        TRY(io = Fdio(file));
+        TRY(io.set_buffer_size(block));
+        text.clear();
+        for (auto line: io.lines_view()) {
+            TEST(line.size() < 120u);
+            text += line;
+        }
+        TEST_EQUAL(text, expect);
+
+    }
+
+    // Mixed buffered and unbuffered operations
+
+    TRY(io = Fdio(file));
+    TRY(io.set_buffer_size(64));
+    TRY(text = io.read_line());     TEST_EQUAL(text, "Line 0 \n");
+    TRY(offset = io.tell());        TEST_EQUAL(offset, 8);
+    TEST_EQUAL(io.getc(), 'L');
+    TEST_EQUAL(io.read(buf, 5), 5u);
+    TEST_EQUAL(std::string(buf, 5), "ine 1");
+    TRY(offset = io.tell());        TEST_EQUAL(offset, 14);
+    TRY(view = io.read_line_view()); TEST_EQUAL(view, " *\n");
+    TRY(io.seek(-3));
+    TRY(text = io.reads(3));        TEST_EQUAL(text, " *\n");
+    TRY(io.seek(0, SEEK_SET));
+    TRY(view = io.read_line_view()); TEST_EQUAL(view, "Line 0 \n");
+    TRY(text = io.read_all());      TEST_EQUAL(text, expect.substr(8));
+    TRY(view = io.read_line_view()); TEST_EQUAL(view, "");
+    TRY(io.close());
+
+    // Writes go to the logical position, not the end of the read-ahead
+
+    TRY(io = Fdio(file, IoMode::open_existing));
+    TRY(io.set_buffer_size(64));
+    TRY(text = io.read_line());     TEST_EQUAL(text, "Line 0 \n");
+    TRY(io.writes("XXXX"));
+    TRY(offset = io.tell());        TEST_EQUAL(offset, 12);
+    TRY(io.seek(0, SEEK_SET));
+    TRY(text = io.read_line());     TEST_EQUAL(text, "Line 0 \n");
+    TRY(text = io.read_line());     TEST_EQUAL(text, "XXXX 1 *\n");
+    TRY(io.close());
+
+    // Lines longer than the buffer
+
+    TRY(io = Fdio(file, IoMode::write));
+    TRY(io.writes(std::string(1000, 'a') + "\nb\n" + std::string(500, 'c')));
+    TRY(io.close());
+    TRY(io = Fdio(file));
+    TRY(io.set_buffer_size(16));
+    vec.clear();
+    for (auto line: io.lines_view())
+        vec.push_back(std::string(line));
+    TEST_EQUAL(vec.size(), 3u);
+    vec.resize(3);
+    TEST_EQUAL(vec[0], std::string(1000, 'a') + "\n");
+    TEST_EQUAL(vec[1], "b\n");
+    TEST_EQUAL(vec[2], std::string(500, 'c'));
+
+    // Pipes are not seekable; read-ahead data must survive a write
+
+    std::pair<Fdio, Fdio> pipe;
+    TRY(pipe = Fdio::pipe());
+    TRY(pipe.second.writes("one\ntwo\nthree\n"));
+    TRY(text = pipe.first.read_line());  TEST_EQUAL(text, "one\n");
+    TRY(pipe.second.close());
+    TRY(text = pipe.first.read_line());  TEST_EQUAL(text, "two\n");
+    TRY(view = pipe.first.read_line_view());  TEST_EQUAL(view, "three\n");
+    TRY(view = pipe.first.read_line_view());  TEST_EQUAL(view, "");
+
+}
+
 void test_crow_stdio_winio() {
 
     #ifdef _WIN32
@@ -385,6 +489,109 @@ void test_crow_stdio_null_device() {
 
 }
 
+void test_crow_stdio_mapped_file() {
+
+    MappedFile mf;
+    Path file = "__mapped_file_test__", empty_file = "__mapped_file_empty__";
+    std::string expect, text;
+    std::vector<std::string> vec;
+    auto guard = on_scope_exit([=] { file.remove(); empty_file.remove(); });
+
+    TEST(! mf.is_open());
+    TEST_EQUAL(mf.size(), 0u);
+    TEST(mf.view().empty());
+    TEST_THROW(MappedFile("__no_such_file__"), IoError);
+    TEST_THROW(MappedFile(file, IoMode::write), IoError);
+
+    for (int i = 0; i < 2000; ++i)
+        expect += "Line " + std::to_string(i) + '\n';
+    TRY(file.save(expect));
+    TRY(empty_file.save(""));
+
+    TRY(mf = MappedFile(file));
+    TEST(mf.is_open());
+    TEST(! mf.is_writable());
+    TEST_EQUAL(mf.size(), expect.size());
+    TEST_EQUAL(mf.window_size(), expect.size());
+    TEST_EQUAL(mf.view(), expect);
+    TEST_EQUAL(mf.bytes().size(), expect.size());
+    TEST_THROW(mf.mutable_bytes(), IoError);
+    TEST_THROW(mf.writes("x"), IoError);
+    TRY(mf.advise(MapHint::sequential | MapHint::willneed | MapHint::hugepages));
+    TEST_THROW(mf.advise(MapHint::sequential | MapHint::random), IoError);
+    TRY(text = mf.read_all());
+    TEST_EQUAL(text, expect);
+    TRY(mf.seek(0, SEEK_SET));
+    vec.clear();
+    for (auto& line: mf.lines())
+        vec.push_back(line);
+    TEST_EQUAL(vec.size(), 2000u);
+    vec.resize(2000);
+    TEST_EQUAL(vec[0], "Line 0\n");
+    TEST_EQUAL(vec[1999], "Line 1999\n");
+    TRY(mf.seek(-10, SEEK_END));
+    TEST_EQUAL(mf.tell(), ptrdiff_t(expect.size() - 10));
+    TRY(text = mf.reads(100));
+    TEST_EQUAL(text, "Line 1999\n");
+    TEST_EQUAL(mf.getc(), EOF);
+    TRY(mf.close());
+    TEST(! mf.is_open());
+
+    // Windowed mapping
+
+    size_t window = MappedFile::granularity();
+    TRY(mf = MappedFile(file, IoMode::read, window));
+    TEST_EQUAL(mf.window(), window);
+    TEST_EQUAL(mf.window_offset(), 0u);
+    TEST_EQUAL(mf.window_size(), window);
+    TEST_EQUAL(mf.view(), expect.substr(0, window));
+    TRY(text = mf.read_all());
+    TEST_EQUAL(text, expect);
+    TRY(mf.seek(0, SEEK_SET));
+    vec.clear();
+    for (auto& line: mf.lines())
+        vec.push_back(line);
+    TEST_EQUAL(vec.size(), 2000u);
+    TRY(text.clear());
+    for (auto& line: vec)
+        text += line;
+    TEST_EQUAL(text, expect);
+    TRY(mf.seek(ptrdiff_t(window) - 3, SEEK_SET));
+    TRY(text = mf.reads(6));
+    TEST_EQUAL(text, expect.substr(window - 3, 6));
+    TRY(mf.remap(1000, 50));
+    TEST_EQUAL(mf.window_offset(), 1000u);
+    TEST_EQUAL(mf.view(), expect.substr(1000, 50));
+    TRY(mf.remap(expect.size() - 5));
+    TEST_EQUAL(mf.view(), expect.substr(expect.size() - 5));
+
+    // Writable mapping
+
+    TRY(mf = MappedFile(file, IoMode::open_existing));
+    TEST(mf.is_writable());
+    TRY(mf.seek(5, SEEK_SET));
+    TRY(mf.writes("ZERO"));
+    TRY(mf.mutable_bytes()[0] = std::byte('l'));
+    TRY(mf.seek(-3, SEEK_END));
+    TEST_EQUAL(mf.write("abcdef", 6), 3u);
+    TRY(mf.flush());
+    TRY(mf.close());
+    TRY(text = file.load());
+    TEST_EQUAL(text.substr(0, 14), "line ZEROne 1\n");
+    TEST_EQUAL(text.substr(text.size() - 5), "19abc");
+    TEST_EQUAL(text.size(), expect.size());
+
+    // Empty file
+
+    TRY(mf = MappedFile(empty_file));
+    TEST(mf.is_open());
+    TEST_EQUAL(mf.size(), 0u);
+    TEST(mf.view().empty());
+    TEST_EQUAL(mf.read_all(), "");
+    TEST_EQUAL(mf.read_line(), "");
+
+}
+
 void test_crow_stdio_anonymous_temporary_file() {
 
     std::unique_ptr<TempFile> tf;
@@ -415,3 +622,88 @@ void test_crow_stdio_named_temporary_file() {
     TEST(! path.exists());
 
 }
+
+void test_crow_stdio_line_benchmark() {
+
+    static constexpr int n_lines = 200'000;
+    static constexpr int n_unbuffered = 2'000;
+
+    Path file = "__line_benchmark__";
+    auto guard = on_scope_exit([=] { file.remove(); });
+
+    {
+        Fdio out(file, IoMode::write);
+        std::string block;
+        for (int i = 0; i < n_lines; ++i) {
+            block += "2026-10-19T12:00:00Z INFO request " + std::to_string(i) + " completed in 42 ms\n";
+            if (block.size() > 60'000) {
+                out.writes(block);
+                block.clear();
+            }
+        }
+        out.writes(block);
+    }
+
+    auto report = [] (const std::string& what, int lines, size_t bytes, auto start) {
+        auto secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+        std::cout << "... " << what << ": " << int(lines / secs) << " lines/s, "
+            << int(1e-6 * double(bytes) / secs) << " MB/s\n";
+    };
+
+    int count = 0;
+    size_t bytes = 0;
+
+    auto start = steady_clock::now();
+    {
+        Cstdio io(file);
+        for (auto& line: io.lines()) {
+            ++count;
+            bytes += line.size();
+        }
+    }
+    TEST_EQUAL(count, n_lines);
+    report("Cstdio::lines()", count, bytes, start);
+
+    count = 0;
+    bytes = 0;
+    start = steady_clock::now();
+    {
+        Fdio io(file);
+        io.set_buffer_size(0);
+        for (auto& line: io.lines()) {
+            ++count;
+            bytes += line.size();
+            if (count == n_unbuffered)
+                break;
+        }
+    }
+    TEST_EQUAL(count, n_unbuffered);
+    report("Fdio::lines() unbuffered", count, bytes, start);
+
+    count = 0;
+    bytes = 0;
+    start = steady_clock::now();
+    {
+        Fdio io(file);
+        for (auto& line: io.lines()) {
+            ++count;
+            bytes += line.size();
+        }
+    }
+    TEST_EQUAL(count, n_lines);
+    report("Fdio::lines()", count, bytes, start);
+
+    count = 0;
+    bytes = 0;
+    start = steady_clock::now();
+    {
+        Fdio io(file);
+        for (auto line: io.lines_view()) {
+            ++count;
+            bytes += line.size();
+        }
+    }
+    TEST_EQUAL(count, n_lines);
+    report("Fdio::lines_view()", count, bytes, start);
+
+}
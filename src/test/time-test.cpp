@@ -3,6 +3,8 @@
 #include <chrono>
 #include <cmath>
 #include <cstdlib>
+#include <ctime>
+#include <iostream>
 #include <ratio>
 #include <stdexcept>
 #include <string>
@@ -221,6 +223,138 @@ void test_crow_time_date_parsing() {
 
 }
 
+void test_crow_time_civil_calendar() {
+
+    int64_t y = 0;
+    int m = 0, d = 0;
+
+    TEST_EQUAL(Detail::days_from_civil(1970, 1, 1), 0);
+    TEST_EQUAL(Detail::days_from_civil(2000, 3, 1), 11'017);
+    TEST_EQUAL(Detail::days_from_civil(1969, 12, 31), -1);
+    TEST_EQUAL(Detail::days_from_civil(1600, 2, 29), -135'081);
+
+    for (int64_t days = -1'000'000; days <= 1'000'000; days += 17) {
+        Detail::civil_from_days(days, y, m, d);
+        REQUIRE(Detail::days_from_civil(y, m, d) == days);
+    }
+
+    #ifdef _XOPEN_SOURCE
+
+        std::tm tm;
+        std::string s;
+
+        for (std::time_t t = -4'000'000'000ll; t < 8'000'000'000ll; t += 86'400 * 37 + 3'607) {
+            gmtime_r(&t, &tm);
+            Detail::civil_from_days(int64_t(t >= 0 ? t / 86'400 : (t - 86'399) / 86'400), y, m, d);
+            REQUIRE(y == tm.tm_year + 1900);
+            REQUIRE(m == tm.tm_mon + 1);
+            REQUIRE(d == tm.tm_mday);
+            REQUIRE(system_clock::to_time_t(make_date(int(y), m, d, tm.tm_hour, tm.tm_min, tm.tm_sec)) == t);
+        }
+
+    #endif
+
+}
+
+void test_crow_time_date_formatting_edge_cases() {
+
+    system_clock::time_point tp;
+    std::string s;
+
+    TRY(tp = make_date(2000, 12, 31, 23, 59, 59.9999));
+    TRY(s = iso_date(tp));     TEST_EQUAL(s, "2000-12-31 23:59:59");
+    TRY(s = iso_date(tp, 3));  TEST_EQUAL(s, "2001-01-01 00:00:00.000");
+    TRY(s = iso_date(tp, 4));  TEST_EQUAL(s, "2000-12-31 23:59:59.9999");
+    TRY(tp = make_date(2000, 12, 31, 23, 59, 59) + microseconds(999'999));
+    TRY(s = iso_date(tp, 6));  TEST_EQUAL(s, "2000-12-31 23:59:59.999999");
+    TRY(s = iso_date(tp, 9));  TEST_EQUAL(s, "2000-12-31 23:59:59.999999000");
+    TRY(s = iso_date(tp, 12)); TEST_EQUAL(s, "2000-12-31 23:59:59.999999000000");
+    TRY(s = iso_date(tp, 5));  TEST_EQUAL(s, "2001-01-01 00:00:00.00000");
+
+    TRY(tp = make_date(1960, 2, 29, 1, 2, 3.25));
+    TRY(s = iso_date(tp, 2));  TEST_EQUAL(s, "1960-02-29 01:02:03.25");
+
+    TRY(tp = make_date(2021, 2, 3, 4, 5, 6.7899));
+    TRY(s = format_date(tp, "H:M:S"));                            TEST_EQUAL(s, "4:5:6");
+    TRY(s = format_date(tp, "yyyy-mm-dd HH:MM:SS.sss"));          TEST_EQUAL(s, "2021-02-03 04:05:06.790");
+    TRY(s = format_date(tp, "Www, dd Mmm yyyy HH:MM:SS"));        TEST_EQUAL(s, "Wed, 03 Feb 2021 04:05:06");
+
+    TEST_THROW(format_date(tp, "yyy"), std::invalid_argument);
+    TEST_THROW(format_date(tp, "SSS"), std::invalid_argument);
+
+    // Repeated calls within the same second use the cached fields
+
+    TRY(tp = make_date(2021, 2, 3, 4, 5, 6));
+
+    for (int i = 0; i < 10; ++i) {
+        TRY(s = iso_date(tp + milliseconds(100 * i), 1));
+        TEST_EQUAL(s, "2021-02-03 04:05:06." + std::to_string(i));
+    }
+
+}
+
+void test_crow_time_iso_date_parsing() {
+
+    system_clock::time_point date = {};
+    std::string str;
+
+    TRY(date = parse_date("2017-11-04T12:34:56Z"));                   TRY(str = iso_date(date, 3));  TEST_EQUAL(str, "2017-11-04 12:34:56.000");
+    TRY(date = parse_date("2017-11-04t12:34:56z"));                   TRY(str = iso_date(date, 3));  TEST_EQUAL(str, "2017-11-04 12:34:56.000");
+    TRY(date = parse_date("2017-11-04T12:34:56.5Z"));                 TRY(str = iso_date(date, 3));  TEST_EQUAL(str, "2017-11-04 12:34:56.500");
+    TRY(date = parse_date("2017-11-04T12:34:56,25Z"));                TRY(str = iso_date(date, 3));  TEST_EQUAL(str, "2017-11-04 12:34:56.250");
+    TRY(date = parse_date("2017-11-04T12:34:56+01:00"));              TRY(str = iso_date(date, 3));  TEST_EQUAL(str, "2017-11-04 11:34:56.000");
+    TRY(date = parse_date("2017-11-04T12:34:56-0530"));               TRY(str = iso_date(date, 3));  TEST_EQUAL(str, "2017-11-04 18:04:56.000");
+    TRY(date = parse_date("2017-11-04T00:30+02"));                    TRY(str = iso_date(date, 3));  TEST_EQUAL(str, "2017-11-03 22:30:00.000");
+    TRY(date = parse_date("2017-11-04T12:34:56.123456789Z"));         TRY(str = iso_date(date, 9));  TEST_EQUAL(str, "2017-11-04 12:34:56.123456789");
+    TRY(date = parse_date("2017-11-04 12:34:56.123456789"));          TRY(str = iso_date(date, 9));  TEST_EQUAL(str, "2017-11-04 12:34:56.123456789");
+    TRY(date = parse_date("2017-11-04 12:34:56.1234567891234"));      TRY(str = iso_date(date, 9));  TEST_EQUAL(str, "2017-11-04 12:34:56.123456789");
+    TRY(date = parse_date("1901-02-03 04:05:06.789"));                TRY(str = iso_date(date, 3));  TEST_EQUAL(str, "1901-02-03 04:05:06.789");
+
+    // Not strict ISO, handled by the general parser
+
+    TRY(date = parse_date("2017-11-04 12.34.56"));                    TRY(str = iso_date(date, 3));  TEST_EQUAL(str, "2017-11-04 12:34:56.000");
+    TRY(date = parse_date("2017/11/04 12:34:56.789"));                TRY(str = iso_date(date, 3));  TEST_EQUAL(str, "2017-11-04 12:34:56.789");
+
+    TRY(date = parse_date("2017-11-04 12:34:56", DT::local));
+    TRY(str = iso_date(date, 0, DT::local));
+    TEST_EQUAL(str, "2017-11-04 12:34:56");
+
+}
+
+void test_crow_time_date_benchmark() {
+
+    static constexpr int iterations = 1'000'000;
+
+    auto base = make_date(2021, 2, 3, 4, 5, 6);
+    auto tp = base;
+    size_t total = 0;
+
+    auto start = steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        total += iso_date(base + microseconds(i), 6).size();
+    auto secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    std::cout << "... iso_date: " << int(iterations / secs) << " calls/s\n";
+    TEST_EQUAL(total, 26u * iterations);
+
+    DateFormatter df("Www, dd Mmm yyyy HH:MM:SS.sss ZZZZ");
+    total = 0;
+    start = steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        total += df(base + microseconds(i)).size();
+    secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    std::cout << "... format_date: " << int(iterations / secs) << " calls/s\n";
+    TEST_EQUAL(total, 35u * iterations);
+
+    std::string text = "2021-02-03T04:05:06.789Z";
+    start = steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        tp = parse_date(text);
+    secs = duration_cast<duration<double>>(steady_clock::now() - start).count();
+    std::cout << "... parse_date: " << int(iterations / secs) << " calls/s\n";
+    TEST_EQUAL(iso_date(tp, 3), "2021-02-03 04:05:06.789");
+
+}
+
 void test_crow_time_point_formatting() {
 
     system_clock::time_point tp;
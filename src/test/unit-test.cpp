@@ -9,6 +9,9 @@ void version_test_group() {
 void log_test_group() {
     UNIT_TEST(crow_logging)
     UNIT_TEST(crow_logging_output)
+    UNIT_TEST(crow_logging_async)
+    UNIT_TEST(crow_logging_async_overflow)
+    UNIT_TEST(crow_logging_benchmark)
 }
 
 void types_test_group() {
@@ -53,6 +56,12 @@ void approx_formatting_test_group() {
     UNIT_TEST(crow_approx_formatting)
 }
 
+void async_io_test_group() {
+    UNIT_TEST(crow_async_io_threads)
+    UNIT_TEST(crow_async_io_uring)
+    UNIT_TEST(crow_async_io_benchmark)
+}
+
 void benchmark_test_group() {
     UNIT_TEST(crow_benchmark)
 }
@@ -166,6 +175,9 @@ void dice_test_group() {
     UNIT_TEST(crow_dice_generation)
     UNIT_TEST(crow_dice_literals)
     UNIT_TEST(crow_dice_pdf)
+    UNIT_TEST(crow_dice_exact_pdf)
+    UNIT_TEST(crow_dice_large_generation)
+    UNIT_TEST(crow_dice_benchmark)
     UNIT_TEST(crow_dice_integer_arithmetic)
     UNIT_TEST(crow_dice_integer_statistics)
     UNIT_TEST(crow_dice_integer_parser)
@@ -173,6 +185,12 @@ void dice_test_group() {
     UNIT_TEST(crow_dice_integer_literals)
 }
 
+void directory_walker_test_group() {
+    UNIT_TEST(crow_directory_walker_serial)
+    UNIT_TEST(crow_directory_walker_parallel)
+    UNIT_TEST(crow_directory_walker_benchmark)
+}
+
 void dso_test_group() {
     UNIT_TEST(crow_dso_loading)
 }
@@ -180,6 +198,10 @@ void dso_test_group() {
 void encoding_test_group() {
     UNIT_TEST(crow_encoding_hexcode)
     UNIT_TEST(crow_encoding_base64)
+    UNIT_TEST(crow_encoding_random)
+    UNIT_TEST(crow_encoding_spans)
+    UNIT_TEST(crow_encoding_streaming)
+    UNIT_TEST(crow_encoding_benchmark)
 }
 
 void english_test_group() {
@@ -267,6 +289,7 @@ void font_test_group() {
     UNIT_TEST(crow_font_text_fitting)
     UNIT_TEST(crow_font_text_wrapping)
     UNIT_TEST(crow_font_rendering)
+    UNIT_TEST(crow_font_glyph_cache)
     UNIT_TEST(crow_font_map)
 }
 
@@ -282,6 +305,9 @@ void format_floating_test_group() {
     UNIT_TEST(crow_format_floating_point_fixed_point_format)
     UNIT_TEST(crow_format_floating_point_general_format)
     UNIT_TEST(crow_format_floating_point_probability_format)
+    UNIT_TEST(crow_format_floating_point_round_trip)
+    UNIT_TEST(crow_format_floating_point_special_values)
+    UNIT_TEST(crow_format_floating_point_benchmark)
 }
 
 void format_integer_test_group() {
@@ -293,6 +319,7 @@ void format_misc_test_group() {
     UNIT_TEST(crow_format_null_values)
     UNIT_TEST(crow_format_std_ordering)
     UNIT_TEST(crow_format_std_optional)
+    UNIT_TEST(crow_format_benchmark)
 }
 
 void format_numeric_test_group() {
@@ -320,6 +347,8 @@ void format_type_test_group() {
     UNIT_TEST(crow_format_class)
     UNIT_TEST(crow_format_function)
     UNIT_TEST(crow_format_literals)
+    UNIT_TEST(crow_format_static_formatter)
+    UNIT_TEST(crow_format_output_functions)
 }
 
 void formula_test_group() {
@@ -693,6 +722,8 @@ void path_file_system_test_group() {
     UNIT_TEST(crow_path_resolution)
     UNIT_TEST(crow_path_file_system_queries)
     UNIT_TEST(crow_path_file_system_updates)
+    UNIT_TEST(crow_path_file_system_copy)
+    UNIT_TEST(crow_path_file_system_copy_benchmark)
     UNIT_TEST(crow_path_io)
     UNIT_TEST(crow_path_links)
     UNIT_TEST(crow_path_metadata)
@@ -778,6 +809,8 @@ void projection_test_group() {
     UNIT_TEST(crow_projection_interrupted_eckert_iv)
     UNIT_TEST(crow_projection_interrupted_mollweide)
     UNIT_TEST(crow_projection_interrupted_sinusoidal)
+    UNIT_TEST(crow_projection_batch_conversion)
+    UNIT_TEST(crow_projection_batch_benchmark)
     UNIT_TEST(crow_projection_sample_maps)
 }
 
@@ -793,6 +826,11 @@ void random_adapter_test_group() {
 void random_algorithm_test_group() {
     UNIT_TEST(crow_random_sample)
     UNIT_TEST(crow_random_shuffle)
+    UNIT_TEST(crow_random_streaming_sample)
+    UNIT_TEST(crow_random_weighted_sample)
+    UNIT_TEST(crow_random_parallel_sample)
+    UNIT_TEST(crow_random_parallel_shuffle)
+    UNIT_TEST(crow_random_parallel_limits)
 }
 
 void random_concept_test_group() {
@@ -818,6 +856,7 @@ void random_lcg_test_group() {
     UNIT_TEST(crow_random_lcg_32)
     UNIT_TEST(crow_random_lcg_64)
     UNIT_TEST(crow_random_lcg_128)
+    UNIT_TEST(crow_random_lcg_advance)
 }
 
 void random_non_arithmetic_test_group() {
@@ -827,9 +866,16 @@ void random_non_arithmetic_test_group() {
     UNIT_TEST(crow_random_uuid)
 }
 
+void random_parallel_test_group() {
+    UNIT_TEST(crow_random_parallel_streams)
+    UNIT_TEST(crow_random_parallel_thread_pool)
+    UNIT_TEST(crow_random_parallel_stream_limits)
+}
+
 void random_pcg_test_group() {
     UNIT_TEST(crow_random_pcg64)
     UNIT_TEST(crow_random_pcg64dxsm)
+    UNIT_TEST(crow_random_pcg64dxsm_advance)
 }
 
 void random_seed_test_group() {
@@ -850,6 +896,7 @@ void random_squirrel_test_group() {
 void random_xoshiro_test_group() {
     UNIT_TEST(crow_random_splitmix64)
     UNIT_TEST(crow_random_xoshiro256ss)
+    UNIT_TEST(crow_random_xoshiro_jump)
 }
 
 void rational_test_group() {
@@ -893,6 +940,13 @@ void regex_runtime_flags_test_group() {
     UNIT_TEST(crow_regex_runtime_flags)
 }
 
+void reprojection_test_group() {
+    UNIT_TEST(crow_reprojection_identity)
+    UNIT_TEST(crow_reprojection_grid_interpolation)
+    UNIT_TEST(crow_reprojection_strips)
+    UNIT_TEST(crow_reprojection_function)
+}
+
 void resource_test_group() {
     UNIT_TEST(crow_resource_handle)
 }
@@ -926,8 +980,18 @@ void spectrum_property_test_group() {
     UNIT_TEST(crow_spectrum_inverse_properties)
 }
 
+void sqlite_pool_test_group() {
+    UNIT_TEST(crow_sqlite_pool_leases)
+    UNIT_TEST(crow_sqlite_pool_thread_pool)
+    UNIT_TEST(crow_sqlite_pool_benchmark)
+}
+
 void sqlite_test_group() {
     UNIT_TEST(crow_sqlite_connection)
+    UNIT_TEST(crow_sqlite_statement_cache)
+    UNIT_TEST(crow_sqlite_binding)
+    UNIT_TEST(crow_sqlite_insert_many)
+    UNIT_TEST(crow_sqlite_insert_benchmark)
 }
 
 void stable_map_multimap_test_group() {
@@ -960,10 +1024,13 @@ void stdio_test_group() {
     UNIT_TEST(crow_stdio_cstdio)
     UNIT_TEST(crow_stdio_fdio)
     UNIT_TEST(crow_stdio_pipe)
+    UNIT_TEST(crow_stdio_fdio_buffering)
     UNIT_TEST(crow_stdio_winio)
     UNIT_TEST(crow_stdio_null_device)
+    UNIT_TEST(crow_stdio_mapped_file)
     UNIT_TEST(crow_stdio_anonymous_temporary_file)
     UNIT_TEST(crow_stdio_named_temporary_file)
+    UNIT_TEST(crow_stdio_line_benchmark)
 }
 
 void string_casing_test_group() {
@@ -1084,6 +1151,10 @@ void time_test_group() {
     UNIT_TEST(crow_time_date_formatting)
     UNIT_TEST(crow_time_parsing)
     UNIT_TEST(crow_time_date_parsing)
+    UNIT_TEST(crow_time_civil_calendar)
+    UNIT_TEST(crow_time_date_formatting_edge_cases)
+    UNIT_TEST(crow_time_iso_date_parsing)
+    UNIT_TEST(crow_time_date_benchmark)
     UNIT_TEST(crow_time_point_formatting)
     UNIT_TEST(crow_time_point_conversion)
     UNIT_TEST(crow_time_system_specific_conversions)
@@ -1135,6 +1206,9 @@ void uri_general_test_group() {
     UNIT_TEST(crow_uri_navigation)
     UNIT_TEST(crow_uri_encoding)
     UNIT_TEST(crow_uri_query)
+    UNIT_TEST(crow_uri_views)
+    UNIT_TEST(crow_uri_normalize)
+    UNIT_TEST(crow_uri_parse_benchmark)
 }
 
 void uri_schemes_test_group() {
@@ -1162,6 +1236,17 @@ void web_client_test_group() {
     UNIT_TEST(crow_web_client_http_head)
     UNIT_TEST(crow_web_client_http_get)
     UNIT_TEST(crow_web_client_rest_api)
+    UNIT_TEST(crow_web_client_batch_futures)
+    UNIT_TEST(crow_web_client_batch_callbacks)
+    UNIT_TEST(crow_web_client_download)
+    UNIT_TEST(crow_web_client_download_back_pressure)
+}
+
+void xml_benchmark_test_group() {
+    UNIT_TEST(crow_xml_benchmark_document)
+    UNIT_TEST(crow_xml_benchmark_document_view)
+    UNIT_TEST(crow_xml_benchmark_reader)
+    UNIT_TEST(crow_xml_benchmark_text_coding)
 }
 
 void xml_construction_test_group() {
@@ -1173,6 +1258,7 @@ void xml_construction_test_group() {
 void xml_functions_test_group() {
     UNIT_TEST(crow_xml_functions_character_encoding)
     UNIT_TEST(crow_xml_functions_character_decoding)
+    UNIT_TEST(crow_xml_functions_long_strings)
     UNIT_TEST(crow_xml_functions_name_validation)
 }
 
@@ -1198,9 +1284,31 @@ void xml_parsing_test_group() {
     UNIT_TEST(crow_xml_parse_complex_elements)
 }
 
+void xml_reader_test_group() {
+    UNIT_TEST(crow_xml_reader_events)
+    UNIT_TEST(crow_xml_reader_empty_elements)
+    UNIT_TEST(crow_xml_reader_skip)
+    UNIT_TEST(crow_xml_reader_html)
+    UNIT_TEST(crow_xml_reader_errors)
+    UNIT_TEST(crow_xml_reader_stream)
+}
+
 void xml_search_test_group() {
     UNIT_TEST(crow_xml_search_all)
     UNIT_TEST(crow_xml_search_selected)
+    UNIT_TEST(crow_xml_search_index)
+    UNIT_TEST(crow_xml_search_index_isolation)
+    UNIT_TEST(crow_xml_search_index_threads)
+    UNIT_TEST(crow_xml_search_query)
+    UNIT_TEST(crow_xml_search_index_benchmark)
+}
+
+void xml_view_test_group() {
+    UNIT_TEST(crow_xml_view_structure)
+    UNIT_TEST(crow_xml_view_text)
+    UNIT_TEST(crow_xml_view_options)
+    UNIT_TEST(crow_xml_view_move)
+    UNIT_TEST(crow_xml_view_benchmark)
 }
 
 int main(int argc, char** argv) {
@@ -1214,6 +1322,7 @@ int main(int argc, char** argv) {
     approx_arithmetic_test_group();
     approx_construction_test_group();
     approx_formatting_test_group();
+    async_io_test_group();
     benchmark_test_group();
     binary_test_group();
     bounded_array_construction_test_group();
@@ -1234,6 +1343,7 @@ int main(int argc, char** argv) {
     compact_array_tracking_test_group();
     constants_test_group();
     dice_test_group();
+    directory_walker_test_group();
     dso_test_group();
     encoding_test_group();
     english_test_group();
@@ -1334,6 +1444,7 @@ int main(int argc, char** argv) {
     random_discrete_test_group();
     random_lcg_test_group();
     random_non_arithmetic_test_group();
+    random_parallel_test_group();
     random_pcg_test_group();
     random_seed_test_group();
     random_spatial_test_group();
@@ -1346,12 +1457,14 @@ int main(int argc, char** argv) {
     regex_match_test_group();
     regex_replace_test_group();
     regex_runtime_flags_test_group();
+    reprojection_test_group();
     resource_test_group();
     root_finding_test_group();
     spatial_index_test_group();
     spectrum_formatting_test_group();
     spectrum_parsing_test_group();
     spectrum_property_test_group();
+    sqlite_pool_test_group();
     sqlite_test_group();
     stable_map_multimap_test_group();
     stable_map_unique_test_group();
@@ -1384,11 +1497,14 @@ int main(int argc, char** argv) {
     uuid_test_group();
     vector_test_group();
     web_client_test_group();
+    xml_benchmark_test_group();
     xml_construction_test_group();
     xml_functions_test_group();
     xml_options_test_group();
     xml_parsing_test_group();
+    xml_reader_test_group();
     xml_search_test_group();
+    xml_view_test_group();
 
     return Crow::UnitTest::end_tests();
 
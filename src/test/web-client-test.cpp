@@ -1,14 +1,203 @@
 #include "crow/web-client.hpp"
+#include "crow/curl-utility.hpp"
+#include "crow/guard.hpp"
+#include "crow/hash.hpp"
 #include "crow/http.hpp"
+#include "crow/path.hpp"
+#include "crow/stdio.hpp"
 #include "crow/unit-test.hpp"
 #include "crow/uri.hpp"
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _XOPEN_SOURCE
+    #include <fcntl.h>
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
 
 using namespace Crow;
+using namespace std::chrono;
 
 using nlohmann::json;
 
+namespace {
+
+    #ifdef _XOPEN_SOURCE
+
+        // Deterministic large body for download tests
+
+        const std::string& big_body() {
+            static const std::string body = [] {
+                std::string s(1'000'000, '\0');
+                for (size_t i = 0; i < s.size(); ++i)
+                    s[i] = char('a' + (i * 7 + i / 26) % 26);
+                return s;
+            }();
+            return body;
+        }
+
+        // Minimal HTTP/1.1 server on the loopback interface, with keep-alive.
+        // Responds to any request with "Hello <path>", except "/missing"
+        // which returns 404, and "/big" and "/norange" which return
+        // big_body(). Open ended byte ranges are honoured except for
+        // "/norange". Each response is delayed slightly so that concurrent
+        // requests overlap.
+
+        class TestServer {
+
+        public:
+
+            TestServer() {
+                listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+                sockaddr_in addr = {};
+                addr.sin_family = AF_INET;
+                addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                addr.sin_port = 0;
+                socklen_t len = sizeof(addr);
+                if (listen_fd_ == -1
+                        || bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+                        || listen(listen_fd_, 256) != 0
+                        || getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0)
+                    throw std::runtime_error("Test server failed to start");
+                port_ = ntohs(addr.sin_port);
+                accept_thread_ = std::thread([this] { accept_loop(); });
+            }
+
+            ~TestServer() noexcept {
+                stop_ = true;
+                accept_thread_.join();
+                close(listen_fd_);
+                std::unique_lock lock(mutex_);
+                for (auto fd: fds_)
+                    shutdown(fd, SHUT_RDWR);
+                lock.unlock();
+                for (auto& t: threads_)
+                    t.join();
+            }
+
+            Uri uri(const std::string& path) const { return Uri("http://127.0.0.1:" + std::to_string(port_) + path); }
+            int connections() const noexcept { return connections_; }
+            int max_concurrent() const noexcept { return max_concurrent_; }
+            int requests() const noexcept { return requests_; }
+
+        private:
+
+            int listen_fd_ = -1;
+            int port_ = 0;
+            std::atomic<bool> stop_ = false;
+            std::atomic<int> connections_ = 0;
+            std::atomic<int> concurrent_ = 0;
+            std::atomic<int> max_concurrent_ = 0;
+            std::atomic<int> requests_ = 0;
+            std::mutex mutex_;
+            std::vector<int> fds_;
+            std::vector<std::thread> threads_;
+            std::thread accept_thread_;
+
+            void accept_loop() {
+                while (! stop_) {
+                    pollfd pfd = {listen_fd_, POLLIN, 0};
+                    if (poll(&pfd, 1, 20) <= 0)
+                        continue;
+                    int fd = accept(listen_fd_, nullptr, nullptr);
+                    if (fd == -1)
+                        continue;
+                    ++connections_;
+                    std::unique_lock lock(mutex_);
+                    fds_.push_back(fd);
+                    threads_.emplace_back([this,fd] { serve(fd); });
+                }
+            }
+
+            void serve(int fd) {
+                std::string buffer;
+                char chunk[4096];
+                for (;;) {
+                    size_t end;
+                    while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+                        auto n = recv(fd, chunk, sizeof(chunk), 0);
+                        if (n <= 0) {
+                            close(fd);
+                            return;
+                        }
+                        buffer.append(chunk, size_t(n));
+                    }
+                    auto request = buffer.substr(0, end);
+                    buffer.erase(0, end + 4);
+                    respond(fd, request);
+                }
+            }
+
+            void respond(int fd, const std::string& request) {
+                ++requests_;
+                int now = ++concurrent_;
+                int prev = max_concurrent_;
+                while (now > prev && ! max_concurrent_.compare_exchange_weak(prev, now)) {}
+                std::this_thread::sleep_for(2ms);
+                auto sp1 = request.find(' ');
+                auto sp2 = request.find(' ', sp1 + 1);
+                auto method = request.substr(0, sp1);
+                auto path = request.substr(sp1 + 1, sp2 - sp1 - 1);
+                std::string status = "200 OK";
+                std::string body = "Hello " + path;
+                std::string extra;
+                if (path == "/missing") {
+                    status = "404 Not Found";
+                    body = "Not found";
+                } else if (path == "/big" || path == "/norange") {
+                    body = big_body();
+                }
+                auto range = request.find("\r\nRange: bytes=");
+                if (range != std::string::npos && path != "/norange") {
+                    size_t from = std::stoul(request.substr(range + 15));
+                    extra = "Content-Range: bytes " + std::to_string(from) + "-" + std::to_string(body.size() - 1)
+                        + "/" + std::to_string(body.size()) + "\r\n";
+                    status = "206 Partial Content";
+                    body.erase(0, from);
+                }
+                std::string response = "HTTP/1.1 " + status + "\r\n"
+                    "Content-Type: text/plain\r\n"
+                    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                    + extra + "\r\n";
+                if (method != "HEAD")
+                    response += body;
+                --concurrent_;
+                send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+            }
+
+        };
+
+        // A loopback port with nothing listening on it
+
+        int closed_port() {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t len = sizeof(addr);
+            bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+            getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+            close(fd);
+            return ntohs(addr.sin_port);
+        }
+
+    #endif
+
+}
+
 void test_crow_web_client_http_head() {
 
     HttpStatus status = {};
@@ -114,3 +303,280 @@ void test_crow_web_client_rest_api() {
     TRY(value = json["name"]);  TEST_EQUAL(value, "Skyscale");
 
 }
+
+void test_crow_web_client_batch_futures() {
+
+    #ifdef _XOPEN_SOURCE
+
+        static constexpr int n_requests = 200;
+
+        TestServer server;
+        WebClient::batch batch;
+        std::vector<std::future<WebClient::batch::result>> futures;
+        WebClient::batch::result res;
+
+        TEST(batch.native_handle() != nullptr);
+        TRY(batch.set_host_limit(4));
+        TEST_EQUAL(batch.host_limit(), 4);
+
+        for (int i = 0; i < n_requests; ++i)
+            TRY(futures.push_back(batch.request(server.uri("/page/" + std::to_string(i)))));
+
+        TEST_EQUAL(batch.pending(), size_t(n_requests));
+        TRY(batch.run());
+        TEST_EQUAL(batch.pending(), 0u);
+
+        for (int i = 0; i < n_requests; ++i) {
+            TRY(res = futures[i].get());
+            TEST_EQUAL(res.status, HttpStatus::ok);
+            TEST_EQUAL(res.response.body, "Hello /page/" + std::to_string(i));
+            TEST_EQUAL(res.response.head["Content-Type"], "text/plain");
+            TEST_EQUAL(res.uri, server.uri("/page/" + std::to_string(i)));
+        }
+
+        TEST_EQUAL(server.requests(), n_requests);
+        TEST(server.max_concurrent() <= 4);
+        TEST(server.connections() <= 4);
+
+        futures.clear();
+        TRY(futures.push_back(batch.request(server.uri("/missing"))));
+        TRY(futures.push_back(batch.request(server.uri("/head"), {}, WebClient::method::head)));
+        TRY(futures.push_back(batch.request(Uri("http://127.0.0.1:" + std::to_string(closed_port()) + "/"))));
+        TRY(batch.run());
+
+        TRY(res = futures[0].get());
+        TEST_EQUAL(res.status, HttpStatus::not_found);
+        TEST_EQUAL(res.response.body, "Not found");
+        TRY(res = futures[1].get());
+        TEST_EQUAL(res.status, HttpStatus::ok);
+        TEST_EQUAL(res.response.head["Content-Length"], "11");
+        TEST_EQUAL(res.response.body, "");
+        TEST_THROW(futures[2].get(), CurlError);
+
+        TEST(server.connections() <= 5);
+
+    #endif
+
+}
+
+void test_crow_web_client_batch_callbacks() {
+
+    #ifdef _XOPEN_SOURCE
+
+        static constexpr int n_requests = 100;
+
+        TestServer server;
+        WebClient::batch batch;
+        std::vector<std::string> bodies;
+        int errors = 0;
+
+        auto done = [&] (WebClient::batch::result& r, std::exception_ptr error) {
+            if (error)
+                ++errors;
+            else
+                bodies.push_back(r.response.body);
+        };
+
+        TRY(batch.set_host_limit(16));
+
+        for (int i = 0; i < n_requests; ++i)
+            TRY(batch.add(server.uri("/" + std::to_string(i)), done));
+        TRY(batch.run());
+
+        TEST_EQUAL(bodies.size(), size_t(n_requests));
+        TEST_EQUAL(errors, 0);
+        TEST(server.max_concurrent() > 1);
+        TEST(server.max_concurrent() <= 16);
+        TEST(server.connections() <= 16);
+
+        std::sort(bodies.begin(), bodies.end());
+        TEST_EQUAL(bodies.front(), "Hello /0");
+        TEST_EQUAL(bodies.back(), "Hello /99");
+
+        TRY(batch.add(Uri("http://127.0.0.1:" + std::to_string(closed_port()) + "/"), done));
+        TRY(batch.run());
+        TEST_EQUAL(errors, 1);
+
+        // An exception from a callback escapes from run(), and the
+        // remaining transfers can be resumed by calling run() again
+
+        int count = 0;
+
+        for (int i = 0; i < 10; ++i)
+            TRY(batch.add(server.uri("/" + std::to_string(i)), [&] (auto&, auto) {
+                if (++count == 5)
+                    throw std::runtime_error("Stop");
+            }));
+
+        TEST_THROW(batch.run(), std::runtime_error);
+        TEST(count >= 5);
+        TEST(count < 10);
+        TRY(batch.run());
+        TEST_EQUAL(count, 10);
+        TEST_EQUAL(batch.pending(), 0u);
+
+        // Requests queued by a callback are run even if the transfer that
+        // triggered it was the last one active
+
+        bodies.clear();
+        std::function<void(WebClient::batch::result&, std::exception_ptr)> chain;
+
+        chain = [&] (WebClient::batch::result& r, std::exception_ptr error) {
+            done(r, error);
+            if (bodies.size() < 5)
+                batch.add(server.uri("/chain/" + std::to_string(bodies.size())), chain);
+        };
+
+        TRY(batch.add(server.uri("/chain/0"), chain));
+        TRY(batch.run());
+        TEST_EQUAL(bodies.size(), 5u);
+        TEST_EQUAL(batch.pending(), 0u);
+        TEST_EQUAL(bodies.back(), "Hello /chain/4");
+
+    #endif
+
+}
+
+void test_crow_web_client_download() {
+
+    #ifdef _XOPEN_SOURCE
+
+        TestServer server;
+        WebClient client;
+        WebClient::headers head;
+        HttpStatus status = {};
+        const auto& big = big_body();
+
+        std::string text;
+        int chunks = 0;
+        WebClient::function_sink fsink([&] (std::string_view chunk) {
+            text += chunk;
+            ++chunks;
+            return true;
+        });
+
+        TRY(status = client.download(server.uri("/big"), fsink, head));
+        TEST_EQUAL(status, HttpStatus::ok);
+        TEST_EQUAL(head["Content-Length"], std::to_string(big.size()));
+        TEST_EQUAL(text.size(), big.size());
+        TEST(text == big);
+        TEST(chunks > 1);
+
+        std::string buffer = "junk";
+        WebClient::buffer_sink bsink(buffer);
+        TRY(status = client.download(server.uri("/big"), bsink, head));
+        TEST_EQUAL(status, HttpStatus::ok);
+        TEST(buffer == big);
+        TEST(buffer.capacity() >= big.size());
+
+        SHA256 hash;
+        std::string digest;
+        WebClient::hash_sink hsink(hash);
+        TRY(status = client.download(server.uri("/big"), hsink, head));
+        TEST_EQUAL(status, HttpStatus::ok);
+        TRY(digest = hash.get());
+        TEST_EQUAL(digest, SHA256()(big));
+
+        // Resume a partial download into a file
+
+        Path file = "__test_web_client_download__";
+        auto guard = on_scope_exit([=] { file.remove(); });
+        TRY(file.save(big.substr(0, 300'000), Path::overwrite));
+
+        {
+            Fdio io(file, O_WRONLY);
+            WebClient::fdio_sink dsink(io);
+            TRY(status = client.download(server.uri("/big"), dsink, head, {}, 300'000));
+            TEST_EQUAL(status, HttpStatus::partial_content);
+            TEST_EQUAL(head["Content-Length"], std::to_string(big.size() - 300'000));
+        }
+
+        TRY(text = file.load());
+        TEST_EQUAL(text.size(), big.size());
+        TEST(text == big);
+
+        {
+            Fdio io(file, O_WRONLY);
+            WebClient::fdio_sink dsink(io);
+            TEST_THROW(client.download(server.uri("/norange"), dsink, head, {}, 300'000), CurlError);
+        }
+
+        // Error bodies are not passed to the sink
+
+        text.clear();
+        chunks = 0;
+        TRY(status = client.download(server.uri("/missing"), fsink, head));
+        TEST_EQUAL(status, HttpStatus::not_found);
+        TEST_EQUAL(text, "");
+        TEST_EQUAL(chunks, 0);
+        TEST_EQUAL(head["Content-Length"], "9");
+
+        // Exceptions from the sink are passed on to the caller
+
+        WebClient::function_sink throwing([] (std::string_view) -> bool { throw std::runtime_error("Sink"); });
+        TEST_THROW(client.download(server.uri("/big"), throwing, head), std::runtime_error);
+
+        WebClient::parameters response;
+        TRY(status = client.request(server.uri("/hello"), response));
+        TEST_EQUAL(status, HttpStatus::ok);
+        TEST_EQUAL(response.body, "Hello /hello");
+
+    #endif
+
+}
+
+void test_crow_web_client_download_back_pressure() {
+
+    #ifdef _XOPEN_SOURCE
+
+        // Refuses every third chunk, and then reports itself busy for a
+        // couple of checks before accepting it
+
+        class slow_sink:
+        public WebClient::sink {
+        public:
+            std::string text;
+            int pauses = 0;
+            int ready_calls = 0;
+            bool write(const char* ptr, size_t len) override {
+                if (++calls_ % 3 == 0 && busy_ == 0) {
+                    ++pauses;
+                    busy_ = 2;
+                    return false;
+                }
+                text.append(ptr, len);
+                return true;
+            }
+            bool ready() override {
+                ++ready_calls;
+                if (busy_ > 0)
+                    --busy_;
+                return busy_ == 0;
+            }
+        private:
+            int calls_ = 0;
+            int busy_ = 0;
+        };
+
+        TestServer server;
+        WebClient client;
+        WebClient::headers head;
+        HttpStatus status = {};
+        slow_sink sink;
+        int64_t progress_calls = 0;
+
+        {
+            WebClient::progress progress(client, [&] (int64_t, int64_t) { ++progress_calls; return true; });
+            TRY(status = client.download(server.uri("/big"), sink, head));
+        }
+
+        TEST_EQUAL(status, HttpStatus::ok);
+        TEST_EQUAL(sink.text.size(), big_body().size());
+        TEST(sink.text == big_body());
+        TEST(sink.pauses > 0);
+        TEST(sink.ready_calls >= 2 * sink.pauses);
+        TEST(progress_calls > 0);
+
+    #endif
+
+}
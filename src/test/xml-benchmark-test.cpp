@@ -0,0 +1,152 @@
+#include "crow/xml.hpp"
+#include "crow/benchmark.hpp"
+#include "crow/format.hpp"
+#include "crow/unit-test.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace Crow;
+using namespace Crow::Xml;
+using namespace std::literals;
+
+namespace {
+
+    constexpr size_t document_size = 32'000;
+    constexpr auto benchmark_time = 50ms;
+
+    const std::string_view prose =
+        "It was the best of times, it was the worst of times, it was the age of wisdom, "
+        "it was the age of foolishness, it was the epoch of belief &amp; incredulity, "
+        "it was the season of &quot;Light&quot;, it was the season of Darkness.\n";
+
+    struct Sample {
+        std::string name;
+        std::string xml;
+        Options opt = Options::none;
+    };
+
+    // Record-oriented data, many small elements
+    std::string data_document() {
+        std::string xml = "<?xml version=\"1.0\"?>\n<records>\n";
+        for (int i = 0; xml.size() < document_size; ++i)
+            xml += fmt("<record><id>{0}</id><name>Record {0}</name><value>{1}</value></record>\n", i, i * 37 % 1000);
+        return xml + "</records>\n";
+    }
+
+    // Long text runs with occasional entities
+    std::string text_document() {
+        std::string xml = "<?xml version=\"1.0\"?>\n<book>\n";
+        while (xml.size() < document_size)
+            xml += "<para>" + std::string(prose) + std::string(prose) + "</para>\n";
+        return xml + "</book>\n";
+    }
+
+    // Empty elements with many attributes
+    std::string attribute_document() {
+        std::string xml = "<?xml version=\"1.0\"?>\n<nodes>\n";
+        for (int i = 0; xml.size() < document_size; ++i)
+            xml += fmt("<node id=\"{0}\" lat=\"-36.{0}\" lon=\"174.{0}\" user=\"someone\" visible=\"true\" "
+                "version=\"{1}\" changeset=\"1234{0}\" timestamp=\"2026-10-19T12:00:00Z\"/>\n", i, i % 7);
+        return xml + "</nodes>\n";
+    }
+
+    // HTML-style markup with inline elements and loose tags
+    std::string html_document() {
+        std::string xml = "<!DOCTYPE html>\n<html><body>\n";
+        for (int i = 0; xml.size() < document_size; ++i)
+            xml += fmt("<div class=\"item\"><p>Paragraph {0} with <b>bold</b> and <a href=\"/page/{0}\">a link</a>"
+                "&nbsp;&mdash; more text<br>and a line break.<p>Second paragraph<img src=\"{0}.png\"></div>\n", i);
+        return xml + "</body></html>\n";
+    }
+
+    const std::vector<Sample>& samples() {
+        static const std::vector<Sample> list = {
+            { "data",        data_document(),       Options::none },
+            { "text",        text_document(),       Options::none },
+            { "attributes",  attribute_document(),  Options::none },
+            { "html",        html_document(),       Options::html },
+        };
+        return list;
+    }
+
+    template <typename F>
+    int megabytes_per_second(size_t bytes, F f) {
+        Benchmark<> bench(1);
+        auto result = bench.run(f, benchmark_time);
+        return int(1e3 * double(bytes) / double(result.average.count()));
+    }
+
+    void report(const std::string& name, const std::string& what, int rate) {
+        std::cout << "... " << name << ": " << what << " " << rate << " MB/s\n";
+    }
+
+}
+
+void test_crow_xml_benchmark_document() {
+
+    for (auto& sample: samples()) {
+        DocumentPtr doc;
+        TRY(doc = Document::create(sample.xml, sample.opt));
+        REQUIRE(doc);
+        auto rate = megabytes_per_second(sample.xml.size(), [&] {
+            return Document::create(sample.xml, sample.opt)->children();
+        });
+        report(sample.name, "Document", rate);
+    }
+
+}
+
+void test_crow_xml_benchmark_document_view() {
+
+    for (auto& sample: samples()) {
+        TRY(DocumentView(sample.xml, sample.opt));
+        auto rate = megabytes_per_second(sample.xml.size(), [&] {
+            return DocumentView(sample.xml, sample.opt).nodes();
+        });
+        report(sample.name, "DocumentView", rate);
+    }
+
+}
+
+void test_crow_xml_benchmark_reader() {
+
+    for (auto& sample: samples()) {
+        auto read_all = [&] {
+            Reader reader(sample.xml, sample.opt);
+            size_t events = 0;
+            while (reader.next())
+                ++events;
+            return events;
+        };
+        size_t events = 0;
+        TRY(events = read_all());
+        TEST(events > 100u);
+        auto rate = megabytes_per_second(sample.xml.size(), read_all);
+        report(sample.name, "Reader", rate);
+    }
+
+}
+
+void test_crow_xml_benchmark_text_coding() {
+
+    std::string plain;
+    while (plain.size() < document_size)
+        plain += "The quick brown fox jumps over the lazy dog.\n";
+
+    std::string mixed;
+    while (mixed.size() < document_size)
+        mixed += prose;
+
+    auto encoded = encode_text(mixed);
+    auto decoded = decode_text(mixed);
+    TEST_EQUAL(decode_text(encoded), mixed);
+
+    report("plain text", "encode_text", megabytes_per_second(plain.size(), [&] { return encode_text(plain).size(); }));
+    report("plain text", "decode_text", megabytes_per_second(plain.size(), [&] { return decode_text(plain).size(); }));
+    report("mixed text", "encode_text", megabytes_per_second(decoded.size(), [&] { return encode_text(decoded).size(); }));
+    report("mixed text", "decode_text", megabytes_per_second(encoded.size(), [&] { return decode_text(encoded).size(); }));
+
+}
@@ -1,5 +1,7 @@
 #include "crow/xml.hpp"
 #include "crow/unit-test.hpp"
+#include <string>
+#include <string_view>
 
 using namespace Crow;
 using namespace Crow::Xml;
@@ -23,6 +25,48 @@ void test_crow_xml_functions_character_decoding() {
 
 }
 
+void test_crow_xml_functions_long_strings() {
+
+    // Exercise the block scanning paths with special characters at every
+    // offset, against a simple character by character encoder
+
+    auto reference = [] (std::string_view str) {
+        std::string out;
+        for (char c: str) {
+            switch (c) {
+                case '&':     out += "&amp;"; break;
+                case '<':     out += "&lt;"; break;
+                case '>':     out += "&gt;"; break;
+                case '\"':    out += "&quot;"; break;
+                case '\'':    out += "&apos;"; break;
+                case '\x01':  out += "&#x1;"; break;
+                case '\x1f':  out += "&#x1f;"; break;
+                case '\x7f':  out += "&#x7f;"; break;
+                default:      out += c; break;
+            }
+        }
+        return out;
+    };
+
+    const std::string filler = "Lorem ipsum\tdolor\r\nsit amet \xce\xb1\xce\xb2 consectetur adipiscing elit sed do eiusmod tempor";
+
+    for (char c: std::string_view("&<>\"'\x01\x1f\x7f")) {
+        for (size_t len = 0; len <= 70; ++len) {
+            for (size_t pos = 0; pos <= len; ++pos) {
+                auto str = filler.substr(0, len);
+                str.insert(pos, 1, c);
+                auto xml = encode_text(str);
+                TEST_EQUAL(xml, reference(str));
+                TEST_EQUAL(decode_text(xml), str);
+            }
+        }
+    }
+
+    TEST_EQUAL(encode_text(filler), filler);
+    TEST_EQUAL(decode_text(filler), filler);
+
+}
+
 void test_crow_xml_functions_name_validation() {
 
     TEST(is_valid_name("Hello"));
@@ -0,0 +1,266 @@
+#include "crow/xml.hpp"
+#include "crow/stdio.hpp"
+#include "crow/string.hpp"
+#include "crow/unit-test.hpp"
+#include <cstdio>
+#include <string>
+
+using namespace Crow;
+using namespace Crow::Literals;
+using namespace Crow::Xml;
+
+namespace {
+
+    std::string trace(Reader& reader) {
+        std::string out;
+        while (reader.next()) {
+            out += to_string(reader.event());
+            switch (reader.event()) {
+                case ReaderEvent::start:
+                case ReaderEvent::end:
+                    out += ':' + std::string(reader.name());
+                    break;
+                case ReaderEvent::text:
+                case ReaderEvent::cdata:
+                    out += ':' + quote(reader.text());
+                    break;
+                default:
+                    break;
+            }
+            out += '\n';
+        }
+        return out;
+    }
+
+    std::string trace(std::string_view xml, Options opt = {}) {
+        Reader reader(xml, opt);
+        return trace(reader);
+    }
+
+    const std::string sample = R"(
+        <?xml version="1.0"?>
+        <!DOCTYPE catalog>
+        <catalog>
+        <item id="1" note="A &amp; B"><name>First</name><![CDATA[<raw>]]></item>
+        <!-- comment -->
+        <item id="2"><name>Second</name><flag/></item>
+        <?target instruction?>
+        </catalog>
+        )"_doc;
+
+    const std::string sample_trace = R"(
+        xmldecl
+        dtd
+        start:catalog
+        text:"\n"
+        start:item
+        start:name
+        text:"First"
+        end:name
+        cdata:"<raw>"
+        end:item
+        text:"\n"
+        text:"\n"
+        start:item
+        start:name
+        text:"Second"
+        end:name
+        start:flag
+        end:flag
+        end:item
+        text:"\n"
+        processing
+        text:"\n"
+        end:catalog
+        text:"\n"
+        )"_doc;
+
+}
+
+void test_crow_xml_reader_events() {
+
+    Reader reader(sample);
+    std::string out;
+
+    TEST_EQUAL(reader.event(), ReaderEvent::none);
+    TEST_EQUAL(reader.depth(), 0u);
+
+    TEST(reader.next());
+    TEST_EQUAL(reader.event(), ReaderEvent::xmldecl);
+    TEST_EQUAL(reader.raw(), "<?xml version=\"1.0\"?>");
+    TEST(reader.next());
+    TEST_EQUAL(reader.event(), ReaderEvent::dtd);
+    TEST_EQUAL(reader.raw(), "<!DOCTYPE catalog>");
+    TEST(reader.next());
+    TEST_EQUAL(reader.event(), ReaderEvent::start);
+    TEST_EQUAL(reader.name(), "catalog");
+    TEST_EQUAL(reader.depth(), 1u);
+    TEST(reader.next());
+    TEST_EQUAL(reader.event(), ReaderEvent::text);
+    TEST(reader.next());
+    TEST_EQUAL(reader.event(), ReaderEvent::start);
+    TEST_EQUAL(reader.name(), "item");
+    TEST_EQUAL(reader.depth(), 2u);
+    TEST_EQUAL(reader.attrs().size(), 2u);
+    TEST_EQUAL(reader.attr("id"), "1");
+    TEST_EQUAL(reader.attr_view("note"), "A &amp; B");
+    TEST_EQUAL(reader.attr("note"), "A & B");
+    TEST(reader.has_attr("note"));
+    TEST(! reader.has_attr("missing"));
+    TEST(! reader.is_empty());
+
+    TRY(out = trace(sample));
+    TEST_EQUAL(out, sample_trace);
+
+    TRY(out = trace(sample, Options::comments));
+    TEST_MATCH(out, "\ncomment\n");
+
+}
+
+void test_crow_xml_reader_empty_elements() {
+
+    Reader reader("<a><b x='1'/></a>");
+
+    TEST(reader.next());
+    TEST_EQUAL(reader.name(), "a");
+    TEST(reader.next());
+    TEST_EQUAL(reader.event(), ReaderEvent::start);
+    TEST_EQUAL(reader.name(), "b");
+    TEST_EQUAL(reader.raw(), "<b x='1'/>");
+    TEST_EQUAL(reader.attr("x"), "1");
+    TEST(reader.is_empty());
+    TEST_EQUAL(reader.depth(), 2u);
+    TEST(reader.next());
+    TEST_EQUAL(reader.event(), ReaderEvent::end);
+    TEST_EQUAL(reader.name(), "b");
+    TEST_EQUAL(reader.raw(), "");
+    TEST_EQUAL(reader.depth(), 2u);
+    TEST(reader.next());
+    TEST_EQUAL(reader.event(), ReaderEvent::end);
+    TEST_EQUAL(reader.name(), "a");
+    TEST_EQUAL(reader.raw(), "</a>");
+    TEST_EQUAL(reader.depth(), 1u);
+    TEST(! reader.next());
+    TEST_EQUAL(reader.event(), ReaderEvent::none);
+    TEST_EQUAL(reader.depth(), 0u);
+    TEST(! reader.next());
+
+}
+
+void test_crow_xml_reader_skip() {
+
+    Reader reader(sample);
+    std::string names;
+
+    while (reader.next()) {
+        if (reader.event() == ReaderEvent::start && reader.name() == "item") {
+            names += reader.attr("id");
+            TRY(reader.skip());
+            TEST_EQUAL(reader.event(), ReaderEvent::end);
+            TEST_EQUAL(reader.name(), "item");
+        } else if (reader.event() == ReaderEvent::start) {
+            names += reader.name();
+        }
+    }
+
+    TEST_EQUAL(names, "catalog12");
+
+}
+
+void test_crow_xml_reader_html() {
+
+    std::string out;
+
+    TRY(out = trace("<HTML><Body><P>One<br><P>Two</HTML>", Options::html));
+    TEST_EQUAL(out, R"(
+        start:HTML
+        start:Body
+        start:P
+        text:"One"
+        start:br
+        end:br
+        start:P
+        text:"Two"
+        end:P
+        end:P
+        end:Body
+        end:HTML
+        )"_doc);
+
+    TRY(out = trace("<a><b>text", Options::html));
+    TEST_EQUAL(out, R"(
+        start:a
+        start:b
+        text:"text"
+        end:b
+        end:a
+        )"_doc);
+
+    Reader reader("<p>Hello   &nbsp;\n  world</p></div>", Options::html);
+    TEST(reader.next());
+    TEST_EQUAL(reader.name(), "p");
+    TEST(reader.next());
+    TEST_EQUAL(reader.event(), ReaderEvent::text);
+    TEST_EQUAL(reader.text(), "Hello \xc2\xa0 world");
+    TEST(reader.next());
+    TEST_EQUAL(reader.event(), ReaderEvent::end);
+    TEST(! reader.next());
+
+}
+
+void test_crow_xml_reader_errors() {
+
+    TEST_THROW(trace("<a><b></a>"), Error);
+    TEST_THROW(trace("</a>"), Error);
+    TEST_THROW(trace("<a x=\"1\" x=\"2\"></a>"), Error);
+    TEST_THROW(trace("<a x></a>"), Error);
+    TEST_THROW(trace("<a b"), Error);
+    TEST_THROW(trace("<!-- unclosed"), Error);
+    TEST_THROW(trace("<![CDATA[unclosed"), Error);
+    TEST_THROW(trace("<?target"), Error);
+    TEST_THROW(trace("<!x>"), Error);
+
+}
+
+void test_crow_xml_reader_stream() {
+
+    std::string xml = "<?xml version=\"1.0\"?>\n<list>\n";
+    for (int i = 0; i < 200; ++i)
+        xml += fmt("<entry n=\"{0}\">Entry &lt;{0}&gt;<!-- note --><![CDATA[data]]></entry>\n", i);
+    xml += "</list>\n";
+
+    std::string expect, out;
+    TRY(expect = trace(xml));
+
+    for (size_t block: {16, 100, 4096}) {
+        TempFile file;
+        TRY(file.writes(xml));
+        TRY(file.seek(0, SEEK_SET));
+        Reader reader(file, Options::none, block);
+        TRY(out = trace(reader));
+        TEST_EQUAL(out, expect);
+    }
+
+    TempFile file;
+    TRY(file.writes(xml));
+    TRY(file.seek(0, SEEK_SET));
+    Reader reader(file, Options::none, 16);
+    std::string text;
+    int entries = 0;
+
+    while (reader.next()) {
+        if (reader.event() == ReaderEvent::start && reader.name() == "entry") {
+            ++entries;
+            if (reader.attr("n") == "123") {
+                TEST(reader.next());
+                text = reader.text();
+            } else {
+                TRY(reader.skip());
+            }
+        }
+    }
+
+    TEST_EQUAL(entries, 200);
+    TEST_EQUAL(text, "Entry <123>");
+
+}
@@ -1,12 +1,20 @@
 #include "crow/xml.hpp"
+#include "crow/benchmark.hpp"
+#include "crow/format.hpp"
 #include "crow/string.hpp"
 #include "crow/unit-test.hpp"
+#include <chrono>
+#include <iostream>
 #include <iterator>
+#include <span>
 #include <string>
+#include <thread>
+#include <vector>
 
 using namespace Crow;
 using namespace Crow::Literals;
 using namespace Crow::Xml;
+using namespace std::literals;
 
 namespace {
 
@@ -136,3 +144,221 @@ void test_crow_xml_search_selected() {
     TRY(range = doc->search("india"));    TEST_EQUAL(std::distance(range.begin(), range.end()), 0);
 
 }
+
+void test_crow_xml_search_index() {
+
+    DocumentPtr doc;
+    std::span<const ElementPtr> list;
+    std::string names;
+
+    TRY(doc = Document::create(R"(
+        <catalog>
+        <item id="1"><name>One</name></item>
+        <item id="2"><name>Two</name><item id="3"/></item>
+        <other/>
+        </catalog>
+        )"_doc));
+    REQUIRE(doc);
+
+    TRY(list = doc->elements("item"));
+    REQUIRE(list.size() == 3u);
+    TEST_EQUAL(list[0]->attr("id"), "1");
+    TEST_EQUAL(list[1]->attr("id"), "2");
+    TEST_EQUAL(list[2]->attr("id"), "3");
+    TRY(list = doc->elements("name"));
+    TEST_EQUAL(list.size(), 2u);
+    TRY(list = doc->elements("missing"));
+    TEST(list.empty());
+    TRY(list = doc->elements("ITEM"));
+    TEST(list.empty());
+    TRY(list = doc->elements("ITEM", Options::icase));
+    TEST_EQUAL(list.size(), 3u);
+
+    // Any change to the tree structure invalidates the index
+
+    auto extra = Element::create("item");
+    extra->set_attr("id", "4");
+    TRY(doc->elements("other")[0]->push_back(extra));
+    TRY(list = doc->elements("item"));
+    REQUIRE(list.size() == 4u);
+    TEST_EQUAL(list[3]->attr("id"), "4");
+
+    TRY(list = doc->elements("catalog"));
+    REQUIRE(list.size() == 1u);
+    TRY(list[0]->clear());
+    TRY(list = doc->elements("item"));
+    TEST(list.empty());
+    TRY(list = doc->elements("catalog"));
+    TEST_EQUAL(list.size(), 1u);
+
+}
+
+void test_crow_xml_search_index_isolation() {
+
+    DocumentPtr doc1, doc2, copy;
+    std::span<const ElementPtr> list1, list2;
+
+    TRY(doc1 = Document::create("<a><b/><b/></a>"_doc));
+    TRY(doc2 = Document::create("<a><b/></a>"_doc));
+    REQUIRE(doc1);
+    REQUIRE(doc2);
+
+    // Changes to one document do not invalidate another document's index
+
+    TRY(list1 = doc1->elements("b"));
+    REQUIRE(list1.size() == 2u);
+    TRY(doc2->elements("a")[0]->push_back(Element::create("b")));
+    TRY(Document::create("<x><b/></x>"_doc));
+    TRY(list2 = doc1->elements("b"));
+    TEST_EQUAL(list2.data(), list1.data());
+    TEST_EQUAL(list2.size(), 2u);
+    TEST_EQUAL(doc2->elements("b").size(), 2u);
+
+    // A copied document has its own index
+
+    TRY(copy = std::static_pointer_cast<Document>(doc1->clone()));
+    REQUIRE(copy);
+    TEST_EQUAL(copy->elements("b").size(), 2u);
+    TRY(copy->push_back(Element::create("b")));
+    TEST_EQUAL(copy->elements("b").size(), 3u);
+    TEST_EQUAL(doc1->elements("b").size(), 2u);
+
+}
+
+void test_crow_xml_search_index_threads() {
+
+    static constexpr int threads = 8;
+    static constexpr int items = 100;
+
+    DocumentPtr doc;
+    std::string xml = "<list>";
+    for (int i = 0; i < items; ++i)
+        xml += "<Item/>";
+    xml += "</list>";
+    TRY(doc = Document::create(xml));
+    REQUIRE(doc);
+
+    Query query("//item", Options::icase);
+    std::vector<size_t> counts(3 * threads);
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] {
+            counts[3 * i] = doc->elements("item", Options::icase).size();
+            counts[3 * i + 1] = doc->query(query).size();
+            counts[3 * i + 2] = doc->elements("Item").size();
+        });
+    }
+
+    for (auto& t: workers)
+        t.join();
+
+    for (auto n: counts)
+        TEST_EQUAL(n, size_t(items));
+
+}
+
+void test_crow_xml_search_query() {
+
+    DocumentPtr doc;
+    Query query;
+    std::vector<ElementPtr> result;
+
+    auto ids = [&result] {
+        std::string out;
+        for (auto& e: result)
+            out += e->attr("id");
+        return out;
+    };
+
+    TRY(doc = Document::create(R"(
+        <library>
+        <shelf id="s1" kind="fiction">
+        <book id="b1" lang="en"><title id="t1">A</title></book>
+        <book id="b2" lang="fr"><title id="t2">B</title></book>
+        </shelf>
+        <shelf id="s2" kind="science">
+        <box id="x1"><book id="b3" lang="en"><title id="t3">C</title></book></box>
+        </shelf>
+        </library>
+        )"_doc));
+    REQUIRE(doc);
+
+    TRY(query = Query("book"));
+    TEST_EQUAL(query.str(), "//book");
+    TRY(result = doc->query(query));
+    TEST_EQUAL(ids(), "b1b2b3");
+
+    TRY(result = doc->query(Query("/library/shelf/book")));
+    TEST_EQUAL(ids(), "b1b2");
+    TRY(result = doc->query(Query("/library//book")));
+    TEST_EQUAL(ids(), "b1b2b3");
+    TRY(result = doc->query(Query("/shelf")));
+    TEST_EQUAL(ids(), "");
+    TRY(result = doc->query(Query("//shelf[@kind='science']//title")));
+    TEST_EQUAL(ids(), "t3");
+    TRY(result = doc->query(Query("//book[@lang=\"en\"]/title")));
+    TEST_EQUAL(ids(), "t1t3");
+    TRY(result = doc->query(Query("//shelf/*[@id]")));
+    TEST_EQUAL(ids(), "b1b2x1");
+    TRY(result = doc->query(Query("//shelf/*/book")));
+    TEST_EQUAL(ids(), "b3");
+    TRY(result = doc->query(Query("//book[@lang][@id='b2']")));
+    TEST_EQUAL(ids(), "b2");
+    TRY(result = doc->query(Query("//BOOK[@LANG='fr']", Options::icase)));
+    TEST_EQUAL(ids(), "b2");
+    TRY(result = doc->query(Query("//*")));
+    TEST_EQUAL(result.size(), 10u);
+
+    TRY(query = Query("/library//shelf[@kind='fiction']/book[@lang]"));
+    TEST_EQUAL(query.str(), "/library//shelf[@kind='fiction']/book[@lang]");
+
+    TEST_THROW(Query(""), Error);
+    TEST_THROW(Query("/"), Error);
+    TEST_THROW(Query("a/"), Error);
+    TEST_THROW(Query("a b"), Error);
+    TEST_THROW(Query("a[@]"), Error);
+    TEST_THROW(Query("a[@b=c]"), Error);
+    TEST_THROW(Query("a[@b='c']x"), Error);
+    TEST_THROW(Query("a[@b='c"), Error);
+
+}
+
+void test_crow_xml_search_index_benchmark() {
+
+    std::string xml = "<catalog>\n";
+    for (int i = 0; i < 2000; ++i)
+        xml += fmt("<section><item id=\"{0}\"><name>Item</name><price>{0}</price></item><note/></section>\n", i);
+    xml += "<special><item id=\"special\"/></special>\n</catalog>\n";
+
+    auto doc = Document::create(xml);
+    Query query("//special/item");
+    size_t count = 0;
+
+    TRY(count = std::distance(doc->search("item").begin(), doc->search("item").end()));
+    TEST_EQUAL(count, 2001u);
+    TEST_EQUAL(doc->elements("item").size(), 2001u);
+    TEST_EQUAL(doc->query(query).size(), 1u);
+
+    Benchmark<> bench(1);
+
+    auto tree = bench.run([&] {
+        size_t n = 0;
+        for (auto& node: doc->search("special"))
+            n += node != nullptr;
+        return n;
+    }, 100ms);
+
+    auto indexed = bench.run([&] {
+        return doc->elements("special").size();
+    }, 100ms);
+
+    auto compiled = bench.run([&] {
+        return doc->query(query).size();
+    }, 100ms);
+
+    std::cout << "... Search for a rare element: tree walk " << tree.average.count() / 1000 << " us, "
+        << "index " << indexed.average.count() << " ns, "
+        << "query " << compiled.average.count() << " ns\n";
+
+}
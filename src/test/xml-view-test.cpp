@@ -0,0 +1,281 @@
+#include "crow/xml.hpp"
+#include "crow/benchmark.hpp"
+#include "crow/string.hpp"
+#include "crow/unit-test.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+    #include <sys/resource.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+#endif
+
+using namespace Crow;
+using namespace Crow::Literals;
+using namespace Crow::Xml;
+using namespace std::literals;
+
+namespace {
+
+    std::string synthetic_document(size_t bytes) {
+        std::string xml = "<?xml version=\"1.0\"?>\n<catalog>\n";
+        for (int i = 0; xml.size() < bytes; ++i) {
+            auto n = std::to_string(i);
+            xml += "<item id=\"" + n + "\" class=\"product &amp; service\">"
+                "<name>Item number " + n + "</name>"
+                "<price currency=\"NZD\">" + n + ".99</price>"
+                "<note>Some text with &lt;markup&gt; &#x41; inside</note>"
+                "<flag/>"
+                "</item>\n";
+        }
+        xml += "</catalog>\n";
+        return xml;
+    }
+
+    #ifdef __linux__
+
+        long peak_rss_kb() {
+            rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            return usage.ru_maxrss;
+        }
+
+        // Run the function in a child process, so that each measurement
+        // starts from the same baseline, and return the peak RSS growth
+
+        template <typename F>
+        long peak_rss_growth_kb(F f) {
+            int fds[2];
+            if (pipe(fds) != 0)
+                return -1;
+            auto pid = fork();
+            if (pid == 0) {
+                close(fds[0]);
+                auto before = peak_rss_kb();
+                f();
+                long growth = peak_rss_kb() - before;
+                auto rc = write(fds[1], &growth, sizeof(growth));
+                _exit(rc == sizeof(growth) ? 0 : 1);
+            }
+            close(fds[1]);
+            long growth = -1;
+            if (pid > 0) {
+                if (read(fds[0], &growth, sizeof(growth)) != sizeof(growth))
+                    growth = -1;
+                waitpid(pid, nullptr, 0);
+            }
+            close(fds[0]);
+            return growth;
+        }
+
+    #endif
+
+}
+
+void test_crow_xml_view_structure() {
+
+    DocumentView doc;
+    NodeView node, child;
+
+    TEST_EQUAL(doc.nodes(), 1u);
+    TEST_EQUAL(doc.root().type(), NodeType::document);
+    TEST(! doc.document_element());
+
+    TRY(doc = DocumentView(R"(
+        <?xml version="1.0"?>
+        <!DOCTYPE html>
+        <root a="1" b='two'>
+        <alpha>Hello</alpha>
+        <beta/>
+        <!-- comment -->
+        <![CDATA[<raw>]]>
+        <?target instruction?>
+        </root>
+        )"_doc));
+
+    TEST_EQUAL(doc.source().substr(0, 5), "<?xml");
+    TRY(node = doc.root());
+    TEST_EQUAL(node.children(), 4u);
+    TEST_EQUAL(node.first_child().type(), NodeType::xmldecl);
+    TEST_EQUAL(node.first_child().raw(), "<?xml version=\"1.0\"?>");
+    TEST_EQUAL(node.first_child().next_sibling().type(), NodeType::dtd);
+    TEST(! node.parent());
+
+    TRY(node = doc.document_element());
+    REQUIRE(node);
+    TEST_EQUAL(node.type(), NodeType::element);
+    TEST_EQUAL(node.name(), "root");
+    TEST(node.parent() == doc.root());
+    TEST_EQUAL(node.raw().substr(0, 6), "<root ");
+    TEST_EQUAL(node.raw().substr(node.raw().size() - 7), "</root>");
+    TEST_EQUAL(node.num_attrs(), 2u);
+    TEST_EQUAL(node.attr("a"), "1");
+    TEST_EQUAL(node.attr("b"), "two");
+    TEST_EQUAL(node.attr("c"), "");
+    TEST(node.has_attr("a"));
+    TEST(! node.has_attr("c"));
+
+    std::vector<NodeType> types;
+    for (auto& n: node)
+        types.push_back(n.type());
+    TEST_EQUAL(types.size(), 10u);
+    TEST_EQUAL(node.children(), 10u);
+
+    TRY(child = node.child("alpha"));
+    REQUIRE(child);
+    TEST_EQUAL(child.text(), "Hello");
+    TEST_EQUAL(child.raw(), "<alpha>Hello</alpha>");
+    TEST_EQUAL(child.children(), 1u);
+    TEST(child.parent() == node);
+
+    TRY(child = node.child("beta"));
+    REQUIRE(child);
+    TEST(child.empty());
+    TEST_EQUAL(child.raw(), "<beta/>");
+
+    TEST(! node.child("gamma"));
+    TEST_EQUAL(node.last_child().type(), NodeType::text);
+
+    size_t cdata = 0, processing = 0, comments = 0;
+    for (auto& n: node) {
+        cdata += int(n.type() == NodeType::cdata);
+        processing += int(n.type() == NodeType::processing);
+        comments += int(n.type() == NodeType::comment);
+    }
+    TEST_EQUAL(cdata, 1u);
+    TEST_EQUAL(processing, 1u);
+    TEST_EQUAL(comments, 0u);
+
+}
+
+void test_crow_xml_view_text() {
+
+    DocumentView doc;
+    NodeView node;
+
+    TRY(doc = DocumentView("<p title=\"&lt;x&gt;\">One &amp; <b>two</b> <![CDATA[&three]]></p>"));
+    TRY(node = doc.document_element());
+    REQUIRE(node);
+    TEST_EQUAL(node.attr_view("title"), "&lt;x&gt;");
+    TEST_EQUAL(node.attr("title"), "<x>");
+    TEST_EQUAL(node.first_child().raw(), "One &amp; ");
+    TEST_EQUAL(node.first_child().text(), "One & ");
+    TEST_EQUAL(node.text(), "One & two &three");
+    TEST_EQUAL(doc.root().text(), "One & two &three");
+
+    auto attrs = node.attrs();
+    REQUIRE(attrs.size() == 1u);
+    TEST_EQUAL(attrs[0].key, "title");
+    TEST_EQUAL(attrs[0].value, "&lt;x&gt;");
+
+    TRY(doc = DocumentView("<p>Hello   &nbsp;\n  world</p>", Options::html));
+    TRY(node = doc.document_element());
+    REQUIRE(node);
+    TEST_EQUAL(node.text(), "Hello \xc2\xa0 world");
+
+}
+
+void test_crow_xml_view_options() {
+
+    DocumentView doc;
+    NodeView node;
+
+    TEST_THROW(DocumentView("<a><b></a>"), Error);
+    TEST_THROW(DocumentView("</a>"), Error);
+    TEST_THROW(DocumentView("<a></a></b>"), Error);
+    TEST_THROW(DocumentView("<a x=\"1\" x=\"2\"></a>"), Error);
+    TEST_THROW(DocumentView("<a x></a>"), Error);
+    TEST_THROW(DocumentView("<!-- unclosed"), Error);
+
+    // Entities are not checked until the text is decoded
+
+    TRY(doc = DocumentView("<a>&</a>"));
+    TRY(node = doc.document_element());
+    REQUIRE(node);
+    TEST_EQUAL(node.first_child().raw(), "&");
+    TEST_EQUAL(node.text(), "&");
+
+    TRY(doc = DocumentView("<a><!-- note --></a>", Options::comments));
+    TRY(node = doc.document_element());
+    REQUIRE(node);
+    TEST_EQUAL(node.first_child().type(), NodeType::comment);
+    TEST_EQUAL(node.first_child().raw(), "<!-- note -->");
+
+    TRY(doc = DocumentView("<HTML><Body CLASS=main><P>One<br><P>Two</HTML>", Options::html));
+    TRY(node = doc.document_element());
+    REQUIRE(node);
+    TEST_EQUAL(node.name(), "HTML");
+    TEST_EQUAL(node.raw(), "<HTML><Body CLASS=main><P>One<br><P>Two</HTML>");
+    TRY(node = node.child("body"));
+    REQUIRE(node);
+    TEST_EQUAL(node.attr("class"), "main");
+    TEST_EQUAL(node.children(), 1u);
+    TRY(node = node.child("p"));
+    REQUIRE(node);
+    TEST_EQUAL(node.children(), 3u);
+    TEST_EQUAL(node.first_child().next_sibling().name(), "br");
+    TEST_EQUAL(node.last_child().name(), "P");
+    TEST_EQUAL(node.text(), "OneTwo");
+
+    TRY(doc = DocumentView("<input disabled>", Options::html));
+    TRY(node = doc.document_element());
+    REQUIRE(node);
+    TEST_EQUAL(node.attr("disabled"), "disabled");
+    TEST(node.empty());
+
+}
+
+void test_crow_xml_view_move() {
+
+    DocumentView doc("<a><b>text</b></a>");
+    NodeView node = doc.document_element().child("b");
+    DocumentView moved = std::move(doc);
+
+    REQUIRE(node);
+    TEST_EQUAL(node.text(), "text");
+    TEST(node.parent() == moved.document_element());
+    TEST(moved.memory() > moved.source().size());
+
+}
+
+void test_crow_xml_view_benchmark() {
+
+    auto xml = synthetic_document(200'000);
+    auto mb = double(xml.size()) / 1e6;
+    Benchmark<> bench(1);
+    size_t count = 0;
+
+    auto view_result = bench.run([&] {
+        DocumentView doc(xml);
+        count = doc.nodes();
+        return count;
+    }, 200ms);
+
+    auto dom_result = bench.run([&] {
+        auto doc = Document::create(xml);
+        return doc->children();
+    }, 200ms);
+
+    TEST(count > 5'000u);
+
+    auto view_rate = int(1e9 * mb / double(view_result.average.count()));
+    auto dom_rate = int(1e9 * mb / double(dom_result.average.count()));
+    std::cout << "... XML parse: view " << view_rate << " MB/s, DOM " << dom_rate << " MB/s\n";
+
+    #ifdef __linux__
+
+        xml = synthetic_document(8'000'000);
+        auto view_kb = peak_rss_growth_kb([&] { DocumentView doc(xml); });
+        auto dom_kb = peak_rss_growth_kb([&] { auto doc = Document::create(xml); });
+
+        TEST(view_kb >= 0);
+        TEST(dom_kb >= 0);
+        std::cout << "... XML peak RSS growth for " << xml.size() / 1'000'000 << " MB: view "
+            << view_kb / 1024 << " MB, DOM " << dom_kb / 1024 << " MB\n";
+
+    #endif
+
+}